@@ -0,0 +1,117 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+
+#include <EzBinaryFileSink.h>
+#include <EzStdoutSink.h>
+
+// Prints a log file written by EzBinaryFileSink in the same format as EzStdoutSink
+namespace {
+	struct Site {
+		std::string file;
+		uint32_t line;
+	};
+
+	template <typename T>
+	bool
+	Read(std::istream& stream, T& value) {
+		return (bool) stream.read(reinterpret_cast<char*>(&value), sizeof(value));
+	}
+
+	void
+	Decode(std::istream& stream) {
+		char magic[sizeof(EzBinaryFileSink::MAGIC)];
+		if (!stream.read(magic, sizeof(magic)) || memcmp(magic, EzBinaryFileSink::MAGIC, sizeof(magic)) != 0) {
+			throw std::runtime_error("Not a binary log file");
+		}
+
+		std::map<uint32_t, Site> sites;
+		EzStdoutSink sink;
+		char arguments[EzMessage::ARGUMENTS_SIZE];
+		char record;
+		while (Read(stream, record)) {
+			uint32_t id;
+			if (record == EzBinaryFileSink::RECORD_SITE) {
+				Site site;
+				uint16_t fileLength;
+				if (!Read(stream, id) || !Read(stream, site.line) || !Read(stream, fileLength)) {
+					break;
+				}
+				site.file.resize(fileLength);
+				if (!stream.read(&site.file[0], fileLength)) {
+					break;
+				}
+				sites[id] = site;
+			} else if (record == EzBinaryFileSink::RECORD_MESSAGE) {
+				uint16_t level;
+				uint64_t microTime;
+				uint8_t truncated;
+				uint16_t size;
+				if (!Read(stream, id) || !Read(stream, level) || !Read(stream, microTime) || !Read(stream, truncated)
+						|| !Read(stream, size) || size > sizeof(arguments) || !stream.read(arguments, size)) {
+					break;
+				}
+				const std::map<uint32_t, Site>::const_iterator site = sites.find(id);
+				if (site == sites.end()) {
+					throw std::runtime_error("Message refers to unknown log statement [" + std::to_string(id) + "]");
+				}
+				EzMessage message(level, site->second.file.empty() ? nullptr : site->second.file.c_str(), site->second.line);
+				message.setMicroTime(microTime);
+				message.setArguments(arguments, size, truncated != 0);
+				sink.write(message);
+			} else {
+				throw std::runtime_error("Corrupt log file, unknown record type");
+			}
+		}
+		sink.flush();
+		if (!stream.eof()) {
+			throw std::runtime_error("Unable to read log file");
+		}
+	}
+}
+
+int main(int argc, char* argv[]) {
+	if (argc != 2) {
+		std::cerr << "Usage: " << argv[0] << " <binary log file>" << std::endl;
+		return 2;
+	}
+
+	try {
+		std::ifstream file(argv[1], std::ios::in | std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("Unable to open [" + std::string(argv[1]) + "]");
+		}
+		Decode(file);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
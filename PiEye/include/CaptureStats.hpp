@@ -0,0 +1,47 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+// Distribution of a duration, in microseconds. Percentiles are accurate to about 6%.
+struct DurationStats {
+	unsigned long long count;
+	float p50;
+	float p99;
+	float max;
+};
+
+// Snapshot of the video path since the camera was created or the stats were reset. Frames arrive when the video
+// callback receives them; the pts of the camera is only used for the interval between frames.
+struct CaptureStats {
+	unsigned long long frames;			// Non-empty video buffers that arrived
+	float fps;							// Frames per second between the first and the last arrival
+	DurationStats frameInterval;		// Between the pts of consecutive frames, as captured by the camera
+	DurationStats decode;				// Decoding a frame out of the camera buffer
+	DurationStats delivery;				// From arrival until the frame was queued, promised and offered to subscribers
+	DurationStats latency;				// From arrival until grabFrame or popFrame returned the frame
+	DurationStats blackout;				// From the last frame before a reconfiguration until the first one after it
+	DurationStats motion;				// Comparing a frame against the motion background, while motion detection runs
+	unsigned long long emptyBuffers;	// Buffers without data, skipped
+	unsigned long long poolStarvations;	// Times the video port could not be fed because the pool had no free buffer
+	unsigned long long waitTimeouts;	// Grabs that gave up waiting for a frame or a still
+};
@@ -0,0 +1,59 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// Elementary stream the video encoder produces
+enum class VideoCodec {
+	H264,
+	MJPEG
+};
+
+// Higher profiles compress better for the same bitrate, but fewer decoders play them
+enum class H264Profile {
+	BASELINE,
+	MAIN,
+	HIGH
+};
+
+// How recorded video is encoded. Fields left 0 take the defaults: 17 Mbit/s and a key frame every 60 frames.
+struct EncoderSettings {
+	VideoCodec codec;
+	unsigned int bitrate;		// Bits per second, at most 25 Mbit/s for H.264
+	unsigned int intraPeriod;	// Frames from one key frame to the next, i.e. the GOP length. H.264 only.
+	H264Profile profile;		// H.264 only
+};
+
+// Piece of the elementary stream, only valid during the handler call
+struct EncodedChunk {
+	const uint8_t* data;
+	unsigned int length;
+	long long pts;		// Of the video frame the chunk belongs to
+	bool keyFrame;		// Part of a frame that decodes on its own
+	bool config;		// Stream headers, i.e. the SPS and PPS of H.264, rather than frame data
+	bool frameEnd;		// Last chunk of a frame
+};
+
+typedef std::function<void(const EncodedChunk& chunk)> EncodedHandler;
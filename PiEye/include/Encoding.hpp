@@ -24,5 +24,6 @@ SOFTWARE.
 
 enum class Encoding {
 	NATIVE_BGR,
-	NATIVE_GRAYSCALE	// I420 encoding, only copying the Y (luminance) component into cv::Mat
+	NATIVE_GRAYSCALE,	// I420 encoding, only copying the Y (luminance) component into cv::Mat
+	CONVERTED_BGR		// I420 encoding, converted to BGR by the ARM cores. Half the transfer of NATIVE_BGR, can't be leased.
 };
@@ -0,0 +1,52 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include "FrameSettings.hpp"
+
+// What the software exposure control aims for. Fields left 0 take the defaults: the mean within 4 levels, at most
+// 33 ms of shutter, 8x analog and no digital gain. Longer exposures than the shutter allows are made up with gain.
+struct ExposureTarget {
+	float intensity;				// Luminance to reach, 1 to 254
+	float percentile;				// 0 aims the mean at the intensity, 0.99 the level below which 99% of the pixels lie
+	float tolerance;				// Levels off the intensity that count as reached
+	unsigned int maxExposureMicros;
+	float maxAnalogGain;
+	float maxDigitalGain;
+};
+
+// Response of the sensor below clipping: luminance grows with (exposure * analog gain * digital gain) ^ gamma. The
+// controller jumps from the luminance of a frame to the exposure of the target with it. 0 takes 1, a linear sensor.
+struct ExposureModel {
+	float gamma;
+};
+
+struct ExposureStats {
+	bool converged;					// The latest frame lies within the tolerance
+	float intensity;				// Of the latest frame, measured as the target asks
+	FrameSettings settings;			// Reported with the latest frame
+	unsigned int framesToConverge;	// Frames from the start, or from the last frame that left the tolerance, until the
+	float millisToConverge;			// first one within it again. 0 until converged once.
+	unsigned int convergences;
+	unsigned int adjustments;		// Settings sent to the camera
+};
@@ -0,0 +1,66 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "EzSink.h"
+
+/**
+ * Writes messages unformatted: the raw arguments plus a reference to the log statement they came from. File and line of
+ * each log statement are only written the first time it logs. Use EzLogDecode to turn the file into text.
+ *
+ * File layout, in native byte order: MAGIC, then records starting with RECORD_SITE or RECORD_MESSAGE.
+ * - site: uint32 id, uint32 line, uint16 file length, file
+ * - message: uint32 site id, uint16 level, uint64 micro time, uint8 truncated, uint16 arguments size, arguments
+ */
+class EzBinaryFileSink : public EzSink {
+public:
+    static const char MAGIC[8];
+    static const char RECORD_SITE = 'S';
+    static const char RECORD_MESSAGE = 'M';
+    
+    explicit EzBinaryFileSink(const std::string& path);
+    
+    virtual void
+    write(const EzMessage& message);
+    
+    virtual void
+    flush();
+
+private:
+    std::ofstream _file;
+    std::map<std::pair<const char*, unsigned int>, unsigned int> _sites;
+    
+    unsigned int
+    getSite(const EzMessage& message);
+    
+    template <typename T>
+    void
+    put(T value) {
+        _file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+};
@@ -22,16 +22,58 @@ SOFTWARE.
 */
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 #include "EzMessage.h"
+#include "EzSink.h"
+
+template <typename T> class RingBuffer;
 
 class EzLogger {
 public:
+    EzLogger();
+    virtual ~EzLogger();
+    
     static EzLogger&
     GetDefault();
     
     virtual void
     log(const EzMessage& message);
+    
+    // Defaults to stdout
+    void
+    setSink(const std::shared_ptr<EzSink>& sink);
+    
+    // From now on log only queues the message, a background thread writes it. Messages are dropped rather than waited
+    // for once queueSize messages are pending. Other threads may keep logging while it starts and stops.
+    void
+    startAsync(unsigned int queueSize);
+    
+    // Writes out the pending messages and goes back to writing on the logging thread
+    void
+    stopAsync();
+    
+    unsigned long long
+    getDropped() const;
 
 private:
-    static EzLogger* _instance;
-};
\ No newline at end of file
+    std::shared_ptr<EzSink> _sink;
+    std::mutex _sinkMutex;
+    std::unique_ptr<RingBuffer<EzMessage> > _queue;	// Producers claim slots with a CAS and never wait
+    std::atomic<bool> _async;
+    std::atomic<unsigned int> _pushing;	// Loggers that saw async mode on and may still push
+    std::atomic<bool> _writing;
+    std::thread _writer;
+    
+    void
+    write();
+    
+    void
+    drain(EzMessage& message);
+    
+    EzLogger(const EzLogger&);
+    EzLogger& operator=(const EzLogger&);
+};
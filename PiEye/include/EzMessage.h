@@ -24,10 +24,22 @@ SOFTWARE.
 
 #include <string>
 
+/**
+ * A log message that records its raw arguments into an inline buffer instead of formatting them, so building one never
+ * allocates. Formatting is left to whoever reads the message. Arguments that don't fit are cut off.
+ */
 class EzMessage {
 public:
+    static const unsigned short ARGUMENTS_SIZE = 480;
+    
+    // Empty message of level 0, e.g. for the slots of a queue
+    EzMessage();
     EzMessage(unsigned short level);
     EzMessage(unsigned short level, const char* file, const unsigned int line);
+    EzMessage(const EzMessage& other);
+    
+    EzMessage&
+    operator=(const EzMessage& other);
     
     unsigned short
     getLevel() const;
@@ -41,7 +53,8 @@ public:
     void
     setMicroTime(unsigned long long microTime);
     
-    const std::string&
+    // Formats the arguments
+    std::string
     getMessage() const;
     
     void
@@ -53,6 +66,19 @@ public:
     unsigned int
     getLine() const;
     
+    // Raw arguments, as written by the binary sink
+    const char*
+    getArguments() const;
+    
+    unsigned short
+    getArgumentsSize() const;
+    
+    bool
+    isTruncated() const;
+    
+    void
+    setArguments(const char* arguments, unsigned short size, bool truncated);
+    
     EzMessage&
     operator<<(const char* value);
 	
@@ -70,14 +96,34 @@ public:
     
     EzMessage&
     operator<<(const unsigned long value);
+    
+    EzMessage&
+    operator<<(const long value);
+    
+    EzMessage&
+    operator<<(const unsigned long long value);
+    
+    EzMessage&
+    operator<<(const long long value);
 	
 	EzMessage&
     operator<<(const float value);
     
+    EzMessage&
+    operator<<(const double value);
+    
 private:
     const char* _file;
     unsigned short _level;
-    const unsigned int _line;
+    unsigned int _line;
     unsigned long long _microTime;
-    std::string _message;
+    unsigned short _size;
+    bool _truncated;
+    char _arguments[ARGUMENTS_SIZE];
+    
+    void
+    append(char type, const void* value, unsigned short size);
+    
+    void
+    appendString(const char* value, size_t length);
 };
@@ -0,0 +1,53 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <fstream>
+#include <string>
+
+#include "EzSink.h"
+
+// Appends to a file, which is moved to <path>.1 once it reaches maxBytes. Older files shift up to <path>.<maxFiles>.
+class EzRotatingFileSink : public EzSink {
+public:
+    EzRotatingFileSink(const std::string& path, unsigned long maxBytes, unsigned int maxFiles);
+    
+    virtual void
+    write(const EzMessage& message);
+    
+    virtual void
+    flush();
+
+private:
+    const std::string _path;
+    const unsigned long _maxBytes;
+    const unsigned int _maxFiles;
+    std::ofstream _file;
+    unsigned long _size;
+    
+    void
+    open();
+    
+    void
+    rotate();
+};
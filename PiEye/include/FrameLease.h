@@ -0,0 +1,54 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <memory>
+
+namespace cv {
+    class Mat;
+}
+
+/**
+ * Zero-copy view on a frame, pointing straight into the camera buffer.
+ *
+ * The camera buffer stays out of the pool for as long as any copy of the lease exists and is handed back to the camera
+ * when the last copy is released. Note that copies of the cv::Mat itself do not extend the lease: clone the image if the
+ * pixels are needed after the lease is gone. Leases should be released before the camera is destroyed.
+ */
+class FrameLease {
+public:
+	FrameLease();
+	explicit FrameLease(const std::shared_ptr<cv::Mat>& image);
+
+	const cv::Mat&
+	getImage() const;
+
+	bool
+	isValid() const;
+
+	void
+	release();
+
+private:
+	std::shared_ptr<cv::Mat> _image;
+};
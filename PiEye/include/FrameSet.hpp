@@ -0,0 +1,43 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "CaptureStats.hpp"
+
+// Frames of all cameras of a rig taken at about the same time. Times are capture times in microseconds of the
+// steady clock, which the pts of every camera is mapped onto.
+struct FrameSet {
+	std::vector<cv::Mat> frames;	// One per camera, in the order of the cameras
+	std::vector<long long> times;
+	long long skewMicros;			// Between the earliest and the latest frame of the set
+};
+
+struct FrameSetStats {
+	unsigned long long sets;
+	unsigned long long unmatched;					// Frames without a partner within the tolerance, dropped
+	std::vector<unsigned long long> unmatchedByCamera;
+	DurationStats skew;
+};
@@ -0,0 +1,55 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Which statistics are computed on the luminance of video frames: the Y plane of I420 encodings, (B + 2G + R) / 4 for
+// NATIVE_BGR. Fields left 0 take the defaults: the whole frame without grid, every row, clipped at 0 and 255.
+struct StatisticsSettings {
+	unsigned int gridColumns;	// Cells across the frame, of equal size as far as the frame divides
+	unsigned int gridRows;
+	unsigned int rowStep;		// 2 reads every second row, 4 every fourth
+	uint8_t darkLevel;			// Pixels at or below are clipped dark
+	uint8_t brightLevel;		// Pixels at or above are clipped bright
+};
+
+// Luminance of a frame, or of a cell of the grid
+struct LuminanceStats {
+	float mean;
+	uint8_t min;
+	uint8_t max;
+	float darkFraction;		// Of the pixels read
+	float brightFraction;
+};
+
+struct FrameStatistics {
+	long long pts;							// Of the frame
+	unsigned int gridColumns;				// 0 without grid
+	unsigned int gridRows;
+	unsigned int pixels;					// Read, i.e. every rowStep-th row
+	LuminanceStats frame;
+	std::vector<LuminanceStats> cells;		// Row by row
+	unsigned int histogram[256];			// Of the whole frame
+};
@@ -0,0 +1,51 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <functional>
+
+namespace cv {
+	class Mat;
+}
+
+// How motion is found on the luma plane of video frames. The frame is cut into square blocks, and every rowStep-th row
+// of a block is compared with a background that slowly follows the frames. A block moves when its pixels differ from
+// the background by more than threshold on average.
+struct MotionSettings {
+	unsigned int blockSize;		// Pixels, a multiple of 16. Edges of the frame that don't fill a block are ignored.
+	unsigned int rowStep;		// 1 compares every row, 4 every fourth. Must divide blockSize.
+	unsigned int threshold;		// Mean absolute difference per pixel, 1 to 255
+	unsigned int minBlocks;		// Moving blocks it takes for the frame to move
+	unsigned int learningShift;	// 1 to 4: the background moves 1/2^learningShift of the way to every frame
+};
+
+// A frame that moved
+struct MotionEvent {
+	long long pts;				// Of the frame
+	unsigned int movingBlocks;
+	unsigned int blocks;		// In the whole grid
+	bool started;				// The frame before did not move
+};
+
+// The mask is a CV_8U image with one pixel per block, 255 where the block moves. Only valid during the handler call.
+typedef std::function<void(const MotionEvent& event, const cv::Mat& mask)> MotionHandler;
@@ -22,9 +22,25 @@ SOFTWARE.
 */
 #pragma once
 
+#include <future>
+#include <functional>
+#include <string>
+#include <vector>
 #include "SensorMode.hpp"
 #include "Encoding.hpp"
 #include "AwbMode.hpp"
+#include "QueuePolicy.hpp"
+#include "SubscriberPolicy.hpp"
+#include "SyntheticSource.hpp"
+#include "CaptureStats.hpp"
+#include "FrameSettings.hpp"
+#include "StartupTimeline.hpp"
+#include "EncoderSettings.hpp"
+#include "EventRecordingStats.hpp"
+#include "MotionSettings.hpp"
+#include "FrameStatistics.hpp"
+#include "ExposureControl.hpp"
+#include "FrameLease.h"
 
 namespace cv {
     class Mat;
@@ -36,6 +52,10 @@ class PiEye {
 public:
 
     PiEye();
+    // Camera on the given CSI port of boards with more than one, e.g. 1 for the second camera of a Compute Module
+    explicit PiEye(unsigned int cameraNumber);
+    // Camera without camera hardware, delivering generated frames
+    explicit PiEye(const SyntheticSource& source);
     ~PiEye();
 
     void
@@ -44,21 +64,261 @@ public:
     void
     destroyCamera();
 	
+	// Size of video frames and stills. Defaults to 1280x720. Changing it on a created camera reconfigures it.
+	void
+	setResolution(unsigned short width, unsigned short height);
+	
+	// Size of video frames only, e.g. small frames for analytics next to full size stills. The camera reserves memory
+	// for the sizes set when it is created, larger ones later on briefly pause it.
+	void
+	setVideoResolution(unsigned short width, unsigned short height);
+	
+	// Size of stills only. A still port that is open closes and opens again in the new size with the next still.
+	void
+	setStillResolution(unsigned short width, unsigned short height);
+	
+	// Frame rate of the video port, 0 to let the camera choose within its fps range. Defaults to 0.
+	void
+	setFrameRate(unsigned short fps);
+	
+	// Changes size and encoding of video frames and stills without destroying the camera. Running video only loses the
+	// frames of a short blackout, reported by getStats(): the video port is disabled, given the new format and enabled
+	// again, keeping its buffers if they fit. The still port is closed if the format changes and opens again with the
+	// next still. Extra streams are rebuilt along with video.
+	void
+	reconfigure(unsigned short width, unsigned short height, const Encoding& encoding);
+	
 	void
 	startVideo();
 	
+	// Creates the camera and starts video on a thread of its own, and opens the still port meanwhile. The future is
+	// ready once the still port is, other calls must wait for it. With settle, video frames are discarded until
+	// exposure and white balance settled, at most 30 of them, so grabFrame() and the subscribers only see settled
+	// frames. That goes on alongside: stills are not held back, and one taken before the ready time of the timeline may
+	// be exposed before the settings settled. Without settle nothing is discarded.
+	std::future<void>
+	startAsync(bool settle = true);
+	
+	// Where the time of the last startAsync went
+	StartupTimeline
+	getStartupTimeline() const;
+	
 	void
 	stopVideo();
 	
+	// Takes the oldest queued frame, waiting for one if the queue is empty
 	void
 	grabFrame(cv::Mat& data);
+	
+	// Like grabFrame, but skips frames until one was exposed with the shutter speed and gains last set, and returns the
+	// settings the camera reported for it. Settings left on auto are not waited for. Times out after 5 s if the camera
+	// can't reach the settings, e.g. a shutter speed longer than the frame rate allows.
+	void
+	grabFrameWithSettings(cv::Mat& data, FrameSettings& settings);
+	
+	// Like grabFrame, with the statistics of that very frame. Frames queued before statistics were started are skipped.
+	void
+	grabFrameWithStatistics(cv::Mat& data, FrameStatistics& statistics);
+	
+	// Takes one video frame per bracket: frames[i] is exposed with brackets[i] and settings[i] holds what the camera
+	// reported for it. Every frame that comes in sends out the next bracket, so a sweep takes about one frame period per
+	// bracket plus the few frames the camera needs to apply settings. Fields left 0 keep their current value, white
+	// balance gains need AwbMode::OFF, and the camera stays on the last bracket afterwards. Times out like
+	// grabFrameWithSettings when a bracket can't be reached.
+	void
+	grabBracket(const std::vector<FrameSettings>& brackets, std::vector<cv::Mat>& frames, std::vector<FrameSettings>& settings);
+	
+	// Takes the oldest queued frame if there is one, never waits
+	bool
+	popFrame(cv::Mat& data);
+	
+	// Frame queue between the camera and grabFrame/popFrame, must be set while video is stopped. Only one thread
+	// should consume frames. Defaults to a single, always fresh frame.
+	void
+	setFrameQueue(unsigned int depth, const QueuePolicy& policy);
+	
+	unsigned long long
+	getDroppedFrames() const;
+	
+	// Latency, throughput and losses of the video path. Recording is lock-free and always on, a snapshot can be taken
+	// from any thread at any time.
+	CaptureStats
+	getStats() const;
+	
+	void
+	resetStats();
+	
+	// Decodes video frames at 1/2 or 1/4 of the size, averaging blocks of pixels straight from the camera buffer. Applies
+	// to grabbed, queued, async and subscribed frames, not to leases. Must be set while video is stopped. Not supported
+	// with CONVERTED_BGR.
+	void
+	setFrameDivisor(unsigned int divisor);
+	
+	// Decodes video frames on this many worker threads instead of the camera callback thread, which then only hands the
+	// buffer over. Large frames are split into slices of rows that all workers decode together; frames are still
+	// delivered in order, together with motion detection, statistics, pyramids and leases. 0, the default, decodes on
+	// the callback thread. Must be set while video is stopped.
+	void
+	setDecodeWorkers(unsigned int workers);
+	
+	unsigned int
+	getDecodeWorkers() const;
+	
+	// Grabs the next frame at full size plus levelCount - 1 halved copies, decoded in one pass. Not supported with
+	// CONVERTED_BGR.
+	void
+	grabFramePyramid(std::vector<cv::Mat>& levels, unsigned int levelCount);
+	
+	// Grabs the next frame without copying it out of the camera buffer. Throws a TimeOutException if no frame could be
+	// leased within 30 seconds, the returned lease is always valid.
+	FrameLease
+	grabFrameLease();
+	
+	// Requests the next frame without waiting for it. Requests in flight together receive consecutive frames; pending
+	// requests fail when video is stopped.
+	std::future<cv::Mat>
+	grabFrameAsync();
+	
+	// Calls the handler with every video frame on a thread of its own, until unsubscribed. Each subscriber queues up
+	// to queueDepth frames, the policy decides what is dropped when it falls behind. With DECIMATE only every
+	// decimation-th frame is taken. Frames are shared between subscribers: clone before modifying.
+	unsigned int
+	subscribe(const std::function<void(const cv::Mat&)>& handler, const SubscriberPolicy& policy = SubscriberPolicy::DROP_OLDEST,
+			unsigned int queueDepth = 4, unsigned int decimation = 1);
+	
+	// Waits for a running handler to finish, so must not be called from the handler itself
+	void
+	unsubscribe(unsigned int id);
+	
+	SubscriberStats
+	getSubscriberStats(unsigned int id) const;
+	
+	// Adds a video stream of its own size and encoding, scaled by the GPU next to the regular frames. Returns the number
+	// of the stream, counting from 0. At most 3 streams, with even sizes, added while video is stopped.
+	unsigned int
+	addStream(unsigned short width, unsigned short height, const Encoding& encoding);
+	
+	void
+	clearStreams();
+	
+	// Takes the latest frame of a stream, waiting for one if it was already taken
+	void
+	grabStreamFrame(unsigned int stream, cv::Mat& data);
+	
+	// Records video into an H.264 or MJPEG elementary stream with the hardware encoder, while frames keep coming as
+	// usual. Chunks of the stream go to the handler from a thread of the camera. Recording pauses while video is
+	// stopped and goes on when it starts again, until stopRecording. The encoder takes a splitter output of the extra
+	// streams, so only 2 streams can be added, and video that runs without streams restarts once to branch it off.
+	// H.264 encodes at most 1920x1080 and repeats its headers with every key frame.
+	void
+	startRecording(const EncoderSettings& settings, const EncodedHandler& handler);
+	
+	// Records into a file, e.g. an .h264 file that ffmpeg or VLC play back
+	void
+	startRecording(const EncoderSettings& settings, const std::string& path);
+	
+	void
+	stopRecording();
+	
+	bool
+	isRecording() const;
+	
+	// Records like startRecording, but only into a ring of memoryBytes in memory that keeps at least the last
+	// preRollSeconds, from a key frame on, as far as the memory allows. Nothing reaches the disk until triggerEvent.
+	void
+	startEventRecording(const EncoderSettings& settings, float preRollSeconds, size_t memoryBytes);
+	
+	// Writes the pre-roll plus the next postRollSeconds of video to a file, on a thread of its own so capture never
+	// waits for the disk. A trigger while a file is still being written extends its post-roll instead and returns false.
+	// Frames the ring overwrites before the file got them are counted in the stats.
+	bool
+	triggerEvent(const std::string& path, float postRollSeconds);
+	
+	EventRecordingStats
+	getEventRecordingStats() const;
+	
+	// Stops recording, and waits for a file being written with the post-roll it got so far
+	void
+	stopEventRecording();
+	
+	// Compares the Y plane of every video frame with a running background, in the camera buffer before anything is
+	// decoded, and calls the handler on the capture thread for frames that moved. Needs an I420 encoding; switching to
+	// NATIVE_BGR throws while it runs. Resolution changes start over with a new background. The handler must be quick
+	// and must not stop motion detection. The time per frame is reported by getStats().
+	void
+	startMotionDetection(const MotionSettings& settings, const MotionHandler& handler);
+	
+	void
+	stopMotionDetection();
+	
+	bool
+	isDetectingMotion() const;
+	
+	// Takes mean, extremes, clipped fractions and a histogram of the luminance of every video frame, for the whole frame
+	// and per cell of an optional grid. They come out of the decode when the frame is decoded anyway, and out of a
+	// single read of the camera buffer when nobody takes the frame, so exposure control and health checks need no
+	// frames at all. Resolution changes keep the settings.
+	void
+	startFrameStatistics(const StatisticsSettings& settings);
+	
+	void
+	stopFrameStatistics();
+	
+	// Statistics of the latest frame, false if there are none yet
+	bool
+	getFrameStatistics(FrameStatistics& statistics) const;
+	
+	// Drives shutter speed and gains from the luminance of every video frame until it lies within the tolerance of the
+	// target. The model turns the distance to the target into the exposure that reaches it, so the first adjustment
+	// lands close. Runs on the frame statistics, which are started for it if they are off; while it runs they can't be
+	// stopped and settings set by hand are overridden. Convergence is reported by getExposureStats().
+	void
+	startAutoExposure(const ExposureTarget& target, const ExposureModel& model = ExposureModel());
+	
+	void
+	stopAutoExposure();
+	
+	bool
+	isAutoExposing() const;
+	
+	// All 0 while auto-exposure is off
+	ExposureStats
+	getExposureStats() const;
+	
+	// Takes a bracket and fits the response of the sensor to the mean luminance of its frames. The brackets should span
+	// a wide range of exposures of a still scene; frames close to black or white are left out. The camera is left at the
+	// last bracket.
+	ExposureModel
+	learnExposureModel(const std::vector<FrameSettings>& brackets);
     
     void
     grabStill(cv::Mat& data);
+	
+	// Takes a still without blocking the caller. Stills are captured one after the other, the future must not outlive
+	// the camera.
+	std::future<cv::Mat>
+	grabStillAsync();
+	
+	// Takes count stills, one every intervalMillis or as fast as the camera can with 0. The camera captures stills
+	// continuously from a single capture start, and those that come in before the next one is due are dropped, so the
+	// interval is a minimum. Stills are decoded into the Mats already in the vector when they have the right size, so
+	// reusing the vector avoids allocations; clone stills that must outlive the next burst.
+	void
+	grabStillBurst(std::vector<cv::Mat>& stills, unsigned int count, unsigned int intervalMillis = 0);
+	
+	// Like grabStill, but only triggers the capture once the camera reports the shutter speed and gains last set
+	void
+	grabStillWithSettings(cv::Mat& data, FrameSettings& settings);
+	
+	// Settings the camera reported last, i.e. those of the latest frame
+	FrameSettings
+	getFrameSettings() const;
     
+    // Takes effect when the video port is enabled, so running video is reconfigured to switch modes
     void
     setSensorMode(const SensorMode mode);
 	
+	// Changing it on a created camera reconfigures it, see reconfigure
 	void
 	setEncoding(const Encoding& encoding);
 	
@@ -89,4 +349,7 @@ public:
 private:
     PiEyeImpl* _impl;
 
+    // Taps the decoded frames of its cameras
+    friend class PiEyeRigImpl;
+
 };
\ No newline at end of file
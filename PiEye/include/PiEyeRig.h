@@ -0,0 +1,92 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <vector>
+#include "SyntheticSource.hpp"
+#include "FrameSet.hpp"
+
+class PiEye;
+class PiEyeRigImpl;
+
+/**
+ * Several cameras that capture together, e.g. a stereo pair on the two CSI ports of a Compute Module. The cameras
+ * are not synchronized, so their frames are paired by capture time: the pts of every camera is mapped onto one time
+ * base and frames within the tolerance of each other form a set. The cameras decode their video on one pool of decode
+ * workers shared by the rig, one worker per camera, which delivers the frames of all cameras in arrival order and
+ * matches them as it goes. Decode workers set on a camera are replaced by that pool when the rig starts.
+ */
+class PiEyeRig {
+public:
+
+	// Cameras 0 to cameraCount - 1 of the board
+	explicit PiEyeRig(unsigned int cameraCount);
+	// Stand-in cameras without camera hardware, one per source. Jitter on the sources exercises the pairing.
+	explicit PiEyeRig(const std::vector<SyntheticSource>& sources);
+	~PiEyeRig();
+
+	unsigned int
+	getCameraCount() const;
+
+	// To configure a camera, e.g. resolution or exposure. Its video belongs to the rig while the rig runs.
+	PiEye&
+	getCamera(unsigned int index);
+
+	// Largest difference of capture times within a set, must stay below half the frame period. Set while the rig is
+	// stopped. Defaults to 5 ms.
+	void
+	setTolerance(unsigned int micros);
+
+	// Starts all cameras side by side, creating them if needed, and pairs their frames from then on. Returns once every
+	// camera can take stills; frames are only paired once a camera's warm-up is over.
+	void
+	start();
+
+	void
+	stop();
+
+	bool
+	isRunning() const;
+
+	// Takes the oldest matched set, waiting for one. Up to 4 sets are queued, the oldest ones are dropped beyond.
+	// Times out after 5 s, e.g. when a camera delivers nothing.
+	void
+	grabFrameSet(FrameSet& set);
+
+	// Takes the oldest matched set if there is one, never waits
+	bool
+	popFrameSet(FrameSet& set);
+
+	// Sets matched, frames dropped for lack of a partner and the skew within the sets
+	FrameSetStats
+	getStats() const;
+
+	void
+	resetStats();
+
+private:
+	PiEyeRigImpl* _impl;
+
+	PiEyeRig(const PiEyeRig&);
+	PiEyeRig& operator=(const PiEyeRig&);
+};
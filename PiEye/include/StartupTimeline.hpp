@@ -0,0 +1,36 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+// When startAsync() reached each step, in milliseconds since it was called. Steps it did not go through stay 0.
+struct StartupTimeline {
+	float componentCreated;		// Camera component created
+	float configured;			// Camera configured and enabled
+	float portEnabled;			// Video port enabled in its format
+	float poolAllocated;		// Video pool allocated and handed to the port
+	float firstFrame;			// First video frame arrived
+	float stillReady;			// Still port and pool open, so the first still doesn't pay for them
+	float ready;				// Exposure and white balance settled, or the first frame without settling; frames from
+								// here on are delivered. 0 until then, the future of startAsync() does not wait for it.
+	unsigned int warmUpFrames;	// Frames discarded while the settings settled
+};
@@ -0,0 +1,37 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+// How frames are queued for a subscriber that falls behind. Every subscriber has its own queue and thread, so a slow
+// subscriber only ever loses its own frames.
+enum class SubscriberPolicy {
+	DROP_NEWEST,	// Never drops a queued frame, new frames are dropped and counted while the queue is full
+	DROP_OLDEST,	// Drops the oldest queued frame to make room
+	LATEST_ONLY,	// Only keeps the most recent frame
+	DECIMATE		// Only takes every Nth frame, dropping the oldest when full
+};
+
+struct SubscriberStats {
+	unsigned long long delivered;
+	unsigned long long dropped;
+};
@@ -0,0 +1,43 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+enum class SyntheticPattern {
+	GRADIENT,	// Colour gradient moving diagonally
+	NOISE,		// Random pixels
+	FILES		// Images loaded from files, played in a loop
+};
+
+// Generated frames for a camera without camera hardware, e.g. to measure throughput on an ordinary Linux box. Frames
+// are rendered as exposed at 10 ms and gain 1; video brightness scales linearly with shutter speed and gains and clips
+// at white.
+struct SyntheticSource {
+	float fps;		// 0 to deliver frames as fast as buffers are handed back, unless a frame rate is set on the camera.
+					// Sources of the same rate deliver in step.
+	SyntheticPattern pattern;
+	std::vector<std::string> files;	// Only for FILES, scaled to the capture resolution
+	float jitterMillis;	// Frames come up to this much early or late at random, like a camera that is not synchronized
+};
@@ -48,3 +48,8 @@ BufferLock::unlock() {
         _buffer = nullptr;
     }
 }
+
+void
+BufferLock::detach() {
+    _buffer = nullptr;
+}
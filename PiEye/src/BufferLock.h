@@ -31,6 +31,10 @@ public:
 	
 	void
 	unlock();
+	
+	// Keeps the buffer locked, unlocking becomes the responsibility of the caller
+	void
+	detach();
     
 private:
     MMAL_BUFFER_HEADER_T* _buffer = nullptr;
@@ -0,0 +1,42 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+struct MMAL_BUFFER_HEADER_T;
+
+/**
+ * Owner of the buffers handed to the callbacks. Buffers that are kept beyond the callback (e.g. by a FrameLease) are
+ * given back through this interface, so it can be backed by MMAL or by a software stand-in.
+ */
+class BufferPool {
+public:
+	virtual ~BufferPool() {}
+
+	// Releases the memory lock taken in the callback
+	virtual void
+	unlock(MMAL_BUFFER_HEADER_T* buffer) = 0;
+
+	// Returns the buffer to the pool and feeds the port with the next free buffer
+	virtual void
+	recycle(MMAL_BUFFER_HEADER_T* buffer) = 0;
+};
@@ -0,0 +1,170 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Encoding.hpp"
+#include "SensorMode.hpp"
+#include "AwbMode.hpp"
+#include "FrameSettings.hpp"
+#include "EncoderSettings.hpp"
+#include "StreamGraph.h"
+
+struct MMAL_BUFFER_HEADER_T;
+class BufferPool;
+
+// Steps of bringing up the camera and its video port, in the order they are reached
+enum class StartupPhase {
+	COMPONENT_CREATED,
+	CONFIGURED,
+	PORT_ENABLED,
+	POOL_ALLOCATED
+};
+
+// What a port delivers
+struct CaptureFormat {
+	Encoding encoding;
+	unsigned short width;
+	unsigned short height;
+	unsigned short fps;	// 0 for stills, or to let the camera choose
+};
+
+/**
+ * Source of camera buffers: the camera component with its ports, pools and callbacks. PiEyeImpl only decodes and hands
+ * out what a backend delivers, so the same frame paths run on MMAL or on a software stand-in.
+ *
+ * Handlers are called from a thread of the backend, with the memory of the buffer locked. A handler that keeps the
+ * buffer (e.g. for a lease) returns true and gives it back through the pool of the port later on. Otherwise the backend
+ * unlocks and recycles the buffer once the handler returns.
+ *
+ * While the camera runs it reports the exposure settings in effect to the settings handler, about once per frame and
+ * before the buffers exposed with them. create and startVideo report each startup phase they complete to the phase
+ * handler, on the calling thread.
+ */
+class CaptureBackend {
+public:
+	typedef std::function<bool(MMAL_BUFFER_HEADER_T* buffer)> BufferHandler;
+	typedef std::function<void(const FrameSettings& settings)> SettingsHandler;
+	typedef std::function<void(const StartupPhase& phase)> PhaseHandler;
+
+	virtual ~CaptureBackend() {}
+
+	// Opens the camera for video and stills up to the given sizes, so it only reserves what the ports will need
+	virtual void
+	create(const CaptureFormat& video, const CaptureFormat& still) = 0;
+
+	virtual void
+	destroy() = 0;
+
+	virtual bool
+	isCreated() const = 0;
+
+	// Must be set before the camera is created
+	virtual void
+	setSettingsHandler(const SettingsHandler& handler) = 0;
+
+	// Must be set before the camera is created
+	virtual void
+	setPhaseHandler(const PhaseHandler& handler) = 0;
+
+	// Starts delivering video buffers, plus the frames of the streams branched off the video port
+	virtual void
+	startVideo(const CaptureFormat& format, const BufferHandler& handler, const std::vector<StreamFormat>& streams,
+			const StreamGraph::FrameHandler& streamHandler) = 0;
+
+	virtual void
+	stopVideo() = 0;
+	
+	// Changes the format of running video without touching the camera or the still port: only the video port is
+	// disabled, committed and enabled again, and its pool is kept if the buffers still fit. stopped runs while no video
+	// buffers are delivered, to swap whatever depends on the format.
+	virtual void
+	reconfigureVideo(const CaptureFormat& format, const std::function<void()>& stopped) = 0;
+
+	virtual bool
+	isVideoRunning() const = 0;
+
+	// Pool of the video port, nullptr while video is stopped
+	virtual std::shared_ptr<BufferPool>
+	getVideoPool() const = 0;
+
+	// Times the video port could not be fed because its pool had no free buffer, since the backend was constructed
+	virtual unsigned long long
+	getPoolStarvations() const = 0;
+	
+	// Encodes video frames next to those delivered to the video handler, handing the stream to the handler from a
+	// thread of the backend. The encoder runs whenever video does until it is stopped, so it may be started before
+	// video; running video may restart to branch it off.
+	virtual void
+	startEncoder(const EncoderSettings& settings, const EncodedHandler& handler) = 0;
+	
+	virtual void
+	stopEncoder() = 0;
+	
+	virtual bool
+	isEncoding() const = 0;
+
+	virtual void
+	openStill(const CaptureFormat& format, const BufferHandler& handler) = 0;
+
+	virtual void
+	closeStill() = 0;
+
+	virtual bool
+	isStillOpen() const = 0;
+
+	// Starts still capture on the open still port. Stills are not one-shot: they keep coming to the handler of the still
+	// port, one after another, until the capture stops. A single still stops it after the first one.
+	virtual void
+	startStillCapture() = 0;
+
+	virtual void
+	stopStillCapture() = 0;
+
+	virtual void
+	setSensorMode(const SensorMode mode) = 0;
+
+	virtual void
+	setShutterSpeed(unsigned int micros) = 0;
+
+	virtual void
+	setIso(unsigned int iso) = 0;
+
+	virtual void
+	setAnalogGain(float gain) = 0;
+
+	virtual void
+	setDigitalGain(float gain) = 0;
+
+	virtual void
+	setWhiteBalanceMode(const AwbMode& mode) = 0;
+
+	virtual void
+	setWhiteBalanceGain(float redGain, float blueGain) = 0;
+
+	virtual void
+	setFpsRange(float minFps, float maxFps) = 0;
+};
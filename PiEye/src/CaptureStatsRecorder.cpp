@@ -0,0 +1,120 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "CaptureStatsRecorder.h"
+
+#include <chrono>
+#include <interface/mmal/mmal_types.h>
+
+CaptureStatsRecorder::CaptureStatsRecorder() : _frames(0), _emptyBuffers(0), _firstArrival(0), _lastArrival(0),
+		_blackoutStart(0), _lastPts(MMAL_TIME_UNKNOWN) {
+}
+
+long long
+CaptureStatsRecorder::Now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void
+CaptureStatsRecorder::recordArrival(long long arrival, int64_t pts) {
+	if (_frames.fetch_add(1, std::memory_order_relaxed) == 0) {
+		_firstArrival.store(arrival, std::memory_order_relaxed);
+	}
+	_lastArrival.store(arrival, std::memory_order_relaxed);
+	if (_blackoutStart.load(std::memory_order_relaxed) != 0) {
+		_blackout.record(arrival - _blackoutStart.exchange(0, std::memory_order_relaxed));
+	}
+
+	if (pts != MMAL_TIME_UNKNOWN && _lastPts != MMAL_TIME_UNKNOWN && pts > _lastPts) {
+		_frameInterval.record((pts - _lastPts) * 1000);
+	}
+	_lastPts = pts;
+}
+
+void
+CaptureStatsRecorder::recordEmptyBuffer() {
+	_emptyBuffers.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+CaptureStatsRecorder::restartVideo() {
+	_lastPts = MMAL_TIME_UNKNOWN;
+}
+
+void
+CaptureStatsRecorder::reconfigureVideo() {
+	const long long lastArrival = _lastArrival.load(std::memory_order_relaxed);
+	_blackoutStart.store(lastArrival != 0 ? lastArrival : Now(), std::memory_order_relaxed);
+	_lastPts = MMAL_TIME_UNKNOWN;
+}
+
+void
+CaptureStatsRecorder::recordDecode(long long nanos) {
+	_decode.record(nanos);
+}
+
+void
+CaptureStatsRecorder::recordDelivery(long long nanos) {
+	_delivery.record(nanos);
+}
+
+void
+CaptureStatsRecorder::recordMotion(long long nanos) {
+	_motion.record(nanos);
+}
+
+void
+CaptureStatsRecorder::recordLatency(long long arrival) {
+	_latency.record(Now() - arrival);
+}
+
+CaptureStats
+CaptureStatsRecorder::getStats() const {
+	CaptureStats stats;
+	stats.frames = _frames.load(std::memory_order_relaxed);
+	const long long span = _lastArrival.load(std::memory_order_relaxed) - _firstArrival.load(std::memory_order_relaxed);
+	stats.fps = stats.frames > 1 && span > 0 ? (stats.frames - 1) * 1e9f / span : 0;
+	stats.frameInterval = _frameInterval.getStats();
+	stats.decode = _decode.getStats();
+	stats.delivery = _delivery.getStats();
+	stats.latency = _latency.getStats();
+	stats.blackout = _blackout.getStats();
+	stats.motion = _motion.getStats();
+	stats.emptyBuffers = _emptyBuffers.load(std::memory_order_relaxed);
+	stats.poolStarvations = 0;
+	stats.waitTimeouts = 0;
+	return stats;
+}
+
+void
+CaptureStatsRecorder::reset() {
+	_frames.store(0, std::memory_order_relaxed);
+	_emptyBuffers.store(0, std::memory_order_relaxed);
+	_firstArrival.store(0, std::memory_order_relaxed);
+	_lastArrival.store(0, std::memory_order_relaxed);
+	_frameInterval.reset();
+	_decode.reset();
+	_delivery.reset();
+	_latency.reset();
+	_blackout.reset();
+	_motion.reset();
+}
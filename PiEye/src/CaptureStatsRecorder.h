@@ -0,0 +1,95 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "CaptureStats.hpp"
+#include "LatencyHistogram.h"
+
+/**
+ * Records the timing of every video frame for getStats(). The callback records arrivals, decodes and deliveries,
+ * consumers record the latency of the frames they take, all without locking. Pool starvations and wait timeouts are
+ * counted elsewhere and left at 0.
+ */
+class CaptureStatsRecorder {
+public:
+	CaptureStatsRecorder();
+
+	// Monotonic clock all timestamps are taken from
+	static long long
+	Now();
+
+	// Called from the video callback only. pts is in microseconds, MMAL_TIME_UNKNOWN if the camera didn't stamp it.
+	void
+	recordArrival(long long arrival, int64_t pts);
+
+	void
+	recordEmptyBuffer();
+
+	// Forgets the pts of the last frame, so no interval spans a restart of video. Only while video is stopped.
+	void
+	restartVideo();
+
+	// Like restartVideo for a reconfiguration, and times the gap from the last arrival to the next one
+	void
+	reconfigureVideo();
+
+	void
+	recordDecode(long long nanos);
+
+	void
+	recordDelivery(long long nanos);
+
+	void
+	recordMotion(long long nanos);
+
+	// Called from consumers, arrival as passed to recordArrival
+	void
+	recordLatency(long long arrival);
+
+	CaptureStats
+	getStats() const;
+
+	void
+	reset();
+
+private:
+	std::atomic<unsigned long long> _frames;
+	std::atomic<unsigned long long> _emptyBuffers;
+	std::atomic<long long> _firstArrival;
+	std::atomic<long long> _lastArrival;
+	std::atomic<long long> _blackoutStart;	// 0 unless a reconfiguration waits for its first frame
+	int64_t _lastPts;
+	LatencyHistogram _frameInterval;
+	LatencyHistogram _decode;
+	LatencyHistogram _delivery;
+	LatencyHistogram _blackout;
+	LatencyHistogram _motion;
+	char _padding[64];
+	LatencyHistogram _latency;
+
+	CaptureStatsRecorder(const CaptureStatsRecorder&);
+	CaptureStatsRecorder& operator=(const CaptureStatsRecorder&);
+};
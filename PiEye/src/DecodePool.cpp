@@ -0,0 +1,201 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "DecodePool.h"
+
+#include <algorithm>
+#include <opencv2/core/core.hpp>
+
+#include "BufferPool.h"
+#include "CaptureStatsRecorder.h"
+#include "FrameDecoder.h"
+#include "PiEyeException.hpp"
+#include "Log.hpp"
+
+#define PIEYE_MAX_DECODE_WORKERS 16
+#define PIEYE_DECODE_SLICE_PIXELS (256 * 1024)	// Slices stay below the size at which the I420 converter goes parallel
+
+struct DecodePool::Job {
+	MMAL_BUFFER_HEADER_T* buffer;
+	std::shared_ptr<BufferPool> pool;
+	Delivery delivery;
+	FrameDecoder decoder;
+	cv::Mat frame;
+	unsigned long long sequence;
+	unsigned int slicesLeft;
+	bool failed;
+	long long decodeStart;
+	long long decodeEnd;
+};
+
+DecodePool::DecodePool(unsigned int workers) : _workers(workers), _submitted(0), _delivered(0), _delivering(false),
+		_running(true) {
+	if (workers == 0 || workers > PIEYE_MAX_DECODE_WORKERS) {
+		throw PiEyeException("Decode workers must lie between 1 and " + std::to_string(PIEYE_MAX_DECODE_WORKERS));
+	}
+	for (unsigned int i = 0; i < workers; ++i) {
+		_threads.push_back(std::thread(&DecodePool::run, this));
+	}
+}
+
+DecodePool::~DecodePool() {
+	drain();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = false;
+	}
+	_condition.notify_all();
+	for (auto&& thread : _threads) {
+		thread.join();
+	}
+}
+
+void
+DecodePool::submit(MMAL_BUFFER_HEADER_T* buffer, const FrameDecoder* decoder, const std::shared_ptr<BufferPool>& pool,
+		const Delivery& delivery) {
+	if (buffer == nullptr || !pool) {
+		throw PiEyeException("Cannot decode without buffer or pool");
+	}
+	std::shared_ptr<Job> job(new Job());
+	job->buffer = buffer;
+	job->pool = pool;
+	job->delivery = delivery;
+	job->failed = false;
+	job->decodeStart = 0;
+	job->decodeEnd = 0;
+	
+	// Slices of an even number of rows, I420 converts rows in pairs
+	unsigned int rows = 0;
+	unsigned int sliceRows = 1;
+	if (decoder != nullptr) {
+		job->decoder = *decoder;
+		decoder->prepare(job->frame);
+		rows = job->frame.rows;
+		sliceRows = std::max(PIEYE_DECODE_SLICE_PIXELS / job->frame.cols, 1);
+		sliceRows += sliceRows % 2;
+	}
+	
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		job->sequence = _submitted++;
+		job->slicesLeft = std::max((rows + sliceRows - 1) / sliceRows, 1u);
+		for (unsigned int row = 0; row < rows; row += sliceRows) {
+			const Slice slice = {job, row, std::min(row + sliceRows, rows)};
+			_slices.push_back(slice);
+		}
+		
+		// A frame that is not decoded still takes its turn on a worker
+		if (rows == 0) {
+			const Slice slice = {job, 0, 0};
+			_slices.push_back(slice);
+		}
+	}
+	_condition.notify_all();
+}
+
+void
+DecodePool::drain() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	
+	// Cameras sharing the pool keep submitting, so only the frames submitted so far are waited for
+	const unsigned long long submitted = _submitted;
+	_drainCondition.wait(lock, [this, submitted]() {
+		return _delivered >= submitted;
+	});
+}
+
+unsigned int
+DecodePool::getWorkers() const {
+	return _workers;
+}
+
+void
+DecodePool::run() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_condition.wait(lock, [this]() {
+			return !_running || !_slices.empty();
+		});
+		if (_slices.empty()) {
+			return;
+		}
+		const Slice slice = _slices.front();
+		_slices.pop_front();
+		lock.unlock();
+		
+		Job& job = *slice.job;
+		const long long start = CaptureStatsRecorder::Now();
+		bool failed = false;
+		if (slice.endRow > slice.firstRow) {
+			try {
+				job.decoder.decodeRows(*job.buffer, job.frame, slice.firstRow, slice.endRow);
+			} catch (const std::exception& e) {
+				EZLOG_WARN("Unable to decode rows [" << slice.firstRow << ", " << slice.endRow << "): " << e.what());
+				failed = true;
+			}
+		}
+		const long long end = CaptureStatsRecorder::Now();
+		
+		lock.lock();
+		job.failed = job.failed || failed;
+		job.decodeStart = job.decodeStart == 0 ? start : std::min(job.decodeStart, start);
+		job.decodeEnd = std::max(job.decodeEnd, end);
+		if (--job.slicesLeft == 0) {
+			_decoded[job.sequence] = slice.job;
+			deliver(lock);
+		}
+	}
+}
+
+void
+DecodePool::deliver(std::unique_lock<std::mutex>& lock) {
+	// Whoever delivers already takes the frames this one completed
+	if (_delivering) {
+		return;
+	}
+	_delivering = true;
+	while (!_decoded.empty() && _decoded.begin()->first == _delivered) {
+		const std::shared_ptr<Job> job = _decoded.begin()->second;
+		_decoded.erase(_decoded.begin());
+		lock.unlock();
+		
+		bool leased = false;
+		try {
+			leased = job->delivery(job->failed ? cv::Mat() : job->frame, job->decodeEnd - job->decodeStart);
+		} catch (const std::exception& e) {
+			EZLOG_ERROR("Unable to deliver a decoded frame: " << e.what());
+		}
+		if (!leased) {
+			try {
+				job->pool->unlock(job->buffer);
+				job->pool->recycle(job->buffer);
+			} catch (const std::exception& e) {
+				EZLOG_ERROR("Unable to return a decoded buffer: " << e.what());
+			}
+		}
+		
+		lock.lock();
+		++_delivered;
+	}
+	_delivering = false;
+	_drainCondition.notify_all();
+}
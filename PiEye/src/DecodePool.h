@@ -0,0 +1,99 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cv {
+	class Mat;
+}
+
+struct MMAL_BUFFER_HEADER_T;
+class BufferPool;
+class FrameDecoder;
+
+/**
+ * Decodes video buffers on a few worker threads instead of the camera callback thread. Large frames are cut into slices
+ * of rows, so all workers help with the same frame while the pool holds fewer buffers than it has workers. Slices
+ * are decoded out of order, frames are delivered in the order they were submitted, by one worker at a time. Delivered
+ * buffers that were not leased are unlocked and given back to their pool. Several cameras may share one pool, e.g. the
+ * cameras of a rig.
+ */
+class DecodePool {
+public:
+	// The decoded frame, empty if it was not decoded, and how long decoding took in nanoseconds. Returns whether the
+	// buffer was leased.
+	typedef std::function<bool(const cv::Mat& frame, long long decodeNanos)> Delivery;
+
+	DecodePool(unsigned int workers);
+	~DecodePool();
+
+	// Takes the locked buffer over. Without a decoder the frame is only delivered.
+	void
+	submit(MMAL_BUFFER_HEADER_T* buffer, const FrameDecoder* decoder, const std::shared_ptr<BufferPool>& pool,
+			const Delivery& delivery);
+
+	// Waits until every frame submitted so far was delivered
+	void
+	drain();
+
+	unsigned int
+	getWorkers() const;
+
+private:
+	struct Job;
+	struct Slice {
+		std::shared_ptr<Job> job;
+		unsigned int firstRow;
+		unsigned int endRow;
+	};
+
+	const unsigned int _workers;
+	std::deque<Slice> _slices;
+	std::map<unsigned long long, std::shared_ptr<Job> > _decoded;	// Waiting for the frames before them, by sequence
+	unsigned long long _submitted;
+	unsigned long long _delivered;
+	bool _delivering;
+	bool _running;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::condition_variable _drainCondition;
+	std::vector<std::thread> _threads;
+
+	void
+	run();
+
+	// Delivers the frames that are next in line, on the worker that completed one of them
+	void
+	deliver(std::unique_lock<std::mutex>& lock);
+
+	DecodePool(const DecodePool&);
+	DecodePool& operator=(const DecodePool&);
+};
@@ -0,0 +1,122 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "Downscaler.h"
+
+#if defined(PIEYE_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define PIEYE_DOWNSCALE_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define PIEYE_DOWNSCALE_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+	// scratch[i] = rows[0][i] + ... + rows[count - 1][i]
+	void
+	SumRows(const uint8_t* const* rows, unsigned int count, unsigned int size, uint16_t* scratch) {
+		unsigned int i = 0;
+#if defined(PIEYE_DOWNSCALE_NEON)
+		for (; i + 16 <= size; i += 16) {
+			const uint8x16_t first = vld1q_u8(rows[0] + i);
+			const uint8x16_t second = vld1q_u8(rows[1] + i);
+			uint16x8_t low = vaddl_u8(vget_low_u8(first), vget_low_u8(second));
+			uint16x8_t high = vaddl_u8(vget_high_u8(first), vget_high_u8(second));
+			for (unsigned int row = 2; row < count; ++row) {
+				const uint8x16_t next = vld1q_u8(rows[row] + i);
+				low = vaddw_u8(low, vget_low_u8(next));
+				high = vaddw_u8(high, vget_high_u8(next));
+			}
+			vst1q_u16(scratch + i, low);
+			vst1q_u16(scratch + i + 8, high);
+		}
+#elif defined(PIEYE_DOWNSCALE_SSE)
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= size; i += 16) {
+			__m128i low = zero;
+			__m128i high = zero;
+			for (unsigned int row = 0; row < count; ++row) {
+				const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[row] + i));
+				low = _mm_add_epi16(low, _mm_unpacklo_epi8(next, zero));
+				high = _mm_add_epi16(high, _mm_unpackhi_epi8(next, zero));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(scratch + i), low);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(scratch + i + 8), high);
+		}
+#endif
+		for (; i < size; ++i) {
+			uint16_t sum = 0;
+			for (unsigned int row = 0; row < count; ++row) {
+				sum += rows[row][i];
+			}
+			scratch[i] = sum;
+		}
+	}
+
+	// Single channel, pairs of columns: target[x] = (scratch[2x] + scratch[2x + 1] + 2) / 4
+	unsigned int
+	SumPairs(const uint16_t* scratch, unsigned int outputWidth, uint8_t* target) {
+		unsigned int x = 0;
+#if defined(PIEYE_DOWNSCALE_NEON)
+		for (; x + 8 <= outputWidth; x += 8) {
+			const uint32x4_t low = vpaddlq_u16(vld1q_u16(scratch + 2 * x));
+			const uint32x4_t high = vpaddlq_u16(vld1q_u16(scratch + 2 * x + 8));
+			const uint16x8_t means = vcombine_u16(vrshrn_n_u32(low, 2), vrshrn_n_u32(high, 2));
+			vst1_u8(target + x, vmovn_u16(means));
+		}
+#elif defined(PIEYE_DOWNSCALE_SSE)
+		const __m128i mask = _mm_set1_epi32(0xFFFF);
+		const __m128i rounding = _mm_set1_epi32(2);
+		for (; x + 8 <= outputWidth; x += 8) {
+			const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(scratch + 2 * x));
+			const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(scratch + 2 * x + 8));
+			const __m128i low = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_and_si128(first, mask),
+					_mm_srli_epi32(first, 16)), rounding), 2);
+			const __m128i high = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_and_si128(second, mask),
+					_mm_srli_epi32(second, 16)), rounding), 2);
+			const __m128i means = _mm_packs_epi32(low, high);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(target + x), _mm_packus_epi16(means, means));
+		}
+#endif
+		return x;
+	}
+}
+
+void
+Downscaler::DownscaleRow(const uint8_t* const* rows, unsigned int divisor, unsigned int width, unsigned int channels,
+		uint16_t* scratch, uint8_t* target) {
+	const unsigned int outputWidth = width / divisor;
+	SumRows(rows, divisor, width * channels, scratch);
+
+	unsigned int x = channels == 1 && divisor == 2 ? SumPairs(scratch, outputWidth, target) : 0;
+	const unsigned int area = divisor * divisor;
+	for (; x < outputWidth; ++x) {
+		for (unsigned int channel = 0; channel < channels; ++channel) {
+			const uint16_t* block = scratch + x * divisor * channels + channel;
+			unsigned int sum = area / 2;
+			for (unsigned int column = 0; column < divisor; ++column) {
+				sum += block[column * channels];
+			}
+			target[x * channels + channel] = sum / area;
+		}
+	}
+}
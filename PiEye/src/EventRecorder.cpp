@@ -0,0 +1,234 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "EventRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "PiEyeException.hpp"
+#include "Log.hpp"
+
+EventRecorder::EventRecorder(float preRollSeconds, size_t memoryBytes) : _preRollMicros(preRollSeconds * 1e6) {
+	if (preRollSeconds <= 0) {
+		throw PiEyeException("Pre-roll must be longer than 0 s");
+	} else if (memoryBytes == 0) {
+		throw PiEyeException("Event recording needs memory for its ring");
+	}
+	
+	// Allocated up front, the ring never grows
+	_memory.resize(memoryBytes);
+}
+
+EventRecorder::~EventRecorder() {
+	try {
+		finish();
+	} catch (const std::exception& e) {
+		EZLOG_ERROR("Unable to finish event recording: " << e.what());
+	}
+}
+
+void
+EventRecorder::push(const EncodedChunk& chunk) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	
+	// H.264 key frames come after their SPS and PPS, which start the GOP themselves
+	const bool frameStart = _lastFrameEnd;
+	const bool gopStart = frameStart && (chunk.config || chunk.keyFrame) && !_lastConfig;
+	_lastFrameEnd = chunk.frameEnd || chunk.config;
+	_lastConfig = chunk.config;
+	if (_chunks.empty() && !gopStart) {
+		return;
+	}
+	
+	// The post-roll ends at the first frame past it
+	if (_flushing && !_flushEnded && frameStart && chunk.pts > _flushEndPts) {
+		_flushEnded = true;
+		_flushEndSequence = _nextSequence;
+	}
+	
+	size_t offset = 0;
+	while (!allocate(chunk.length, offset)) {
+		if (_chunks.empty()) {
+			EZLOG_WARN("Chunk of [" << chunk.length << "] bytes doesn't fit in the ring, dropped it");
+			return;
+		}
+		evictGop();
+	}
+	memcpy(&_memory[offset], chunk.data, chunk.length);
+	const Chunk stored = {_nextSequence++, offset, chunk.length, chunk.pts, gopStart, chunk.frameEnd};
+	_chunks.push_back(stored);
+	_bufferedBytes += chunk.length;
+	if (gopStart) {
+		_gops.push_back(stored.sequence);
+	}
+	trimPreRoll(chunk.pts);
+	
+	if (_flushing) {
+		_condition.notify_one();
+	}
+}
+
+bool
+EventRecorder::trigger(const std::string& path, float postRollSeconds) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	const long long endPts = (_chunks.empty() ? 0 : _chunks.back().pts) + (long long) (postRollSeconds * 1e6);
+	if (_flushing) {
+		// Chunks past the old end are still in the ring, as unwritten chunks are never trimmed
+		EZLOG_DEBUG("Extending the post-roll of the running flush");
+		_flushEnded = false;
+		_flushEndPts = std::max(_flushEndPts, endPts);
+		return false;
+	}
+	
+	const std::shared_ptr<std::ofstream> file(new std::ofstream(path.c_str(), std::ios::binary | std::ios::trunc));
+	if (!file->is_open()) {
+		throw PiEyeException("Unable to open [" + path + "] for event recording");
+	}
+	
+	// A writer that is done only has to exit
+	if (_writer.joinable()) {
+		_writer.join();
+	}
+	_flushing = true;
+	_flushEnded = false;
+	_flushEndPts = endPts;
+	_writeSequence = _chunks.empty() ? _nextSequence : _chunks.front().sequence;
+	++_events;
+	_writer = std::thread(&EventRecorder::write, this, file);
+	EZLOG_DEBUG("Event [" << _events << "] triggered with [" << _bufferedBytes << "] bytes of pre-roll");
+	return true;
+}
+
+void
+EventRecorder::finish() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_flushing && !_flushEnded) {
+			_flushEnded = true;
+			_flushEndSequence = _nextSequence;
+		}
+		_condition.notify_one();
+	}
+	if (_writer.joinable()) {
+		_writer.join();
+	}
+}
+
+EventRecordingStats
+EventRecorder::getStats() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	EventRecordingStats stats;
+	stats.memoryBytes = _memory.size();
+	stats.bufferedBytes = _bufferedBytes;
+	stats.bufferedSeconds = _chunks.empty() ? 0 : (_chunks.back().pts - _chunks.front().pts) / 1e6f;
+	stats.events = _events;
+	stats.flushing = _flushing;
+	stats.droppedFrames = _droppedFrames;
+	return stats;
+}
+
+bool
+EventRecorder::allocate(size_t length, size_t& offset) const {
+	if (_chunks.empty()) {
+		offset = 0;
+		return length <= _memory.size();
+	}
+	
+	const size_t head = _chunks.back().offset + _chunks.back().length;
+	const size_t tail = _chunks.front().offset;
+	if (head > tail) {
+		// Free behind the head, else wrap around to the start
+		if (head + length <= _memory.size()) {
+			offset = head;
+			return true;
+		}
+		offset = 0;
+		return length <= tail;
+	}
+	offset = head;
+	return head + length <= tail;
+}
+
+void
+EventRecorder::evictGop() {
+	do {
+		const Chunk& chunk = _chunks.front();
+		if (_flushing && chunk.sequence >= _writeSequence && chunk.frameEnd) {
+			++_droppedFrames;
+		}
+		_bufferedBytes -= chunk.length;
+		_chunks.pop_front();
+	} while (!_chunks.empty() && !_chunks.front().gopStart);
+	_gops.pop_front();
+	
+	// The writer picks up at the next key frame
+	const unsigned long long front = _chunks.empty() ? _nextSequence : _chunks.front().sequence;
+	if (_flushing && _writeSequence < front) {
+		_writeSequence = front;
+	}
+}
+
+void
+EventRecorder::trimPreRoll(long long pts) {
+	// The second GOP alone must still cover the pre-roll, and the writer must be past the first one
+	while (_gops.size() > 1) {
+		const unsigned long long second = _gops[1];
+		if (_chunks[second - _chunks.front().sequence].pts > pts - _preRollMicros || (_flushing && _writeSequence < second)) {
+			return;
+		}
+		evictGop();
+	}
+}
+
+void
+EventRecorder::write(std::shared_ptr<std::ofstream> file) {
+	std::vector<uint8_t> buffer;
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_condition.wait(lock, [this]() {
+			return _writeSequence < _nextSequence || _flushEnded;
+		});
+		if (_flushEnded && _writeSequence >= _flushEndSequence) {
+			break;
+		}
+		
+		// Copied out, so the disk is written without the lock
+		const Chunk& chunk = _chunks[_writeSequence - _chunks.front().sequence];
+		buffer.assign(&_memory[chunk.offset], &_memory[chunk.offset] + chunk.length);
+		++_writeSequence;
+		lock.unlock();
+		file->write((const char*) buffer.data(), buffer.size());
+		lock.lock();
+	}
+	
+	
+	// Done under the lock, so a trigger from here on starts a new file rather than extending this one
+	_flushing = false;
+	lock.unlock();
+	file->close();
+	if (!*file) {
+		EZLOG_ERROR("Unable to write event recording");
+	}
+	EZLOG_DEBUG("Event recording written");
+}
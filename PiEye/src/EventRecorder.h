@@ -0,0 +1,113 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EncoderSettings.hpp"
+#include "EventRecordingStats.hpp"
+
+/**
+ * Keeps the latest seconds of an encoded stream in a ring of fixed size that always starts at a key frame, and writes
+ * them to a file on a trigger, followed by whatever comes in during the post-roll. Chunks are pushed from the encoder
+ * thread and never wait for the disk: a writer thread copies them out of the ring one at a time. When the disk falls
+ * so far behind that the ring has to overwrite chunks not written yet, the file skips to the next key frame.
+ */
+class EventRecorder {
+public:
+	EventRecorder(float preRollSeconds, size_t memoryBytes);
+	~EventRecorder();
+
+	// Takes the next chunk of the stream, on the encoder thread
+	void
+	push(const EncodedChunk& chunk);
+
+	// Writes the pre-roll plus the next postRollSeconds to a new file. While a file is still being written its post-roll
+	// is extended instead, and false is returned.
+	bool
+	trigger(const std::string& path, float postRollSeconds);
+
+	// Ends the post-roll of a running flush with what arrived so far and waits until it is written
+	void
+	finish();
+
+	EventRecordingStats
+	getStats() const;
+
+private:
+	// Where a chunk lies in the ring. Sequences count the stored chunks.
+	struct Chunk {
+		unsigned long long sequence;
+		size_t offset;
+		unsigned int length;
+		long long pts;
+		bool gopStart;		// First chunk of a key frame, or of the headers in front of it
+		bool frameEnd;
+	};
+
+	const long long _preRollMicros;
+	std::vector<uint8_t> _memory;
+	std::deque<Chunk> _chunks;		// Oldest first, starting at a GOP
+	std::deque<unsigned long long> _gops;	// Sequences of the GOP starts in the ring
+	size_t _bufferedBytes = 0;
+	unsigned long long _nextSequence = 0;
+	bool _lastFrameEnd = true;
+	bool _lastConfig = false;
+	mutable std::mutex _mutex;
+	std::condition_variable _condition;
+	std::thread _writer;
+	bool _flushing = false;
+	unsigned long long _writeSequence = 0;	// Next chunk to write
+	long long _flushEndPts = 0;
+	bool _flushEnded = false;				// The post-roll is complete up to the end sequence
+	unsigned long long _flushEndSequence = 0;
+	unsigned int _events = 0;
+	unsigned long long _droppedFrames = 0;
+
+	// Finds room for length bytes behind the newest chunk, false if the ring is too full
+	bool
+	allocate(size_t length, size_t& offset) const;
+
+	// Drops the oldest GOP. Chunks of it that were not written yet count as dropped frames.
+	void
+	evictGop();
+
+	// Drops GOPs that are not needed to cover the pre-roll before pts
+	void
+	trimPreRoll(long long pts);
+
+	// Body of the writer thread
+	void
+	write(std::shared_ptr<std::ofstream> file);
+
+	EventRecorder(const EventRecorder&);
+	EventRecorder& operator=(const EventRecorder&);
+};
@@ -0,0 +1,266 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "ExposureController.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "PiEyeException.hpp"
+#include "Log.hpp"
+
+#define PIEYE_DEFAULT_EXPOSURE_TOLERANCE 4
+#define PIEYE_DEFAULT_MAX_EXPOSURE_MICROS 33000
+#define PIEYE_DEFAULT_MAX_ANALOG_GAIN 8
+#define PIEYE_MIN_EXPOSURE_MICROS 10
+#define PIEYE_MAX_EXPOSURE_STEP 16		// Largest factor of a single adjustment, for frames too dark or clipped to measure
+#define PIEYE_MIN_MODEL_INTENSITY 8		// Fitting leaves out frames close to black or to clipping
+#define PIEYE_MAX_MODEL_INTENSITY 247
+#define PIEYE_EXPOSURE_LEAVE_FRAMES 2	// Frames in a row outside the tolerance before a converged exposure is adjusted
+
+namespace {
+	ExposureTarget
+	FillDefaults(ExposureTarget target) {
+		if (target.intensity < 1 || target.intensity > 254) {
+			throw PiEyeException("Exposure target must lie between 1 and 254, got [" + std::to_string(target.intensity) + "]");
+		} else if (target.percentile < 0 || target.percentile >= 1) {
+			throw PiEyeException("Exposure percentile must lie between 0 and 1");
+		}
+		if (target.tolerance <= 0) {
+			target.tolerance = PIEYE_DEFAULT_EXPOSURE_TOLERANCE;
+		}
+		if (target.maxExposureMicros == 0) {
+			target.maxExposureMicros = PIEYE_DEFAULT_MAX_EXPOSURE_MICROS;
+		}
+		if (target.maxAnalogGain < 1) {
+			target.maxAnalogGain = PIEYE_DEFAULT_MAX_ANALOG_GAIN;
+		}
+		if (target.maxDigitalGain < 1) {
+			target.maxDigitalGain = 1;
+		}
+		return target;
+	}
+
+	ExposureModel
+	FillDefaults(ExposureModel model) {
+		if (model.gamma < 0) {
+			throw PiEyeException("Exposure model needs a positive gamma");
+		} else if (model.gamma == 0) {
+			model.gamma = 1;
+		}
+		return model;
+	}
+
+	// Exposure times gains, gains that are not reported count as 1
+	double
+	GetExposure(const FrameSettings& settings) {
+		return settings.exposureMicros * (double) std::max(settings.analogGain, 1.0f) * std::max(settings.digitalGain, 1.0f);
+	}
+
+	bool
+	SameSettings(const FrameSettings& first, const FrameSettings& second) {
+		return first.exposureMicros == second.exposureMicros && first.analogGain == second.analogGain
+				&& first.digitalGain == second.digitalGain;
+	}
+}
+
+ExposureController::ExposureController(const ExposureTarget& target, const ExposureModel& model,
+		const SettingsHandler& handler) : _target(FillDefaults(target)), _model(FillDefaults(model)), _handler(handler),
+		_nextSettings(), _nextArrival(0), _running(true), _requested(), _episodeStart(0), _episodeFrames(0),
+		_outsideFrames(0), _stats() {
+	if (!_handler) {
+		throw PiEyeException("Exposure control needs a handler for the settings");
+	}
+	_thread = std::thread(&ExposureController::run, this);
+}
+
+ExposureController::~ExposureController() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = false;
+	}
+	_condition.notify_one();
+	_thread.join();
+}
+
+void
+ExposureController::offer(const std::shared_ptr<const FrameStatistics>& statistics, const FrameSettings& settings,
+		long long arrival) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_nextStatistics = statistics;
+		_nextSettings = settings;
+		_nextArrival = arrival;
+	}
+	_condition.notify_one();
+}
+
+ExposureStats
+ExposureController::getStats() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _stats;
+}
+
+float
+ExposureController::Measure(const FrameStatistics& statistics, float percentile) {
+	if (percentile <= 0 || statistics.pixels == 0) {
+		return statistics.frame.mean;
+	}
+	const unsigned long long wanted = (unsigned long long) std::ceil(percentile * statistics.pixels);
+	unsigned long long count = 0;
+	for (unsigned int level = 0; level < 256; ++level) {
+		count += statistics.histogram[level];
+		if (count >= wanted) {
+			return level;
+		}
+	}
+	return 255;
+}
+
+ExposureModel
+ExposureController::FitModel(const std::vector<FrameSettings>& settings, const std::vector<float>& intensities) {
+	if (settings.size() != intensities.size()) {
+		throw PiEyeException("Exposure model needs one intensity per setting");
+	}
+	
+	// Least squares on log luminance over log exposure
+	double sumX = 0;
+	double sumY = 0;
+	double sumXX = 0;
+	double sumXY = 0;
+	unsigned int count = 0;
+	for (size_t i = 0; i < settings.size(); ++i) {
+		const double exposure = GetExposure(settings[i]);
+		if (exposure <= 0 || intensities[i] < PIEYE_MIN_MODEL_INTENSITY || intensities[i] > PIEYE_MAX_MODEL_INTENSITY) {
+			continue;
+		}
+		const double x = std::log(exposure);
+		const double y = std::log(intensities[i]);
+		sumX += x;
+		sumY += y;
+		sumXX += x * x;
+		sumXY += x * y;
+		++count;
+	}
+	const double spread = count * sumXX - sumX * sumX;
+	if (count < 2 || spread <= 1e-9) {
+		throw PiEyeException("Exposure model needs at least 2 unclipped frames of different exposures, got ["
+				+ std::to_string(count) + "]");
+	}
+	const ExposureModel model = {(float) ((count * sumXY - sumX * sumY) / spread)};
+	if (model.gamma <= 0) {
+		throw PiEyeException("Luminance did not grow with the exposure, gamma [" + std::to_string(model.gamma) + "]");
+	}
+	return model;
+}
+
+void
+ExposureController::run() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_condition.wait(lock, [this]() {
+			return !_running || _nextStatistics;
+		});
+		if (!_running) {
+			return;
+		}
+		const std::shared_ptr<const FrameStatistics> statistics = _nextStatistics;
+		_nextStatistics.reset();
+		const FrameSettings request = control(*statistics, _nextSettings, _nextArrival);
+		if (request.exposureMicros == 0) {
+			continue;
+		}
+		
+		// Setting the camera may take a while, frames offered meanwhile replace each other
+		lock.unlock();
+		try {
+			_handler(request);
+		} catch (const std::exception& e) {
+			EZLOG_WARN("Unable to apply exposure settings: " << e.what());
+		}
+		lock.lock();
+	}
+}
+
+FrameSettings
+ExposureController::control(const FrameStatistics& statistics, const FrameSettings& settings, long long arrival) {
+	const float intensity = Measure(statistics, _target.percentile);
+	_stats.intensity = intensity;
+	_stats.settings = settings;
+	if (_episodeFrames == 0) {
+		_episodeStart = arrival;
+	}
+	++_episodeFrames;
+	
+	if (std::abs(intensity - _target.intensity) <= _target.tolerance) {
+		_outsideFrames = 0;
+		if (!_stats.converged) {
+			_stats.converged = true;
+			_stats.framesToConverge = _episodeFrames;
+			_stats.millisToConverge = (arrival - _episodeStart) / 1e6f;
+			++_stats.convergences;
+		}
+		return FrameSettings();
+	} else if (_stats.converged) {
+		// A single frame off, like a flicker or a passing light, is not worth chasing
+		if (_outsideFrames++ == 0) {
+			_episodeStart = arrival;
+		}
+		if (_outsideFrames < PIEYE_EXPOSURE_LEAVE_FRAMES) {
+			return FrameSettings();
+		}
+		_stats.converged = false;
+		_episodeFrames = _outsideFrames;
+	}
+	
+	// Too dark or too bright to measure how far off it is: step as far as allowed
+	const double exposure = GetExposure(settings);
+	double next;
+	if (intensity < 1) {
+		next = exposure * PIEYE_MAX_EXPOSURE_STEP;
+	} else if (intensity >= 255) {
+		next = exposure / PIEYE_MAX_EXPOSURE_STEP;
+	} else {
+		next = exposure * std::pow(_target.intensity / intensity, 1.0 / _model.gamma);
+		next = std::min(std::max(next, exposure / PIEYE_MAX_EXPOSURE_STEP), exposure * PIEYE_MAX_EXPOSURE_STEP);
+	}
+	const FrameSettings request = split(next);
+	if (SameSettings(request, _requested)) {
+		return FrameSettings();
+	}
+	_requested = request;
+	++_stats.adjustments;
+	return request;
+}
+
+FrameSettings
+ExposureController::split(double exposure) const {
+	const double longest = (double) _target.maxExposureMicros * _target.maxAnalogGain * _target.maxDigitalGain;
+	exposure = std::min(std::max(exposure, (double) PIEYE_MIN_EXPOSURE_MICROS), longest);
+	FrameSettings settings = FrameSettings();
+	settings.exposureMicros = std::lround(std::min(exposure, (double) _target.maxExposureMicros));
+	const double gain = std::max(1.0, exposure / _target.maxExposureMicros);
+	settings.analogGain = std::max(1.0, std::min(gain, (double) _target.maxAnalogGain));
+	settings.digitalGain = std::max(1.0, std::min(gain / settings.analogGain, (double) _target.maxDigitalGain));
+	return settings;
+}
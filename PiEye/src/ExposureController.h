@@ -0,0 +1,95 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ExposureControl.hpp"
+#include "FrameStatistics.hpp"
+
+/**
+ * Closed loop software auto-exposure. Every frame offers its statistics together with the settings it was exposed
+ * with, and the model turns the distance to the target into the total exposure that reaches it, which is split into
+ * shutter first, then analog and digital gain. Frames still exposed with older settings ask for the same settings
+ * again, which are not sent twice, so the pipeline delay of the sensor causes no overshoot. Once converged, it takes two
+ * frames in a row off the target to adjust again. The camera is set from a thread of its own, the capture thread only
+ * hands over the latest frame.
+ */
+class ExposureController {
+public:
+	typedef std::function<void(const FrameSettings& settings)> SettingsHandler;
+
+	ExposureController(const ExposureTarget& target, const ExposureModel& model, const SettingsHandler& handler);
+	~ExposureController();
+
+	// Statistics of a frame and the settings reported with it, arrival in nanoseconds. Replaces a frame not controlled yet.
+	void
+	offer(const std::shared_ptr<const FrameStatistics>& statistics, const FrameSettings& settings, long long arrival);
+
+	ExposureStats
+	getStats() const;
+
+	// Luminance as the target measures it: the mean, or the level of a percentile of the histogram
+	static float
+	Measure(const FrameStatistics& statistics, float percentile);
+
+	// Fits the gamma of the model to the mean luminance of frames taken with different settings, leaving out clipped ones
+	static ExposureModel
+	FitModel(const std::vector<FrameSettings>& settings, const std::vector<float>& intensities);
+
+private:
+	const ExposureTarget _target;
+	const ExposureModel _model;
+	const SettingsHandler _handler;
+	std::shared_ptr<const FrameStatistics> _nextStatistics;
+	FrameSettings _nextSettings;
+	long long _nextArrival;
+	bool _running;
+	FrameSettings _requested;
+	long long _episodeStart;			// Arrival of the first frame since the start or since it left the tolerance
+	unsigned int _episodeFrames;
+	unsigned int _outsideFrames;		// In a row since the exposure converged
+	ExposureStats _stats;
+	mutable std::mutex _mutex;
+	std::condition_variable _condition;
+	std::thread _thread;
+
+	void
+	run();
+
+	// Takes one frame, on the controller thread. Returns the settings to send, or no exposure if there is nothing to send.
+	FrameSettings
+	control(const FrameStatistics& statistics, const FrameSettings& settings, long long arrival);
+
+	// Shutter up to the longest allowed, gains for the rest
+	FrameSettings
+	split(double exposure) const;
+
+	ExposureController(const ExposureController&);
+	ExposureController& operator=(const ExposureController&);
+};
@@ -0,0 +1,77 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "EzBinaryFileSink.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "PiEyeException.hpp"
+
+const char EzBinaryFileSink::MAGIC[8] = {'E', 'Z', 'L', 'O', 'G', 'B', 'I', '1'};
+const char EzBinaryFileSink::RECORD_SITE;
+const char EzBinaryFileSink::RECORD_MESSAGE;
+
+EzBinaryFileSink::EzBinaryFileSink(const std::string& path) :
+        _file(path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary) {
+    if (!_file) {
+        throw PiEyeException("Unable to open log file [" + path + "]");
+    }
+    _file.write(MAGIC, sizeof(MAGIC));
+}
+
+void
+EzBinaryFileSink::write(const EzMessage& message) {
+    const uint32_t site = getSite(message);
+    put(RECORD_MESSAGE);
+    put(site);
+    put<uint16_t>(message.getLevel());
+    put<uint64_t>(message.getMicroTime());
+    put<uint8_t>(message.isTruncated());
+    put<uint16_t>(message.getArgumentsSize());
+    _file.write(message.getArguments(), message.getArgumentsSize());
+}
+
+void
+EzBinaryFileSink::flush() {
+    _file.flush();
+}
+
+unsigned int
+EzBinaryFileSink::getSite(const EzMessage& message) {
+    // The file name is a literal from __FILE__, so its address identifies it
+    const std::pair<const char*, unsigned int> key(message.getFile(), message.getLine());
+    const std::map<std::pair<const char*, unsigned int>, unsigned int>::const_iterator it = _sites.find(key);
+    if (it != _sites.end()) {
+        return it->second;
+    }
+    
+    const uint32_t site = _sites.size();
+    const uint16_t fileLength = message.getFile() ? strlen(message.getFile()) : 0;
+    put(RECORD_SITE);
+    put(site);
+    put<uint32_t>(message.getLine());
+    put(fileLength);
+    _file.write(message.getFile(), fileLength);
+    _sites[key] = site;
+    return site;
+}
@@ -22,63 +22,105 @@ SOFTWARE.
 */
 #include "EzLogger.h"
 
+#include <chrono>
 #include <iostream>
 
-#include "Log.hpp"
-
-EzLogger* EzLogger::_instance = nullptr;
+#include "RingBuffer.h"
+#include "EzStdoutSink.h"
 
 namespace {
-    const char*
-    GetLevelStr(unsigned short level) {
-        switch (level) {
-        case EZLOG_LEVEL_TRACE:
-            return "TRACE";
-        case EZLOG_LEVEL_DEBUG:
-            return "DEBUG";
-        case EZLOG_LEVEL_INFO:
-            return "INFO";
-        case EZLOG_LEVEL_WARNING:
-            return "WARN";
-        case EZLOG_LEVEL_ERROR:
-            return "ERROR";
-        default:
-            return "UNKNOWN";
+    // How long the writer sleeps when the queue is empty. Loggers never wake it up, so they never touch a lock.
+    const std::chrono::milliseconds WRITER_IDLE(5);
+}
+
+EzLogger::EzLogger() : _sink(new EzStdoutSink()), _async(false), _pushing(0), _writing(false) {
+}
+
+EzLogger::~EzLogger() {
+    stopAsync();
+}
+
+EzLogger&
+EzLogger::GetDefault() {
+    // Never destroyed, so it can still be used while other statics are torn down
+    static EzLogger* instance = new EzLogger();
+    return *instance;
+}
+
+void
+EzLogger::log(const EzMessage& message) {
+    // stopAsync turns async mode off before it waits for the pushes that saw it on, so none lands after the last drain
+    if (_async) {
+        ++_pushing;
+        if (_async) {
+            _queue->push(message);
+            --_pushing;
+            return;
         }
+        --_pushing;
     }
     
-    std::string
-    GetDateStr(const unsigned long long microTime) {
-        char buf[64];
-        long secPart = microTime / 1000 / 1000;
-        long microPart = microTime - (secPart * 1000 * 1000);
-        if (microPart < 0) {
-            secPart--;
-            microPart += 1000 * 1000;
-        }
-        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&secPart));
-        const std::string millis = std::to_string(microPart / 1000);
-        
-        return std::string(buf) + "." + std::string(3 - millis.size(), '0') + millis;
+    std::lock_guard<std::mutex> lock(_sinkMutex);
+    _sink->write(message);
+    _sink->flush();
+}
+
+void
+EzLogger::setSink(const std::shared_ptr<EzSink>& sink) {
+    std::lock_guard<std::mutex> lock(_sinkMutex);
+    _sink = sink;
+}
+
+void
+EzLogger::startAsync(unsigned int queueSize) {
+    stopAsync();
+    _queue.reset(new RingBuffer<EzMessage>(queueSize, QueuePolicy::REJECT_NEWEST));
+    _writing = true;
+    _writer = std::thread(&EzLogger::write, this);
+    _async = true;
+}
+
+void
+EzLogger::stopAsync() {
+    if (!_writer.joinable()) {
+        return;
+    }
+    _async = false;
+    while (_pushing > 0) {
+        std::this_thread::yield();
     }
+    _writing = false;
+    _writer.join();
 }
 
-EzLogger&
-EzLogger::GetDefault() {
-    if (_instance == nullptr) {
-        _instance = new EzLogger();
+unsigned long long
+EzLogger::getDropped() const {
+    return _queue ? _queue->getDropped() : 0;
+}
+
+void
+EzLogger::write() {
+    EzMessage message(0);
+    while (_writing) {
+        drain(message);
+        std::this_thread::sleep_for(WRITER_IDLE);
     }
-    return *_instance;
+    drain(message);
 }
 
 void
-EzLogger::log(const EzMessage& message) {
-    std::cout << GetDateStr(message.getMicroTime()) << " - "
-        << "[" << GetLevelStr(message.getLevel()) << "]";
-    if (message.getFile()) {
-        std::cout << " - " << message.getFile() << ":" << message.getLine() << " - ";
-    } else {
-        std::cout << ":";
+EzLogger::drain(EzMessage& message) {
+    std::lock_guard<std::mutex> lock(_sinkMutex);
+    bool written = false;
+    while (_queue->pop(message)) {
+        try {
+            _sink->write(message);
+            written = true;
+        } catch (const std::exception& e) {
+            std::cerr << "Unable to write log message: " << e.what() << std::endl;
+        }
+    }
+    if (written) {
+        _sink->flush();
     }
-    std::cout << message.getMessage() << std::endl;
 }
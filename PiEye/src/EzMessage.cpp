@@ -22,9 +22,23 @@ SOFTWARE.
 */
 #include "EzMessage.h"
 
+#include <cstring>
+#include <cstdint>
 #include <sys/time.h>
 
 namespace {
+    // Every argument is a type tag followed by its value in native byte order. Strings are prefixed with their length.
+    const char TYPE_STRING = 's';
+    const char TYPE_BOOL = 'b';
+    const char TYPE_UINT = 'u';
+    const char TYPE_INT = 'i';
+    const char TYPE_ULONG = 'l';
+    const char TYPE_LONG = 'j';
+    const char TYPE_ULONGLONG = 'Q';
+    const char TYPE_LONGLONG = 'q';
+    const char TYPE_FLOAT = 'f';
+    const char TYPE_DOUBLE = 'd';
+    
     unsigned long long
     GetMicroTime() {
         struct timeval timeVal;
@@ -32,13 +46,42 @@ namespace {
         const unsigned long long microTime = timeVal.tv_sec;
         return (microTime * 1000 * 1000) + timeVal.tv_usec;
     }
+    
+    template <typename T>
+    T
+    Read(const char* data) {
+        T value;
+        memcpy(&value, data, sizeof(T));
+        return value;
+    }
+}
+
+const unsigned short EzMessage::ARGUMENTS_SIZE;
+
+EzMessage::EzMessage() : EzMessage(0) {
 }
 
-EzMessage::EzMessage(unsigned short level) : _file(nullptr), _level(level), _line(0), _microTime(GetMicroTime()) {
+EzMessage::EzMessage(unsigned short level) : _file(nullptr), _level(level), _line(0), _microTime(GetMicroTime()),
+        _size(0), _truncated(false) {
 }
 
 EzMessage::EzMessage(unsigned short level, const char* file, const unsigned int line) : 
-        _file(file), _level(level), _line(line), _microTime(GetMicroTime()) {
+        _file(file), _level(level), _line(line), _microTime(GetMicroTime()), _size(0), _truncated(false) {
+}
+
+EzMessage::EzMessage(const EzMessage& other) : _file(other._file), _level(other._level), _line(other._line),
+        _microTime(other._microTime), _size(other._size), _truncated(other._truncated) {
+    memcpy(_arguments, other._arguments, _size);
+}
+
+EzMessage&
+EzMessage::operator=(const EzMessage& other) {
+    _file = other._file;
+    _level = other._level;
+    _line = other._line;
+    _microTime = other._microTime;
+    setArguments(other._arguments, other._size, other._truncated);
+    return *this;
 }
 
 unsigned short
@@ -61,14 +104,68 @@ EzMessage::setMicroTime(unsigned long long microTime) {
     _microTime = microTime;
 }
 
-const std::string&
+std::string
 EzMessage::getMessage() const {
-    return _message;
+    std::string message;
+    unsigned short position = 0;
+    while (position < _size) {
+        const char type = _arguments[position++];
+        switch (type) {
+        case TYPE_STRING: {
+            const uint16_t length = Read<uint16_t>(_arguments + position);
+            message.append(_arguments + position + sizeof(length), length);
+            position += sizeof(length) + length;
+            break;
+        }
+        case TYPE_BOOL:
+            message += _arguments[position] ? "true" : "false";
+            position += 1;
+            break;
+        case TYPE_UINT:
+            message += std::to_string(Read<unsigned int>(_arguments + position));
+            position += sizeof(unsigned int);
+            break;
+        case TYPE_INT:
+            message += std::to_string(Read<int>(_arguments + position));
+            position += sizeof(int);
+            break;
+        case TYPE_ULONG:
+            message += std::to_string(Read<unsigned long>(_arguments + position));
+            position += sizeof(unsigned long);
+            break;
+        case TYPE_LONG:
+            message += std::to_string(Read<long>(_arguments + position));
+            position += sizeof(long);
+            break;
+        case TYPE_ULONGLONG:
+            message += std::to_string(Read<unsigned long long>(_arguments + position));
+            position += sizeof(unsigned long long);
+            break;
+        case TYPE_LONGLONG:
+            message += std::to_string(Read<long long>(_arguments + position));
+            position += sizeof(long long);
+            break;
+        case TYPE_FLOAT:
+            message += std::to_string(Read<float>(_arguments + position));
+            position += sizeof(float);
+            break;
+        case TYPE_DOUBLE:
+            message += std::to_string(Read<double>(_arguments + position));
+            position += sizeof(double);
+            break;
+        default:
+            return message + "<corrupt arguments>";
+        }
+    }
+    
+    return _truncated ? message + "..." : message;
 }
 
 void
 EzMessage::setMessage(const std::string& message) {
-    _message = message;
+    _size = 0;
+    _truncated = false;
+    *this << message;
 }
 
 const char*
@@ -81,44 +178,122 @@ EzMessage::getLine() const {
     return _line;
 }
 
+const char*
+EzMessage::getArguments() const {
+    return _arguments;
+}
+
+unsigned short
+EzMessage::getArgumentsSize() const {
+    return _size;
+}
+
+bool
+EzMessage::isTruncated() const {
+    return _truncated;
+}
+
+void
+EzMessage::setArguments(const char* arguments, unsigned short size, bool truncated) {
+    _size = size < ARGUMENTS_SIZE ? size : ARGUMENTS_SIZE;
+    _truncated = truncated || size > ARGUMENTS_SIZE;
+    memmove(_arguments, arguments, _size);
+}
+
 EzMessage&
 EzMessage::operator<<(const char* value) {
-    _message += value;
+    appendString(value, strlen(value));
     return *this;
 }
 
 EzMessage&
 EzMessage::operator<<(const std::string& value) {
-	_message += value;
+	appendString(value.data(), value.size());
 	return *this;
 }
 
 EzMessage&
 EzMessage::operator<<(const bool value) {
-	_message += value ? "true" : "false";
+	const char flag = value ? 1 : 0;
+	append(TYPE_BOOL, &flag, sizeof(flag));
 	return *this;
 }
 
 EzMessage&
 EzMessage::operator<<(const unsigned int value) {
-    _message += std::to_string(value);
+    append(TYPE_UINT, &value, sizeof(value));
     return *this;
 }
 
 EzMessage&
 EzMessage::operator<<(const int value) {
-    _message += std::to_string(value);
+    append(TYPE_INT, &value, sizeof(value));
     return *this;
 }
 
 EzMessage&
 EzMessage::operator<<(const unsigned long value) {
-    _message += std::to_string(value);
+    append(TYPE_ULONG, &value, sizeof(value));
+    return *this;
+}
+
+EzMessage&
+EzMessage::operator<<(const long value) {
+    append(TYPE_LONG, &value, sizeof(value));
+    return *this;
+}
+
+EzMessage&
+EzMessage::operator<<(const unsigned long long value) {
+    append(TYPE_ULONGLONG, &value, sizeof(value));
+    return *this;
+}
+
+EzMessage&
+EzMessage::operator<<(const long long value) {
+    append(TYPE_LONGLONG, &value, sizeof(value));
     return *this;
 }
 
 EzMessage&
 EzMessage::operator<<(const float value) {
-	_message += std::to_string(value);
+	append(TYPE_FLOAT, &value, sizeof(value));
 	return *this;
-}
\ No newline at end of file
+}
+
+EzMessage&
+EzMessage::operator<<(const double value) {
+    append(TYPE_DOUBLE, &value, sizeof(value));
+    return *this;
+}
+
+void
+EzMessage::append(char type, const void* value, unsigned short size) {
+    if (_truncated || _size + 1 + size > ARGUMENTS_SIZE) {
+        _truncated = true;
+        return;
+    }
+    _arguments[_size] = type;
+    memcpy(_arguments + _size + 1, value, size);
+    _size += 1 + size;
+}
+
+void
+EzMessage::appendString(const char* value, size_t length) {
+    const unsigned short header = 1 + sizeof(uint16_t);
+    if (_truncated || _size + header > ARGUMENTS_SIZE) {
+        _truncated = true;
+        return;
+    }
+    
+    // Keeps whatever part of the string fits
+    uint16_t fitting = length;
+    if (_size + header + length > ARGUMENTS_SIZE) {
+        fitting = ARGUMENTS_SIZE - _size - header;
+        _truncated = true;
+    }
+    _arguments[_size] = TYPE_STRING;
+    memcpy(_arguments + _size + 1, &fitting, sizeof(fitting));
+    memcpy(_arguments + _size + header, value, fitting);
+    _size += header + fitting;
+}
@@ -0,0 +1,76 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "EzRotatingFileSink.h"
+
+#include <cstdio>
+
+#include "PiEyeException.hpp"
+
+EzRotatingFileSink::EzRotatingFileSink(const std::string& path, unsigned long maxBytes, unsigned int maxFiles) :
+        _path(path), _maxBytes(maxBytes), _maxFiles(maxFiles), _size(0) {
+    if (maxBytes == 0) {
+        throw PiEyeException("Log file size must be at least one byte");
+    }
+    open();
+}
+
+void
+EzRotatingFileSink::write(const EzMessage& message) {
+    Format(_file, message);
+    const std::streamoff position = _file.tellp();
+    _size = position < 0 ? _size : position;
+    if (_size >= _maxBytes) {
+        rotate();
+    }
+}
+
+void
+EzRotatingFileSink::flush() {
+    _file.flush();
+}
+
+void
+EzRotatingFileSink::open() {
+    _file.open(_path.c_str(), std::ios::out | std::ios::app);
+    if (!_file) {
+        throw PiEyeException("Unable to open log file [" + _path + "]");
+    }
+    _file.seekp(0, std::ios::end);
+    const std::streamoff position = _file.tellp();
+    _size = position < 0 ? 0 : position;
+}
+
+void
+EzRotatingFileSink::rotate() {
+    _file.close();
+    if (_maxFiles == 0) {
+        std::remove(_path.c_str());
+    } else {
+        std::remove((_path + "." + std::to_string(_maxFiles)).c_str());
+        for (unsigned int i = _maxFiles - 1; i > 0; --i) {
+            std::rename((_path + "." + std::to_string(i)).c_str(), (_path + "." + std::to_string(i + 1)).c_str());
+        }
+        std::rename(_path.c_str(), (_path + ".1").c_str());
+    }
+    open();
+}
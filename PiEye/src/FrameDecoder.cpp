@@ -0,0 +1,391 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "FrameDecoder.h"
+
+#include <cstring>
+#include <opencv2/core/core.hpp>
+#include <interface/mmal/mmal_buffer.h>
+
+#include "BufferPool.h"
+#include "I420Converter.h"
+#include "Downscaler.h"
+#include "FrameStatistician.h"
+#include "PiEyeException.hpp"
+#include "Log.hpp"
+
+namespace {
+	unsigned int
+	AlignUp(unsigned int value, unsigned int alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Bytes per pixel in the buffer, for I420 only counting the Y plane
+	unsigned int
+	GetBufferPixelSize(const Encoding& encoding) {
+		switch (encoding) {
+			case Encoding::NATIVE_BGR:
+				return 3;
+			case Encoding::NATIVE_GRAYSCALE:
+			case Encoding::CONVERTED_BGR:
+				return 1;
+		}
+
+		throw PiEyeException("Encoding not supported");
+	}
+
+	unsigned int
+	GetImageChannels(const Encoding& encoding) {
+		switch (encoding) {
+			case Encoding::NATIVE_BGR:
+			case Encoding::CONVERTED_BGR:
+				return 3;
+			case Encoding::NATIVE_GRAYSCALE:
+				return 1;
+		}
+
+		throw PiEyeException("Encoding not supported");
+	}
+
+	uint8_t
+	Clamp(int value) {
+		return value < 0 ? 0 : (value > 255 ? 255 : value);
+	}
+
+	// Full range BT.601, in 8 bit fixed point
+	uint8_t
+	GetLuma(const uint8_t* bgr) {
+		return (29 * bgr[0] + 150 * bgr[1] + 77 * bgr[2] + 128) >> 8;
+	}
+
+	uint8_t
+	GetBlueChroma(const uint8_t* bgr) {
+		return Clamp(((128 * bgr[0] - 85 * bgr[1] - 43 * bgr[2] + 128) >> 8) + 128);
+	}
+
+	uint8_t
+	GetRedChroma(const uint8_t* bgr) {
+		return Clamp(((-21 * bgr[0] - 107 * bgr[1] + 128 * bgr[2] + 128) >> 8) + 128);
+	}
+
+	// Row of a pyramid level is complete: once it completes a pair, halve the pair into the next level
+	void
+	CascadeRow(std::vector<cv::Mat>& levels, unsigned int level, int row, unsigned int channels,
+			std::vector<uint16_t>& scratch) {
+		if (row % 2 == 0 || level + 1 >= levels.size() || row / 2 >= levels[level + 1].rows) {
+			return;
+		}
+		const uint8_t* rows[] = {levels[level].ptr<uint8_t>(row - 1), levels[level].ptr<uint8_t>(row)};
+		Downscaler::DownscaleRow(rows, 2, levels[level].cols, channels, scratch.data(), levels[level + 1].ptr<uint8_t>(row / 2));
+		CascadeRow(levels, level + 1, row / 2, channels, scratch);
+	}
+
+	// Hands a leased buffer back once the last reference to its image is gone
+	class LeaseReturn {
+	public:
+		LeaseReturn(MMAL_BUFFER_HEADER_T* buffer, const std::shared_ptr<BufferPool>& pool) : _buffer(buffer), _pool(pool) {
+		}
+
+		void
+		operator()(cv::Mat* image) {
+			delete image;
+			try {
+				_pool->unlock(_buffer);
+				_pool->recycle(_buffer);
+			} catch (const std::exception& e) {
+				EZLOG_ERROR("Unable to return a leased buffer: " << e.what());
+			}
+		}
+
+	private:
+		MMAL_BUFFER_HEADER_T* _buffer;
+		std::shared_ptr<BufferPool> _pool;
+	};
+}
+
+FrameDecoder::FrameDecoder() : FrameDecoder(Encoding::NATIVE_BGR, 0, 0) {
+}
+
+FrameDecoder::FrameDecoder(const Encoding& encoding, unsigned short width, unsigned short height, unsigned int divisor) :
+		_encoding(encoding), _width(width), _height(height), _stride(AlignWidth(width) * GetBufferPixelSize(encoding)),
+		_divisor(divisor) {
+	if (divisor != 1 && divisor != 2 && divisor != 4) {
+		throw PiEyeException("Frame divisor must be 1, 2 or 4");
+	} else if (divisor != 1 && !CanDownscale(encoding)) {
+		throw PiEyeException("Encoding can't be decoded at a smaller size");
+	}
+}
+
+void
+FrameDecoder::decode(const MMAL_BUFFER_HEADER_T& buffer, cv::Mat& target, FrameStatistician* statistician) const {
+	prepare(target);
+	if (statistician == nullptr || _encoding == Encoding::CONVERTED_BGR) {
+		decodeRows(buffer, target, 0, target.rows);
+		if (statistician != nullptr) {
+			measure(buffer, *statistician);
+		}
+		return;
+	}
+	checkBufferSize(buffer);
+	statistician->begin();
+	
+	const uint8_t* source = buffer.data + buffer.offset;
+	if (_divisor > 1) {
+		const unsigned int channels = GetImageChannels(_encoding);
+		std::vector<uint16_t> scratch(_width * channels);
+		const uint8_t* rows[4];
+		for (int row = 0; row < target.rows; ++row) {
+			for (unsigned int i = 0; i < _divisor; ++i) {
+				rows[i] = source + (row * _divisor + i) * _stride;
+			}
+			Downscaler::DownscaleRow(rows, _divisor, _width, channels, scratch.data(), target.ptr<uint8_t>(row));
+			for (unsigned int i = 0; i < _divisor; ++i) {
+				measureRow(source, row * _divisor + i, *statistician);
+			}
+		}
+		
+		// Rows that don't fill a block of the divisor still count
+		for (unsigned int row = target.rows * _divisor; row < _height; ++row) {
+			measureRow(source, row, *statistician);
+		}
+		return;
+	}
+	
+	const unsigned int rowSize = _width * GetBufferPixelSize(_encoding);
+	for (unsigned short row = 0; row < _height; ++row) {
+		memcpy(target.ptr<uchar>(row), source + row * _stride, rowSize);
+		measureRow(source, row, *statistician);
+	}
+}
+
+void
+FrameDecoder::prepare(cv::Mat& target) const {
+	target.create(_height / _divisor, _width / _divisor, getImageType());
+}
+
+void
+FrameDecoder::decodeRows(const MMAL_BUFFER_HEADER_T& buffer, cv::Mat& target, unsigned int firstRow, unsigned int endRow) const {
+	checkBufferSize(buffer);
+	if ((unsigned int) target.rows != _height / _divisor || (unsigned int) target.cols != _width / _divisor || target.type() != getImageType()) {
+		throw PiEyeException("Target of a row range must be prepared for the frame");
+	} else if (firstRow > endRow || endRow > (unsigned int) target.rows) {
+		throw PiEyeException("Rows [" + std::to_string(firstRow) + ", " + std::to_string(endRow) + ") lie outside the frame");
+	} else if (firstRow == endRow) {
+		return;
+	}
+	
+	const uint8_t* source = buffer.data + buffer.offset;
+	if (_encoding == Encoding::CONVERTED_BGR) {
+		if (firstRow % 2 != 0 || endRow % 2 != 0) {
+			throw PiEyeException("I420 rows must be decoded in pairs");
+		}
+		
+		// Chroma planes follow the Y plane at half the stride and height
+		const uint8_t* u = source + _stride * AlignHeight(_height);
+		const uint8_t* v = u + (_stride / 2) * (AlignHeight(_height) / 2);
+		const unsigned int chromaOffset = (firstRow / 2) * (_stride / 2);
+		cv::Mat rows = target.rowRange(firstRow, endRow);
+		I420Converter::Convert(source + firstRow * _stride, u + chromaOffset, v + chromaOffset, _stride, _stride / 2, rows);
+		return;
+	}
+	
+	if (_divisor > 1) {
+		const unsigned int channels = GetImageChannels(_encoding);
+		std::vector<uint16_t> scratch(_width * channels);
+		const uint8_t* rows[4];
+		for (unsigned int row = firstRow; row < endRow; ++row) {
+			for (unsigned int i = 0; i < _divisor; ++i) {
+				rows[i] = source + (row * _divisor + i) * _stride;
+			}
+			Downscaler::DownscaleRow(rows, _divisor, _width, channels, scratch.data(), target.ptr<uint8_t>(row));
+		}
+		return;
+	}
+	
+	const unsigned int rowSize = _width * GetBufferPixelSize(_encoding);
+	if (target.isContinuous() && rowSize == _stride) {
+		memcpy(target.ptr<uchar>(firstRow), source + firstRow * _stride, rowSize * (endRow - firstRow));
+	} else {
+		for (unsigned int row = firstRow; row < endRow; ++row) {
+			memcpy(target.ptr<uchar>(row), source + row * _stride, rowSize);
+		}
+	}
+}
+
+void
+FrameDecoder::measure(const MMAL_BUFFER_HEADER_T& buffer, FrameStatistician& statistician) const {
+	checkBufferSize(buffer);
+	statistician.begin();
+	const uint8_t* source = buffer.data + buffer.offset;
+	for (unsigned short row = 0; row < _height; ++row) {
+		measureRow(source, row, statistician);
+	}
+}
+
+void
+FrameDecoder::decodePyramid(const MMAL_BUFFER_HEADER_T& buffer, std::vector<cv::Mat>& levels, unsigned int levelCount) const {
+	if (!CanDownscale(_encoding)) {
+		throw PiEyeException("Encoding can't be decoded into a pyramid");
+	} else if (levelCount == 0 || levelCount > 16 || (_width >> (levelCount - 1)) == 0 || (_height >> (levelCount - 1)) == 0) {
+		throw PiEyeException("Frame too small for [" + std::to_string(levelCount) + "] pyramid levels");
+	}
+	checkBufferSize(buffer);
+	
+	levels.resize(levelCount);
+	for (unsigned int level = 0; level < levelCount; ++level) {
+		levels[level].create(_height >> level, _width >> level, getImageType());
+	}
+	
+	// Every source row is read once, halving follows while the rows are still in cache
+	const unsigned int channels = GetImageChannels(_encoding);
+	const unsigned int rowSize = _width * channels;
+	const uint8_t* source = buffer.data + buffer.offset;
+	std::vector<uint16_t> scratch(rowSize);
+	for (unsigned short row = 0; row < _height; ++row) {
+		memcpy(levels[0].ptr<uint8_t>(row), source + row * _stride, rowSize);
+		CascadeRow(levels, 0, row, channels, scratch);
+	}
+}
+
+void
+FrameDecoder::encode(const cv::Mat& source, MMAL_BUFFER_HEADER_T& buffer) const {
+	if (source.type() != CV_8UC3 || source.empty()) {
+		throw PiEyeException("Only BGR images can be encoded");
+	} else if (buffer.alloc_size < getFrameSize()) {
+		throw PiEyeException("Buffer size [" + std::to_string(buffer.alloc_size) + "] too small for frame size [" + std::to_string(getFrameSize()) + "]");
+	}
+	
+	std::vector<int> columns(_width);
+	for (unsigned short x = 0; x < _width; ++x) {
+		columns[x] = x * source.cols / _width;
+	}
+	uint8_t* target = buffer.data;
+	buffer.offset = 0;
+	buffer.length = getFrameSize();
+	if (_encoding == Encoding::NATIVE_BGR) {
+		for (unsigned short y = 0; y < _height; ++y) {
+			const uint8_t* sourceRow = source.ptr<uint8_t>(y * source.rows / _height);
+			uint8_t* row = target + y * _stride;
+			for (unsigned short x = 0; x < _width; ++x) {
+				memcpy(row + 3 * x, sourceRow + 3 * columns[x], 3);
+			}
+		}
+		return;
+	}
+	
+	// I420: chroma is sampled at the top left pixel of every 2x2 block
+	uint8_t* u = target + _stride * AlignHeight(_height);
+	uint8_t* v = u + (_stride / 2) * (AlignHeight(_height) / 2);
+	for (unsigned short y = 0; y < _height; ++y) {
+		const uint8_t* sourceRow = source.ptr<uint8_t>(y * source.rows / _height);
+		uint8_t* row = target + y * _stride;
+		for (unsigned short x = 0; x < _width; ++x) {
+			row[x] = GetLuma(sourceRow + 3 * columns[x]);
+		}
+		if (y % 2 == 0) {
+			uint8_t* uRow = u + (y / 2) * (_stride / 2);
+			uint8_t* vRow = v + (y / 2) * (_stride / 2);
+			for (unsigned short x = 0; x + 1 < _width; x += 2) {
+				uRow[x / 2] = GetBlueChroma(sourceRow + 3 * columns[x]);
+				vRow[x / 2] = GetRedChroma(sourceRow + 3 * columns[x]);
+			}
+		}
+	}
+}
+
+FrameLease
+FrameDecoder::lease(MMAL_BUFFER_HEADER_T* buffer, const std::shared_ptr<BufferPool>& pool) const {
+	if (buffer == nullptr || !pool) {
+		throw PiEyeException("Cannot lease a buffer without buffer or pool");
+	}
+	if (!CanLease(_encoding)) {
+		throw PiEyeException("Encoding can't be leased");
+	}
+	checkBufferSize(*buffer);
+
+	cv::Mat* image = new cv::Mat(_height, _width, getImageType(), buffer->data + buffer->offset, _stride);
+	return FrameLease(std::shared_ptr<cv::Mat>(image, LeaseReturn(buffer, pool)));
+}
+
+unsigned int
+FrameDecoder::getStride() const {
+	return _stride;
+}
+
+unsigned int
+FrameDecoder::getFrameSize() const {
+	const unsigned int planeSize = _stride * AlignHeight(_height);
+	return _encoding == Encoding::NATIVE_BGR ? planeSize : planeSize * 3 / 2;
+}
+
+int
+FrameDecoder::getImageType() const {
+	return CV_8UC(GetImageChannels(_encoding));
+}
+
+bool
+FrameDecoder::CanLease(const Encoding& encoding) {
+	return encoding != Encoding::CONVERTED_BGR;
+}
+
+bool
+FrameDecoder::CanDownscale(const Encoding& encoding) {
+	return encoding != Encoding::CONVERTED_BGR;
+}
+
+unsigned int
+FrameDecoder::AlignWidth(unsigned int width) {
+	return AlignUp(width, 32);
+}
+
+unsigned int
+FrameDecoder::AlignHeight(unsigned int height) {
+	return AlignUp(height, 16);
+}
+
+void
+FrameDecoder::checkBufferSize(const MMAL_BUFFER_HEADER_T& buffer) const {
+	if (_width == 0 || _height == 0) {
+		throw StateException("Decoder has no frame format");
+	}
+
+	// The last row of the last plane needn't be padded
+	unsigned long dataSize = (unsigned long) _stride * (_height - 1) + _width * GetBufferPixelSize(_encoding);
+	if (_encoding == Encoding::CONVERTED_BGR) {
+		dataSize = (unsigned long) _stride * AlignHeight(_height) + (_stride / 2) * (AlignHeight(_height) / 2)
+				+ (_stride / 2) * (_height / 2 - 1) + _width / 2;
+	}
+	if (dataSize > buffer.length) {
+		throw PiEyeException("Buffer size [" + std::to_string(buffer.length) + "] too small for image size [" + std::to_string(dataSize) + "]");
+	}
+}
+
+void
+FrameDecoder::measureRow(const uint8_t* source, unsigned int y, FrameStatistician& statistician) const {
+	if (!statistician.isSampled(y)) {
+		return;
+	} else if (_encoding == Encoding::NATIVE_BGR) {
+		statistician.addBgrRow(source + y * _stride, y);
+	} else {
+		statistician.addLumaRow(source + y * _stride, y);
+	}
+}
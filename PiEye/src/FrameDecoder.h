@@ -0,0 +1,117 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Encoding.hpp"
+#include "FrameLease.h"
+
+namespace cv {
+	class Mat;
+}
+
+struct MMAL_BUFFER_HEADER_T;
+class BufferPool;
+class FrameStatistician;
+
+/**
+ * Turns the raw content of a port buffer into images, according to the format that was committed on that port.
+ */
+class FrameDecoder {
+public:
+	FrameDecoder();
+	// With a divisor of 2 or 4 frames are decoded at that fraction of the size, averaging blocks of pixels
+	FrameDecoder(const Encoding& encoding, unsigned short width, unsigned short height, unsigned int divisor = 1);
+
+	// Copies the frame out of the buffer. With a statistician the statistics of the full size frame are taken in the
+	// same pass, row by row while the rows are in cache; I420 to BGR conversion reads the Y plane once more after.
+	void
+	decode(const MMAL_BUFFER_HEADER_T& buffer, cv::Mat& target, FrameStatistician* statistician = nullptr) const;
+
+	// Gives target the size and type of a decoded frame
+	void
+	prepare(cv::Mat& target) const;
+
+	// Decodes rows [firstRow, endRow) of the frame into a prepared target, so slices of one frame can be decoded on
+	// several threads at once. I420 slices must start and end on even rows.
+	void
+	decodeRows(const MMAL_BUFFER_HEADER_T& buffer, cv::Mat& target, unsigned int firstRow, unsigned int endRow) const;
+
+	// Only takes the statistics, without copying the frame
+	void
+	measure(const MMAL_BUFFER_HEADER_T& buffer, FrameStatistician& statistician) const;
+	
+	// Copies the full size frame and halves it levelCount - 1 times, all in one pass over the buffer. Ignores the divisor.
+	void
+	decodePyramid(const MMAL_BUFFER_HEADER_T& buffer, std::vector<cv::Mat>& levels, unsigned int levelCount) const;
+
+	// The other way around, for software stand-ins of the camera: fills the buffer with a BGR image, nearest neighbour
+	// scaled to the frame size. Ignores the divisor.
+	void
+	encode(const cv::Mat& source, MMAL_BUFFER_HEADER_T& buffer) const;
+
+	// Wraps the frame without copying. On success the lease owns the (memory locked) buffer and gives it back to the pool.
+	// Only for encodings that CanLease.
+	FrameLease
+	lease(MMAL_BUFFER_HEADER_T* buffer, const std::shared_ptr<BufferPool>& pool) const;
+
+	// Row size of the (first plane of the) buffer
+	unsigned int
+	getStride() const;
+	
+	// Size of a complete frame in the buffer
+	unsigned int
+	getFrameSize() const;
+
+	int
+	getImageType() const;
+
+	static bool
+	CanLease(const Encoding& encoding);
+	
+	// Whether decimated and pyramid decoding are supported
+	static bool
+	CanDownscale(const Encoding& encoding);
+	
+	static unsigned int
+	AlignWidth(unsigned int width);
+
+	static unsigned int
+	AlignHeight(unsigned int height);
+
+private:
+	Encoding _encoding;
+	unsigned short _width;
+	unsigned short _height;
+	unsigned int _stride;
+	unsigned int _divisor;
+
+	void
+	checkBufferSize(const MMAL_BUFFER_HEADER_T& buffer) const;
+
+	// Adds source row y to the statistics if the statistician samples it
+	void
+	measureRow(const uint8_t* source, unsigned int y, FrameStatistician& statistician) const;
+};
@@ -0,0 +1,51 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "FrameLease.h"
+
+#include <opencv2/core/core.hpp>
+
+#include "PiEyeException.hpp"
+
+FrameLease::FrameLease() {
+}
+
+FrameLease::FrameLease(const std::shared_ptr<cv::Mat>& image) : _image(image) {
+}
+
+const cv::Mat&
+FrameLease::getImage() const {
+	if (!_image) {
+		throw StateException("Frame lease is not valid");
+	}
+	return *_image;
+}
+
+bool
+FrameLease::isValid() const {
+	return (bool) _image;
+}
+
+void
+FrameLease::release() {
+	_image.reset();
+}
@@ -0,0 +1,138 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "FrameMatcher.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "PiEyeException.hpp"
+
+#define PIEYE_MAX_PENDING_FRAMES 8		// Per camera, while another camera delivers nothing
+
+FrameMatcher::FrameMatcher(unsigned int cameraCount, unsigned int toleranceMicros) : _tolerance(toleranceMicros),
+		_pending(cameraCount), _offsets(cameraCount, 0), _synced(cameraCount, false), _sets(0), _unmatched(cameraCount, 0) {
+	if (cameraCount == 0) {
+		throw PiEyeException("Frame matcher needs at least one camera");
+	}
+}
+
+void
+FrameMatcher::add(unsigned int camera, const cv::Mat& frame, long long pts, long long arrival, std::vector<FrameSet>& sets) {
+	if (camera >= _pending.size()) {
+		throw PiEyeException("Unknown camera [" + std::to_string(camera) + "]");
+	}
+	
+	// The quickest frame so far tells best where the pts lies on the steady clock
+	const long long offset = arrival / 1000 - pts;
+	if (!_synced[camera] || offset < _offsets[camera]) {
+		_offsets[camera] = offset;
+		_synced[camera] = true;
+	}
+	const PendingFrame pending = {frame, pts + _offsets[camera]};
+	_pending[camera].push_back(pending);
+	if (_pending[camera].size() > PIEYE_MAX_PENDING_FRAMES) {
+		drop(camera);
+	}
+	
+	const unsigned int cameraCount = _pending.size();
+	while (true) {
+		long long earliest = 0;
+		long long latest = 0;
+		for (unsigned int i = 0; i < cameraCount; ++i) {
+			if (_pending[i].empty()) {
+				return;
+			}
+			const long long time = _pending[i].front().time;
+			earliest = i == 0 ? time : std::min(earliest, time);
+			latest = i == 0 ? time : std::max(latest, time);
+		}
+		
+		if (latest - earliest > _tolerance) {
+			for (unsigned int i = 0; i < cameraCount; ++i) {
+				while (!_pending[i].empty() && _pending[i].front().time < latest - _tolerance) {
+					drop(i);
+				}
+			}
+			continue;
+		}
+		
+		FrameSet set;
+		set.frames.reserve(cameraCount);
+		set.times.reserve(cameraCount);
+		for (unsigned int i = 0; i < cameraCount; ++i) {
+			set.frames.push_back(_pending[i].front().frame);
+			set.times.push_back(_pending[i].front().time);
+			_pending[i].pop_front();
+		}
+		set.skewMicros = latest - earliest;
+		_skew.record(set.skewMicros * 1000);
+		{
+			std::lock_guard<std::mutex> lock(_statsMutex);
+			++_sets;
+		}
+		sets.push_back(set);
+	}
+}
+
+void
+FrameMatcher::setTolerance(unsigned int micros) {
+	_tolerance = micros;
+}
+
+void
+FrameMatcher::clear() {
+	for (size_t i = 0; i < _pending.size(); ++i) {
+		_pending[i].clear();
+	}
+	std::fill(_synced.begin(), _synced.end(), false);
+}
+
+FrameSetStats
+FrameMatcher::getStats() const {
+	FrameSetStats stats;
+	{
+		std::lock_guard<std::mutex> lock(_statsMutex);
+		stats.sets = _sets;
+		stats.unmatchedByCamera = _unmatched;
+	}
+	stats.unmatched = std::accumulate(stats.unmatchedByCamera.begin(), stats.unmatchedByCamera.end(), 0ULL);
+	stats.skew = _skew.getStats();
+	return stats;
+}
+
+void
+FrameMatcher::resetStats() {
+	{
+		std::lock_guard<std::mutex> lock(_statsMutex);
+		_sets = 0;
+		std::fill(_unmatched.begin(), _unmatched.end(), 0);
+	}
+	_skew.reset();
+}
+
+void
+FrameMatcher::drop(unsigned int camera) {
+	_pending[camera].pop_front();
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	++_unmatched[camera];
+}
@@ -0,0 +1,83 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "FrameSet.hpp"
+#include "LatencyHistogram.h"
+
+/**
+ * Pairs the frames of several cameras by capture time. The pts of each camera is mapped onto the steady clock with
+ * the smallest offset between arrival and pts seen so far, the frame that came through quickest. Whenever every
+ * camera has a frame pending, frames older than the tolerance before the latest of them can't be matched any more
+ * and are dropped, and the rest form a set. With a tolerance below half the frame period every frame has at most one
+ * partner per camera, so the earliest match is the nearest one.
+ */
+class FrameMatcher {
+public:
+	FrameMatcher(unsigned int cameraCount, unsigned int toleranceMicros);
+
+	// Adds a frame with the pts of its camera and its arrival in nanoseconds. Sets it completes are appended.
+	void
+	add(unsigned int camera, const cv::Mat& frame, long long pts, long long arrival, std::vector<FrameSet>& sets);
+
+	// Only while no frames are added
+	void
+	setTolerance(unsigned int micros);
+
+	// Forgets pending frames and the time base, e.g. when the cameras start again
+	void
+	clear();
+
+	FrameSetStats
+	getStats() const;
+
+	void
+	resetStats();
+
+private:
+	struct PendingFrame {
+		cv::Mat frame;
+		long long time;
+	};
+
+	long long _tolerance;
+	std::vector<std::deque<PendingFrame> > _pending;
+	std::vector<long long> _offsets;	// From pts to steady clock microseconds, per camera
+	std::vector<bool> _synced;
+	unsigned long long _sets;
+	std::vector<unsigned long long> _unmatched;
+	LatencyHistogram _skew;
+	mutable std::mutex _statsMutex;
+
+	// Drops the oldest frame of a camera, counting it as unmatched
+	void
+	drop(unsigned int camera);
+
+	FrameMatcher(const FrameMatcher&);
+	FrameMatcher& operator=(const FrameMatcher&);
+};
@@ -0,0 +1,84 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "FramePromises.h"
+
+FramePromises::FramePromises() : _pending(0) {
+}
+
+std::future<cv::Mat>
+FramePromises::add() {
+	std::promise<cv::Mat> promise;
+	std::future<cv::Mat> future = promise.get_future();
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_promises.push_back(std::move(promise));
+	++_pending;
+	return future;
+}
+
+bool
+FramePromises::hasPending() const {
+	return _pending > 0;
+}
+
+void
+FramePromises::fulfil(const cv::Mat& frame) {
+	std::promise<cv::Mat> promise;
+	if (takeOldest(promise)) {
+		promise.set_value(frame);
+	}
+}
+
+void
+FramePromises::fail(const std::exception_ptr& error) {
+	std::promise<cv::Mat> promise;
+	if (takeOldest(promise)) {
+		promise.set_exception(error);
+	}
+}
+
+void
+FramePromises::failAll(const std::exception_ptr& error) {
+	std::deque<std::promise<cv::Mat> > promises;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		promises.swap(_promises);
+		_pending = 0;
+	}
+
+	for (auto&& promise : promises) {
+		promise.set_exception(error);
+	}
+}
+
+bool
+FramePromises::takeOldest(std::promise<cv::Mat>& promise) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_promises.empty()) {
+		return false;
+	}
+	promise = std::move(_promises.front());
+	_promises.pop_front();
+	--_pending;
+	return true;
+}
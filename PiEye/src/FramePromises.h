@@ -0,0 +1,62 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <opencv2/core/core.hpp>
+
+/**
+ * Pending asynchronous frame requests. Each arriving frame fulfils the oldest request, so requests that are in flight
+ * together receive consecutive frames.
+ */
+class FramePromises {
+public:
+	FramePromises();
+
+	std::future<cv::Mat>
+	add();
+
+	// Cheap check for the callback, does not lock
+	bool
+	hasPending() const;
+
+	void
+	fulfil(const cv::Mat& frame);
+
+	void
+	fail(const std::exception_ptr& error);
+
+	void
+	failAll(const std::exception_ptr& error);
+
+private:
+	std::deque<std::promise<cv::Mat> > _promises;
+	std::mutex _mutex;
+	std::atomic<unsigned int> _pending;
+
+	bool
+	takeOldest(std::promise<cv::Mat>& promise);
+};
@@ -0,0 +1,252 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "FrameStatistician.h"
+
+#include <algorithm>
+#include <string>
+
+#include "PiEyeException.hpp"
+
+#if defined(PIEYE_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define PIEYE_STATISTICS_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define PIEYE_STATISTICS_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+	const unsigned int VECTOR_SIZE = 16;
+	const unsigned int LEVELS = 256;
+	const unsigned int HISTOGRAM_TABLES = 4;
+	const LuminanceSums EMPTY_SUMS = {0, 0, 0, 0, 255, 0};
+
+#if defined(PIEYE_STATISTICS_NEON)
+	const char* const KERNEL_NAME = "NEON";
+#elif defined(PIEYE_STATISTICS_SSE)
+	const char* const KERNEL_NAME = "SSE2";
+#else
+	const char* const KERNEL_NAME = "scalar";
+#endif
+
+	void
+	Merge(const LuminanceSums& source, LuminanceSums& target) {
+		target.sum += source.sum;
+		target.pixels += source.pixels;
+		target.dark += source.dark;
+		target.bright += source.bright;
+		target.min = std::min(target.min, source.min);
+		target.max = std::max(target.max, source.max);
+	}
+
+	LuminanceStats
+	ToStats(const LuminanceSums& sums) {
+		LuminanceStats stats = LuminanceStats();
+		if (sums.pixels > 0) {
+			stats.mean = (float) sums.sum / sums.pixels;
+			stats.min = sums.min;
+			stats.max = sums.max;
+			stats.darkFraction = (float) sums.dark / sums.pixels;
+			stats.brightFraction = (float) sums.bright / sums.pixels;
+		}
+		return stats;
+	}
+
+	// Sum, extremes and clipped pixels of size pixels
+	LuminanceSums
+	SumSegment(const uint8_t* pixels, unsigned int size, uint8_t darkLevel, uint8_t brightLevel) {
+		LuminanceSums sums = EMPTY_SUMS;
+		sums.pixels = size;
+		unsigned int i = 0;
+		uint8_t lows[VECTOR_SIZE];
+		uint8_t highs[VECTOR_SIZE];
+#if defined(PIEYE_STATISTICS_NEON)
+		if (size >= VECTOR_SIZE) {
+			const uint8x16_t dark = vdupq_n_u8(darkLevel);
+			const uint8x16_t bright = vdupq_n_u8(brightLevel);
+			uint32x4_t sum = vdupq_n_u32(0);
+			uint32x4_t darkCount = vdupq_n_u32(0);
+			uint32x4_t brightCount = vdupq_n_u32(0);
+			uint8x16_t low = vdupq_n_u8(255);
+			uint8x16_t high = vdupq_n_u8(0);
+			for (; i + VECTOR_SIZE <= size; i += VECTOR_SIZE) {
+				const uint8x16_t next = vld1q_u8(pixels + i);
+				sum = vpadalq_u16(sum, vpaddlq_u8(next));
+				darkCount = vpadalq_u16(darkCount, vpaddlq_u8(vshrq_n_u8(vcleq_u8(next, dark), 7)));
+				brightCount = vpadalq_u16(brightCount, vpaddlq_u8(vshrq_n_u8(vcgeq_u8(next, bright), 7)));
+				low = vminq_u8(low, next);
+				high = vmaxq_u8(high, next);
+			}
+			uint32_t lanes[4];
+			vst1q_u32(lanes, sum);
+			sums.sum = (unsigned long long) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+			vst1q_u32(lanes, darkCount);
+			sums.dark = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+			vst1q_u32(lanes, brightCount);
+			sums.bright = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+			vst1q_u8(lows, low);
+			vst1q_u8(highs, high);
+			sums.min = *std::min_element(lows, lows + VECTOR_SIZE);
+			sums.max = *std::max_element(highs, highs + VECTOR_SIZE);
+		}
+#elif defined(PIEYE_STATISTICS_SSE)
+		if (size >= VECTOR_SIZE) {
+			// Compares are signed, so pixels at or below a level are those the minimum leaves as they are
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i one = _mm_set1_epi8(1);
+			const __m128i dark = _mm_set1_epi8(darkLevel);
+			const __m128i bright = _mm_set1_epi8(brightLevel);
+			__m128i sum = zero;
+			__m128i darkCount = zero;
+			__m128i brightCount = zero;
+			__m128i low = _mm_set1_epi8(-1);
+			__m128i high = zero;
+			for (; i + VECTOR_SIZE <= size; i += VECTOR_SIZE) {
+				const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+				sum = _mm_add_epi64(sum, _mm_sad_epu8(next, zero));
+				const __m128i isDark = _mm_cmpeq_epi8(_mm_min_epu8(next, dark), next);
+				const __m128i isBright = _mm_cmpeq_epi8(_mm_max_epu8(next, bright), next);
+				darkCount = _mm_add_epi64(darkCount, _mm_sad_epu8(_mm_and_si128(isDark, one), zero));
+				brightCount = _mm_add_epi64(brightCount, _mm_sad_epu8(_mm_and_si128(isBright, one), zero));
+				low = _mm_min_epu8(low, next);
+				high = _mm_max_epu8(high, next);
+			}
+			sums.sum = _mm_cvtsi128_si32(sum) + (unsigned long long) _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+			sums.dark = _mm_cvtsi128_si32(darkCount) + _mm_cvtsi128_si32(_mm_srli_si128(darkCount, 8));
+			sums.bright = _mm_cvtsi128_si32(brightCount) + _mm_cvtsi128_si32(_mm_srli_si128(brightCount, 8));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lows), low);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(highs), high);
+			sums.min = *std::min_element(lows, lows + VECTOR_SIZE);
+			sums.max = *std::max_element(highs, highs + VECTOR_SIZE);
+		}
+#endif
+		for (; i < size; ++i) {
+			const uint8_t pixel = pixels[i];
+			sums.sum += pixel;
+			sums.dark += pixel <= darkLevel ? 1 : 0;
+			sums.bright += pixel >= brightLevel ? 1 : 0;
+			sums.min = std::min(sums.min, pixel);
+			sums.max = std::max(sums.max, pixel);
+		}
+		return sums;
+	}
+
+	// Neighbouring pixels count into different tables, which are added up in the end
+	void
+	CountLevels(const uint8_t* pixels, unsigned int size, unsigned int* histograms) {
+		unsigned int* const first = histograms;
+		unsigned int* const second = histograms + LEVELS;
+		unsigned int* const third = histograms + 2 * LEVELS;
+		unsigned int* const fourth = histograms + 3 * LEVELS;
+		unsigned int i = 0;
+		for (; i + HISTOGRAM_TABLES <= size; i += HISTOGRAM_TABLES) {
+			++first[pixels[i]];
+			++second[pixels[i + 1]];
+			++third[pixels[i + 2]];
+			++fourth[pixels[i + 3]];
+		}
+		for (; i < size; ++i) {
+			++first[pixels[i]];
+		}
+	}
+}
+
+FrameStatistician::FrameStatistician(const StatisticsSettings& settings, unsigned short width, unsigned short height) :
+		_width(width), _rowStep(settings.rowStep == 0 ? 1 : settings.rowStep), _darkLevel(settings.darkLevel),
+		_brightLevel(settings.brightLevel == 0 ? 255 : settings.brightLevel),
+		_grid(settings.gridColumns > 0 || settings.gridRows > 0), _columns(std::max(1u, settings.gridColumns)),
+		_histograms(HISTOGRAM_TABLES * LEVELS), _luma(width) {
+	const unsigned int rows = std::max(1u, settings.gridRows);
+	if (_columns > width || rows > height) {
+		throw PiEyeException("Statistics grid of [" + std::to_string(_columns) + "x" + std::to_string(rows)
+				+ "] cells is finer than the frame");
+	} else if (_darkLevel >= _brightLevel) {
+		throw PiEyeException("Dark level must lie below the bright level");
+	}
+	_columnStarts.resize(_columns + 1);
+	for (unsigned int column = 0; column <= _columns; ++column) {
+		_columnStarts[column] = column * width / _columns;
+	}
+	_cellRows.resize(height);
+	for (unsigned int row = 0; row < rows; ++row) {
+		std::fill(_cellRows.begin() + row * height / rows, _cellRows.begin() + (row + 1) * height / rows, row);
+	}
+	_cells.resize(_columns * rows);
+	begin();
+}
+
+void
+FrameStatistician::begin() {
+	std::fill(_cells.begin(), _cells.end(), EMPTY_SUMS);
+	std::fill(_histograms.begin(), _histograms.end(), 0);
+}
+
+bool
+FrameStatistician::isSampled(unsigned int y) const {
+	return y % _rowStep == 0;
+}
+
+void
+FrameStatistician::addLumaRow(const uint8_t* row, unsigned int y) {
+	LuminanceSums* cells = _cells.data() + _cellRows[y] * _columns;
+	for (unsigned int column = 0; column < _columns; ++column) {
+		const unsigned int start = _columnStarts[column];
+		Merge(SumSegment(row + start, _columnStarts[column + 1] - start, _darkLevel, _brightLevel), cells[column]);
+	}
+	CountLevels(row, _width, _histograms.data());
+}
+
+void
+FrameStatistician::addBgrRow(const uint8_t* row, unsigned int y) {
+	for (unsigned int x = 0; x < _width; ++x) {
+		const uint8_t* pixel = row + 3 * x;
+		_luma[x] = (pixel[0] + 2 * pixel[1] + pixel[2] + 2) >> 2;
+	}
+	addLumaRow(_luma.data(), y);
+}
+
+void
+FrameStatistician::finish(long long pts, FrameStatistics& statistics) const {
+	statistics.pts = pts;
+	statistics.gridColumns = _grid ? _columns : 0;
+	statistics.gridRows = _grid ? _cells.size() / _columns : 0;
+	statistics.cells.resize(_grid ? _cells.size() : 0);
+	LuminanceSums total = EMPTY_SUMS;
+	for (size_t cell = 0; cell < _cells.size(); ++cell) {
+		Merge(_cells[cell], total);
+		if (_grid) {
+			statistics.cells[cell] = ToStats(_cells[cell]);
+		}
+	}
+	statistics.pixels = total.pixels;
+	statistics.frame = ToStats(total);
+	for (unsigned int level = 0; level < LEVELS; ++level) {
+		statistics.histogram[level] = _histograms[level] + _histograms[LEVELS + level] + _histograms[2 * LEVELS + level]
+				+ _histograms[3 * LEVELS + level];
+	}
+}
+
+const char*
+FrameStatistician::GetKernelName() {
+	return KERNEL_NAME;
+}
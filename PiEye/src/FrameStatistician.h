@@ -0,0 +1,87 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "FrameStatistics.hpp"
+
+// Running sums of a cell, or of a segment of a row
+struct LuminanceSums {
+	unsigned long long sum;
+	unsigned int pixels;
+	unsigned int dark;
+	unsigned int bright;
+	uint8_t min;
+	uint8_t max;
+};
+
+/**
+ * Accumulates luminance statistics of a frame row by row, so they can be taken while the decoder has the rows in cache.
+ * Sums, extremes and clipped pixels of the cells are vectorized 16 pixels at a time; the histogram spreads its counts
+ * over four tables, so neighbouring pixels of the same level don't wait on each other.
+ */
+class FrameStatistician {
+public:
+	FrameStatistician(const StatisticsSettings& settings, unsigned short width, unsigned short height);
+
+	// Starts over for the next frame
+	void
+	begin();
+
+	// Whether row y is read at all
+	bool
+	isSampled(unsigned int y) const;
+
+	// Adds row y of a luminance plane, only for sampled rows
+	void
+	addLumaRow(const uint8_t* row, unsigned int y);
+
+	// Adds row y of a BGR image, turned into luminance first
+	void
+	addBgrRow(const uint8_t* row, unsigned int y);
+
+	// Statistics of the rows added since begin
+	void
+	finish(long long pts, FrameStatistics& statistics) const;
+
+	static const char*
+	GetKernelName();
+
+private:
+	const unsigned short _width;
+	const unsigned int _rowStep;
+	const uint8_t _darkLevel;
+	const uint8_t _brightLevel;
+	const bool _grid;
+	const unsigned int _columns;
+	std::vector<unsigned int> _columnStarts;	// One more than there are columns
+	std::vector<unsigned int> _cellRows;		// Per frame row
+	std::vector<LuminanceSums> _cells;
+	std::vector<unsigned int> _histograms;		// Four tables of 256
+	std::vector<uint8_t> _luma;					// Scratch row for BGR
+
+	FrameStatistician(const FrameStatistician&);
+	FrameStatistician& operator=(const FrameStatistician&);
+};
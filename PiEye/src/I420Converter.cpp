@@ -0,0 +1,344 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "I420Converter.h"
+
+#include <opencv2/core/core.hpp>
+
+// NEON only with PIEYE_NEON, the compiler alone turns it on for every aarch64 build
+#if defined(PIEYE_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define PIEYE_I420_NEON
+#include <arm_neon.h>
+#elif defined(__AVX2__)
+#define PIEYE_I420_AVX2
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#define PIEYE_I420_SSE
+#include <smmintrin.h>
+#endif
+
+#include "PiEyeException.hpp"
+
+// Frames at least this large are converted in parallel
+#define PIEYE_I420_PARALLEL_PIXELS (640 * 480)
+
+namespace {
+	// ITU-R BT.601 coefficients in 20 bit fixed point, as used by OpenCV
+	const int SHIFT = 20;
+	const int HALF = 1 << (SHIFT - 1);
+	const int CY = 1220542;
+	const int CUB = 2116026;
+	const int CUG = -409993;
+	const int CVG = -852492;
+	const int CVR = 1673527;
+
+	struct RowPair {
+		const uint8_t* y0;
+		const uint8_t* y1;
+		const uint8_t* u;
+		const uint8_t* v;
+		uint8_t* bgr0;
+		uint8_t* bgr1;
+	};
+
+	inline uint8_t
+	Clamp(int value) {
+		return value < 0 ? 0 : (value > 255 ? 255 : value);
+	}
+
+	inline void
+	ConvertPixel(uint8_t luma, int ruv, int guv, int buv, uint8_t* bgr) {
+		const int y = (luma > 16 ? luma - 16 : 0) * CY;
+		bgr[0] = Clamp((y + buv) >> SHIFT);
+		bgr[1] = Clamp((y + guv) >> SHIFT);
+		bgr[2] = Clamp((y + ruv) >> SHIFT);
+	}
+
+	// Converts pixels [start, width) of both rows, two pixels per chroma sample
+	void
+	ConvertScalar(const RowPair& rows, unsigned int start, unsigned int width) {
+		for (unsigned int x = start; x < width; x += 2) {
+			const int u = rows.u[x / 2] - 128;
+			const int v = rows.v[x / 2] - 128;
+			const int ruv = HALF + CVR * v;
+			const int guv = HALF + CVG * v + CUG * u;
+			const int buv = HALF + CUB * u;
+			ConvertPixel(rows.y0[x], ruv, guv, buv, rows.bgr0 + 3 * x);
+			ConvertPixel(rows.y0[x + 1], ruv, guv, buv, rows.bgr0 + 3 * x + 3);
+			ConvertPixel(rows.y1[x], ruv, guv, buv, rows.bgr1 + 3 * x);
+			ConvertPixel(rows.y1[x + 1], ruv, guv, buv, rows.bgr1 + 3 * x + 3);
+		}
+	}
+
+#if defined(PIEYE_I420_NEON)
+	const char* const KERNEL_NAME = "NEON";
+
+	// Eight pixels of one channel: (y + chroma) >> SHIFT, saturated to 8 bit
+	inline uint8x8_t
+	Channel(int32x4_t y0, int32x4_t y1, int32x4_t chroma0, int32x4_t chroma1) {
+		const int16x4_t low = vqmovn_s32(vshrq_n_s32(vaddq_s32(y0, chroma0), SHIFT));
+		const int16x4_t high = vqmovn_s32(vshrq_n_s32(vaddq_s32(y1, chroma1), SHIFT));
+		return vqmovun_s16(vcombine_s16(low, high));
+	}
+
+	// Sixteen pixels of one row, with the chroma terms already duplicated per pixel pair
+	inline void
+	ConvertRow16(const uint8_t* luma, const int32x4x2_t* ruv, const int32x4x2_t* guv, const int32x4x2_t* buv,
+			uint8_t* bgr) {
+		const uint8x16_t y8 = vqsubq_u8(vld1q_u8(luma), vdupq_n_u8(16));
+		const uint16x8_t yLow = vmovl_u8(vget_low_u8(y8));
+		const uint16x8_t yHigh = vmovl_u8(vget_high_u8(y8));
+		int32x4_t y[4];
+		y[0] = vmulq_n_s32(vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(yLow))), CY);
+		y[1] = vmulq_n_s32(vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(yLow))), CY);
+		y[2] = vmulq_n_s32(vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(yHigh))), CY);
+		y[3] = vmulq_n_s32(vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(yHigh))), CY);
+
+		for (unsigned int half = 0; half < 2; ++half) {
+			uint8x8x3_t pixels;
+			pixels.val[0] = Channel(y[2 * half], y[2 * half + 1], buv[half].val[0], buv[half].val[1]);
+			pixels.val[1] = Channel(y[2 * half], y[2 * half + 1], guv[half].val[0], guv[half].val[1]);
+			pixels.val[2] = Channel(y[2 * half], y[2 * half + 1], ruv[half].val[0], ruv[half].val[1]);
+			vst3_u8(bgr + 24 * half, pixels);
+		}
+	}
+
+	unsigned int
+	ConvertVector(const RowPair& rows, unsigned int width) {
+		const int32x4_t half = vdupq_n_s32(HALF);
+		unsigned int x = 0;
+		for (; x + 16 <= width; x += 16) {
+			const int16x8_t u = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(rows.u + x / 2), vdup_n_u8(128)));
+			const int16x8_t v = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(rows.v + x / 2), vdup_n_u8(128)));
+			int32x4x2_t ruv[2];
+			int32x4x2_t guv[2];
+			int32x4x2_t buv[2];
+			for (unsigned int i = 0; i < 2; ++i) {
+				const int32x4_t u32 = vmovl_s16(i == 0 ? vget_low_s16(u) : vget_high_s16(u));
+				const int32x4_t v32 = vmovl_s16(i == 0 ? vget_low_s16(v) : vget_high_s16(v));
+				const int32x4_t r = vmlaq_n_s32(half, v32, CVR);
+				const int32x4_t g = vmlaq_n_s32(vmlaq_n_s32(half, v32, CVG), u32, CUG);
+				const int32x4_t b = vmlaq_n_s32(half, u32, CUB);
+				ruv[i] = vzipq_s32(r, r);
+				guv[i] = vzipq_s32(g, g);
+				buv[i] = vzipq_s32(b, b);
+			}
+			ConvertRow16(rows.y0 + x, ruv, guv, buv, rows.bgr0 + 3 * x);
+			ConvertRow16(rows.y1 + x, ruv, guv, buv, rows.bgr1 + 3 * x);
+		}
+		return x;
+	}
+#elif defined(PIEYE_I420_AVX2) || defined(PIEYE_I420_SSE)
+	// Shuffle masks interleaving three planar vectors of 16 bytes into 48 bytes of BGR
+	struct InterleaveMasks {
+		__m128i masks[3][3];	// [output vector][channel]
+
+		InterleaveMasks() {
+			for (int output = 0; output < 3; ++output) {
+				for (int channel = 0; channel < 3; ++channel) {
+					alignas(16) int8_t mask[16];
+					for (int i = 0; i < 16; ++i) {
+						const int position = output * 16 + i;
+						mask[i] = position % 3 == channel ? position / 3 : -1;
+					}
+					masks[output][channel] = _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+				}
+			}
+		}
+	};
+
+	const InterleaveMasks INTERLEAVE;
+
+	inline void
+	StoreBgr(__m128i b, __m128i g, __m128i r, uint8_t* bgr) {
+		for (int output = 0; output < 3; ++output) {
+			const __m128i pixels = _mm_or_si128(_mm_or_si128(
+					_mm_shuffle_epi8(b, INTERLEAVE.masks[output][0]),
+					_mm_shuffle_epi8(g, INTERLEAVE.masks[output][1])),
+					_mm_shuffle_epi8(r, INTERLEAVE.masks[output][2]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(bgr + 16 * output), pixels);
+		}
+	}
+
+#if defined(PIEYE_I420_AVX2)
+	const char* const KERNEL_NAME = "AVX2";
+
+	// Sixteen pixels of one channel: (y + chroma) >> SHIFT, saturated to 8 bit
+	inline __m128i
+	Channel(__m256i y0, __m256i y1, __m256i chroma0, __m256i chroma1) {
+		const __m256i low = _mm256_srai_epi32(_mm256_add_epi32(y0, chroma0), SHIFT);
+		const __m256i high = _mm256_srai_epi32(_mm256_add_epi32(y1, chroma1), SHIFT);
+		// packs works per 128 bit lane, put the quarters back in order
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+		return _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+	}
+
+	inline void
+	ConvertRow16(const uint8_t* luma, const __m256i* ruv, const __m256i* guv, const __m256i* buv, uint8_t* bgr) {
+		const __m128i y8 = _mm_subs_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(luma)), _mm_set1_epi8(16));
+		const __m256i cy = _mm256_set1_epi32(CY);
+		const __m256i y0 = _mm256_mullo_epi32(_mm256_cvtepu8_epi32(y8), cy);
+		const __m256i y1 = _mm256_mullo_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(y8, 8)), cy);
+		StoreBgr(Channel(y0, y1, buv[0], buv[1]), Channel(y0, y1, guv[0], guv[1]), Channel(y0, y1, ruv[0], ruv[1]), bgr);
+	}
+
+	unsigned int
+	ConvertVector(const RowPair& rows, unsigned int width) {
+		const __m256i half = _mm256_set1_epi32(HALF);
+		const __m256i offset = _mm256_set1_epi32(128);
+		const __m256i duplicateLow = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+		const __m256i duplicateHigh = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+		unsigned int x = 0;
+		for (; x + 16 <= width; x += 16) {
+			const __m256i u = _mm256_sub_epi32(_mm256_cvtepu8_epi32(
+					_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows.u + x / 2))), offset);
+			const __m256i v = _mm256_sub_epi32(_mm256_cvtepu8_epi32(
+					_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows.v + x / 2))), offset);
+			const __m256i r = _mm256_add_epi32(half, _mm256_mullo_epi32(v, _mm256_set1_epi32(CVR)));
+			const __m256i g = _mm256_add_epi32(_mm256_add_epi32(half, _mm256_mullo_epi32(v, _mm256_set1_epi32(CVG))),
+					_mm256_mullo_epi32(u, _mm256_set1_epi32(CUG)));
+			const __m256i b = _mm256_add_epi32(half, _mm256_mullo_epi32(u, _mm256_set1_epi32(CUB)));
+			const __m256i ruv[2] = {_mm256_permutevar8x32_epi32(r, duplicateLow), _mm256_permutevar8x32_epi32(r, duplicateHigh)};
+			const __m256i guv[2] = {_mm256_permutevar8x32_epi32(g, duplicateLow), _mm256_permutevar8x32_epi32(g, duplicateHigh)};
+			const __m256i buv[2] = {_mm256_permutevar8x32_epi32(b, duplicateLow), _mm256_permutevar8x32_epi32(b, duplicateHigh)};
+			ConvertRow16(rows.y0 + x, ruv, guv, buv, rows.bgr0 + 3 * x);
+			ConvertRow16(rows.y1 + x, ruv, guv, buv, rows.bgr1 + 3 * x);
+		}
+		return x;
+	}
+#else
+	const char* const KERNEL_NAME = "SSE4.1";
+
+	// Sixteen pixels of one channel: (y + chroma) >> SHIFT, saturated to 8 bit
+	inline __m128i
+	Channel(const __m128i* y, const __m128i* chroma) {
+		__m128i sums[4];
+		for (int i = 0; i < 4; ++i) {
+			sums[i] = _mm_srai_epi32(_mm_add_epi32(y[i], chroma[i]), SHIFT);
+		}
+		return _mm_packus_epi16(_mm_packs_epi32(sums[0], sums[1]), _mm_packs_epi32(sums[2], sums[3]));
+	}
+
+	inline void
+	ConvertRow16(const uint8_t* luma, const __m128i* ruv, const __m128i* guv, const __m128i* buv, uint8_t* bgr) {
+		const __m128i y8 = _mm_subs_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(luma)), _mm_set1_epi8(16));
+		const __m128i cy = _mm_set1_epi32(CY);
+		const __m128i y[4] = {
+				_mm_mullo_epi32(_mm_cvtepu8_epi32(y8), cy),
+				_mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(y8, 4)), cy),
+				_mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(y8, 8)), cy),
+				_mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(y8, 12)), cy)};
+		StoreBgr(Channel(y, buv), Channel(y, guv), Channel(y, ruv), bgr);
+	}
+
+	unsigned int
+	ConvertVector(const RowPair& rows, unsigned int width) {
+		const __m128i half = _mm_set1_epi32(HALF);
+		const __m128i offset = _mm_set1_epi32(128);
+		unsigned int x = 0;
+		for (; x + 16 <= width; x += 16) {
+			const __m128i u8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows.u + x / 2));
+			const __m128i v8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows.v + x / 2));
+			__m128i ruv[4];
+			__m128i guv[4];
+			__m128i buv[4];
+			for (int i = 0; i < 2; ++i) {
+				const __m128i u = _mm_sub_epi32(_mm_cvtepu8_epi32(i == 0 ? u8 : _mm_srli_si128(u8, 4)), offset);
+				const __m128i v = _mm_sub_epi32(_mm_cvtepu8_epi32(i == 0 ? v8 : _mm_srli_si128(v8, 4)), offset);
+				const __m128i r = _mm_add_epi32(half, _mm_mullo_epi32(v, _mm_set1_epi32(CVR)));
+				const __m128i g = _mm_add_epi32(_mm_add_epi32(half, _mm_mullo_epi32(v, _mm_set1_epi32(CVG))),
+						_mm_mullo_epi32(u, _mm_set1_epi32(CUG)));
+				const __m128i b = _mm_add_epi32(half, _mm_mullo_epi32(u, _mm_set1_epi32(CUB)));
+				ruv[2 * i] = _mm_unpacklo_epi32(r, r);
+				ruv[2 * i + 1] = _mm_unpackhi_epi32(r, r);
+				guv[2 * i] = _mm_unpacklo_epi32(g, g);
+				guv[2 * i + 1] = _mm_unpackhi_epi32(g, g);
+				buv[2 * i] = _mm_unpacklo_epi32(b, b);
+				buv[2 * i + 1] = _mm_unpackhi_epi32(b, b);
+			}
+			ConvertRow16(rows.y0 + x, ruv, guv, buv, rows.bgr0 + 3 * x);
+			ConvertRow16(rows.y1 + x, ruv, guv, buv, rows.bgr1 + 3 * x);
+		}
+		return x;
+	}
+#endif
+#else
+	const char* const KERNEL_NAME = "scalar";
+
+	unsigned int
+	ConvertVector(const RowPair&, unsigned int) {
+		return 0;
+	}
+#endif
+
+	// Converts a range of row pairs
+	class ConvertBody : public cv::ParallelLoopBody {
+	public:
+		ConvertBody(const uint8_t* y, const uint8_t* u, const uint8_t* v, unsigned int yStride, unsigned int uvStride,
+				cv::Mat& target) : _y(y), _u(u), _v(v), _yStride(yStride), _uvStride(uvStride), _target(target) {
+		}
+
+		virtual void
+		operator()(const cv::Range& range) const {
+			const unsigned int width = _target.cols;
+			for (int pair = range.start; pair < range.end; ++pair) {
+				RowPair rows;
+				rows.y0 = _y + 2 * pair * _yStride;
+				rows.y1 = rows.y0 + _yStride;
+				rows.u = _u + pair * _uvStride;
+				rows.v = _v + pair * _uvStride;
+				rows.bgr0 = _target.ptr<uint8_t>(2 * pair);
+				rows.bgr1 = _target.ptr<uint8_t>(2 * pair + 1);
+				ConvertScalar(rows, ConvertVector(rows, width), width);
+			}
+		}
+
+	private:
+		const uint8_t* _y;
+		const uint8_t* _u;
+		const uint8_t* _v;
+		const unsigned int _yStride;
+		const unsigned int _uvStride;
+		cv::Mat& _target;
+	};
+}
+
+void
+I420Converter::Convert(const uint8_t* y, const uint8_t* u, const uint8_t* v, unsigned int yStride,
+		unsigned int uvStride, cv::Mat& target) {
+	if (target.type() != CV_8UC3 || target.cols % 2 != 0 || target.rows % 2 != 0) {
+		throw PiEyeException("I420 conversion needs an even sized BGR image");
+	}
+
+	const ConvertBody body(y, u, v, yStride, uvStride, target);
+	const cv::Range pairs(0, target.rows / 2);
+	if (target.cols * target.rows >= PIEYE_I420_PARALLEL_PIXELS) {
+		cv::parallel_for_(pairs, body, cv::getNumThreads());
+	} else {
+		body(pairs);
+	}
+}
+
+const char*
+I420Converter::GetKernelName() {
+	return KERNEL_NAME;
+}
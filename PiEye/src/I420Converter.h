@@ -0,0 +1,44 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <cstdint>
+
+namespace cv {
+	class Mat;
+}
+
+/**
+ * Converts I420 frames to BGR with the same fixed point math as cv::cvtColor(COLOR_YUV2BGR_I420), so the results are
+ * identical. Uses NEON, AVX2 or SSE4.1 when the compiler targets them and spreads large frames over all cores.
+ */
+class I420Converter {
+public:
+	// Converts into target, which must already have the (even) frame size and type CV_8UC3
+	static void
+	Convert(const uint8_t* y, const uint8_t* u, const uint8_t* v, unsigned int yStride, unsigned int uvStride,
+			cv::Mat& target);
+
+	static const char*
+	GetKernelName();
+};
@@ -0,0 +1,89 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+
+LatencyHistogram::LatencyHistogram() : _max(0) {
+	reset();
+}
+
+void
+LatencyHistogram::record(unsigned long long nanos) {
+	_counts[GetBucket(nanos)].fetch_add(1, std::memory_order_relaxed);
+	unsigned long long max = _max.load(std::memory_order_relaxed);
+	while (nanos > max && !_max.compare_exchange_weak(max, nanos, std::memory_order_relaxed)) {
+	}
+}
+
+DurationStats
+LatencyHistogram::getStats() const {
+	unsigned long long counts[BUCKET_COUNT];
+	unsigned long long total = 0;
+	for (unsigned int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+		counts[bucket] = _counts[bucket].load(std::memory_order_relaxed);
+		total += counts[bucket];
+	}
+
+	DurationStats stats = {total, 0, 0, _max.load(std::memory_order_relaxed) / 1000.0f};
+	const double fractions[] = {0.5, 0.99};
+	float* const percentiles[] = {&stats.p50, &stats.p99};
+	for (unsigned int i = 0; i < 2 && total > 0; ++i) {
+		const unsigned long long rank = std::max(1ull, (unsigned long long) (fractions[i] * total + 0.5));
+		unsigned long long seen = 0;
+		unsigned int bucket = 0;
+		while (bucket < BUCKET_COUNT - 1 && seen + counts[bucket] < rank) {
+			seen += counts[bucket++];
+		}
+		*percentiles[i] = std::min(stats.max, (float) (GetValue(bucket) / 1000));
+	}
+	return stats;
+}
+
+void
+LatencyHistogram::reset() {
+	for (unsigned int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+		_counts[bucket].store(0, std::memory_order_relaxed);
+	}
+	_max.store(0, std::memory_order_relaxed);
+}
+
+unsigned int
+LatencyHistogram::GetBucket(unsigned long long nanos) {
+	if (nanos < SUB_BUCKETS) {
+		return nanos;
+	}
+	const unsigned int exponent = 63 - __builtin_clzll(nanos);
+	const unsigned int shift = exponent - SUB_BUCKET_BITS;
+	return SUB_BUCKETS + shift * SUB_BUCKETS + ((nanos >> shift) & (SUB_BUCKETS - 1));
+}
+
+double
+LatencyHistogram::GetValue(unsigned int bucket) {
+	if (bucket < SUB_BUCKETS) {
+		return bucket;
+	}
+	const unsigned int shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+	const unsigned long long lowest = (unsigned long long) (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+	return lowest + ((1ull << shift) - 1) / 2.0;
+}
@@ -0,0 +1,65 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+
+#include "CaptureStats.hpp"
+
+/**
+ * Histogram of durations in nanoseconds that can be recorded from any thread without locking. Values up to 16 ns have
+ * a bucket each, larger values share 16 buckets per power of two, so a bucket is never wider than 1/16 of its value.
+ * Recording is a couple of relaxed atomic operations; a snapshot taken while recording may be off by the values being
+ * recorded.
+ */
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+
+	void
+	record(unsigned long long nanos);
+
+	DurationStats
+	getStats() const;
+
+	void
+	reset();
+
+private:
+	static const unsigned int SUB_BUCKET_BITS = 4;
+	static const unsigned int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const unsigned int BUCKET_COUNT = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+	std::atomic<unsigned long long> _counts[BUCKET_COUNT];
+	std::atomic<unsigned long long> _max;
+
+	static unsigned int
+	GetBucket(unsigned long long nanos);
+
+	// Middle of the values counted in a bucket
+	static double
+	GetValue(unsigned int bucket);
+
+	LatencyHistogram(const LatencyHistogram&);
+	LatencyHistogram& operator=(const LatencyHistogram&);
+};
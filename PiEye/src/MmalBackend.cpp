@@ -0,0 +1,810 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "MmalBackend.h"
+
+#include <algorithm>
+#include <interface/mmal/mmal.h>
+#include <interface/mmal/util/mmal_default_components.h>
+#include <interface/mmal/util/mmal_util_params.h>
+#include <interface/mmal/util/mmal_util.h>
+
+#include "BufferLock.h"
+#include "MmalBufferPool.h"
+#include "MmalStreamGraph.h"
+#include "MmalVideoEncoder.h"
+#include "PiEyeException.hpp"
+#include "Util.hpp"
+#include "Log.hpp"
+
+#define PIEYE_PORT_PREVIEW 0
+#define PIEYE_PORT_VIDEO 1
+#define PIEYE_PORT_STILL 2
+#define PIEYE_MIN_VIDEO_BUFFERS (unsigned int)3
+#define PIEYE_MIN_STILL_BUFFERS (unsigned int)3
+
+namespace {
+    void
+    LogCameraSettings(const MMAL_PARAMETER_CAMERA_SETTINGS_T& settings) {
+		EZLOG_DEBUG("Exposure [" << settings.exposure << "], "
+					<< "analog gain [" << settings.analog_gain.num << "/" << settings.analog_gain.den << "], "
+					<< "digital gain [" << settings.digital_gain.num << "/" << settings.digital_gain.den << "], "
+					<< "red gain [" << settings.awb_red_gain.num << "/" << settings.awb_red_gain.den << "], "
+					<< "blue gain [" << settings.awb_blue_gain.num << "/" << settings.awb_blue_gain.den << "], "
+					<< "focus pos [" << settings.focus_position << "]");
+    }
+}
+
+MmalBackend::MmalBackend(unsigned int cameraNumber) : _cameraNumber(cameraNumber), _encoderSettings(), _videoFormat() {
+}
+
+MmalBackend::~MmalBackend() {
+    try {
+        destroy();
+    } catch (const std::exception& e) {
+        EZLOG_ERROR("Unable to destroy camera: " << e.what());
+    }
+}
+
+void
+MmalBackend::create(const CaptureFormat& video, const CaptureFormat& still) {
+    MMAL_STATUS_T status;
+    
+    // Skip if already open
+    if (_camera) {
+        return;
+    }
+
+    try {
+        // Create component
+        status = mmal_component_create(MMAL_COMPONENT_DEFAULT_CAMERA, &_camera);
+        CheckStatus(status, "Unable to create default camera component");
+        if (_camera == nullptr) {
+            throw PiEyeException("Created camera is a nullptr");
+        } else if (!_camera->control) {
+            throw PiEyeException("Camera has no control port");
+        } else if (!_camera->output_num) {
+            throw PiEyeException("Camera has no output ports");
+        }
+        reachPhase(StartupPhase::COMPONENT_CREATED);
+        
+        // Select the sensor before anything else is configured
+        setParameter(_camera->control, MMAL_PARAMETER_CAMERA_NUM, _cameraNumber);
+        
+        // Enable camera control callback
+        const MMAL_PARAMETER_CHANGE_EVENT_REQUEST_T changeEvent = {{MMAL_PARAMETER_CHANGE_EVENT_REQUEST, sizeof(MMAL_PARAMETER_CHANGE_EVENT_REQUEST_T)},
+            MMAL_PARAMETER_CAMERA_SETTINGS, true};
+        status = mmal_port_parameter_set(_camera->control, &changeEvent.hdr);
+        CheckStatus(status, "Unable to register change event on camera control port");
+        
+        // Set camera config
+        setCameraConfig(video.width, video.height, still.width, still.height);
+        
+        // Enable camera control port
+        _camera->control->userdata = (struct MMAL_PORT_USERDATA_T*) this;
+        status = mmal_port_enable(_camera->control, ControlCallback);
+        CheckStatus(status, "Unable to enable camera control port");
+        
+        // Enable camera
+        status = mmal_component_enable(_camera);
+        CheckStatus(status, "Unable to enable camera");
+        reachPhase(StartupPhase::CONFIGURED);
+		
+    } catch (...) {
+        destroy();
+        throw;
+    }
+}
+
+void
+MmalBackend::destroy() {
+    EZLOG_TRACE("Destroying camera");
+    MMAL_STATUS_T status;
+    stopVideo();
+	closeStill();
+    if (_camera) {
+        
+        // Disable
+        EZLOG_TRACE("Disabling camera");
+        if (_camera->is_enabled) {
+            status = mmal_component_disable(_camera);
+            CheckStatus(status, "Unable to disable camera");
+        }
+        
+        // Destroy
+        EZLOG_TRACE("Destroying camera component");
+        status = mmal_component_destroy(_camera);
+        CheckStatus(status, "Unable to destroy camera component");
+        _camera = nullptr;
+    }
+    EZLOG_TRACE("Camera destroyed!");
+}
+
+bool
+MmalBackend::isCreated() const {
+	return _camera != nullptr;
+}
+
+void
+MmalBackend::setSettingsHandler(const SettingsHandler& handler) {
+	if (_camera) {
+		throw StateException("Cannot change the settings handler after the camera was created");
+	}
+	_settingsHandler = handler;
+}
+
+void
+MmalBackend::setPhaseHandler(const PhaseHandler& handler) {
+	if (_camera) {
+		throw StateException("Cannot change the phase handler after the camera was created");
+	}
+	_phaseHandler = handler;
+}
+
+void
+MmalBackend::startVideo(const CaptureFormat& format, const BufferHandler& handler, const std::vector<StreamFormat>& streams,
+		const StreamGraph::FrameHandler& streamHandler) {
+	EZLOG_TRACE("Opening video port");
+    MMAL_STATUS_T status;
+
+    // Skip if already started
+    if (_videoPort != nullptr) {
+		EZLOG_TRACE("Video already opened");
+        return;
+    }
+    
+    // Check if camera is opened and video is available
+    if (_camera == nullptr) {
+        throw StateException("Cannot start video before camera was created");
+    } else if (_camera->output_num <= PIEYE_PORT_VIDEO || _camera->output[PIEYE_PORT_VIDEO] == nullptr) {
+        throw PiEyeException("Video port is not available");
+    }
+    
+    try {
+        // Configure
+        MMAL_PORT_T* cameraVideoPort = _camera->output[PIEYE_PORT_VIDEO];
+        fitCameraConfig(format.width, format.height, 0, 0);
+        setFormat(*cameraVideoPort, format);
+        _videoHandler = handler;
+        _videoFormat = format;
+        _streamFormats = streams;
+        _streamHandler = streamHandler;
+        
+        // With extra streams or the encoder the frames come out of the splitter instead of the camera
+        _videoPort = cameraVideoPort;
+        if (!streams.empty() || _encodedHandler) {
+			EZLOG_TRACE("Building stream graph");
+			_streamGraph.reset(new MmalStreamGraph(cameraVideoPort, streamHandler));
+			_streamGraph->build(streams);
+			_videoPort = _streamGraph->getMainPort();
+			if (_encodedHandler) {
+				buildEncoder();
+			}
+        }
+        _videoPort->userdata = (struct MMAL_PORT_USERDATA_T*) this;
+        
+        // Make sure enough buffers are available for video and preview
+        if (_videoPort->buffer_num < PIEYE_MIN_VIDEO_BUFFERS) {
+            _videoPort->buffer_num = PIEYE_MIN_VIDEO_BUFFERS;
+        }
+        
+        // Enable video port
+		EZLOG_TRACE("Enabling video port");
+        status = mmal_port_enable(_videoPort, BufferCallback);
+        CheckStatus(status, "Unable to enable video port");
+        reachPhase(StartupPhase::PORT_ENABLED);
+        
+        // Create buffer pool and inject all buffers
+		EZLOG_TRACE("Creating video pool");
+        _videoPool.reset(new MmalBufferPool(_videoPort, _videoPort->buffer_num, _videoPort->buffer_size));
+        _videoPool->fill();
+        reachPhase(StartupPhase::POOL_ALLOCATED);
+        
+        // Go!
+		EZLOG_TRACE("Enabling capture parameter on video port");
+        setParameter(cameraVideoPort, MMAL_PARAMETER_CAPTURE, true);
+        
+		EZLOG_TRACE("Video enabled successfully");
+    } catch (...) {
+		EZLOG_WARN("Could not enable video port");
+        stopVideo();
+        throw;
+    }
+}
+
+void
+MmalBackend::stopVideo() {
+	if (_videoPort == nullptr) {
+		EZLOG_TRACE("Video already stopped");
+	} else {
+		EZLOG_TRACE("Stopping video");
+		
+        // Disable video port
+        if (_videoPort->is_enabled) {
+			EZLOG_TRACE("Disabling video port");
+            const MMAL_STATUS_T status = mmal_port_disable(_videoPort);
+            CheckStatus(status, "Unable to disable video port");
+        }
+        
+        // Free video pool, leased buffers keep it alive until they are released
+        if (_videoPool) {
+			if (_videoPool.use_count() > 1) {
+				EZLOG_WARN("Video pool has leased buffers, it will be destroyed when the last lease is released");
+			}
+			EZLOG_TRACE("Destroying video pool");
+			_poolStarvations += _videoPool->getStarvations();
+            _videoPool.reset();
+        }
+		
+		// Tear down the encoder, then the splitter and scalers of the extra streams it hangs off
+		if (_encoder) {
+			EZLOG_TRACE("Destroying video encoder");
+			_encoder.reset();
+		}
+		if (_streamGraph) {
+			EZLOG_TRACE("Destroying stream graph");
+			_streamGraph.reset();
+		}
+	
+		_videoPort = nullptr;
+		EZLOG_TRACE("Video stopped");
+    }
+}
+
+void
+MmalBackend::reconfigureVideo(const CaptureFormat& format, const std::function<void()>& stopped) {
+	if (_videoPort == nullptr) {
+		throw StateException("Cannot reconfigure video before it was started");
+	}
+	
+	// The splitter with the scalers of the extra streams and the encoder hangs off the camera port, so those are rebuilt
+	// like on a restart; the camera and the still port stay up either way
+	if (_streamGraph) {
+		EZLOG_DEBUG("Restarting video with its streams");
+		const BufferHandler handler = _videoHandler;
+		const std::vector<StreamFormat> streams = _streamFormats;
+		const StreamGraph::FrameHandler streamHandler = _streamHandler;
+		stopVideo();
+		stopped();
+		startVideo(format, handler, streams, streamHandler);
+		return;
+	}
+	
+	MMAL_STATUS_T status;
+	try {
+		// Disable, which hands all buffers in the port back to the pool
+		EZLOG_TRACE("Disabling video port");
+		status = mmal_port_disable(_videoPort);
+		CheckStatus(status, "Unable to disable video port");
+		stopped();
+		
+		// Commit the new format
+		fitCameraConfig(format.width, format.height, 0, 0);
+		setFormat(*_videoPort, format);
+		_videoFormat = format;
+		
+		// Keep the pool if its buffers are big and many enough, leased buffers of the old format come back to it
+		if (_videoPool && _videoPool->getBufferSize() >= _videoPort->buffer_size_min
+				&& _videoPool->getBufferCount() >= _videoPort->buffer_num_min) {
+			EZLOG_DEBUG("Keeping video pool of [" << _videoPool->getBufferCount() << "] buffers");
+			_videoPort->buffer_num = _videoPool->getBufferCount();
+			_videoPort->buffer_size = _videoPool->getBufferSize();
+		} else {
+			EZLOG_DEBUG("Video pool is too small for the new format");
+			if (_videoPool) {
+				_poolStarvations += _videoPool->getStarvations();
+				_videoPool.reset();
+			}
+			if (_videoPort->buffer_num < PIEYE_MIN_VIDEO_BUFFERS) {
+				_videoPort->buffer_num = PIEYE_MIN_VIDEO_BUFFERS;
+			}
+		}
+		
+		// Enable again
+		EZLOG_TRACE("Enabling video port");
+		status = mmal_port_enable(_videoPort, BufferCallback);
+		CheckStatus(status, "Unable to enable video port");
+		if (!_videoPool) {
+			EZLOG_TRACE("Creating video pool");
+			_videoPool.reset(new MmalBufferPool(_videoPort, _videoPort->buffer_num, _videoPort->buffer_size));
+		}
+		_videoPool->fill();
+		setParameter(_videoPort, MMAL_PARAMETER_CAPTURE, true);
+		EZLOG_TRACE("Video reconfigured successfully");
+	} catch (...) {
+		EZLOG_WARN("Could not reconfigure video port");
+		stopVideo();
+		throw;
+	}
+}
+
+bool
+MmalBackend::isVideoRunning() const {
+	return _videoPort != nullptr;
+}
+
+std::shared_ptr<BufferPool>
+MmalBackend::getVideoPool() const {
+	return _videoPool;
+}
+
+unsigned long long
+MmalBackend::getPoolStarvations() const {
+	return _poolStarvations + (_videoPool ? _videoPool->getStarvations() : 0);
+}
+
+void
+MmalBackend::startEncoder(const EncoderSettings& settings, const EncodedHandler& handler) {
+	if (_encodedHandler) {
+		throw StateException("Encoder is already running");
+	} else if (!handler) {
+		throw PiEyeException("Encoder needs a handler for the encoded stream");
+	}
+	_encoderSettings = settings;
+	_encodedHandler = handler;
+	if (_videoPort == nullptr) {
+		EZLOG_DEBUG("Encoder starts along with video");
+		return;
+	}
+	
+	if (_streamGraph) {
+		buildEncoder();
+		return;
+	}
+	
+	// Video straight from the camera port has no splitter to branch the encoder off yet
+	EZLOG_DEBUG("Restarting video to branch off the encoder");
+	const BufferHandler videoHandler = _videoHandler;
+	const std::vector<StreamFormat> streams = _streamFormats;
+	const StreamGraph::FrameHandler streamHandler = _streamHandler;
+	stopVideo();
+	try {
+		startVideo(_videoFormat, videoHandler, streams, streamHandler);
+	} catch (...) {
+		// Video goes on without the encoder
+		EZLOG_WARN("Could not start the encoder, restarting video without it");
+		stopEncoder();
+		startVideo(_videoFormat, videoHandler, streams, streamHandler);
+		throw;
+	}
+}
+
+void
+MmalBackend::stopEncoder() {
+	// The splitter stays until video stops, it costs nothing without the encoder
+	_encoder.reset();
+	_encodedHandler = EncodedHandler();
+}
+
+bool
+MmalBackend::isEncoding() const {
+	return static_cast<bool>(_encodedHandler);
+}
+
+void
+MmalBackend::openStill(const CaptureFormat& format, const BufferHandler& handler) {
+	if (_stillPort != nullptr) {
+		EZLOG_TRACE("Still port already open");
+		return;
+	}
+	
+	EZLOG_DEBUG("Initializing still port");
+	requireCamera();
+    if (_camera->output_num <= PIEYE_PORT_STILL || _camera->output[PIEYE_PORT_STILL] == nullptr) {
+        throw PiEyeException("Still port is not available");
+    }
+	
+	// Configure
+	_stillPort = _camera->output[PIEYE_PORT_STILL];
+	_stillPort->userdata = (struct MMAL_PORT_USERDATA_T*) this;
+	_stillHandler = handler;
+	fitCameraConfig(0, 0, format.width, format.height);
+	setFormat(*_stillPort, format);
+	
+	// Make sure enough buffers are available
+	unsigned short minBufferCount = std::max(PIEYE_MIN_STILL_BUFFERS, _stillPort->buffer_num_recommended);
+	if (_stillPort->buffer_num < minBufferCount) {
+		_stillPort->buffer_num = minBufferCount;
+	}
+	
+	// Enable port
+	EZLOG_TRACE("Enabling still port");
+	MMAL_STATUS_T status = mmal_port_enable(_stillPort, BufferCallback);
+	CheckStatus(status, "Unable to enable still port");
+	
+	// Create buffer pool and inject all buffers
+	EZLOG_TRACE("Creating still pool");
+	_stillPool.reset(new MmalBufferPool(_stillPort, _stillPort->buffer_num, _stillPort->buffer_size));
+	_stillPool->fill();
+}
+
+void
+MmalBackend::closeStill() {
+    EZLOG_TRACE("CloseStill");
+	if (_stillPort == nullptr) {
+		EZLOG_TRACE("Still port already closed");
+	} else {
+		EZLOG_TRACE("Closing still port");
+		
+		// Set capture off:
+		EZLOG_TRACE("Turning off still capture parameter");
+		setParameter(_stillPort, MMAL_PARAMETER_CAPTURE, false);
+		
+        // Disable still port
+        if (_stillPort->is_enabled) {
+			EZLOG_TRACE("Disabling still port");
+            const MMAL_STATUS_T status = mmal_port_disable(_stillPort);
+            CheckStatus(status, "Unable to disable still port");
+        }
+        
+        // Free pool
+        if (_stillPool) {
+			EZLOG_TRACE("Destroying still pool");
+            _stillPool.reset();
+        }
+		
+		_stillPort = nullptr;
+		EZLOG_TRACE("Still port closed");
+    }
+}
+
+bool
+MmalBackend::isStillOpen() const {
+	return _stillPort != nullptr;
+}
+
+void
+MmalBackend::startStillCapture() {
+	if (_stillPort == nullptr) {
+		throw StateException("Still port must be opened first");
+	}
+	EZLOG_TRACE("Enabling capture parameter on still port");
+	setParameter(_stillPort, MMAL_PARAMETER_CAPTURE, true);
+}
+
+void
+MmalBackend::stopStillCapture() {
+	if (_stillPort == nullptr) {
+		return;
+	}
+	EZLOG_TRACE("Disabling capture parameter on still port");
+	setParameter(_stillPort, MMAL_PARAMETER_CAPTURE, false);
+}
+
+void
+MmalBackend::setSensorMode(const SensorMode mode) {
+    requireCamera();
+    setParameter(_camera->control, MMAL_PARAMETER_CAMERA_CUSTOM_SENSOR_CONFIG, (unsigned int) mode);
+}
+
+void
+MmalBackend::setShutterSpeed(unsigned int micros) {
+    requireCamera();
+    setParameter(_camera->control, MMAL_PARAMETER_SHUTTER_SPEED, micros);
+}
+
+void
+MmalBackend::setIso(unsigned int iso) {
+    requireCamera();
+    setParameter(_camera->control, MMAL_PARAMETER_ISO, iso);
+}
+
+void
+MmalBackend::setAnalogGain(float gain) {
+    requireCamera();
+    setParameter(_camera->control, MMAL_PARAMETER_ANALOG_GAIN, gain);
+}
+
+void
+MmalBackend::setDigitalGain(float gain) {
+    requireCamera();
+    setParameter(_camera->control, MMAL_PARAMETER_DIGITAL_GAIN, gain);
+}
+
+void
+MmalBackend::setWhiteBalanceMode(const AwbMode& mode) {
+	requireCamera();
+	MMAL_PARAM_AWBMODE_T awbMode = MMAL_PARAM_AWBMODE_AUTO;
+	switch (mode) {
+		case AwbMode::OFF:
+			awbMode = MMAL_PARAM_AWBMODE_OFF;
+			break;
+		case AwbMode::AUTO:
+			awbMode = MMAL_PARAM_AWBMODE_AUTO;
+			break;
+		case AwbMode::SUNLIGHT:
+			awbMode = MMAL_PARAM_AWBMODE_SUNLIGHT;
+			break;
+		case AwbMode::CLOUDY:
+			awbMode = MMAL_PARAM_AWBMODE_CLOUDY;
+			break;
+		case AwbMode::SHADE:
+			awbMode = MMAL_PARAM_AWBMODE_SHADE;
+			break;
+		case AwbMode::TUNGSTEN:
+			awbMode = MMAL_PARAM_AWBMODE_TUNGSTEN;
+			break;
+		case AwbMode::FLUORESCENT:
+			awbMode = MMAL_PARAM_AWBMODE_FLUORESCENT;
+			break;
+		case AwbMode::INCANDESCENT:
+			awbMode = MMAL_PARAM_AWBMODE_INCANDESCENT;
+			break;
+		case AwbMode::FLASH:
+			awbMode = MMAL_PARAM_AWBMODE_FLASH;
+			break;
+		case AwbMode::HORIZON:
+			awbMode = MMAL_PARAM_AWBMODE_HORIZON;
+			break;
+	}
+	
+	const MMAL_PARAMETER_AWBMODE_T param = {{MMAL_PARAMETER_AWB_MODE, sizeof(param)}, awbMode};
+	const MMAL_STATUS_T status = mmal_port_parameter_set(_camera->control, &param.hdr);
+	CheckStatus(status, "Unable to set AWB mode");
+}
+
+void
+MmalBackend::setWhiteBalanceGain(float redGain, float blueGain) {
+    requireCamera();
+    const MMAL_PARAMETER_AWB_GAINS_T param = {{MMAL_PARAMETER_CUSTOM_AWB_GAINS,sizeof(param)},
+        ToRational(redGain), ToRational(blueGain)};
+    const MMAL_STATUS_T status = mmal_port_parameter_set(_camera->control, &param.hdr);
+    CheckStatus(status, "Unable to set gains for AWB");
+}
+
+void
+MmalBackend::setFpsRange(float minFps, float maxFps) {
+    requireCamera();
+    const MMAL_PARAMETER_FPS_RANGE_T fpsRange = {{MMAL_PARAMETER_FPS_RANGE, sizeof(fpsRange)},
+        ToRational(minFps), ToRational(maxFps)};
+    MMAL_STATUS_T status = mmal_port_parameter_set(_camera->output[PIEYE_PORT_PREVIEW], &fpsRange.hdr);
+    CheckStatus(status, "Unable to set FPS range on preview port");
+	
+	// TODO: Put this somewhere else, or will we always sync video and preview ports?
+	status = mmal_port_parameter_set(_camera->output[PIEYE_PORT_VIDEO], &fpsRange.hdr);
+	CheckStatus(status, "Unable to set FPS range on video port");
+}
+
+void
+MmalBackend::ControlCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer) {
+    if (buffer == nullptr) {
+        EZLOG_WARN("Got empty buffer from camera control");
+    } else if (buffer->cmd == MMAL_EVENT_PARAMETER_CHANGED) {
+        MMAL_EVENT_PARAMETER_CHANGED_T *param = (MMAL_EVENT_PARAMETER_CHANGED_T *)buffer->data;
+        if (param == nullptr) {
+            EZLOG_WARN("Got invalid parameter changed event from camera control");
+        } else if (param->hdr.id == MMAL_PARAMETER_CAMERA_SETTINGS) {
+            MMAL_PARAMETER_CAMERA_SETTINGS_T *settings = (MMAL_PARAMETER_CAMERA_SETTINGS_T*)param;
+            LogCameraSettings(*settings);
+            MmalBackend* instance = (MmalBackend*) port->userdata;
+            if (instance != nullptr && instance->_settingsHandler) {
+                const FrameSettings frameSettings = {settings->exposure, FromRational(settings->analog_gain),
+                    FromRational(settings->digital_gain), FromRational(settings->awb_red_gain),
+                    FromRational(settings->awb_blue_gain)};
+                instance->_settingsHandler(frameSettings);
+            }
+        } else {
+            EZLOG_WARN("Received weird parameter update [" << param->hdr.id << "]");
+        }
+    } else {
+        EZLOG_WARN("Received unexpected camera control callback event [" << buffer->cmd << "]");
+    }
+
+    mmal_buffer_header_release(buffer);
+}
+
+void
+MmalBackend::BufferCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer) {
+    BufferLock bufferLock(buffer);
+    MmalBackend* instance = (MmalBackend*) port->userdata;
+    EZLOG_DEBUG("Encoder callback: [" << buffer->length << "] bytes");
+	std::shared_ptr<MmalBufferPool> bufferPool;
+	bool leased = false;
+    if (instance == nullptr) {
+        throw PiEyeException("Unable to determine backend instance in callback");
+    } else if (buffer == nullptr) {
+        throw PiEyeException("Received an invalid buffer");
+    } else if (port == instance->_videoPort){
+		bufferPool = instance->_videoPool;
+        leased = instance->_videoHandler(buffer);
+    } else if (port == instance->_stillPort) {
+		instance->_stillHandler(buffer);
+		bufferPool = instance->_stillPool;
+	} else {
+        EZLOG_WARN("Received a buffer from an unknown port");
+	}
+	
+	// A leased buffer stays locked and is given back to the pool by the last lease
+	if (leased) {
+		bufferLock.detach();
+	} else {
+		bufferLock.unlock();
+		
+		// Only release buffer back to pool if it came from one of our pools
+		if (bufferPool) {
+			bufferPool->recycle(buffer);
+		}
+	}
+    
+	EZLOG_TRACE("BufferCallback completed");
+}
+
+void
+MmalBackend::setCameraConfig(unsigned short maxVideoWidth, unsigned short maxVideoHeight, unsigned short maxStillWidth,
+		unsigned short maxStillHeight) {
+    if (_camera == nullptr) {
+        throw PiEyeException("Tried to set camera config while camera is not loaded yet");
+    }
+    MMAL_PARAMETER_CAMERA_CONFIG_T config = {{MMAL_PARAMETER_CAMERA_CONFIG, sizeof(config)}};
+    config.max_stills_w = maxStillWidth;
+    config.max_stills_h = maxStillHeight;
+    config.stills_yuv422 = 0;
+    config.one_shot_stills = 0;	// Stills keep coming while the capture parameter is set, a burst needs no restart
+    config.max_preview_video_w = maxVideoWidth;
+    config.max_preview_video_h = maxVideoHeight;
+    config.num_preview_video_frames = _previewFrames;
+    config.stills_capture_circular_buffer_height = 0;
+    config.fast_preview_resume = 0;
+    //config.use_stc_timestamp = MMAL_PARAM_TIMESTAMP_MODE_RAW_STC;
+    config.use_stc_timestamp = MMAL_PARAM_TIMESTAMP_MODE_RESET_STC;
+    const MMAL_STATUS_T status = mmal_port_parameter_set(_camera->control, &config.hdr);
+    CheckStatus(status, "Unable to set camera configuration");
+    _maxVideoWidth = maxVideoWidth;
+    _maxVideoHeight = maxVideoHeight;
+    _maxStillWidth = maxStillWidth;
+    _maxStillHeight = maxStillHeight;
+}
+
+void
+MmalBackend::fitCameraConfig(unsigned short videoWidth, unsigned short videoHeight, unsigned short stillWidth, unsigned short stillHeight) {
+	if (videoWidth <= _maxVideoWidth && videoHeight <= _maxVideoHeight && stillWidth <= _maxStillWidth
+			&& stillHeight <= _maxStillHeight) {
+		return;
+	}
+	
+	// The config can only change while the camera is disabled, so a port that is up pauses meanwhile and keeps its pool
+	EZLOG_DEBUG("Raising camera config to video of [" << videoWidth << "x" << videoHeight << "] and stills of ["
+			<< stillWidth << "x" << stillHeight << "]");
+	const bool videoPaused = _videoPort != nullptr && _videoPort->is_enabled;
+	const bool stillPaused = _stillPort != nullptr && _stillPort->is_enabled;
+	if (videoPaused && _streamGraph) {
+		throw StateException("Cannot raise the camera config while extra streams run, stop video first");
+	}
+	MMAL_STATUS_T status;
+	if (videoPaused) {
+		status = mmal_port_disable(_videoPort);
+		CheckStatus(status, "Unable to disable video port");
+	}
+	if (stillPaused) {
+		status = mmal_port_disable(_stillPort);
+		CheckStatus(status, "Unable to disable still port");
+	}
+	status = mmal_component_disable(_camera);
+	CheckStatus(status, "Unable to disable camera");
+	setCameraConfig(std::max(videoWidth, _maxVideoWidth), std::max(videoHeight, _maxVideoHeight),
+			std::max(stillWidth, _maxStillWidth), std::max(stillHeight, _maxStillHeight));
+	status = mmal_component_enable(_camera);
+	CheckStatus(status, "Unable to enable camera");
+	if (stillPaused) {
+		status = mmal_port_enable(_stillPort, BufferCallback);
+		CheckStatus(status, "Unable to enable still port");
+		_stillPool->fill();
+	}
+	if (videoPaused) {
+		status = mmal_port_enable(_videoPort, BufferCallback);
+		CheckStatus(status, "Unable to enable video port");
+		_videoPool->fill();
+		setParameter(_videoPort, MMAL_PARAMETER_CAPTURE, true);
+	}
+}
+
+void
+MmalBackend::setFormat(MMAL_PORT_T& port, const CaptureFormat& captureFormat) {
+    // Get format from port
+    if (port.format == nullptr) {
+        throw PiEyeException("Format for a port not available");
+    }
+    MMAL_ES_FORMAT_T& format = *port.format;
+    
+    // Fill details
+	format.encoding = GetMmalEncoding(captureFormat.encoding);
+    format.encoding_variant = GetMmalEncoding(captureFormat.encoding);
+    format.es->video.width = FrameDecoder::AlignWidth(captureFormat.width);
+    format.es->video.height = FrameDecoder::AlignHeight(captureFormat.height);
+    format.es->video.crop.x = 0;
+    format.es->video.crop.y = 0;
+    format.es->video.crop.width = captureFormat.width;
+    format.es->video.crop.height = captureFormat.height;
+    format.es->video.frame_rate.num = captureFormat.fps;
+    format.es->video.frame_rate.den = 1;
+    
+    // Set
+    const MMAL_STATUS_T status = mmal_port_format_commit(&port);
+    CheckStatus(status, "Unable to set format for preview port");
+}
+
+void
+MmalBackend::setParameter(MMAL_PORT_T* port, unsigned int parameter, bool value) {
+    if (port == nullptr) {
+        throw PiEyeException("Cannot set boolean parameter on a NULL port");
+    } else {
+		EZLOG_DEBUG("Setting parameter [" << ParameterToString(parameter) << "] to [" << value << "]");
+        const MMAL_STATUS_T status = mmal_port_parameter_set_boolean(port, parameter, value);
+        CheckStatus(status, "Unable to set boolean parameter [" + ParameterToString(parameter) + "] to [" + std::to_string(value) + "]");
+    }
+}
+
+void
+MmalBackend::setParameter(MMAL_PORT_T* port, unsigned int parameter, unsigned int value) {
+    if (port == nullptr) {
+        throw PiEyeException("Cannot set unsigned int parameter on a NULL port");
+    } else {
+		EZLOG_DEBUG("Setting parameter [" << ParameterToString(parameter) << "] to [" << value << "]");
+        const MMAL_STATUS_T status = mmal_port_parameter_set_uint32(port, parameter, value);
+        CheckStatus(status, "Unable to set unsigned int parameter [" + ParameterToString(parameter) + "] to [" + std::to_string(value) + "]");
+    }
+}
+
+void
+MmalBackend::setParameter(MMAL_PORT_T* port, unsigned int parameter, float value) {
+    if (port == nullptr) {
+        throw PiEyeException("Cannot set rational parameter on a NULL port");
+    } else {
+		EZLOG_DEBUG("Setting parameter [" << ParameterToString(parameter) << "] to [" << value << "]");
+        const MMAL_STATUS_T status = mmal_port_parameter_set_rational(port, parameter, ToRational(value));
+        CheckStatus(status, "Unable to set rational parameter [" + ParameterToString(parameter) + "] to [" + std::to_string(value) + "]");
+    }
+}
+
+void
+MmalBackend::buildEncoder() {
+	MMAL_PORT_T* sparePort = _streamGraph->getSparePort();
+	if (sparePort == nullptr) {
+		stopEncoder();
+		throw PiEyeException("No splitter output left for the encoder, at most [" + std::to_string(_streamGraph->getMaxStreams() - 1)
+				+ "] streams can be added while encoding");
+	}
+	EZLOG_TRACE("Building video encoder");
+	try {
+		_encoder.reset(new MmalVideoEncoder(sparePort, _encoderSettings, _encodedHandler));
+		_encoder->build();
+	} catch (...) {
+		stopEncoder();
+		throw;
+	}
+}
+
+void
+MmalBackend::reachPhase(const StartupPhase& phase) const {
+	if (_phaseHandler) {
+		_phaseHandler(phase);
+	}
+}
+
+void
+MmalBackend::requireCamera() {
+    if (_camera == nullptr) {
+        throw StateException("Camera must be created first");
+    } else if (_camera->control == nullptr) {
+        throw PiEyeException("Control port not available");
+    }
+}
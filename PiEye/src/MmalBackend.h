@@ -0,0 +1,191 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <memory>
+
+#include "CaptureBackend.h"
+
+struct MMAL_COMPONENT_T;
+struct MMAL_PORT_T;
+class MmalBufferPool;
+class MmalStreamGraph;
+class MmalVideoEncoder;
+
+/**
+ * Backend on the MMAL camera component. Video and stills come from their own camera ports, extra streams from a
+ * splitter and ISPs on the video port. The video encoder takes a splitter output of its own.
+ */
+class MmalBackend : public CaptureBackend {
+public:
+	// Camera on the given CSI port, 0 for the only one of most boards. Compute Modules have a second one.
+	explicit MmalBackend(unsigned int cameraNumber = 0);
+	virtual ~MmalBackend();
+
+	virtual void
+	create(const CaptureFormat& video, const CaptureFormat& still);
+
+	virtual void
+	destroy();
+
+	virtual bool
+	isCreated() const;
+
+	virtual void
+	setSettingsHandler(const SettingsHandler& handler);
+
+	virtual void
+	setPhaseHandler(const PhaseHandler& handler);
+
+	virtual void
+	startVideo(const CaptureFormat& format, const BufferHandler& handler, const std::vector<StreamFormat>& streams,
+			const StreamGraph::FrameHandler& streamHandler);
+
+	virtual void
+	stopVideo();
+
+	virtual void
+	reconfigureVideo(const CaptureFormat& format, const std::function<void()>& stopped);
+
+	virtual bool
+	isVideoRunning() const;
+
+	virtual std::shared_ptr<BufferPool>
+	getVideoPool() const;
+
+	virtual unsigned long long
+	getPoolStarvations() const;
+
+	virtual void
+	startEncoder(const EncoderSettings& settings, const EncodedHandler& handler);
+
+	virtual void
+	stopEncoder();
+
+	virtual bool
+	isEncoding() const;
+
+	virtual void
+	openStill(const CaptureFormat& format, const BufferHandler& handler);
+
+	virtual void
+	closeStill();
+
+	virtual bool
+	isStillOpen() const;
+
+	virtual void
+	startStillCapture();
+
+	virtual void
+	stopStillCapture();
+
+	virtual void
+	setSensorMode(const SensorMode mode);
+
+	virtual void
+	setShutterSpeed(unsigned int micros);
+
+	virtual void
+	setIso(unsigned int iso);
+
+	virtual void
+	setAnalogGain(float gain);
+
+	virtual void
+	setDigitalGain(float gain);
+
+	virtual void
+	setWhiteBalanceMode(const AwbMode& mode);
+
+	virtual void
+	setWhiteBalanceGain(float redGain, float blueGain);
+
+	virtual void
+	setFpsRange(float minFps, float maxFps);
+
+private:
+	const unsigned int _cameraNumber;
+	MMAL_COMPONENT_T* _camera = nullptr;
+	MMAL_PORT_T* _videoPort = nullptr;
+	MMAL_PORT_T* _stillPort = nullptr;
+	std::shared_ptr<MmalBufferPool> _videoPool;
+	std::shared_ptr<MmalBufferPool> _stillPool;
+	std::unique_ptr<MmalStreamGraph> _streamGraph;
+	std::unique_ptr<MmalVideoEncoder> _encoder;
+	EncoderSettings _encoderSettings;
+	EncodedHandler _encodedHandler;	// Set while encoding is on, also with video stopped
+	CaptureFormat _videoFormat;
+	BufferHandler _videoHandler;
+	BufferHandler _stillHandler;
+	SettingsHandler _settingsHandler;
+	PhaseHandler _phaseHandler;
+	std::vector<StreamFormat> _streamFormats;	// Kept to rebuild the streams on a reconfiguration
+	StreamGraph::FrameHandler _streamHandler;
+	unsigned short _previewFrames = 3;
+	unsigned short _maxVideoWidth = 0;	// Largest frames the camera config allows
+	unsigned short _maxVideoHeight = 0;
+	unsigned short _maxStillWidth = 0;
+	unsigned short _maxStillHeight = 0;
+	unsigned long long _poolStarvations = 0;	// Of video pools already destroyed
+
+	void
+	reachPhase(const StartupPhase& phase) const;
+
+	// Tunnels the spare splitter output into the encoder. Encoding is off again if that fails.
+	void
+	buildEncoder();
+
+	static void
+	ControlCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer);
+
+	static void
+	BufferCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer);
+
+	void
+	setCameraConfig(unsigned short maxVideoWidth, unsigned short maxVideoHeight, unsigned short maxStillWidth,
+			unsigned short maxStillHeight);
+
+	// Raises the camera config to video and stills of the given sizes if needed, 0 for a port left as it is. Briefly
+	// disables the camera, ports that are up pause meanwhile.
+	void
+	fitCameraConfig(unsigned short videoWidth, unsigned short videoHeight, unsigned short stillWidth, unsigned short stillHeight);
+
+	void
+	setFormat(MMAL_PORT_T& port, const CaptureFormat& format);
+
+	void
+	setParameter(MMAL_PORT_T* port, unsigned int parameter, bool value);
+
+	void
+	setParameter(MMAL_PORT_T* port, unsigned int parameter, unsigned int value);
+
+	void
+	setParameter(MMAL_PORT_T* port, unsigned int parameter, float value);
+
+	void
+	requireCamera();
+
+	MmalBackend(const MmalBackend&);
+	MmalBackend& operator=(const MmalBackend&);
+};
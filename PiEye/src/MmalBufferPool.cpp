@@ -0,0 +1,107 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "MmalBufferPool.h"
+
+#include <interface/mmal/mmal.h>
+#include <interface/mmal/util/mmal_util.h>
+
+#include "PiEyeException.hpp"
+#include "Util.hpp"
+#include "Log.hpp"
+
+MmalBufferPool::MmalBufferPool(MMAL_PORT_T* port, unsigned int bufferCount, unsigned int bufferSize) : _port(port), _pool(nullptr),
+		_bufferCount(bufferCount), _bufferSize(bufferSize), _starvations(0) {
+	if (_port == nullptr) {
+		throw PiEyeException("Cannot create a buffer pool for a NULL port");
+	}
+
+	EZLOG_TRACE("Creating pool with [" << bufferCount << "] buffers of [" << bufferSize << "] bytes");
+	_pool = mmal_port_pool_create(_port, bufferCount, bufferSize);
+	if (!_pool) {
+		throw PiEyeException("Unable to allocate buffer pool");
+	}
+}
+
+MmalBufferPool::~MmalBufferPool() {
+	EZLOG_TRACE("Destroying pool");
+	mmal_port_pool_destroy(_port, _pool);
+	_pool = nullptr;
+}
+
+void
+MmalBufferPool::fill() {
+	const int bufferCount = mmal_queue_length(_pool->queue);
+	EZLOG_TRACE("Injecting [" << bufferCount << "] buffers in port");
+	for (int i = 0; i < bufferCount; ++i) {
+		MMAL_BUFFER_HEADER_T* buffer = mmal_queue_get(_pool->queue);
+		if (!buffer) {
+			throw PiEyeException("Unable to get buffer");
+		}
+
+		const MMAL_STATUS_T status = mmal_port_send_buffer(_port, buffer);
+		CheckStatus(status, "Unable to send a buffer to the port");
+	}
+}
+
+void
+MmalBufferPool::unlock(MMAL_BUFFER_HEADER_T* buffer) {
+	mmal_buffer_header_mem_unlock(buffer);
+}
+
+void
+MmalBufferPool::recycle(MMAL_BUFFER_HEADER_T* buffer) {
+	mmal_buffer_header_release(buffer);
+
+	// Re-inject buffer
+	if (_port->is_enabled) {
+		EZLOG_TRACE("Re-injecting a buffer");
+		MMAL_BUFFER_HEADER_T* nextBuffer = mmal_queue_get(_pool->queue);
+		if (nextBuffer) {
+			const MMAL_STATUS_T status = mmal_port_send_buffer(_port, nextBuffer);
+			CheckStatus(status, "Unable to send buffer back to port");
+		} else {
+			++_starvations;
+			EZLOG_WARN("Unable to get a new buffer from pool");
+		}
+	}
+}
+
+unsigned int
+MmalBufferPool::available() const {
+	return mmal_queue_length(_pool->queue);
+}
+
+unsigned int
+MmalBufferPool::getBufferCount() const {
+	return _bufferCount;
+}
+
+unsigned int
+MmalBufferPool::getBufferSize() const {
+	return _bufferSize;
+}
+
+unsigned long long
+MmalBufferPool::getStarvations() const {
+	return _starvations;
+}
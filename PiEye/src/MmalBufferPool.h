@@ -0,0 +1,69 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+
+#include "BufferPool.h"
+
+struct MMAL_PORT_T;
+struct MMAL_POOL_T;
+
+class MmalBufferPool : public BufferPool {
+public:
+	MmalBufferPool(MMAL_PORT_T* port, unsigned int bufferCount, unsigned int bufferSize);
+	virtual ~MmalBufferPool();
+
+	// Sends all free buffers to the port
+	void
+	fill();
+
+	virtual void
+	unlock(MMAL_BUFFER_HEADER_T* buffer);
+
+	virtual void
+	recycle(MMAL_BUFFER_HEADER_T* buffer);
+
+	unsigned int
+	available() const;
+
+	unsigned int
+	getBufferCount() const;
+
+	unsigned int
+	getBufferSize() const;
+
+	// Recycles that found no free buffer to send to the port
+	unsigned long long
+	getStarvations() const;
+
+private:
+	MMAL_PORT_T* _port;
+	MMAL_POOL_T* _pool;
+	const unsigned int _bufferCount;
+	const unsigned int _bufferSize;
+	std::atomic<unsigned long long> _starvations;
+
+	MmalBufferPool(const MmalBufferPool&);
+	MmalBufferPool& operator=(const MmalBufferPool&);
+};
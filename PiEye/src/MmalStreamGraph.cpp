@@ -0,0 +1,194 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "MmalStreamGraph.h"
+
+#include <algorithm>
+#include <interface/mmal/mmal.h>
+#include <interface/mmal/util/mmal_default_components.h>
+#include <interface/mmal/util/mmal_util.h>
+
+#include "BufferLock.h"
+#include "MmalBufferPool.h"
+#include "PiEyeException.hpp"
+#include "Util.hpp"
+#include "Log.hpp"
+
+// The ISP converts to every encoding we decode, vc.ril.resize lacks BGR24
+#define PIEYE_COMPONENT_ISP "vc.ril.isp"
+#define PIEYE_MIN_STREAM_BUFFERS (unsigned int)3
+
+MmalStreamGraph::MmalStreamGraph(MMAL_PORT_T* source, const FrameHandler& handler) : StreamGraph(handler), _source(source) {
+	if (_source == nullptr) {
+		throw PiEyeException("Cannot build a stream graph on a NULL port");
+	}
+}
+
+MmalStreamGraph::~MmalStreamGraph() {
+	try {
+		destroy();
+	} catch (const std::exception& e) {
+		EZLOG_ERROR("Unable to destroy stream graph: " << e.what());
+	}
+}
+
+void
+MmalStreamGraph::build(const std::vector<StreamFormat>& streams) {
+	if (_splitter) {
+		throw StateException("Stream graph was already built");
+	}
+	setStreams(streams);
+	EZLOG_DEBUG("Building stream graph with [" << streams.size() << "] streams");
+
+	try {
+		MMAL_STATUS_T status = mmal_component_create(MMAL_COMPONENT_DEFAULT_VIDEO_SPLITTER, &_splitter);
+		CheckStatus(status, "Unable to create video splitter");
+		if (_splitter->input_num == 0 || _splitter->output_num <= streams.size()) {
+			throw PiEyeException("Video splitter has too few ports for [" + std::to_string(streams.size()) + "] streams");
+		}
+
+		// Every splitter output repeats the camera format, the ISPs and the encoder take it from there
+		CopyFormat(_splitter->input[0], _source);
+		for (unsigned int i = 0; i < _splitter->output_num; ++i) {
+			CopyFormat(_splitter->output[i], _splitter->input[0]);
+		}
+		status = mmal_connection_create(&_splitterConnection, _source, _splitter->input[0],
+				MMAL_CONNECTION_FLAG_TUNNELLING | MMAL_CONNECTION_FLAG_ALLOCATION_ON_INPUT);
+		CheckStatus(status, "Unable to connect the video port to the splitter");
+
+		for (unsigned int stream = 0; stream < streams.size(); ++stream) {
+			buildBranch(stream);
+		}
+
+		status = mmal_component_enable(_splitter);
+		CheckStatus(status, "Unable to enable video splitter");
+		status = mmal_connection_enable(_splitterConnection);
+		CheckStatus(status, "Unable to enable splitter connection");
+		const std::vector<Branch>::iterator branchEnd = _branches.end();
+		for (std::vector<Branch>::iterator it = _branches.begin(); it != branchEnd; ++it) {
+			status = mmal_connection_enable(it->connection);
+			CheckStatus(status, "Unable to enable ISP connection");
+			it->pool->fill();
+		}
+	} catch (...) {
+		EZLOG_WARN("Could not build stream graph");
+		destroy();
+		throw;
+	}
+}
+
+void
+MmalStreamGraph::buildBranch(unsigned int stream) {
+	const StreamFormat& format = _streams[stream];
+	_branches.push_back(Branch());
+	Branch& branch = _branches.back();
+
+	MMAL_STATUS_T status = mmal_component_create(PIEYE_COMPONENT_ISP, &branch.isp);
+	CheckStatus(status, "Unable to create ISP for stream [" + std::to_string(stream) + "]");
+	if (branch.isp->input_num == 0 || branch.isp->output_num == 0) {
+		throw PiEyeException("ISP has no input or output port");
+	}
+	CopyFormat(branch.isp->input[0], _splitter->output[stream + 1]);
+
+	// Scaled and converted to the layout the stream's decoder expects
+	branch.output = branch.isp->output[0];
+	mmal_format_copy(branch.output->format, branch.isp->input[0]->format);
+	MMAL_ES_FORMAT_T& outputFormat = *branch.output->format;
+	outputFormat.encoding = GetMmalEncoding(format.encoding);
+	outputFormat.encoding_variant = outputFormat.encoding;
+	outputFormat.es->video.width = FrameDecoder::AlignWidth(format.width);
+	outputFormat.es->video.height = FrameDecoder::AlignHeight(format.height);
+	outputFormat.es->video.crop.x = 0;
+	outputFormat.es->video.crop.y = 0;
+	outputFormat.es->video.crop.width = format.width;
+	outputFormat.es->video.crop.height = format.height;
+	status = mmal_port_format_commit(branch.output);
+	CheckStatus(status, "Unable to set format for stream [" + std::to_string(stream) + "]");
+
+	status = mmal_connection_create(&branch.connection, _splitter->output[stream + 1], branch.isp->input[0],
+			MMAL_CONNECTION_FLAG_TUNNELLING | MMAL_CONNECTION_FLAG_ALLOCATION_ON_INPUT);
+	CheckStatus(status, "Unable to connect the splitter to the ISP of stream [" + std::to_string(stream) + "]");
+
+	branch.output->buffer_num = std::max(PIEYE_MIN_STREAM_BUFFERS, branch.output->buffer_num_recommended);
+	branch.output->buffer_size = std::max(branch.output->buffer_size_recommended, branch.output->buffer_size_min);
+	branch.output->userdata = (struct MMAL_PORT_USERDATA_T*) this;
+	status = mmal_port_enable(branch.output, BranchCallback);
+	CheckStatus(status, "Unable to enable output of stream [" + std::to_string(stream) + "]");
+	branch.pool.reset(new MmalBufferPool(branch.output, branch.output->buffer_num, branch.output->buffer_size));
+
+	status = mmal_component_enable(branch.isp);
+	CheckStatus(status, "Unable to enable ISP of stream [" + std::to_string(stream) + "]");
+}
+
+void
+MmalStreamGraph::destroy() {
+	// Downstream first, so no buffer is in flight towards a destroyed port
+	while (!_branches.empty()) {
+		Branch& branch = _branches.back();
+		if (branch.output && branch.output->is_enabled) {
+			CheckStatus(mmal_port_disable(branch.output), "Unable to disable stream output");
+		}
+		branch.pool.reset();
+		DestroyConnection(branch.connection);
+		DestroyComponent(branch.isp);
+		_branches.pop_back();
+	}
+	DestroyConnection(_splitterConnection);
+	DestroyComponent(_splitter);
+}
+
+unsigned int
+MmalStreamGraph::getMaxStreams() const {
+	// The splitter has four outputs, the first one carries the unscaled frames
+	return 3;
+}
+
+MMAL_PORT_T*
+MmalStreamGraph::getMainPort() const {
+	return _splitter ? _splitter->output[0] : nullptr;
+}
+
+MMAL_PORT_T*
+MmalStreamGraph::getSparePort() const {
+	const unsigned int spare = _streams.size() + 1;
+	return _splitter && spare < _splitter->output_num ? _splitter->output[spare] : nullptr;
+}
+
+void
+MmalStreamGraph::BranchCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer) {
+	BufferLock bufferLock(buffer);
+	MmalStreamGraph* instance = (MmalStreamGraph*) port->userdata;
+	if (instance == nullptr) {
+		throw PiEyeException("Unable to determine stream graph in callback");
+	}
+
+	for (unsigned int stream = 0; stream < instance->_branches.size(); ++stream) {
+		Branch& branch = instance->_branches[stream];
+		if (port == branch.output) {
+			instance->deliver(stream, *buffer);
+			bufferLock.unlock();
+			branch.pool->recycle(buffer);
+			return;
+		}
+	}
+	EZLOG_WARN("Received a buffer from an unknown stream port");
+}
@@ -0,0 +1,83 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "StreamGraph.h"
+
+struct MMAL_COMPONENT_T;
+struct MMAL_PORT_T;
+struct MMAL_CONNECTION_T;
+struct MMAL_BUFFER_HEADER_T;
+class MmalBufferPool;
+
+/**
+ * Tunnels a camera output port into a video splitter. The first splitter output carries the unscaled frames, every
+ * other output is tunnelled into an ISP that scales and converts one stream, so no pixel is touched by the ARM before
+ * the stream's own callback. An output left over can feed yet another component, like the video encoder.
+ */
+class MmalStreamGraph : public StreamGraph {
+public:
+	MmalStreamGraph(MMAL_PORT_T* source, const FrameHandler& handler);
+	virtual ~MmalStreamGraph();
+
+	virtual void
+	build(const std::vector<StreamFormat>& streams);
+
+	virtual void
+	destroy();
+
+	virtual unsigned int
+	getMaxStreams() const;
+
+	// Splitter output with the unscaled frames, to be enabled by the owner. nullptr until built.
+	MMAL_PORT_T*
+	getMainPort() const;
+
+	// First splitter output after those of the streams, with the unscaled frames as well. nullptr until built or if the
+	// streams take all outputs.
+	MMAL_PORT_T*
+	getSparePort() const;
+
+private:
+	// Scaler of one stream, fed by a splitter output
+	struct Branch {
+		MMAL_COMPONENT_T* isp = nullptr;
+		MMAL_CONNECTION_T* connection = nullptr;
+		MMAL_PORT_T* output = nullptr;
+		std::shared_ptr<MmalBufferPool> pool;
+	};
+
+	MMAL_PORT_T* _source;
+	MMAL_COMPONENT_T* _splitter = nullptr;
+	MMAL_CONNECTION_T* _splitterConnection = nullptr;
+	std::vector<Branch> _branches;
+
+	void
+	buildBranch(unsigned int stream);
+
+	static void
+	BranchCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer);
+};
@@ -0,0 +1,165 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "MmalVideoEncoder.h"
+
+#include <algorithm>
+#include <interface/mmal/mmal.h>
+#include <interface/mmal/util/mmal_default_components.h>
+#include <interface/mmal/util/mmal_util_params.h>
+#include <interface/mmal/util/mmal_util.h>
+
+#include "BufferLock.h"
+#include "MmalBufferPool.h"
+#include "PiEyeException.hpp"
+#include "Util.hpp"
+#include "Log.hpp"
+
+#define PIEYE_MIN_ENCODER_BUFFERS (unsigned int)3
+#define PIEYE_MAX_H264_WIDTH 1920
+#define PIEYE_MAX_H264_HEIGHT 1088
+
+namespace {
+	MMAL_VIDEO_PROFILE_T
+	GetMmalProfile(const H264Profile& profile) {
+		switch (profile) {
+			case H264Profile::BASELINE:
+				return MMAL_VIDEO_PROFILE_H264_BASELINE;
+			case H264Profile::MAIN:
+				return MMAL_VIDEO_PROFILE_H264_MAIN;
+			case H264Profile::HIGH:
+				return MMAL_VIDEO_PROFILE_H264_HIGH;
+		}
+		throw PiEyeException("H.264 profile not supported");
+	}
+}
+
+MmalVideoEncoder::MmalVideoEncoder(MMAL_PORT_T* source, const EncoderSettings& settings, const EncodedHandler& handler) :
+		VideoEncoder(settings, handler), _source(source) {
+	if (_source == nullptr) {
+		throw PiEyeException("Cannot encode a NULL port");
+	}
+}
+
+MmalVideoEncoder::~MmalVideoEncoder() {
+	try {
+		destroy();
+	} catch (const std::exception& e) {
+		EZLOG_ERROR("Unable to destroy video encoder: " << e.what());
+	}
+}
+
+void
+MmalVideoEncoder::build() {
+	if (_encoder) {
+		throw StateException("Video encoder was already built");
+	}
+	EZLOG_DEBUG("Building video encoder at [" << _settings.bitrate << "] bit/s");
+	
+	try {
+		MMAL_STATUS_T status = mmal_component_create(MMAL_COMPONENT_DEFAULT_VIDEO_ENCODER, &_encoder);
+		CheckStatus(status, "Unable to create video encoder");
+		if (_encoder->input_num == 0 || _encoder->output_num == 0) {
+			throw PiEyeException("Video encoder has no input or output port");
+		}
+		CopyFormat(_encoder->input[0], _source);
+		const MMAL_VIDEO_FORMAT_T& video = _encoder->input[0]->format->es->video;
+		if (_settings.codec == VideoCodec::H264 && (video.width > PIEYE_MAX_H264_WIDTH || video.height > PIEYE_MAX_H264_HEIGHT)) {
+			throw PiEyeException("H.264 encodes at most 1920x1080, got [" + std::to_string(video.width) + "x"
+					+ std::to_string(video.height) + "]");
+		}
+		
+		// Same size and frame rate, compressed
+		_output = _encoder->output[0];
+		mmal_format_copy(_output->format, _encoder->input[0]->format);
+		_output->format->encoding = _settings.codec == VideoCodec::H264 ? MMAL_ENCODING_H264 : MMAL_ENCODING_MJPEG;
+		_output->format->bitrate = _settings.bitrate;
+		status = mmal_port_format_commit(_output);
+		CheckStatus(status, "Unable to set format of video encoder");
+		if (_settings.codec == VideoCodec::H264) {
+			setH264Parameters();
+		}
+		
+		status = mmal_connection_create(&_connection, _source, _encoder->input[0],
+				MMAL_CONNECTION_FLAG_TUNNELLING | MMAL_CONNECTION_FLAG_ALLOCATION_ON_INPUT);
+		CheckStatus(status, "Unable to connect the video encoder");
+		
+		_output->buffer_num = std::max(PIEYE_MIN_ENCODER_BUFFERS, _output->buffer_num_recommended);
+		_output->buffer_size = std::max(_output->buffer_size_recommended, _output->buffer_size_min);
+		_output->userdata = (struct MMAL_PORT_USERDATA_T*) this;
+		status = mmal_port_enable(_output, OutputCallback);
+		CheckStatus(status, "Unable to enable output of video encoder");
+		_pool.reset(new MmalBufferPool(_output, _output->buffer_num, _output->buffer_size));
+		
+		status = mmal_component_enable(_encoder);
+		CheckStatus(status, "Unable to enable video encoder");
+		status = mmal_connection_enable(_connection);
+		CheckStatus(status, "Unable to enable encoder connection");
+		_pool->fill();
+	} catch (...) {
+		EZLOG_WARN("Could not build video encoder");
+		destroy();
+		throw;
+	}
+}
+
+void
+MmalVideoEncoder::setH264Parameters() {
+	MMAL_STATUS_T status = mmal_port_parameter_set_uint32(_output, MMAL_PARAMETER_INTRAPERIOD, _settings.intraPeriod);
+	CheckStatus(status, "Unable to set intra period of video encoder");
+	
+	MMAL_PARAMETER_VIDEO_PROFILE_T profile;
+	profile.hdr.id = MMAL_PARAMETER_PROFILE;
+	profile.hdr.size = sizeof(profile);
+	profile.profile[0].profile = GetMmalProfile(_settings.profile);
+	profile.profile[0].level = MMAL_VIDEO_LEVEL_H264_4;
+	status = mmal_port_parameter_set(_output, &profile.hdr);
+	CheckStatus(status, "Unable to set profile of video encoder");
+	
+	status = mmal_port_parameter_set_boolean(_output, MMAL_PARAMETER_VIDEO_ENCODE_INLINE_HEADER, MMAL_TRUE);
+	CheckStatus(status, "Unable to enable inline headers of video encoder");
+}
+
+void
+MmalVideoEncoder::destroy() {
+	// Output first, so no buffer is in flight towards the handler
+	if (_output && _output->is_enabled) {
+		CheckStatus(mmal_port_disable(_output), "Unable to disable output of video encoder");
+	}
+	_pool.reset();
+	_output = nullptr;
+	DestroyConnection(_connection);
+	DestroyComponent(_encoder);
+}
+
+void
+MmalVideoEncoder::OutputCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer) {
+	BufferLock bufferLock(buffer);
+	MmalVideoEncoder* instance = (MmalVideoEncoder*) port->userdata;
+	if (instance == nullptr) {
+		throw PiEyeException("Unable to determine video encoder in callback");
+	}
+	
+	instance->deliver(*buffer);
+	bufferLock.unlock();
+	instance->_pool->recycle(buffer);
+}
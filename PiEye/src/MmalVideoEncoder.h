@@ -0,0 +1,62 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <memory>
+
+#include "VideoEncoder.h"
+
+struct MMAL_COMPONENT_T;
+struct MMAL_PORT_T;
+struct MMAL_CONNECTION_T;
+class MmalBufferPool;
+
+/**
+ * Tunnels a port with raw frames into the video encoder of the GPU, so the ARM only sees the compressed stream. H.264
+ * repeats its stream headers with every key frame, so the stream can be cut at any of them.
+ */
+class MmalVideoEncoder : public VideoEncoder {
+public:
+	MmalVideoEncoder(MMAL_PORT_T* source, const EncoderSettings& settings, const EncodedHandler& handler);
+	virtual ~MmalVideoEncoder();
+
+	virtual void
+	build();
+
+	virtual void
+	destroy();
+
+private:
+	MMAL_PORT_T* _source;
+	MMAL_COMPONENT_T* _encoder = nullptr;
+	MMAL_CONNECTION_T* _connection = nullptr;
+	MMAL_PORT_T* _output = nullptr;
+	std::shared_ptr<MmalBufferPool> _pool;
+
+	// Profile, GOP and inline headers, on the committed output
+	void
+	setH264Parameters();
+
+	static void
+	OutputCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer);
+};
@@ -0,0 +1,202 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "MotionDetector.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "PiEyeException.hpp"
+
+#if defined(PIEYE_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define PIEYE_MOTION_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define PIEYE_MOTION_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+	const unsigned int VECTOR_SIZE = 16;
+	const unsigned int MAX_BLOCK_SIZE = 256;	// Keeps the 16 bit lanes of the NEON sums from overflowing
+	const unsigned int MAX_LEARNING_SHIFT = 4;
+
+#if defined(PIEYE_MOTION_NEON)
+	const char* const KERNEL_NAME = "NEON";
+#elif defined(PIEYE_MOTION_SSE)
+	const char* const KERNEL_NAME = "SSE2";
+#else
+	const char* const KERNEL_NAME = "scalar";
+#endif
+
+	// Averages shift times towards the frame, rounding towards it so the background can reach the frame exactly
+	inline uint8_t
+	Follow(uint8_t frame, uint8_t background, unsigned int shift) {
+		const unsigned int round = frame >= background ? 1 : 0;
+		unsigned int value = frame;
+		for (unsigned int s = 0; s < shift; ++s) {
+			value = (background + value + round) >> 1;
+		}
+		return value;
+	}
+
+	// sums[block] += sum of |row - background| over each of the blocks, then the background follows the row. Block size
+	// is a multiple of 16.
+	void
+	CompareRow(const uint8_t* row, uint8_t* background, unsigned int blockSize, unsigned int blocks, unsigned int shift,
+			unsigned int* sums) {
+		for (unsigned int block = 0; block < blocks; ++block) {
+			const uint8_t* frame = row + block * blockSize;
+			uint8_t* target = background + block * blockSize;
+			unsigned int i = 0;
+#if defined(PIEYE_MOTION_NEON)
+			uint16x8_t sad = vdupq_n_u16(0);
+			for (; i + VECTOR_SIZE <= blockSize; i += VECTOR_SIZE) {
+				const uint8x16_t next = vld1q_u8(frame + i);
+				const uint8x16_t old = vld1q_u8(target + i);
+				sad = vpadalq_u8(sad, vabdq_u8(next, old));
+				const uint8x16_t up = vcgeq_u8(next, old);
+				uint8x16_t value = next;
+				for (unsigned int s = 0; s < shift; ++s) {
+					value = vbslq_u8(up, vrhaddq_u8(old, value), vhaddq_u8(old, value));
+				}
+				vst1q_u8(target + i, value);
+			}
+			const uint64x2_t total = vpaddlq_u32(vpaddlq_u16(sad));
+			sums[block] += vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1);
+#elif defined(PIEYE_MOTION_SSE)
+			// Averages round up, so rounding down is an average of the inverted values
+			const __m128i ones = _mm_set1_epi8(-1);
+			__m128i sad = _mm_setzero_si128();
+			for (; i + VECTOR_SIZE <= blockSize; i += VECTOR_SIZE) {
+				const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + i));
+				const __m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(target + i));
+				sad = _mm_add_epi64(sad, _mm_sad_epu8(next, old));
+				const __m128i up = _mm_cmpeq_epi8(_mm_max_epu8(next, old), next);
+				const __m128i invertedOld = _mm_xor_si128(old, ones);
+				__m128i upper = next;
+				__m128i lower = _mm_xor_si128(next, ones);
+				for (unsigned int s = 0; s < shift; ++s) {
+					upper = _mm_avg_epu8(old, upper);
+					lower = _mm_avg_epu8(invertedOld, lower);
+				}
+				lower = _mm_xor_si128(lower, ones);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(target + i),
+						_mm_or_si128(_mm_and_si128(up, upper), _mm_andnot_si128(up, lower)));
+			}
+			sums[block] += _mm_cvtsi128_si32(sad) + _mm_cvtsi128_si32(_mm_srli_si128(sad, 8));
+#endif
+			unsigned int sum = 0;
+			for (; i < blockSize; ++i) {
+				sum += frame[i] > target[i] ? frame[i] - target[i] : target[i] - frame[i];
+				target[i] = Follow(frame[i], target[i], shift);
+			}
+			sums[block] += sum;
+		}
+	}
+}
+
+MotionDetector::MotionDetector(const MotionSettings& settings, unsigned short width, unsigned short height,
+		unsigned int stride) : _settings(settings), _stride(stride),
+		_blocksX(settings.blockSize == 0 ? 0 : width / settings.blockSize),
+		_blocksY(settings.blockSize == 0 ? 0 : height / settings.blockSize),
+		_rowsPerBlock(settings.rowStep == 0 ? 0 : settings.blockSize / settings.rowStep), _planeSize(0),
+		_initialized(false), _moving(false) {
+	if (settings.blockSize == 0 || settings.blockSize % VECTOR_SIZE != 0 || settings.blockSize > MAX_BLOCK_SIZE) {
+		throw PiEyeException("Motion block size must be a multiple of 16 up to " + std::to_string(MAX_BLOCK_SIZE));
+	} else if (settings.rowStep == 0 || settings.blockSize % settings.rowStep != 0) {
+		throw PiEyeException("Motion row step must divide the block size");
+	} else if (settings.threshold == 0 || settings.threshold > 255) {
+		throw PiEyeException("Motion threshold must be between 1 and 255");
+	} else if (settings.learningShift == 0 || settings.learningShift > MAX_LEARNING_SHIFT) {
+		throw PiEyeException("Motion learning shift must be between 1 and " + std::to_string(MAX_LEARNING_SHIFT));
+	} else if (_blocksX == 0 || _blocksY == 0) {
+		throw PiEyeException("Frame is smaller than a motion block");
+	} else if (settings.minBlocks == 0 || settings.minBlocks > _blocksX * _blocksY) {
+		throw PiEyeException("Motion needs between 1 and [" + std::to_string(_blocksX * _blocksY) + "] blocks");
+	}
+	const unsigned int rowSize = _blocksX * settings.blockSize;
+	_planeSize = ((_blocksY * _rowsPerBlock - 1) * settings.rowStep) * stride + rowSize;
+	_background.resize(_blocksY * _rowsPerBlock * _blocksX * settings.blockSize);
+	_sums.resize(_blocksX * _blocksY);
+	_mask.create(_blocksY, _blocksX, CV_8U);
+	_mask.setTo(0);
+}
+
+bool
+MotionDetector::process(const uint8_t* plane, unsigned int length, long long pts, MotionEvent& event) {
+	if (length < _planeSize) {
+		throw PiEyeException("Buffer of [" + std::to_string(length) + "] bytes is too small for motion detection");
+	}
+	const unsigned int rowSize = _blocksX * _settings.blockSize;
+	if (!_initialized) {
+		for (unsigned int row = 0; row < _blocksY * _rowsPerBlock; ++row) {
+			memcpy(_background.data() + row * rowSize, plane + row * _settings.rowStep * _stride, rowSize);
+		}
+		_initialized = true;
+		return false;
+	}
+
+	std::fill(_sums.begin(), _sums.end(), 0);
+	for (unsigned int blockY = 0; blockY < _blocksY; ++blockY) {
+		unsigned int* sums = _sums.data() + blockY * _blocksX;
+		for (unsigned int i = 0; i < _rowsPerBlock; ++i) {
+			const unsigned int row = blockY * _rowsPerBlock + i;
+			CompareRow(plane + row * _settings.rowStep * _stride, _background.data() + row * rowSize,
+					_settings.blockSize, _blocksX, _settings.learningShift, sums);
+		}
+	}
+
+	// Mean difference above the threshold, without dividing
+	const unsigned int limit = _settings.threshold * _settings.blockSize * _rowsPerBlock;
+	unsigned int movingBlocks = 0;
+	for (unsigned int blockY = 0; blockY < _blocksY; ++blockY) {
+		uint8_t* mask = _mask.ptr<uint8_t>(blockY);
+		for (unsigned int blockX = 0; blockX < _blocksX; ++blockX) {
+			const bool moving = _sums[blockY * _blocksX + blockX] > limit;
+			mask[blockX] = moving ? 255 : 0;
+			movingBlocks += moving ? 1 : 0;
+		}
+	}
+
+	const bool started = !_moving;
+	_moving = movingBlocks >= _settings.minBlocks;
+	if (!_moving) {
+		return false;
+	}
+	event.pts = pts;
+	event.movingBlocks = movingBlocks;
+	event.blocks = _blocksX * _blocksY;
+	event.started = started;
+	return true;
+}
+
+const cv::Mat&
+MotionDetector::getMask() const {
+	return _mask;
+}
+
+const char*
+MotionDetector::GetKernelName() {
+	return KERNEL_NAME;
+}
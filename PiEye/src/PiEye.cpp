@@ -22,9 +22,21 @@ SOFTWARE.
 */
 #include "PiEye.h"
 
+#include <opencv2/core/core.hpp>
+
 #include "PiEyeImpl.h"
+#include "MmalBackend.h"
+#include "SyntheticBackend.h"
 
-PiEye::PiEye() : _impl(new PiEyeImpl()){
+PiEye::PiEye() : _impl(new PiEyeImpl(new MmalBackend())){
+    
+}
+
+PiEye::PiEye(unsigned int cameraNumber) : _impl(new PiEyeImpl(new MmalBackend(cameraNumber))) {
+    
+}
+
+PiEye::PiEye(const SyntheticSource& source) : _impl(new PiEyeImpl(new SyntheticBackend(source))) {
     
 }
 
@@ -45,11 +57,46 @@ PiEye::destroyCamera() {
     _impl->destroyCamera();
 }
 
+void
+PiEye::setResolution(unsigned short width, unsigned short height) {
+    _impl->setResolution(width, height);
+}
+
+void
+PiEye::setVideoResolution(unsigned short width, unsigned short height) {
+    _impl->setVideoResolution(width, height);
+}
+
+void
+PiEye::setStillResolution(unsigned short width, unsigned short height) {
+    _impl->setStillResolution(width, height);
+}
+
+void
+PiEye::setFrameRate(unsigned short fps) {
+    _impl->setFrameRate(fps);
+}
+
+void
+PiEye::reconfigure(unsigned short width, unsigned short height, const Encoding& encoding) {
+    _impl->reconfigure(width, height, encoding);
+}
+
 void
 PiEye::startVideo() {
     _impl->startVideo();
 }
 
+std::future<void>
+PiEye::startAsync(bool settle) {
+    return _impl->startAsync(settle);
+}
+
+StartupTimeline
+PiEye::getStartupTimeline() const {
+    return _impl->getStartupTimeline();
+}
+
 void
 PiEye::stopVideo() {
     _impl->stopVideo();
@@ -60,11 +107,227 @@ PiEye::grabFrame(cv::Mat& data) {
     _impl->grabFrame(data);
 }
 
+void
+PiEye::grabFrameWithSettings(cv::Mat& data, FrameSettings& settings) {
+    _impl->grabFrameWithSettings(data, settings);
+}
+
+void
+PiEye::grabFrameWithStatistics(cv::Mat& data, FrameStatistics& statistics) {
+    _impl->grabFrameWithStatistics(data, statistics);
+}
+
+void
+PiEye::grabBracket(const std::vector<FrameSettings>& brackets, std::vector<cv::Mat>& frames, std::vector<FrameSettings>& settings) {
+    _impl->grabBracket(brackets, frames, settings);
+}
+
+bool
+PiEye::popFrame(cv::Mat& data) {
+    return _impl->popFrame(data);
+}
+
+void
+PiEye::setFrameQueue(unsigned int depth, const QueuePolicy& policy) {
+    _impl->setFrameQueue(depth, policy);
+}
+
+unsigned long long
+PiEye::getDroppedFrames() const {
+    return _impl->getDroppedFrames();
+}
+
+CaptureStats
+PiEye::getStats() const {
+    return _impl->getStats();
+}
+
+void
+PiEye::resetStats() {
+    _impl->resetStats();
+}
+
+void
+PiEye::setFrameDivisor(unsigned int divisor) {
+    _impl->setFrameDivisor(divisor);
+}
+
+void
+PiEye::setDecodeWorkers(unsigned int workers) {
+    _impl->setDecodeWorkers(workers);
+}
+
+unsigned int
+PiEye::getDecodeWorkers() const {
+    return _impl->getDecodeWorkers();
+}
+
+void
+PiEye::grabFramePyramid(std::vector<cv::Mat>& levels, unsigned int levelCount) {
+    _impl->grabFramePyramid(levels, levelCount);
+}
+
+FrameLease
+PiEye::grabFrameLease() {
+    return _impl->grabFrameLease();
+}
+
+std::future<cv::Mat>
+PiEye::grabFrameAsync() {
+    return _impl->grabFrameAsync();
+}
+
+unsigned int
+PiEye::subscribe(const std::function<void(const cv::Mat&)>& handler, const SubscriberPolicy& policy,
+		unsigned int queueDepth, unsigned int decimation) {
+    return _impl->subscribe(handler, policy, queueDepth, decimation);
+}
+
+void
+PiEye::unsubscribe(unsigned int id) {
+    _impl->unsubscribe(id);
+}
+
+SubscriberStats
+PiEye::getSubscriberStats(unsigned int id) const {
+    return _impl->getSubscriberStats(id);
+}
+
+unsigned int
+PiEye::addStream(unsigned short width, unsigned short height, const Encoding& encoding) {
+    return _impl->addStream(width, height, encoding);
+}
+
+void
+PiEye::clearStreams() {
+    _impl->clearStreams();
+}
+
+void
+PiEye::grabStreamFrame(unsigned int stream, cv::Mat& data) {
+    _impl->grabStreamFrame(stream, data);
+}
+
+void
+PiEye::startRecording(const EncoderSettings& settings, const EncodedHandler& handler) {
+    _impl->startRecording(settings, handler);
+}
+
+void
+PiEye::startRecording(const EncoderSettings& settings, const std::string& path) {
+    _impl->startRecording(settings, path);
+}
+
+void
+PiEye::stopRecording() {
+    _impl->stopRecording();
+}
+
+bool
+PiEye::isRecording() const {
+    return _impl->isRecording();
+}
+
+void
+PiEye::startEventRecording(const EncoderSettings& settings, float preRollSeconds, size_t memoryBytes) {
+    _impl->startEventRecording(settings, preRollSeconds, memoryBytes);
+}
+
+bool
+PiEye::triggerEvent(const std::string& path, float postRollSeconds) {
+    return _impl->triggerEvent(path, postRollSeconds);
+}
+
+EventRecordingStats
+PiEye::getEventRecordingStats() const {
+    return _impl->getEventRecordingStats();
+}
+
+void
+PiEye::stopEventRecording() {
+    _impl->stopEventRecording();
+}
+
+void
+PiEye::startMotionDetection(const MotionSettings& settings, const MotionHandler& handler) {
+    _impl->startMotionDetection(settings, handler);
+}
+
+void
+PiEye::stopMotionDetection() {
+    _impl->stopMotionDetection();
+}
+
+bool
+PiEye::isDetectingMotion() const {
+    return _impl->isDetectingMotion();
+}
+
+void
+PiEye::startFrameStatistics(const StatisticsSettings& settings) {
+    _impl->startFrameStatistics(settings);
+}
+
+void
+PiEye::stopFrameStatistics() {
+    _impl->stopFrameStatistics();
+}
+
+bool
+PiEye::getFrameStatistics(FrameStatistics& statistics) const {
+    return _impl->getFrameStatistics(statistics);
+}
+
+void
+PiEye::startAutoExposure(const ExposureTarget& target, const ExposureModel& model) {
+    _impl->startAutoExposure(target, model);
+}
+
+void
+PiEye::stopAutoExposure() {
+    _impl->stopAutoExposure();
+}
+
+bool
+PiEye::isAutoExposing() const {
+    return _impl->isAutoExposing();
+}
+
+ExposureStats
+PiEye::getExposureStats() const {
+    return _impl->getExposureStats();
+}
+
+ExposureModel
+PiEye::learnExposureModel(const std::vector<FrameSettings>& brackets) {
+    return _impl->learnExposureModel(brackets);
+}
+
 void
 PiEye::grabStill(cv::Mat& data) {
     _impl->grabStill(data);
 }
 
+std::future<cv::Mat>
+PiEye::grabStillAsync() {
+    return _impl->grabStillAsync();
+}
+
+void
+PiEye::grabStillBurst(std::vector<cv::Mat>& stills, unsigned int count, unsigned int intervalMillis) {
+    _impl->grabStillBurst(stills, count, intervalMillis);
+}
+
+void
+PiEye::grabStillWithSettings(cv::Mat& data, FrameSettings& settings) {
+    _impl->grabStillWithSettings(data, settings);
+}
+
+FrameSettings
+PiEye::getFrameSettings() const {
+    return _impl->getFrameSettings();
+}
+
 void
 PiEye::setSensorMode(const SensorMode mode) {
     _impl->setSensorMode(mode);
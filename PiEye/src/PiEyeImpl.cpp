@@ -24,54 +24,82 @@ SOFTWARE.
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <thread>
 #include <opencv2/core/core.hpp>
-#include <interface/mmal/mmal.h>
-#include <interface/mmal/util/mmal_default_components.h>
-#include <interface/mmal/util/mmal_connection.h>
-#include <interface/mmal/util/mmal_util_params.h>
-#include <interface/mmal/util/mmal_util.h>
+#include <interface/mmal/mmal_buffer.h>
 
-#include "BufferLock.h"
+#include "CaptureBackend.h"
+#include "BufferPool.h"
+#include "RingBuffer.h"
+#include "FramePromises.h"
+#include "Subscriber.h"
+#include "EventRecorder.h"
+#include "MotionDetector.h"
+#include "FrameStatistician.h"
+#include "ExposureController.h"
+#include "DecodePool.h"
 #include "PiEyeException.hpp"
-#include "Util.hpp"
 #include "Log.hpp"
 
-#define PIEYE_PORT_PREVIEW 0
-#define PIEYE_PORT_VIDEO 1
-#define PIEYE_PORT_STILL 2
-#define PIEYE_MIN_VIDEO_BUFFERS (unsigned int)3
-#define PIEYE_MIN_STILL_BUFFERS (unsigned int)3
+#define PIEYE_DEFAULT_FRAME_QUEUE_DEPTH 1
+#define PIEYE_MAX_STREAMS 3
+#define PIEYE_SETTINGS_TIMEOUT 5
+#define PIEYE_SETTINGS_TOLERANCE 0.05f
+#define PIEYE_EXPOSURE_SLACK_MICROS 50
+#define PIEYE_BRACKET_RETRY_FRAMES 8
+#define PIEYE_WARMUP_STABLE_FRAMES 3
+#define PIEYE_MAX_WARMUP_FRAMES 30
+#define PIEYE_EXPOSURE_ROW_STEP 4		// Rows of the frame statistics started for auto-exposure
+#define PIEYE_MODEL_CLIPPED_FRACTION 0.02f
+
+// Frame in the queue of grabFrame/popFrame, stamped with its arrival to measure its latency
+struct PiEyeImpl::QueuedFrame {
+	cv::Mat image;
+	long long arrival;
+	FrameSettings settings;
+	std::shared_ptr<const FrameStatistics> statistics;	// Null while statistics are off
+};
 
 namespace {
-    void
-    LogCameraSettings(const MMAL_PARAMETER_CAMERA_SETTINGS_T& settings) {
-		EZLOG_DEBUG("Exposure [" << settings.exposure << "], "
-					<< "analog gain [" << settings.analog_gain.num << "/" << settings.analog_gain.den << "], "
-					<< "digital gain [" << settings.digital_gain.num << "/" << settings.digital_gain.den << "], "
-					<< "red gain [" << settings.awb_red_gain.num << "/" << settings.awb_red_gain.den << "], "
-					<< "blue gain [" << settings.awb_blue_gain.num << "/" << settings.awb_blue_gain.den << "], "
-					<< "focus pos [" << settings.focus_position << "]");
-    }
+	// The sensor rounds exposure to whole lines and gains to its own steps, so reported settings are never exact
+	bool
+	Reflects(float reported, float requested, float slack) {
+		return requested == 0 || std::abs(reported - requested) <= std::max(slack, requested * PIEYE_SETTINGS_TOLERANCE);
+	}
 	
-	unsigned int
-	GetMmalEncoding(const Encoding& encoding) {
-		switch(encoding) {
-			case Encoding::NATIVE_BGR:
-				return MMAL_ENCODING_BGR24;
-			case Encoding::NATIVE_GRAYSCALE:
-				return MMAL_ENCODING_I420;
-		}
-		
-		throw PiEyeException("Encoding not supported");
+	// Whether a frame taken with the reported settings honours every setting that is not left on auto
+	bool
+	Reflects(const FrameSettings& reported, const FrameSettings& requested) {
+		return Reflects(reported.exposureMicros, requested.exposureMicros, PIEYE_EXPOSURE_SLACK_MICROS)
+				&& Reflects(reported.analogGain, requested.analogGain, 0) && Reflects(reported.digitalGain, requested.digitalGain, 0)
+				&& Reflects(reported.redGain, requested.redGain, 0) && Reflects(reported.blueGain, requested.blueGain, 0);
 	}
 }
 
-PiEyeImpl::PiEyeImpl() {
-    
+PiEyeImpl::PiEyeImpl(CaptureBackend* backend) : _backend(backend), _frameRing(new RingBuffer<QueuedFrame>(PIEYE_DEFAULT_FRAME_QUEUE_DEPTH, QueuePolicy::OVERWRITE_OLDEST)),
+		_frameConsumer(false), _framePromises(new FramePromises()), _motionSettings(),
+		_statisticsSettings(), _stillRequest(nullptr), _burstTaken(0),
+		_requestedSettings(), _reportedSettings(), _stillSettings(), _startupTimeline(), _warmingUp(false), _warmUpSettings(),
+		_poolStarvationBase(0), _waitTimeOutBase(0) {
+    if (!_backend) {
+        throw PiEyeException("Camera needs a capture backend");
+    }
+    _backend->setSettingsHandler([this](const FrameSettings& settings) {
+		parseSettings(settings);
+	});
+	_backend->setPhaseHandler([this](const StartupPhase& phase) {
+		recordPhase(phase);
+	});
 }
 
 PiEyeImpl::~PiEyeImpl() {
     try {
+		stopAutoExposure();
         destroyCamera();
     } catch (const std::exception& e) {
         EZLOG_ERROR("Unable to destroy camera: " << e.what());
@@ -82,216 +110,1040 @@ PiEyeImpl::~PiEyeImpl() {
 
 void
 PiEyeImpl::createCamera() {
-    MMAL_STATUS_T status;
-    
-    // Skip if already open
-    if (_camera) {
-        return;
-    }
-
-    try {
-        // Create component
-        status = mmal_component_create(MMAL_COMPONENT_DEFAULT_CAMERA, &_camera);
-        CheckStatus(status, "Unable to create default camera component");
-        if (_camera == nullptr) {
-            throw PiEyeException("Created camera is a nullptr");
-        } else if (!_camera->control) {
-            throw PiEyeException("Camera has no control port");
-        } else if (!_camera->output_num) {
-            throw PiEyeException("Camera has no output ports");
-        }
-        
-        // Enable camera control callback
-        const MMAL_PARAMETER_CHANGE_EVENT_REQUEST_T changeEvent = {{MMAL_PARAMETER_CHANGE_EVENT_REQUEST, sizeof(MMAL_PARAMETER_CHANGE_EVENT_REQUEST_T)},
-            MMAL_PARAMETER_CAMERA_SETTINGS, true};
-        status = mmal_port_parameter_set(_camera->control, &changeEvent.hdr);
-        CheckStatus(status, "Unable to register change event on camera control port");
-        
-        // Set camera config
-        setCameraConfig();
-        
-        // Enable camera control port
-        status = mmal_port_enable(_camera->control, ControlCallback);
-        CheckStatus(status, "Unable to enable camera control port");
-        
-        // Enable camera
-        status = mmal_component_enable(_camera);
-        CheckStatus(status, "Unable to enable camera");
-		
-    } catch (...) {
-        destroyCamera();
-        throw;
-    }
+    const CaptureFormat video = {_encoding, _videoWidth, _videoHeight, _fps};
+    const CaptureFormat still = {_encoding, _stillWidth, _stillHeight, 0};
+    _backend->create(video, still);
 }
 
 void
 PiEyeImpl::destroyCamera() {
     EZLOG_TRACE("Destroying camera");
-    MMAL_STATUS_T status;
     stopVideo();
 	closeStill();
-    if (_camera) {
-        
-        // Disable
-        EZLOG_TRACE("Disabling camera");
-        if (_camera->is_enabled) {
-            status = mmal_component_disable(_camera);
-            CheckStatus(status, "Unable to disable camera");
-        }
-        
-        // Destroy
-        EZLOG_TRACE("Destroying camera component");
-        status = mmal_component_destroy(_camera);
-        CheckStatus(status, "Unable to destroy camera component");
-        _camera = nullptr;
-    }
+    _backend->destroy();
     EZLOG_TRACE("Camera destroyed!");
 }
 
+void
+PiEyeImpl::setResolution(unsigned short width, unsigned short height) {
+	reconfigure(width, height, _encoding);
+}
+
+void
+PiEyeImpl::setVideoResolution(unsigned short width, unsigned short height) {
+	if (width == 0 || height == 0) {
+		throw PiEyeException("Resolution can't be empty");
+	}
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	changeVideoFormat(width, height, _encoding, _fps);
+}
+
+void
+PiEyeImpl::setStillResolution(unsigned short width, unsigned short height) {
+	if (width == 0 || height == 0) {
+		throw PiEyeException("Resolution can't be empty");
+	}
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	changeStillFormat(width, height, _encoding);
+}
+
+void
+PiEyeImpl::setFrameRate(unsigned short fps) {
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	changeVideoFormat(_videoWidth, _videoHeight, _encoding, fps);
+}
+
+void
+PiEyeImpl::reconfigure(unsigned short width, unsigned short height, const Encoding& encoding) {
+	if (width == 0 || height == 0) {
+		throw PiEyeException("Resolution can't be empty");
+	}
+	EZLOG_DEBUG("Reconfiguring to [" << width << "x" << height << "]");
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	changeStillFormat(width, height, encoding);
+	changeVideoFormat(width, height, encoding, _fps);
+}
+
+void
+PiEyeImpl::changeStillFormat(unsigned short width, unsigned short height, const Encoding& encoding) {
+	if (width == _stillWidth && height == _stillHeight && encoding == _encoding) {
+		return;
+	}
+	
+	// The port opens again in the new format with the next still
+	closeStill();
+	_stillWidth = width;
+	_stillHeight = height;
+}
+
+void
+PiEyeImpl::changeVideoFormat(unsigned short width, unsigned short height, const Encoding& encoding, unsigned short fps) {
+	if (width == _videoWidth && height == _videoHeight && encoding == _encoding && fps == _fps) {
+		return;
+	}
+	std::unique_ptr<MotionDetector> motionDetector = createMotionDetector(width, height, encoding);
+	std::unique_ptr<FrameStatistician> statistician = createStatistician(width, height);
+	if (!_backend->isVideoRunning()) {
+		_videoWidth = width;
+		_videoHeight = height;
+		_encoding = encoding;
+		_fps = fps;
+		std::lock_guard<std::mutex> lock(_motionMutex);
+		_motionDetector.swap(motionDetector);
+		std::lock_guard<std::mutex> statisticsLock(_statisticsMutex);
+		_statistician.swap(statistician);
+		return;
+	}
+	
+	// Nothing decodes video while the port is down, so the decoder, the motion background and the statistics grid can
+	// be swapped
+	const CaptureFormat format = {encoding, width, height, fps};
+	_backend->reconfigureVideo(format, [this, &format, &motionDetector, &statistician]() {
+		drainDecodes();
+		_videoWidth = format.width;
+		_videoHeight = format.height;
+		_encoding = format.encoding;
+		_fps = format.fps;
+		_videoDecoder = FrameDecoder(_encoding, _videoWidth, _videoHeight, _frameDivisor);
+		_stats.reconfigureVideo();
+		std::lock_guard<std::mutex> lock(_motionMutex);
+		_motionDetector.swap(motionDetector);
+		std::lock_guard<std::mutex> statisticsLock(_statisticsMutex);
+		_statistician.swap(statistician);
+	});
+	EZLOG_DEBUG("Reconfigured video to [" << width << "x" << height << "] at [" << fps << "] fps");
+}
+
 void
 PiEyeImpl::startVideo() {
 	EZLOG_TRACE("Opening video port");
-    MMAL_STATUS_T status;
 
     // Skip if already started
-    if (_videoPort != nullptr) {
+    if (_backend->isVideoRunning()) {
 		EZLOG_TRACE("Video already opened");
         return;
-    }
-    
-    // Check if camera is opened and video is available
-    if (_camera == nullptr) {
+    } else if (!_backend->isCreated()) {
         throw StateException("Cannot start video before camera was created");
-    } else if (_camera->output_num <= PIEYE_PORT_VIDEO || _camera->output[PIEYE_PORT_VIDEO] == nullptr) {
-        throw PiEyeException("Video port is not available");
     }
     
-    try {
-        // Configure
-        _videoPort = _camera->output[PIEYE_PORT_VIDEO];
-        _videoPort->userdata = (struct MMAL_PORT_USERDATA_T*) this;
-        setFormat(*_videoPort, _fps);
-        setFormat(*_camera->output[1], _fps); // TODO - should not be here
-        
-        // Make sure enough buffers are available for video and preview
-        if (_videoPort->buffer_num < PIEYE_MIN_VIDEO_BUFFERS) {
-            _videoPort->buffer_num = PIEYE_MIN_VIDEO_BUFFERS;
-        }
-        
-        // Enable video port
-		EZLOG_TRACE("Enabling video port");
-        status = mmal_port_enable(_videoPort, BufferCallback);
-        CheckStatus(status, "Unable to enable video port");
-        
-        // Create buffer pool
-		EZLOG_TRACE("Creating video pool with [" << _videoPort->buffer_num << "] buffers of [" << _videoPort->buffer_size << "] bytes");
-        _videoPool = mmal_port_pool_create(_videoPort, _videoPort->buffer_num, _videoPort->buffer_size);
-        if (!_videoPool) {
-            throw PiEyeException("Unable to allocate video pool");
-        }
-        
-        // Inject all buffers
-        const int bufferCount = mmal_queue_length(_videoPool->queue);
-		EZLOG_TRACE("Injecting [" << bufferCount << "] buffers in video port");
-        for(int i = 0; i < bufferCount; ++i) {
-            MMAL_BUFFER_HEADER_T* buffer = mmal_queue_get(_videoPool->queue);
-
-            if (!buffer) {
-                throw PiEyeException("Unable to get buffer");
-            }
-            
-            status = mmal_port_send_buffer(_videoPort, buffer);
-            CheckStatus(status, "Unable to send a buffer to the video port");
-        }
-        
-        // Go!
-		EZLOG_TRACE("Enabling capture parameter on video port");
-        setParameter(_videoPort, MMAL_PARAMETER_CAPTURE, true);
-        
-		EZLOG_TRACE("Video enabled successfully");
-    } catch (...) {
-		EZLOG_WARN("Could not enable video port");
-        stopVideo();
-        throw;
-    }
+    _videoDecoder = FrameDecoder(_encoding, _videoWidth, _videoHeight, _frameDivisor);
+    _stats.restartVideo();
+    const CaptureFormat format = {_encoding, _videoWidth, _videoHeight, _fps};
+    _backend->startVideo(format, [this](MMAL_BUFFER_HEADER_T* buffer) {
+		return parseVideoBuffer(buffer);
+	}, _streamFormats, [this](unsigned int stream, const cv::Mat& frame) {
+		parseStreamFrame(stream, frame);
+	});
+	EZLOG_TRACE("Video enabled successfully");
+}
+
+std::future<void>
+PiEyeImpl::startAsync(bool settle) {
+	// Creating the camera and waiting for settled frames blocks for a while, so it runs on a thread of its own
+	return std::async(std::launch::async, [this, settle]() {
+		start(settle);
+	});
+}
+
+StartupTimeline
+PiEyeImpl::getStartupTimeline() const {
+	std::lock_guard<std::mutex> lock(_startupMutex);
+	return _startupTimeline;
+}
+
+void
+PiEyeImpl::start(bool settle) {
+	{
+		std::lock_guard<std::mutex> lock(_startupMutex);
+		_startupTimeline = StartupTimeline();
+		_startupStart = CaptureStatsRecorder::Now();
+		_stableFrames = 0;
+		_settle = settle;
+	}
+	_warmingUp = true;
+	
+	try {
+		createCamera();
+		startVideo();
+		
+		// Opened while the first frames settle, instead of with the first still. The start does not wait for the
+		// settings to settle: the warm-up goes on alongside, and only keeps unsettled frames from the video consumers.
+		{
+			std::lock_guard<std::mutex> lock(_stillMutex);
+			initStill();
+		}
+		std::lock_guard<std::mutex> lock(_startupMutex);
+		_startupTimeline.stillReady = getStartupMillis();
+		
+	} catch (...) {
+		EZLOG_ERROR("Something went wrong while starting the camera");
+		_warmingUp = false;
+		std::lock_guard<std::mutex> lock(_startupMutex);
+		_startupStart = 0;
+		throw;
+	}
+}
+
+void
+PiEyeImpl::recordPhase(const StartupPhase& phase) {
+	std::lock_guard<std::mutex> lock(_startupMutex);
+	if (_startupStart == 0) {
+		return;
+	}
+	const float millis = getStartupMillis();
+	switch (phase) {
+		case StartupPhase::COMPONENT_CREATED:
+			_startupTimeline.componentCreated = millis;
+			break;
+		case StartupPhase::CONFIGURED:
+			_startupTimeline.configured = millis;
+			break;
+		case StartupPhase::PORT_ENABLED:
+			_startupTimeline.portEnabled = millis;
+			break;
+		case StartupPhase::POOL_ALLOCATED:
+			_startupTimeline.poolAllocated = millis;
+			break;
+	}
+}
+
+float
+PiEyeImpl::getStartupMillis() const {
+	return (CaptureStatsRecorder::Now() - _startupStart) / 1e6f;
+}
+
+bool
+PiEyeImpl::warmUp(const FrameSettings& settings) {
+	std::lock_guard<std::mutex> lock(_startupMutex);
+	if (_startupTimeline.warmUpFrames == 0) {
+		_startupTimeline.firstFrame = getStartupMillis();
+	}
+	
+	// Settled once a few frames in a row were exposed like the one before
+	_stableFrames = _startupTimeline.warmUpFrames > 0 && Reflects(settings, _warmUpSettings) ? _stableFrames + 1 : 0;
+	_warmUpSettings = settings;
+	if (_settle && _stableFrames < PIEYE_WARMUP_STABLE_FRAMES && _startupTimeline.warmUpFrames < PIEYE_MAX_WARMUP_FRAMES) {
+		++_startupTimeline.warmUpFrames;
+		return true;
+	}
+	_startupTimeline.ready = getStartupMillis();
+	_startupStart = 0;
+	_warmingUp = false;
+	EZLOG_DEBUG("Camera ready after [" << _startupTimeline.ready << "] ms, discarded [" << _startupTimeline.warmUpFrames
+			<< "] warm-up frames");
+	return false;
 }
 
 void
 PiEyeImpl::stopVideo() {
-	if (_videoPort == nullptr) {
+	if (!_backend->isVideoRunning()) {
 		EZLOG_TRACE("Video already stopped");
 	} else {
 		EZLOG_TRACE("Stopping video");
+		_backend->stopVideo();
+		drainDecodes();
 		
-        // Disable video port
-        if (_videoPort->is_enabled) {
-			EZLOG_TRACE("Disabling video port");
-            const MMAL_STATUS_T status = mmal_port_disable(_videoPort);
-            CheckStatus(status, "Unable to disable video port");
-        }
-        
-        // Free video pool
-        if (_videoPool) {
-			EZLOG_TRACE("Destroying video pool");
-            mmal_port_pool_destroy(_videoPort, _videoPool);
-            _videoPool = nullptr;
-        }
-	
-		_videoPort = nullptr;	
+		// A warm-up cut short does not carry over to the next start of video
+		if (_warmingUp.exchange(false)) {
+			std::lock_guard<std::mutex> lock(_startupMutex);
+			_startupStart = 0;
+		}
+		_framePromises->failAll(std::make_exception_ptr(StateException("Video was stopped before the frame arrived")));
 		EZLOG_TRACE("Video stopped");
     }
 }
 
 void
 PiEyeImpl::grabFrame(cv::Mat& data) {
-	// TODO: Check if video started
 	EZLOG_TRACE("Grabbing a frame");
-    _frameRequests.insert(&data);
-    _videoWait.wait(30);
+	if (!_backend->isVideoRunning()) {
+		throw StateException("Cannot grab a frame before video was started");
+	}
+	
+	_frameConsumer = true;
+	RingBuffer<QueuedFrame>& frameRing = *_frameRing;
+	QueuedFrame frame;
+	_videoWait.wait(30, [&frameRing, &frame]() {
+		return frameRing.pop(frame);
+	});
+	_stats.recordLatency(frame.arrival);
+	data = frame.image;
 	EZLOG_TRACE("Grabbed a frame");
 }
 
+void
+PiEyeImpl::grabFrameWithSettings(cv::Mat& data, FrameSettings& settings) {
+	EZLOG_TRACE("Grabbing a frame with the requested settings");
+	if (!_backend->isVideoRunning()) {
+		throw StateException("Cannot grab a frame before video was started");
+	}
+	
+	// Frames exposed before the settings took effect are dropped, not returned
+	_frameConsumer = true;
+	const FrameSettings requested = getRequestedSettings();
+	RingBuffer<QueuedFrame>& frameRing = *_frameRing;
+	QueuedFrame frame;
+	unsigned int skipped = 0;
+	_videoWait.wait(PIEYE_SETTINGS_TIMEOUT, [&frameRing, &frame, &requested, &skipped]() {
+		while (frameRing.pop(frame)) {
+			if (Reflects(frame.settings, requested)) {
+				return true;
+			}
+			++skipped;
+		}
+		return false;
+	});
+	_stats.recordLatency(frame.arrival);
+	data = frame.image;
+	settings = frame.settings;
+	EZLOG_DEBUG("Grabbed a frame with the requested settings, skipped [" << skipped << "] frames");
+}
+
+void
+PiEyeImpl::grabFrameWithStatistics(cv::Mat& data, FrameStatistics& statistics) {
+	EZLOG_TRACE("Grabbing a frame with its statistics");
+	if (!_backend->isVideoRunning()) {
+		throw StateException("Cannot grab a frame before video was started");
+	} else if (!hasStatistician()) {
+		throw StateException("Frame statistics must be started first");
+	}
+	
+	// Frames queued before statistics were started have none, and are dropped
+	_frameConsumer = true;
+	RingBuffer<QueuedFrame>& frameRing = *_frameRing;
+	QueuedFrame frame;
+	_videoWait.wait(30, [&frameRing, &frame]() {
+		while (frameRing.pop(frame)) {
+			if (frame.statistics) {
+				return true;
+			}
+		}
+		return false;
+	});
+	_stats.recordLatency(frame.arrival);
+	data = frame.image;
+	statistics = *frame.statistics;
+	EZLOG_TRACE("Grabbed a frame with its statistics");
+}
+
+void
+PiEyeImpl::grabBracket(const std::vector<FrameSettings>& brackets, std::vector<cv::Mat>& frames, std::vector<FrameSettings>& settings) {
+	EZLOG_DEBUG("Grabbing a bracket of [" << brackets.size() << "] settings");
+	if (!_backend->isVideoRunning()) {
+		throw StateException("Cannot grab a bracket before video was started");
+	}
+	frames.assign(brackets.size(), cv::Mat());
+	settings.assign(brackets.size(), FrameSettings());
+	
+	// Brackets still to request, and those requested but not seen yet with the frame count they were requested at
+	std::deque<unsigned int> pending;
+	for (unsigned int i = 0; i < brackets.size(); ++i) {
+		pending.push_back(i);
+	}
+	std::deque<std::pair<unsigned int, unsigned long> > requested;
+	
+	_frameConsumer = true;
+	RingBuffer<QueuedFrame>& frameRing = *_frameRing;
+	QueuedFrame frame;
+	unsigned long frameCount = 0;
+	unsigned int remaining = brackets.size();
+	unsigned int retries = 0;
+	std::chrono::steady_clock::time_point progress = std::chrono::steady_clock::now();
+	while (remaining > 0) {
+		// The sensor pipelines its settings, so the next bracket goes out while the frames of the previous ones are
+		// still being exposed
+		if (!pending.empty()) {
+			applySettings(brackets[pending.front()]);
+			requested.push_back(std::make_pair(pending.front(), frameCount));
+			pending.pop_front();
+		}
+		_videoWait.wait(PIEYE_SETTINGS_TIMEOUT, [&frameRing, &frame]() {
+			return frameRing.pop(frame);
+		});
+		++frameCount;
+		
+		// Oldest first: a frame with a later bracket means the ones requested before it were overtaken
+		std::deque<std::pair<unsigned int, unsigned long> >::iterator match = requested.begin();
+		while (match != requested.end() && !Reflects(frame.settings, brackets[match->first])) {
+			++match;
+		}
+		if (match != requested.end()) {
+			for (std::deque<std::pair<unsigned int, unsigned long> >::iterator it = requested.begin(); it != match; ++it) {
+				pending.push_back(it->first);
+				++retries;
+			}
+			_stats.recordLatency(frame.arrival);
+			frames[match->first] = frame.image;
+			settings[match->first] = frame.settings;
+			requested.erase(requested.begin(), match + 1);
+			--remaining;
+			progress = std::chrono::steady_clock::now();
+		} else if (!requested.empty() && frameCount - requested.front().second > PIEYE_BRACKET_RETRY_FRAMES) {
+			pending.push_back(requested.front().first);
+			requested.pop_front();
+			++retries;
+		} else if (std::chrono::steady_clock::now() - progress > std::chrono::seconds(PIEYE_SETTINGS_TIMEOUT)) {
+			throw TimeOutException("Camera did not reach the settings of the bracket");
+		}
+	}
+	EZLOG_DEBUG("Grabbed a bracket of [" << brackets.size() << "] settings in [" << frameCount << "] frames, retried ["
+			<< retries << "] settings");
+}
+
+bool
+PiEyeImpl::popFrame(cv::Mat& data) {
+	_frameConsumer = true;
+	QueuedFrame frame;
+	if (!_frameRing->pop(frame)) {
+		return false;
+	}
+	_stats.recordLatency(frame.arrival);
+	data = frame.image;
+	return true;
+}
+
+void
+PiEyeImpl::setFrameQueue(unsigned int depth, const QueuePolicy& policy) {
+	if (_backend->isVideoRunning()) {
+		throw StateException("Cannot change the frame queue while video is running");
+	}
+	_frameRing.reset(new RingBuffer<QueuedFrame>(depth, policy));
+}
+
+unsigned long long
+PiEyeImpl::getDroppedFrames() const {
+	return _frameRing->getDropped();
+}
+
+CaptureStats
+PiEyeImpl::getStats() const {
+	CaptureStats stats = _stats.getStats();
+	stats.poolStarvations = _backend->getPoolStarvations() - _poolStarvationBase;
+	stats.waitTimeouts = getWaitTimeOuts() - _waitTimeOutBase;
+	return stats;
+}
+
+void
+PiEyeImpl::resetStats() {
+	_stats.reset();
+	_poolStarvationBase = _backend->getPoolStarvations();
+	_waitTimeOutBase = getWaitTimeOuts();
+}
+
+void
+PiEyeImpl::setFrameDivisor(unsigned int divisor) {
+	if (_backend->isVideoRunning()) {
+		throw StateException("Cannot change the frame divisor while video is running");
+	} else if (divisor != 1 && divisor != 2 && divisor != 4) {
+		throw PiEyeException("Frame divisor must be 1, 2 or 4");
+	}
+	_frameDivisor = divisor;
+}
+
+void
+PiEyeImpl::setDecodeWorkers(unsigned int workers) {
+	setDecodePool(std::shared_ptr<DecodePool>(workers > 0 ? new DecodePool(workers) : nullptr));
+}
+
+unsigned int
+PiEyeImpl::getDecodeWorkers() const {
+	return _decodePool ? _decodePool->getWorkers() : 0;
+}
+
+void
+PiEyeImpl::setDecodePool(const std::shared_ptr<DecodePool>& pool) {
+	if (_backend->isVideoRunning()) {
+		throw StateException("Cannot change the decode workers while video is running");
+	}
+	_decodePool = pool;
+}
+
+void
+PiEyeImpl::grabFramePyramid(std::vector<cv::Mat>& levels, unsigned int levelCount) {
+	if (!FrameDecoder::CanDownscale(_encoding)) {
+		throw StateException("Frames can't be decoded into a pyramid with this encoding");
+	} else if (levelCount == 0) {
+		throw PiEyeException("A pyramid needs at least one level");
+	}
+	EZLOG_TRACE("Grabbing a frame pyramid");
+	
+	// Filled in by the callback
+	levels.clear();
+	{
+		std::lock_guard<std::mutex> lock(_pyramidMutex);
+		_pyramidRequests[&levels] = levelCount;
+	}
+	
+	try {
+		_videoWait.wait(30, [&]() {
+			std::lock_guard<std::mutex> lock(_pyramidMutex);
+			return !levels.empty();
+		});
+	} catch (...) {
+		std::lock_guard<std::mutex> lock(_pyramidMutex);
+		_pyramidRequests.erase(&levels);
+		throw;
+	}
+	
+	std::lock_guard<std::mutex> lock(_pyramidMutex);
+	_pyramidRequests.erase(&levels);
+	EZLOG_TRACE("Grabbed a frame pyramid");
+}
+
+FrameLease
+PiEyeImpl::grabFrameLease() {
+	if (!FrameDecoder::CanLease(_encoding)) {
+		throw StateException("Frames can't be leased with this encoding");
+	}
+	EZLOG_TRACE("Grabbing a frame lease");
+	FrameLease lease;
+	{
+		std::lock_guard<std::mutex> lock(_leaseMutex);
+		_leaseRequests.insert(&lease);
+	}
+	
+	// Frames that could not be leased wake the wait as well, so it only ends once the lease was filled in. Throws a
+	// TimeOutException if none was.
+	try {
+		_videoWait.wait(30, [&]() {
+			std::lock_guard<std::mutex> lock(_leaseMutex);
+			return lease.isValid();
+		});
+	} catch (...) {
+		std::lock_guard<std::mutex> lock(_leaseMutex);
+		_leaseRequests.erase(&lease);
+		throw;
+	}
+	
+	std::lock_guard<std::mutex> lock(_leaseMutex);
+	_leaseRequests.erase(&lease);
+	EZLOG_TRACE("Grabbed a frame lease");
+	return lease;
+}
+
+std::future<cv::Mat>
+PiEyeImpl::grabFrameAsync() {
+	if (!_backend->isVideoRunning()) {
+		throw StateException("Cannot grab a frame before video was started");
+	}
+	return _framePromises->add();
+}
+
+unsigned int
+PiEyeImpl::subscribe(const std::function<void(const cv::Mat&)>& handler, const SubscriberPolicy& policy,
+		unsigned int queueDepth, unsigned int decimation) {
+	const std::shared_ptr<Subscriber> subscriber(new Subscriber(handler, policy, queueDepth, decimation));
+	std::lock_guard<std::mutex> lock(_subscriberMutex);
+	const unsigned int id = _nextSubscriber++;
+	_subscribers[id] = subscriber;
+	EZLOG_DEBUG("Added subscriber [" << id << "]");
+	return id;
+}
+
+void
+PiEyeImpl::unsubscribe(unsigned int id) {
+	std::shared_ptr<Subscriber> subscriber;
+	{
+		std::lock_guard<std::mutex> lock(_subscriberMutex);
+		const std::map<unsigned int, std::shared_ptr<Subscriber> >::iterator it = _subscribers.find(id);
+		if (it == _subscribers.end()) {
+			throw PiEyeException("Unknown subscriber [" + std::to_string(id) + "]");
+		}
+		subscriber = it->second;
+		_subscribers.erase(it);
+	}
+	
+	// Waits for the handler to finish, so never while holding the lock. A frame in flight may still hold the
+	// subscriber, but a closed one takes no more frames.
+	subscriber->close();
+	subscriber.reset();
+	EZLOG_DEBUG("Removed subscriber [" << id << "]");
+}
+
+void
+PiEyeImpl::setFrameTap(const FrameTap& tap) {
+	std::lock_guard<std::mutex> lock(_frameTapMutex);
+	_frameTap = tap;
+}
+
+SubscriberStats
+PiEyeImpl::getSubscriberStats(unsigned int id) const {
+	std::lock_guard<std::mutex> lock(_subscriberMutex);
+	const std::map<unsigned int, std::shared_ptr<Subscriber> >::const_iterator it = _subscribers.find(id);
+	if (it == _subscribers.end()) {
+		throw PiEyeException("Unknown subscriber [" + std::to_string(id) + "]");
+	}
+	return it->second->getStats();
+}
+
+unsigned int
+PiEyeImpl::addStream(unsigned short width, unsigned short height, const Encoding& encoding) {
+	if (_backend->isVideoRunning()) {
+		throw StateException("Cannot add a stream while video is running");
+	} else if (_streamFormats.size() >= PIEYE_MAX_STREAMS) {
+		throw PiEyeException("At most [" + std::to_string(PIEYE_MAX_STREAMS) + "] streams are supported");
+	} else if (width == 0 || height == 0 || width % 2 != 0 || height % 2 != 0) {
+		throw PiEyeException("Stream size must be even, got [" + std::to_string(width) + "x" + std::to_string(height) + "]");
+	}
+	
+	const StreamFormat format = {width, height, encoding};
+	_streamFormats.push_back(format);
+	_streamRings.push_back(std::shared_ptr<RingBuffer<cv::Mat> >(new RingBuffer<cv::Mat>(1, QueuePolicy::OVERWRITE_OLDEST)));
+	EZLOG_DEBUG("Added stream [" << _streamFormats.size() - 1 << "] of [" << width << "x" << height << "]");
+	return _streamFormats.size() - 1;
+}
+
+void
+PiEyeImpl::clearStreams() {
+	if (_backend->isVideoRunning()) {
+		throw StateException("Cannot remove streams while video is running");
+	}
+	_streamFormats.clear();
+	_streamRings.clear();
+}
+
+void
+PiEyeImpl::grabStreamFrame(unsigned int stream, cv::Mat& data) {
+	if (!_backend->isVideoRunning()) {
+		throw StateException("Cannot grab a frame before video was started");
+	} else if (stream >= _streamRings.size()) {
+		throw PiEyeException("Unknown stream [" + std::to_string(stream) + "]");
+	}
+	
+	RingBuffer<cv::Mat>& streamRing = *_streamRings[stream];
+	_streamWait.wait(30, [&streamRing, &data]() {
+		return streamRing.pop(data);
+	});
+}
+
+void
+PiEyeImpl::startRecording(const EncoderSettings& settings, const EncodedHandler& handler) {
+	// May restart video, so not while its format changes
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	_backend->startEncoder(settings, handler);
+	EZLOG_DEBUG("Recording at [" << settings.bitrate << "] bit/s");
+}
+
+void
+PiEyeImpl::startRecording(const EncoderSettings& settings, const std::string& path) {
+	// Shared with the handler, the file closes when the encoder lets go of it
+	const std::shared_ptr<std::ofstream> file(new std::ofstream(path.c_str(), std::ios::binary | std::ios::trunc));
+	if (!file->is_open()) {
+		throw PiEyeException("Unable to open [" + path + "] for recording");
+	}
+	startRecording(settings, [file](const EncodedChunk& chunk) {
+		file->write((const char*) chunk.data, chunk.length);
+	});
+}
+
+void
+PiEyeImpl::stopRecording() {
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	_backend->stopEncoder();
+}
+
+bool
+PiEyeImpl::isRecording() const {
+	return _backend->isEncoding();
+}
+
+void
+PiEyeImpl::startEventRecording(const EncoderSettings& settings, float preRollSeconds, size_t memoryBytes) {
+	std::lock_guard<std::mutex> lock(_eventMutex);
+	if (_eventRecorder) {
+		throw StateException("Event recording is already running");
+	}
+	const std::shared_ptr<EventRecorder> recorder(new EventRecorder(preRollSeconds, memoryBytes));
+	startRecording(settings, [recorder](const EncodedChunk& chunk) {
+		recorder->push(chunk);
+	});
+	_eventRecorder = recorder;
+}
+
+bool
+PiEyeImpl::triggerEvent(const std::string& path, float postRollSeconds) {
+	const std::shared_ptr<EventRecorder> recorder = getEventRecorder();
+	if (!recorder) {
+		throw StateException("Event recording must be started first");
+	}
+	return recorder->trigger(path, postRollSeconds);
+}
+
+EventRecordingStats
+PiEyeImpl::getEventRecordingStats() const {
+	const std::shared_ptr<EventRecorder> recorder = getEventRecorder();
+	if (!recorder) {
+		return EventRecordingStats();
+	}
+	return recorder->getStats();
+}
+
+void
+PiEyeImpl::stopEventRecording() {
+	std::shared_ptr<EventRecorder> recorder;
+	{
+		std::lock_guard<std::mutex> lock(_eventMutex);
+		recorder.swap(_eventRecorder);
+		if (!recorder) {
+			return;
+		}
+		stopRecording();
+	}
+	
+	// The file being written keeps the recorder busy for its post-roll, no reason to hold up the others meanwhile
+	recorder->finish();
+}
+
+std::shared_ptr<EventRecorder>
+PiEyeImpl::getEventRecorder() const {
+	std::lock_guard<std::mutex> lock(_eventMutex);
+	return _eventRecorder;
+}
+
+void
+PiEyeImpl::startMotionDetection(const MotionSettings& settings, const MotionHandler& handler) {
+	if (!handler) {
+		throw PiEyeException("Motion detection needs a handler");
+	}
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	const MotionSettings previous = _motionSettings;
+	_motionSettings = settings;
+	std::unique_ptr<MotionDetector> motionDetector;
+	try {
+		if (_encoding == Encoding::NATIVE_BGR) {
+			throw PiEyeException("Motion detection needs an I420 encoding");
+		}
+		const unsigned int stride = FrameDecoder(_encoding, _videoWidth, _videoHeight).getStride();
+		motionDetector.reset(new MotionDetector(settings, _videoWidth, _videoHeight, stride));
+	} catch (const PiEyeException&) {
+		_motionSettings = previous;
+		throw;
+	}
+	std::lock_guard<std::mutex> motionLock(_motionMutex);
+	_motionDetector.swap(motionDetector);
+	_motionHandler = handler;
+}
+
+void
+PiEyeImpl::stopMotionDetection() {
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	std::lock_guard<std::mutex> motionLock(_motionMutex);
+	_motionDetector.reset();
+	_motionHandler = MotionHandler();
+}
+
+bool
+PiEyeImpl::isDetectingMotion() const {
+	std::lock_guard<std::mutex> lock(_motionMutex);
+	return static_cast<bool>(_motionDetector);
+}
+
+void
+PiEyeImpl::startFrameStatistics(const StatisticsSettings& settings) {
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	std::unique_ptr<FrameStatistician> statistician(new FrameStatistician(settings, _videoWidth, _videoHeight));
+	_statisticsSettings = settings;
+	std::lock_guard<std::mutex> statisticsLock(_statisticsMutex);
+	_statistician.swap(statistician);
+}
+
+void
+PiEyeImpl::stopFrameStatistics() {
+	if (isAutoExposing()) {
+		throw StateException("Auto-exposure runs on the frame statistics, stop it first");
+	}
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	{
+		std::lock_guard<std::mutex> statisticsLock(_statisticsMutex);
+		_statistician.reset();
+	}
+	std::lock_guard<std::mutex> lastLock(_lastStatisticsMutex);
+	_lastStatistics.reset();
+}
+
+bool
+PiEyeImpl::getFrameStatistics(FrameStatistics& statistics) const {
+	std::lock_guard<std::mutex> lock(_lastStatisticsMutex);
+	if (!_lastStatistics) {
+		return false;
+	}
+	statistics = *_lastStatistics;
+	return true;
+}
+
+bool
+PiEyeImpl::hasStatistician() const {
+	std::lock_guard<std::mutex> lock(_statisticsMutex);
+	return static_cast<bool>(_statistician);
+}
+
+void
+PiEyeImpl::startAutoExposure(const ExposureTarget& target, const ExposureModel& model) {
+	std::unique_ptr<ExposureController> controller(new ExposureController(target, model, [this](const FrameSettings& settings) {
+		applySettings(settings);
+	}));
+	
+	// Started before taking the exposure mutex, as starting them takes the still mutex
+	bool exposureStatistics = false;
+	if (!hasStatistician()) {
+		const StatisticsSettings settings = {0, 0, PIEYE_EXPOSURE_ROW_STEP, 0, 0};
+		startFrameStatistics(settings);
+		exposureStatistics = true;
+	}
+	std::lock_guard<std::mutex> lock(_exposureMutex);
+	_exposureStatistics = _exposureStatistics || exposureStatistics;
+	_exposureController.swap(controller);
+}
+
+void
+PiEyeImpl::stopAutoExposure() {
+	std::unique_ptr<ExposureController> controller;
+	bool exposureStatistics;
+	{
+		std::lock_guard<std::mutex> lock(_exposureMutex);
+		controller.swap(_exposureController);
+		exposureStatistics = _exposureStatistics;
+		_exposureStatistics = false;
+	}
+	
+	// Joins the controller thread, which may be setting the camera
+	controller.reset();
+	if (exposureStatistics) {
+		stopFrameStatistics();
+	}
+}
+
+bool
+PiEyeImpl::isAutoExposing() const {
+	std::lock_guard<std::mutex> lock(_exposureMutex);
+	return static_cast<bool>(_exposureController);
+}
+
+ExposureStats
+PiEyeImpl::getExposureStats() const {
+	std::lock_guard<std::mutex> lock(_exposureMutex);
+	return _exposureController ? _exposureController->getStats() : ExposureStats();
+}
+
+ExposureModel
+PiEyeImpl::learnExposureModel(const std::vector<FrameSettings>& brackets) {
+	std::vector<cv::Mat> frames;
+	std::vector<FrameSettings> settings;
+	grabBracket(brackets, frames, settings);
+	
+	// Mean luminance of every frame, measured as the frame statistics would. Frames with clipped highlights or shadows
+	// no longer grow with the exposure and are left out.
+	const StatisticsSettings statisticsSettings = {0, 0, PIEYE_EXPOSURE_ROW_STEP, 0, 0};
+	std::vector<FrameSettings> unclipped;
+	std::vector<float> intensities;
+	for (size_t i = 0; i < frames.size(); ++i) {
+		const cv::Mat& frame = frames[i];
+		FrameStatistician statistician(statisticsSettings, frame.cols, frame.rows);
+		statistician.begin();
+		for (int y = 0; y < frame.rows; ++y) {
+			if (!statistician.isSampled(y)) {
+				continue;
+			} else if (frame.channels() == 1) {
+				statistician.addLumaRow(frame.ptr<uint8_t>(y), y);
+			} else {
+				statistician.addBgrRow(frame.ptr<uint8_t>(y), y);
+			}
+		}
+		FrameStatistics statistics;
+		statistician.finish(0, statistics);
+		if (statistics.frame.darkFraction <= PIEYE_MODEL_CLIPPED_FRACTION && statistics.frame.brightFraction <= PIEYE_MODEL_CLIPPED_FRACTION) {
+			unclipped.push_back(settings[i]);
+			intensities.push_back(statistics.frame.mean);
+		}
+	}
+	return ExposureController::FitModel(unclipped, intensities);
+}
+
+std::unique_ptr<FrameStatistician>
+PiEyeImpl::createStatistician(unsigned short width, unsigned short height) const {
+	if (!_statistician) {
+		return std::unique_ptr<FrameStatistician>();
+	}
+	return std::unique_ptr<FrameStatistician>(new FrameStatistician(_statisticsSettings, width, height));
+}
+
+std::shared_ptr<const FrameStatistics>
+PiEyeImpl::publishStatistics(const FrameStatistician& statistician, long long pts) {
+	const std::shared_ptr<FrameStatistics> statistics(new FrameStatistics());
+	statistician.finish(pts, *statistics);
+	std::lock_guard<std::mutex> lock(_lastStatisticsMutex);
+	_lastStatistics = statistics;
+	return statistics;
+}
+
+std::unique_ptr<MotionDetector>
+PiEyeImpl::createMotionDetector(unsigned short width, unsigned short height, const Encoding& encoding) const {
+	if (!_motionDetector) {
+		return std::unique_ptr<MotionDetector>();
+	} else if (encoding == Encoding::NATIVE_BGR) {
+		throw PiEyeException("Motion detection needs an I420 encoding, stop it before switching to BGR");
+	}
+	const unsigned int stride = FrameDecoder(encoding, width, height).getStride();
+	return std::unique_ptr<MotionDetector>(new MotionDetector(_motionSettings, width, height, stride));
+}
+
+void
+PiEyeImpl::detectMotion(const MMAL_BUFFER_HEADER_T& buffer) {
+	MotionEvent event;
+	cv::Mat mask;
+	MotionHandler handler;
+	{
+		std::lock_guard<std::mutex> lock(_motionMutex);
+		if (!_motionDetector) {
+			return;
+		}
+		try {
+			const long long start = CaptureStatsRecorder::Now();
+			const bool moved = _motionDetector->process(buffer.data + buffer.offset, buffer.length, buffer.pts, event);
+			_stats.recordMotion(CaptureStatsRecorder::Now() - start);
+			if (!moved) {
+				return;
+			}
+		} catch (const PiEyeException& e) {
+			EZLOG_WARN("Error occurred, skipping motion detection of a frame: " << e.what());
+			return;
+		}
+		
+		// The mask is shared, not copied: only the next frame on this thread writes it again, and a detector swapped
+		// meanwhile leaves it to this reference
+		mask = _motionDetector->getMask();
+		handler = _motionHandler;
+	}
+	
+	// Called outside the lock, so a slow handler does not hold up starting or stopping motion detection
+	handler(event, mask);
+}
+
 void
 PiEyeImpl::grabStill(cv::Mat& data) {
 	EZLOG_DEBUG("Grabbing still");
+	std::lock_guard<std::mutex> lock(_stillMutex);
 	
-	// Check if camera is opened and still port is available
-    if (_camera == nullptr) {
+	// Check if camera is opened
+    if (!_backend->isCreated()) {
         throw StateException("Cannot take still before camera was created");
-    } else if (_camera->output_num <= PIEYE_PORT_STILL || _camera->output[PIEYE_PORT_STILL] == nullptr) {
-        throw PiEyeException("Still port is not available");
     }
     
     try {
 		initStill();
-		_stillRequest = &data;
-        
-        // Go!
-		EZLOG_TRACE("Enabling capture parameter on still port");
-        setParameter(_stillPort, MMAL_PARAMETER_CAPTURE, true);
-		
-        // Wait...
-		EZLOG_TRACE("Waiting for the callback...");
-		_stillWait.wait(5);
+		captureStill(data);
 		EZLOG_TRACE("Grabbed a still");
-		_stillRequest = nullptr;
         
     } catch (...) {
 		EZLOG_ERROR("Something went wrong while taking still");
+		_stillRequest = nullptr;
         closeStill();
         throw;
     }
 }
 
+void
+PiEyeImpl::grabStillBurst(std::vector<cv::Mat>& stills, unsigned int count, unsigned int intervalMillis) {
+	EZLOG_DEBUG("Grabbing a burst of [" << count << "] stills");
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	if (!_backend->isCreated()) {
+		throw StateException("Cannot take stills before camera was created");
+	} else if (count == 0) {
+		throw PiEyeException("A burst needs at least one still");
+	}
+	
+	try {
+		initStill();
+		
+		// Stills are decoded straight into these, so a vector reused between bursts is never reallocated
+		stills.resize(count);
+		for (std::vector<cv::Mat>::iterator it = stills.begin(); it != stills.end(); ++it) {
+			it->create(_stillHeight, _stillWidth, _stillDecoder.getImageType());
+		}
+		
+		{
+			std::lock_guard<std::mutex> burstLock(_burstMutex);
+			_burstStills = &stills;
+			_burstTaken = 0;
+			_burstIntervalMillis = intervalMillis;
+			_burstDue = 0;
+		}
+		
+		// One capture start for the whole burst, the camera then keeps delivering stills until it is stopped
+		_backend->startStillCapture();
+		// A long burst would overflow the seconds of the wait, at worst it waits for some 18 hours
+		const unsigned long long timeout = std::min<unsigned long long>(5 + (unsigned long long) count * intervalMillis / 1000,
+				std::numeric_limits<unsigned short>::max());
+		_stillWait.wait((unsigned short) timeout, [this, count]() {
+			return _burstTaken.load() == count;
+		});
+		_backend->stopStillCapture();
+		endBurst();
+		EZLOG_DEBUG("Grabbed a burst of [" << count << "] stills");
+		
+	} catch (...) {
+		EZLOG_ERROR("Something went wrong while taking a burst of stills");
+		try {
+			_backend->stopStillCapture();
+		} catch (const std::exception& e) {
+			EZLOG_ERROR("Unable to stop still capture: " << e.what());
+		}
+		endBurst();
+		closeStill();
+		throw;
+	}
+}
+
+void
+PiEyeImpl::grabStillWithSettings(cv::Mat& data, FrameSettings& settings) {
+	EZLOG_DEBUG("Waiting for the requested settings before grabbing a still");
+	const FrameSettings requested = getRequestedSettings();
+	_settingsWait.wait(PIEYE_SETTINGS_TIMEOUT, [this, &requested]() {
+		std::lock_guard<std::mutex> lock(_settingsMutex);
+		return Reflects(_reportedSettings, requested);
+	});
+	grabStill(data);
+	
+	std::lock_guard<std::mutex> lock(_settingsMutex);
+	settings = _stillSettings;
+}
+
+std::future<cv::Mat>
+PiEyeImpl::grabStillAsync() {
+	// Captures are triggered one at a time, so the trigger and wait run on their own thread
+	return std::async(std::launch::async, [this]() {
+		cv::Mat still;
+		grabStill(still);
+		return still;
+	});
+}
+
+FrameSettings
+PiEyeImpl::getFrameSettings() const {
+	std::lock_guard<std::mutex> lock(_settingsMutex);
+	return _reportedSettings;
+}
+
 void
 PiEyeImpl::setSensorMode(const SensorMode mode) {
-    requireCamera();
-    setParameter(_camera->control, MMAL_PARAMETER_CAMERA_CUSTOM_SENSOR_CONFIG, (unsigned int) mode);
+	if (!_backend->isVideoRunning()) {
+		_backend->setSensorMode(mode);
+		return;
+	}
+	
+	// The camera only switches modes when the video port is enabled
+	const CaptureFormat format = {_encoding, _videoWidth, _videoHeight, _fps};
+	_backend->reconfigureVideo(format, [this, mode]() {
+		_backend->setSensorMode(mode);
+		_stats.reconfigureVideo();
+	});
 }
 
 void
 PiEyeImpl::setEncoding(const Encoding& encoding) {
-	_encoding = encoding;
+	std::lock_guard<std::mutex> lock(_stillMutex);
+	changeStillFormat(_stillWidth, _stillHeight, encoding);
+	changeVideoFormat(_videoWidth, _videoHeight, encoding, _fps);
 }
 
 const Encoding&
@@ -301,383 +1153,401 @@ PiEyeImpl::getEncoding() const {
 
 void
 PiEyeImpl::setShutterSpeed(unsigned short millis) {
-    requireCamera();
     const unsigned int micros = 1000 * millis;
-    setParameter(_camera->control, MMAL_PARAMETER_SHUTTER_SPEED, micros);
+    _backend->setShutterSpeed(micros);
+    requestSettings([micros](FrameSettings& settings) {
+		settings.exposureMicros = micros;
+	});
 }
 
 void
 PiEyeImpl::setIso(unsigned short iso) {
-    requireCamera();
-    setParameter(_camera->control, MMAL_PARAMETER_ISO, (unsigned int) iso);
+    _backend->setIso(iso);
 }
 
 void
 PiEyeImpl::setAnalogGain(float gain) {
-    requireCamera();
-    setParameter(_camera->control, MMAL_PARAMETER_ANALOG_GAIN, gain);
+    _backend->setAnalogGain(gain);
+    requestSettings([gain](FrameSettings& settings) {
+		settings.analogGain = gain;
+	});
 }
 
 void
 PiEyeImpl::setDigitalGain(float gain) {
-    requireCamera();
-    setParameter(_camera->control, MMAL_PARAMETER_DIGITAL_GAIN, gain);
+    _backend->setDigitalGain(gain);
+    requestSettings([gain](FrameSettings& settings) {
+		settings.digitalGain = gain;
+	});
 }
 
 void
 PiEyeImpl::setWhiteBalanceMode(const AwbMode& mode) {
-	requireCamera();
-	MMAL_PARAM_AWBMODE_T awbMode = MMAL_PARAM_AWBMODE_AUTO;
-	switch (mode) {
-		case AwbMode::OFF:
-			awbMode = MMAL_PARAM_AWBMODE_OFF;
-			break;
-		case AwbMode::AUTO:
-			awbMode = MMAL_PARAM_AWBMODE_AUTO;
-			break;
-		case AwbMode::SUNLIGHT:
-			awbMode = MMAL_PARAM_AWBMODE_SUNLIGHT;
-			break;
-		case AwbMode::CLOUDY:
-			awbMode = MMAL_PARAM_AWBMODE_CLOUDY;
-			break;
-		case AwbMode::SHADE:
-			awbMode = MMAL_PARAM_AWBMODE_SHADE;
-			break;
-		case AwbMode::TUNGSTEN:
-			awbMode = MMAL_PARAM_AWBMODE_TUNGSTEN;
-			break;
-		case AwbMode::FLUORESCENT:
-			awbMode = MMAL_PARAM_AWBMODE_FLUORESCENT;
-			break;
-		case AwbMode::INCANDESCENT:
-			awbMode = MMAL_PARAM_AWBMODE_INCANDESCENT;
-			break;
-		case AwbMode::FLASH:
-			awbMode = MMAL_PARAM_AWBMODE_FLASH;
-			break;
-		case AwbMode::HORIZON:
-			awbMode = MMAL_PARAM_AWBMODE_HORIZON;
-			break;
+	_backend->setWhiteBalanceMode(mode);
+	if (mode != AwbMode::OFF) {
+		requestSettings([](FrameSettings& settings) {
+			settings.redGain = 0;
+			settings.blueGain = 0;
+		});
 	}
-	
-	const MMAL_PARAMETER_AWBMODE_T param = {{MMAL_PARAMETER_AWB_MODE, sizeof(param)}, awbMode};
-	const MMAL_STATUS_T status = mmal_port_parameter_set(_camera->control, &param.hdr);
-	CheckStatus(status, "Unable to set AWB mode");
 }
 
 void
 PiEyeImpl::setWhiteBalanceGain(float redGain, float blueGain) {
-    requireCamera();
-    const MMAL_PARAMETER_AWB_GAINS_T param = {{MMAL_PARAMETER_CUSTOM_AWB_GAINS,sizeof(param)},
-        ToRational(redGain), ToRational(blueGain)};
-    const MMAL_STATUS_T status = mmal_port_parameter_set(_camera->control, &param.hdr);
-    CheckStatus(status, "Unable to set gains for AWB");
+    _backend->setWhiteBalanceGain(redGain, blueGain);
+    requestSettings([redGain, blueGain](FrameSettings& settings) {
+		settings.redGain = redGain;
+		settings.blueGain = blueGain;
+	});
 }
 
 void
 PiEyeImpl::setFpsRange(float minFps, float maxFps) {
-    requireCamera();
-    const MMAL_PARAMETER_FPS_RANGE_T fpsRange = {{MMAL_PARAMETER_FPS_RANGE, sizeof(fpsRange)},
-        ToRational(minFps), ToRational(maxFps)};
-    MMAL_STATUS_T status = mmal_port_parameter_set(_camera->output[0], &fpsRange.hdr); // TODO: Use preview port instead of 0
-    CheckStatus(status, "Unable to set FPS range on preview port");
-	
-	// TODO: Put this somewhere else, or will we always sync video and preview ports?
-	status = mmal_port_parameter_set(_videoPort, &fpsRange.hdr);
-	CheckStatus(status, "Unable to set FPS range on video port");
-}
-
-
-void
-PiEyeImpl::ControlCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer) {
-    if (buffer == nullptr) {
-        EZLOG_WARN("Got empty buffer from camera control");
-    } else if (buffer->cmd == MMAL_EVENT_PARAMETER_CHANGED) {
-        MMAL_EVENT_PARAMETER_CHANGED_T *param = (MMAL_EVENT_PARAMETER_CHANGED_T *)buffer->data;
-        if (param == nullptr) {
-            EZLOG_WARN("Got invalid parameter changed event from camera control");
-        } else if (param->hdr.id == MMAL_PARAMETER_CAMERA_SETTINGS) {
-            MMAL_PARAMETER_CAMERA_SETTINGS_T *settings = (MMAL_PARAMETER_CAMERA_SETTINGS_T*)param;
-            LogCameraSettings(*settings);
-        } else {
-            EZLOG_WARN("Received weird parameter update [" << param->hdr.id << "]");
-        }
-    } else {
-        EZLOG_WARN("Received unexpected camera control callback event [" << buffer->cmd << "]");
-    }
+    _backend->setFpsRange(minFps, maxFps);
+}
 
-    mmal_buffer_header_release(buffer);
-}
-
-void
-PiEyeImpl::BufferCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer) {
-    BufferLock bufferLock(buffer);
-    PiEyeImpl* instance = (PiEyeImpl*) port->userdata;
-    EZLOG_DEBUG("Encoder callback: [" << buffer->length << "] bytes");
-	MMAL_POOL_T* bufferPool = nullptr;
-    if (instance == nullptr) {
-        throw PiEyeException("Unable to determine PiEyeImpl instance in callback");
-    } else if (buffer == nullptr) {
-        throw PiEyeException("Received an invalid buffer");
-    } else if (port == instance->_videoPort){
-        instance->parseVideoBuffer(*buffer);
-		bufferPool = instance->_videoPool;
-    } else if (port == instance->_stillPort) {
-		instance->parseStillBuffer(*buffer);
-		bufferPool = instance->_stillPool;
-	} else {
-        EZLOG_WARN("Received a buffer from an unknown port");
+bool
+PiEyeImpl::parseVideoBuffer(MMAL_BUFFER_HEADER_T* buffer) {
+	// Skip empty buffer
+	const long long arrival = CaptureStatsRecorder::Now();
+	if (buffer->length == 0) {
+		EZLOG_DEBUG("Skipping empty buffer");
+		_stats.recordEmptyBuffer();
+		return false;
 	}
-    bufferLock.unlock();
+	_stats.recordArrival(arrival, buffer->pts);
+	const FrameSettings settings = getFrameSettings();
 	
-	// Only release buffer back to pool if it came from one of our pools
-	if (bufferPool) {
-		mmal_buffer_header_release(buffer);
-		
-		// Re-inject buffer
-		if (port->is_enabled) {
-			EZLOG_TRACE("Re-injecting a buffer");
-			MMAL_BUFFER_HEADER_T* nextBuffer = mmal_queue_get(bufferPool->queue);
-			if (nextBuffer) {
-				const MMAL_STATUS_T status = mmal_port_send_buffer(port, nextBuffer);
-				CheckStatus(status, "Unable to send buffer back to port");
+	// Frames taken before exposure and white balance settled are not worth decoding
+	if (_warmingUp && warmUp(settings)) {
+		return false;
+	}
+	
+	// With decode workers the callback only hands the buffer over, so the camera can fill the next one. The workers
+	// give it back once its frame was delivered.
+	if (_decodePool) {
+		const std::shared_ptr<BufferPool> videoPool = _backend->getVideoPool();
+		if (videoPool) {
+			_decodePool->submit(buffer, wantsFrames() ? &_videoDecoder : nullptr, videoPool,
+					[this, buffer, arrival, settings](const cv::Mat& frame, long long decodeNanos) {
+				return deliverVideoBuffer(buffer, arrival, settings, frame, decodeNanos);
+			});
+			return true;
+		}
+	}
+	return deliverVideoBuffer(buffer, arrival, settings, cv::Mat(), 0);
+}
+
+bool
+PiEyeImpl::deliverVideoBuffer(MMAL_BUFFER_HEADER_T* buffer, long long arrival, const FrameSettings& settings,
+		const cv::Mat& decoded, long long decodeNanos) {
+	// Motion is found on the Y plane right in the buffer, whether or not anybody decodes the frame
+	detectMotion(*buffer);
+	
+	// Queue a decoded copy once somebody consumes frames, and hand it to the oldest pending request, to every
+	// subscriber and to the tap of a rig. All of them share the one copy and none of them is waited for. Statistics
+	// come out of that decode, or out of a read of the buffer alone when nobody takes the frame or it was decoded by
+	// the decode pool. Subscribers are taken from a copy of the list, so subscribing never waits for a decode.
+	std::vector<std::shared_ptr<Subscriber> > subscribers;
+	{
+		std::lock_guard<std::mutex> lock(_subscriberMutex);
+		const std::map<unsigned int, std::shared_ptr<Subscriber> >::const_iterator subscriberEnd = _subscribers.end();
+		for (std::map<unsigned int, std::shared_ptr<Subscriber> >::const_iterator it = _subscribers.begin(); it != subscriberEnd; ++it) {
+			subscribers.push_back(it->second);
+		}
+	}
+	std::unique_lock<std::mutex> statisticsLock(_statisticsMutex);
+	FrameStatistician* const statistician = _statistician.get();
+	std::shared_ptr<const FrameStatistics> statistics;
+	const bool promised = _framePromises->hasPending();
+	if (_frameConsumer || promised || !subscribers.empty() || hasFrameTap()) {
+		try {
+			cv::Mat frame = decoded;
+			if (frame.empty()) {
+				const long long decodeStart = CaptureStatsRecorder::Now();
+				_videoDecoder.decode(*buffer, frame, statistician);
+				_stats.recordDecode(CaptureStatsRecorder::Now() - decodeStart);
 			} else {
-				EZLOG_WARN("Unable to get a new buffer from pool");
+				_stats.recordDecode(decodeNanos);
+				if (statistician != nullptr) {
+					_videoDecoder.measure(*buffer, *statistician);
+				}
+			}
+			if (statistician != nullptr) {
+				statistics = publishStatistics(*statistician, buffer->pts);
+			}
+			const QueuedFrame queued = {frame, arrival, settings, statistics};
+			if (_frameConsumer && !_frameRing->push(queued)) {
+				EZLOG_DEBUG("Frame queue is full, dropped a frame");
+			}
+			if (promised) {
+				_framePromises->fulfil(frame);
+			}
+			for (auto&& subscriber : subscribers) {
+				subscriber->offer(frame);
+			}
+			
+			// Held while the tap runs, so a tap that was replaced is never called again
+			{
+				std::lock_guard<std::mutex> tapLock(_frameTapMutex);
+				if (_frameTap) {
+					_frameTap(frame, buffer->pts, arrival);
+				}
+			}
+			_stats.recordDelivery(CaptureStatsRecorder::Now() - arrival);
+		} catch (const PiEyeException& e) {
+			EZLOG_WARN("Error occurred, skipping a frame: " << e.what());
+			if (promised) {
+				_framePromises->fail(std::current_exception());
+			}
+		}
+	}
+	if (statistician != nullptr && !statistics) {
+		try {
+			_videoDecoder.measure(*buffer, *statistician);
+			statistics = publishStatistics(*statistician, buffer->pts);
+		} catch (const PiEyeException& e) {
+			EZLOG_WARN("Error occurred, skipping statistics of a frame: " << e.what());
+		}
+	}
+	statisticsLock.unlock();
+	
+	// Auto-exposure takes the statistics on a thread of its own, the frame only replaces the one it has not taken yet
+	if (statistics) {
+		std::lock_guard<std::mutex> lock(_exposureMutex);
+		if (_exposureController) {
+			_exposureController->offer(statistics, settings, arrival);
+		}
+	}
+	
+	// Pyramid requests share the levels of one pyramid, as deep as the deepest request
+	{
+		std::lock_guard<std::mutex> lock(_pyramidMutex);
+		if (!_pyramidRequests.empty()) {
+			unsigned int levelCount = 0;
+			const std::map<std::vector<cv::Mat>*, unsigned int>::const_iterator pyramidEnd = _pyramidRequests.end();
+			for (std::map<std::vector<cv::Mat>*, unsigned int>::const_iterator it = _pyramidRequests.begin(); it != pyramidEnd; ++it) {
+				levelCount = std::max(levelCount, it->second);
+			}
+			try {
+				std::vector<cv::Mat> pyramid;
+				_videoDecoder.decodePyramid(*buffer, pyramid, levelCount);
+				for (std::map<std::vector<cv::Mat>*, unsigned int>::const_iterator it = _pyramidRequests.begin(); it != pyramidEnd; ++it) {
+					it->first->assign(pyramid.begin(), pyramid.begin() + it->second);
+				}
+			} catch (const PiEyeException& e) {
+				EZLOG_WARN("Error occurred, skipping pyramid requests: " << e.what());
+			}
+		}
+	}
+	
+	// All lease requests share a single lease on the buffer
+	bool leased = false;
+	{
+		std::lock_guard<std::mutex> lock(_leaseMutex);
+		const std::shared_ptr<BufferPool> videoPool = _leaseRequests.empty() ? std::shared_ptr<BufferPool>() : _backend->getVideoPool();
+		if (videoPool) {
+			try {
+				const FrameLease lease = _videoDecoder.lease(buffer, videoPool);
+				leased = true;
+				const std::set<FrameLease*>::const_iterator leaseEnd = _leaseRequests.end();
+				for (std::set<FrameLease*>::iterator it = _leaseRequests.begin(); it != leaseEnd; ++it) {
+					**it = lease;
+				}
+			} catch (const PiEyeException& e) {
+				EZLOG_WARN("Error occurred, skipping lease requests: " << e.what());
 			}
 		}
 	}
     
-	EZLOG_TRACE("BufferCallback completed");
+    _videoWait.notify();
+	return leased;
+}
+
+bool
+PiEyeImpl::wantsFrames() const {
+	{
+		std::lock_guard<std::mutex> lock(_subscriberMutex);
+		if (!_subscribers.empty()) {
+			return true;
+		}
+	}
+	return _frameConsumer || _framePromises->hasPending() || hasFrameTap();
+}
+
+bool
+PiEyeImpl::hasFrameTap() const {
+	std::lock_guard<std::mutex> lock(_frameTapMutex);
+	return (bool) _frameTap;
 }
 
 void
-PiEyeImpl::parseVideoBuffer(const MMAL_BUFFER_HEADER_T& buffer) {
-	// Skip empty buffer
-	if (buffer.length == 0) {
-		EZLOG_DEBUG("Skipping empty buffer");
-		return;
+PiEyeImpl::drainDecodes() {
+	if (_decodePool) {
+		_decodePool->drain();
 	}
-	
-    // Loop over target buffers:
-    const std::set<cv::Mat*>::const_iterator requestEnd = _frameRequests.end();
-    for (std::set<cv::Mat*>::iterator it = _frameRequests.begin(); it != requestEnd; ++it) {
-        if (*it != nullptr) {
-            try {
-				decodeBuffer(buffer, **it);
-            } catch (const PiEyeException& e) {
-                std::cout << "Error occurred, skipping a frame request: " << e.what() << std::endl;
-            }
-        }
-    }
-    
-    _videoWait.notify();
+}
+
+unsigned long long
+PiEyeImpl::getWaitTimeOuts() const {
+	return _videoWait.getTimeOuts() + _stillWait.getTimeOuts() + _streamWait.getTimeOuts() + _settingsWait.getTimeOuts();
+}
+
+void
+PiEyeImpl::parseSettings(const FrameSettings& settings) {
+	{
+		std::lock_guard<std::mutex> lock(_settingsMutex);
+		_reportedSettings = settings;
+	}
+	_settingsWait.notify();
+}
+
+void
+PiEyeImpl::requestSettings(const std::function<void(FrameSettings&)>& change) {
+	std::lock_guard<std::mutex> lock(_settingsMutex);
+	change(_requestedSettings);
+}
+
+FrameSettings
+PiEyeImpl::getRequestedSettings() const {
+	std::lock_guard<std::mutex> lock(_settingsMutex);
+	return _requestedSettings;
+}
+
+void
+PiEyeImpl::applySettings(const FrameSettings& settings) {
+	if (settings.exposureMicros > 0) {
+		_backend->setShutterSpeed(settings.exposureMicros);
+	}
+	if (settings.analogGain > 0) {
+		_backend->setAnalogGain(settings.analogGain);
+	}
+	if (settings.digitalGain > 0) {
+		_backend->setDigitalGain(settings.digitalGain);
+	}
+	if (settings.redGain > 0 && settings.blueGain > 0) {
+		_backend->setWhiteBalanceGain(settings.redGain, settings.blueGain);
+	}
+	requestSettings([&settings](FrameSettings& requested) {
+		requested.exposureMicros = settings.exposureMicros > 0 ? settings.exposureMicros : requested.exposureMicros;
+		requested.analogGain = settings.analogGain > 0 ? settings.analogGain : requested.analogGain;
+		requested.digitalGain = settings.digitalGain > 0 ? settings.digitalGain : requested.digitalGain;
+		if (settings.redGain > 0 && settings.blueGain > 0) {
+			requested.redGain = settings.redGain;
+			requested.blueGain = settings.blueGain;
+		}
+	});
 }
 
 void
 PiEyeImpl::parseStillBuffer(const MMAL_BUFFER_HEADER_T& buffer) {
 	// Skip empty buffer
+	cv::Mat* const request = _stillRequest.load();
 	if (buffer.length == 0) {
 		EZLOG_DEBUG("Skipping empty buffer");
 		return;
 		
-	// Only if pending request
-	} else if (_stillRequest == nullptr) {
-        EZLOG_WARN("Cannot parse still buffer as there is no target to store it");
+	// Stills of a burst keep coming until the burst stops the capture
+	} else if (parseBurstStill(buffer)) {
 		return;
+		
+	// Only if pending request, stills that come in while the capture stops are expected
+	} else if (request == nullptr) {
+        EZLOG_DEBUG("Skipping still buffer as there is no target to store it");
+		return;
+	}
+	_stillDecoder.decode(buffer, *request);
+	{
+		std::lock_guard<std::mutex> lock(_settingsMutex);
+		_stillSettings = _reportedSettings;
 	}
-	decodeBuffer(buffer, *_stillRequest);
 	
 	EZLOG_TRACE("Notifying still waits");
+	_stillRequest = nullptr;
 	_stillWait.notify();
 }
 
 void
-PiEyeImpl::setCameraConfig() {
-    if (_camera == nullptr) {
-        throw PiEyeException("Tried to set camera config while camera is not loaded yet");
-    }
-    MMAL_PARAMETER_CAMERA_CONFIG_T config = {{MMAL_PARAMETER_CAMERA_CONFIG, sizeof(config)}};
-    config.max_stills_w = _width;
-    config.max_stills_h = _height;
-    config.stills_yuv422 = 0;
-    config.one_shot_stills = 1;
-    config.max_preview_video_w = _width;
-    config.max_preview_video_h = _height;
-    config.num_preview_video_frames = _previewFrames;
-    config.stills_capture_circular_buffer_height = 0;
-    config.fast_preview_resume = 0;
-    //config.use_stc_timestamp = MMAL_PARAM_TIMESTAMP_MODE_RAW_STC;
-    config.use_stc_timestamp = MMAL_PARAM_TIMESTAMP_MODE_RESET_STC;
-    const MMAL_STATUS_T status = mmal_port_parameter_set(_camera->control, &config.hdr);
-    CheckStatus(status, "Unable to set camera configuration");
-}
-
-void
-PiEyeImpl::setFormat(MMAL_PORT_T& port, unsigned short fps) {
-    // Get format from port
-    if (port.format == nullptr) {
-        throw PiEyeException("Format for a port not available");
-    }
-    MMAL_ES_FORMAT_T& format = *port.format;
-    
-    // Fill details
-	format.encoding = GetMmalEncoding(_encoding);
-    format.encoding_variant = GetMmalEncoding(_encoding);
-    format.es->video.width = _width;
-    format.es->video.height = _height;
-    format.es->video.crop.x = 0;
-    format.es->video.crop.y = 0;
-    format.es->video.crop.width = _width;
-    format.es->video.crop.height = _height;
-    format.es->video.frame_rate.num = fps;
-    format.es->video.frame_rate.den = 1;
-    
-    // Set
-    const MMAL_STATUS_T status = mmal_port_format_commit(&port);
-    CheckStatus(status, "Unable to set format for preview port");
-}
-
-void
-PiEyeImpl::setParameter(MMAL_PORT_T* port, unsigned int parameter, bool value) {
-    if (port == nullptr) {
-        throw PiEyeException("Cannot set boolean parameter on a NULL port");
-    } else {
-		EZLOG_DEBUG("Setting parameter [" << ParameterToString(parameter) << "] to [" << value << "]");
-        const MMAL_STATUS_T status = mmal_port_parameter_set_boolean(port, parameter, value);
-        CheckStatus(status, "Unable to set boolean parameter [" + ParameterToString(parameter) + "] to [" + std::to_string(value) + "]");
-    }
-}
-
-void
-PiEyeImpl::setParameter(MMAL_PORT_T* port, unsigned int parameter, unsigned int value) {
-    if (port == nullptr) {
-        throw PiEyeException("Cannot set unsigned int parameter on a NULL port");
-    } else {
-		EZLOG_DEBUG("Setting parameter [" << ParameterToString(parameter) << "] to [" << value << "]");
-        const MMAL_STATUS_T status = mmal_port_parameter_set_uint32(port, parameter, value);
-        CheckStatus(status, "Unable to set unsigned int parameter [" + ParameterToString(parameter) + "] to [" + std::to_string(value) + "]");
-    }
+PiEyeImpl::parseStreamFrame(unsigned int stream, const cv::Mat& frame) {
+	// Always the latest frame, each stream has its own callback thread to fill it
+	_streamRings[stream]->push(frame);
+	_streamWait.notify();
 }
 
-void
-PiEyeImpl::setParameter(MMAL_PORT_T* port, unsigned int parameter, float value) {
-    if (port == nullptr) {
-        throw PiEyeException("Cannot set rational parameter on a NULL port");
-    } else {
-		EZLOG_DEBUG("Setting parameter [" << ParameterToString(parameter) << "] to [" << value << "]");
-        const MMAL_STATUS_T status = mmal_port_parameter_set_rational(port, parameter, ToRational(value));
-        CheckStatus(status, "Unable to set rational parameter [" + ParameterToString(parameter) + "] to [" + std::to_string(value) + "]");
-    }
+bool
+PiEyeImpl::parseBurstStill(const MMAL_BUFFER_HEADER_T& buffer) {
+	bool complete;
+	{
+		std::lock_guard<std::mutex> lock(_burstMutex);
+		if (_burstStills == nullptr) {
+			return false;
+		}
+		const long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		const unsigned int taken = _burstTaken.load();
+		if (taken == _burstStills->size() || now < _burstDue) {
+			EZLOG_TRACE("Dropping a still of the burst that is not due");
+			return true;
+		}
+		_stillDecoder.decode(buffer, (*_burstStills)[taken]);
+		{
+			std::lock_guard<std::mutex> settingsLock(_settingsMutex);
+			_stillSettings = _reportedSettings;
+		}
+		
+		// Spaced from the one that was taken, so a late still pushes the rest of the burst back
+		_burstDue = now + _burstIntervalMillis * 1000000LL;
+		_burstTaken = taken + 1;
+		complete = taken + 1 == _burstStills->size();
+	}
+	
+	// Outside the burst mutex, the wait holds its own mutex while it checks the count
+	if (complete) {
+		EZLOG_TRACE("Notifying still waits");
+		_stillWait.notify();
+	}
+	return true;
 }
 
 void
-PiEyeImpl::requireCamera() {
-    if (_camera == nullptr) {
-        throw StateException("Camera must be created first");
-    } else if (_camera->control == nullptr) {
-        throw PiEyeException("Control port not available");
-    }
+PiEyeImpl::endBurst() {
+	std::lock_guard<std::mutex> lock(_burstMutex);
+	_burstStills = nullptr;
 }
 
 void
-PiEyeImpl::decodeBuffer(const MMAL_BUFFER_HEADER_T& buffer, cv::Mat& target) {
-	switch (_encoding) {
-		case Encoding::NATIVE_BGR:
-			target.create(_height, _width, CV_8UC3);
-			break;
-		case Encoding::NATIVE_GRAYSCALE:
-			target.create(_height, _width, CV_8UC1);
-			break;
-	}
+PiEyeImpl::captureStill(cv::Mat& data) {
+	_stillRequest = &data;
 	
-	unsigned long dataSize = target.total() * target.elemSize();
-	if (dataSize > buffer.length) {
-		throw PiEyeException("Buffer size [" + std::to_string(buffer.length) + "] too small for image size [" + std::to_string(dataSize) + "]");
-	} else if (target.isContinuous()) {
-		memcpy(target.ptr<uchar>(0), buffer.data + buffer.offset, dataSize);
-	} else {
-		// TODO: Implement row by row memcpy
-        EZLOG_WARN("Image not continuous, not even bothering");
-	}
+	// Go! Stills are not one-shot, so the capture stops again once the first one arrived
+	_backend->startStillCapture();
+	
+	// Wait...
+	EZLOG_TRACE("Waiting for the callback...");
+	_stillWait.wait(5, [this]() {
+		return _stillRequest.load() == nullptr;
+	});
+	_backend->stopStillCapture();
 }
 
 void
 PiEyeImpl::initStill() {
-	if (_stillPort != nullptr) {
+	if (_backend->isStillOpen()) {
 		EZLOG_TRACE("Still port already open");
 		return;
 	}
 	
 	EZLOG_DEBUG("Initializing still port");
-	requireCamera();
-	
-	// Configure
-	_stillPort = _camera->output[PIEYE_PORT_STILL];
-	_stillPort->userdata = (struct MMAL_PORT_USERDATA_T*) this;
-	setFormat(*_stillPort, 0);
-	//setFormat(*_camera->output[1], _fps); // TODO - should not be here
-	
-	// Make sure enough buffers are available
-	unsigned short minBufferCount = std::max(PIEYE_MIN_STILL_BUFFERS, _stillPort->buffer_num_recommended);
-	if (_stillPort->buffer_num < minBufferCount) {
-		_stillPort->buffer_num = minBufferCount;
-	}
-	
-	// Enable port
-	EZLOG_TRACE("Enabling still port");
-	MMAL_STATUS_T status = mmal_port_enable(_stillPort, BufferCallback);
-	CheckStatus(status, "Unable to enable still port");
-	
-	// Create buffer pool
-	EZLOG_TRACE("Creating still pool with [" << _stillPort->buffer_num << "] buffers of [" << _stillPort->buffer_size << "] bytes");
-	_stillPool = mmal_port_pool_create(_stillPort, _stillPort->buffer_num, _stillPort->buffer_size);
-	if (!_stillPool) {
-		throw PiEyeException("Unable to allocate still pool");
-	}
-    
-    // Inject all buffers
-    const int bufferCount = mmal_queue_length(_stillPool->queue);
-    EZLOG_TRACE("Injecting [" << bufferCount << "] buffers in still port");
-    for (int i = 0; i < bufferCount; ++i) {
-        MMAL_BUFFER_HEADER_T* buffer = mmal_queue_get(_stillPool->queue);
-
-        if (!buffer) {
-            throw PiEyeException("Unable to get buffer");
-        }
-        
-        status = mmal_port_send_buffer(_stillPort, buffer);
-        CheckStatus(status, "Unable to send a buffer to the still port");
-    }
+	_stillDecoder = FrameDecoder(_encoding, _stillWidth, _stillHeight);
+	const CaptureFormat format = {_encoding, _stillWidth, _stillHeight, 0};
+	_backend->openStill(format, [this](MMAL_BUFFER_HEADER_T* buffer) {
+		parseStillBuffer(*buffer);
+		return false;
+	});
 }
 
 void
 PiEyeImpl::closeStill() {
-    EZLOG_TRACE("CloseStill");
-	if (_stillPort == nullptr) {
-		EZLOG_TRACE("Still port already closed");
-	} else {
-		EZLOG_TRACE("Closing still port");
-		
-		// Set capture off:
-		EZLOG_TRACE("Turning off still capture parameter");
-		setParameter(_stillPort, MMAL_PARAMETER_CAPTURE, false);
-		
-        // Disable still port
-        if (_stillPort->is_enabled) {
-			EZLOG_TRACE("Disabling still port");
-            const MMAL_STATUS_T status = mmal_port_disable(_stillPort);
-            CheckStatus(status, "Unable to disable still port");
-        }
-        
-        // Free pool
-        if (_stillPool) {
-			EZLOG_TRACE("Destroying still pool");
-            mmal_port_pool_destroy(_stillPort, _stillPool);
-            _stillPool = nullptr;
-        }
-		
-		_stillPort = nullptr;
-		EZLOG_TRACE("Still port closed");
-    }
+	EZLOG_TRACE("Closing still port");
+	_backend->closeStill();
 }
@@ -23,26 +23,56 @@ SOFTWARE.
 #pragma once
 
 #include <set>
-#include <interface/mmal/mmal_types.h>
+#include <map>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <future>
 #include "SensorMode.hpp"
 #include "Encoding.hpp"
 #include "AwbMode.hpp"
+#include "QueuePolicy.hpp"
+#include "SubscriberPolicy.hpp"
+#include "CaptureStats.hpp"
+#include "FrameSettings.hpp"
+#include "StartupTimeline.hpp"
+#include "EncoderSettings.hpp"
+#include "EventRecordingStats.hpp"
+#include "MotionSettings.hpp"
+#include "FrameStatistics.hpp"
+#include "ExposureControl.hpp"
+#include "FrameLease.h"
+#include "FrameDecoder.h"
+#include "StreamGraph.h"
+#include "CaptureStatsRecorder.h"
 #include "Wait.h"
 
 namespace cv {
     class Mat;
 }
 
-struct MMAL_COMPONENT_T;
-struct MMAL_PORT_T;
-struct MMAL_POOL_T;
-struct MMAL_PARAMETER_CAMERA_SETTINGS_T;
 struct MMAL_BUFFER_HEADER_T;
+class CaptureBackend;
+enum class StartupPhase;
+template <typename T> class RingBuffer;
+class FramePromises;
+class Subscriber;
+class EventRecorder;
+class MotionDetector;
+class FrameStatistician;
+class ExposureController;
+class DecodePool;
 
 class PiEyeImpl {
 public:
+	// Every decoded video frame with the pts of the camera and its arrival in nanoseconds, on the capture thread or
+	// the decode worker that delivers it
+	typedef std::function<void(const cv::Mat& frame, long long pts, long long arrival)> FrameTap;
 
-    PiEyeImpl();
+    // Takes ownership of the backend
+    explicit PiEyeImpl(CaptureBackend* backend);
     ~PiEyeImpl();
 
     void
@@ -51,17 +81,178 @@ public:
     void
     destroyCamera();
 	
+	void
+	setResolution(unsigned short width, unsigned short height);
+	
+	void
+	setVideoResolution(unsigned short width, unsigned short height);
+	
+	void
+	setStillResolution(unsigned short width, unsigned short height);
+	
+	void
+	setFrameRate(unsigned short fps);
+	
+	void
+	reconfigure(unsigned short width, unsigned short height, const Encoding& encoding);
+	
 	void
 	startVideo();
 	
+	std::future<void>
+	startAsync(bool settle);
+	
+	StartupTimeline
+	getStartupTimeline() const;
+	
 	void
 	stopVideo();
 	
 	void
 	grabFrame(cv::Mat& data);
+	
+	void
+	grabFrameWithSettings(cv::Mat& data, FrameSettings& settings);
+	
+	void
+	grabFrameWithStatistics(cv::Mat& data, FrameStatistics& statistics);
+	
+	void
+	grabBracket(const std::vector<FrameSettings>& brackets, std::vector<cv::Mat>& frames, std::vector<FrameSettings>& settings);
+	
+	bool
+	popFrame(cv::Mat& data);
+	
+	void
+	setFrameQueue(unsigned int depth, const QueuePolicy& policy);
+	
+	unsigned long long
+	getDroppedFrames() const;
+	
+	CaptureStats
+	getStats() const;
+	
+	void
+	resetStats();
+	
+	void
+	setFrameDivisor(unsigned int divisor);
+	
+	void
+	setDecodeWorkers(unsigned int workers);
+	
+	unsigned int
+	getDecodeWorkers() const;
+	
+	// For a rig whose cameras decode on one pool, which then also delivers their frames one at a time. An empty one
+	// decodes on the capture thread. Must be set while video is stopped.
+	void
+	setDecodePool(const std::shared_ptr<DecodePool>& pool);
+	
+	void
+	grabFramePyramid(std::vector<cv::Mat>& levels, unsigned int levelCount);
+	
+	FrameLease
+	grabFrameLease();
+	
+	std::future<cv::Mat>
+	grabFrameAsync();
+	
+	unsigned int
+	subscribe(const std::function<void(const cv::Mat&)>& handler, const SubscriberPolicy& policy, unsigned int queueDepth,
+			unsigned int decimation);
+	
+	void
+	unsubscribe(unsigned int id);
+	
+	SubscriberStats
+	getSubscriberStats(unsigned int id) const;
+	
+	// For a rig that pairs the frames of its cameras. The tap must be quick and not call back into the camera; an empty
+	// one removes it.
+	void
+	setFrameTap(const FrameTap& tap);
+	
+	unsigned int
+	addStream(unsigned short width, unsigned short height, const Encoding& encoding);
+	
+	void
+	clearStreams();
+	
+	void
+	grabStreamFrame(unsigned int stream, cv::Mat& data);
+	
+	void
+	startRecording(const EncoderSettings& settings, const EncodedHandler& handler);
+	
+	void
+	startRecording(const EncoderSettings& settings, const std::string& path);
+	
+	void
+	stopRecording();
+	
+	bool
+	isRecording() const;
+	
+	void
+	startEventRecording(const EncoderSettings& settings, float preRollSeconds, size_t memoryBytes);
+	
+	bool
+	triggerEvent(const std::string& path, float postRollSeconds);
+	
+	EventRecordingStats
+	getEventRecordingStats() const;
+	
+	void
+	stopEventRecording();
+	
+	void
+	startMotionDetection(const MotionSettings& settings, const MotionHandler& handler);
+	
+	void
+	stopMotionDetection();
+	
+	bool
+	isDetectingMotion() const;
+	
+	void
+	startFrameStatistics(const StatisticsSettings& settings);
+	
+	void
+	stopFrameStatistics();
+	
+	bool
+	getFrameStatistics(FrameStatistics& statistics) const;
+	
+	void
+	startAutoExposure(const ExposureTarget& target, const ExposureModel& model);
+	
+	void
+	stopAutoExposure();
+	
+	bool
+	isAutoExposing() const;
+	
+	ExposureStats
+	getExposureStats() const;
+	
+	ExposureModel
+	learnExposureModel(const std::vector<FrameSettings>& brackets);
     
 	void
 	grabStill(cv::Mat& data);
+	
+	void
+	grabStillWithSettings(cv::Mat& data, FrameSettings& settings);
+	
+	void
+	grabStillBurst(std::vector<cv::Mat>& stills, unsigned int count, unsigned int intervalMillis);
+	
+	std::future<cv::Mat>
+	grabStillAsync();
+	
+	FrameSettings
+	getFrameSettings() const;
     
     void
     setSensorMode(const SensorMode mode);
@@ -94,58 +285,178 @@ public:
     setFpsRange(float minFps, float maxFps);
     
 private:
-    MMAL_COMPONENT_T* _camera = nullptr;
-	MMAL_PORT_T* _previewPort = nullptr;
-    MMAL_PORT_T* _videoPort = nullptr;
-	MMAL_PORT_T* _stillPort = nullptr;
-	MMAL_POOL_T* _videoPool = nullptr;
-	MMAL_POOL_T* _stillPool = nullptr;
+	struct QueuedFrame;
+	
+	std::unique_ptr<CaptureBackend> _backend;
+	FrameDecoder _videoDecoder;
+	FrameDecoder _stillDecoder;
 	Encoding _encoding = Encoding::NATIVE_BGR;
-    unsigned short _width = 1280;
-    unsigned short _height = 720;
-    unsigned short _previewFrames = 3;
+    unsigned short _videoWidth = 1280;
+    unsigned short _videoHeight = 720;
+    unsigned short _stillWidth = 1280;
+    unsigned short _stillHeight = 720;
     unsigned short _fps = 0;
 	Wait _videoWait;
 	Wait _stillWait;
-	std::set<cv::Mat*> _frameRequests;
-	cv::Mat* _stillRequest = nullptr;
-    
-    static void
-    ControlCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer);
-
-    static void
-    BufferCallback(MMAL_PORT_T* port, MMAL_BUFFER_HEADER_T* buffer);
+	std::unique_ptr<RingBuffer<QueuedFrame> > _frameRing;
+	std::atomic<bool> _frameConsumer;
+	std::unique_ptr<FramePromises> _framePromises;
+	std::mutex _stillMutex;
+	std::set<FrameLease*> _leaseRequests;
+	std::mutex _leaseMutex;
+	std::map<std::vector<cv::Mat>*, unsigned int> _pyramidRequests;
+	std::mutex _pyramidMutex;
+	unsigned int _frameDivisor = 1;
+	std::map<unsigned int, std::shared_ptr<Subscriber> > _subscribers;
+	mutable std::mutex _subscriberMutex;
+	FrameTap _frameTap;
+	mutable std::mutex _frameTapMutex;	// Also held while the tap runs
+	unsigned int _nextSubscriber = 1;
+	std::vector<StreamFormat> _streamFormats;
+	std::vector<std::shared_ptr<RingBuffer<cv::Mat> > > _streamRings;
+	Wait _streamWait;
+	std::shared_ptr<EventRecorder> _eventRecorder;
+	mutable std::mutex _eventMutex;	// Held while event recording starts and its encoder stops, before the still mutex
+	std::unique_ptr<MotionDetector> _motionDetector;	// Swapped under both the still and the motion mutex
+	MotionSettings _motionSettings;
+	MotionHandler _motionHandler;
+	mutable std::mutex _motionMutex;
+	std::unique_ptr<FrameStatistician> _statistician;	// Swapped under both the still and the statistics mutex
+	StatisticsSettings _statisticsSettings;
+	mutable std::mutex _statisticsMutex;
+	std::shared_ptr<const FrameStatistics> _lastStatistics;
+	mutable std::mutex _lastStatisticsMutex;
+	std::unique_ptr<ExposureController> _exposureController;
+	bool _exposureStatistics = false;	// Frame statistics were started for auto-exposure and stop with it
+	mutable std::mutex _exposureMutex;
+	std::atomic<cv::Mat*> _stillRequest;
+	std::vector<cv::Mat>* _burstStills = nullptr;	// Filled in turn by the continuous capture of a burst
+	std::atomic<unsigned int> _burstTaken;	// Read by the wait for the burst without the burst mutex
+	unsigned int _burstIntervalMillis = 0;
+	long long _burstDue = 0;	// Steady clock nanos of the next still of the burst, earlier ones are dropped
+	std::mutex _burstMutex;	// Also held while a still of the burst decodes
+	CaptureStatsRecorder _stats;
+	FrameSettings _requestedSettings;	// 0 for settings left on auto
+	FrameSettings _reportedSettings;
+	FrameSettings _stillSettings;
+	mutable std::mutex _settingsMutex;
+	Wait _settingsWait;
+	StartupTimeline _startupTimeline;
+	long long _startupStart = 0;	// When startAsync was called, 0 once the warm-up is over
+	std::atomic<bool> _warmingUp;
+	FrameSettings _warmUpSettings;	// Of the previous warm-up frame
+	unsigned int _stableFrames = 0;	// Warm-up frames in a row with the settings of the one before
+	bool _settle = true;	// Warm-up discards frames until the settings settled, otherwise it ends with the first one
+	mutable std::mutex _startupMutex;
+	std::atomic<unsigned long long> _poolStarvationBase;	// Counted by the backend and the waits since construction, so
+	std::atomic<unsigned long long> _waitTimeOutBase;		// resetStats() only remembers where they stood
+	std::shared_ptr<DecodePool> _decodePool;	// Empty to decode on the capture thread, may be shared with other cameras,
+												// only changes while video is stopped
     
-    void
-    parseVideoBuffer(const MMAL_BUFFER_HEADER_T& buffer);
+    bool
+    parseVideoBuffer(MMAL_BUFFER_HEADER_T* buffer);
+	
+	// The rest of parseVideoBuffer once the frame is due, in the order frames arrived. Takes a frame the decode pool
+	// decoded already, or decodes it when empty. Returns whether the buffer was leased.
+	bool
+	deliverVideoBuffer(MMAL_BUFFER_HEADER_T* buffer, long long arrival, const FrameSettings& settings, const cv::Mat& decoded,
+			long long decodeNanos);
+	
+	// Whether anybody takes decoded frames right now
+	bool
+	wantsFrames() const;
+	
+	bool
+	hasFrameTap() const;
+	
+	// Empty unless event recording runs
+	std::shared_ptr<EventRecorder>
+	getEventRecorder() const;
+	
+	// Waits until the decode pool delivered every frame it was handed, once video stopped
+	void
+	drainDecodes();
+	
+	// Both with the still mutex held. The still port closes if its format changes, running video is reconfigured.
+	void
+	changeStillFormat(unsigned short width, unsigned short height, const Encoding& encoding);
+	
+	void
+	changeVideoFormat(unsigned short width, unsigned short height, const Encoding& encoding, unsigned short fps);
+	
+	// A detector with the current settings for the new format, empty if motion detection is off. Throws if the
+	// format doesn't allow it, before anything changed.
+	std::unique_ptr<MotionDetector>
+	createMotionDetector(unsigned short width, unsigned short height, const Encoding& encoding) const;
+	
+	// Likewise for frame statistics
+	std::unique_ptr<FrameStatistician>
+	createStatistician(unsigned short width, unsigned short height) const;
+	
+	bool
+	hasStatistician() const;
+	
+	// Makes the statistics the statistician gathered the latest ones
+	std::shared_ptr<const FrameStatistics>
+	publishStatistics(const FrameStatistician& statistician, long long pts);
+	
+	// Runs motion detection on the buffer of a video frame, where the frame is delivered
+	void
+	detectMotion(const MMAL_BUFFER_HEADER_T& buffer);
+	
+	// Body of startAsync
+	void
+	start(bool settle);
+	
+	void
+	recordPhase(const StartupPhase& phase);
+	
+	// Milliseconds since startAsync was called, the startup mutex must be held
+	float
+	getStartupMillis() const;
+	
+	// Counts a frame that arrived during warm-up. True if it is to be discarded, false once the settings settled.
+	bool
+	warmUp(const FrameSettings& settings);
+	
+	unsigned long long
+	getWaitTimeOuts() const;
+	
+	void
+	parseSettings(const FrameSettings& settings);
+	
+	// Changes the settings the camera is asked for
+	void
+	requestSettings(const std::function<void(FrameSettings&)>& change);
+	
+	FrameSettings
+	getRequestedSettings() const;
+	
+	// Asks the camera for every setting that is not 0
+	void
+	applySettings(const FrameSettings& settings);
 	
 	void
 	parseStillBuffer(const MMAL_BUFFER_HEADER_T& buffer);
-    
-    void
-    setCameraConfig();
-    
-    void
-    setFormat(MMAL_PORT_T& port, unsigned short fps);
-    
-    void
-    setParameter(MMAL_PORT_T* port, unsigned int parameter, bool value);
-    
-    void
-    setParameter(MMAL_PORT_T* port, unsigned int parameter, unsigned int value);
-    
-    void
-    setParameter(MMAL_PORT_T* port, unsigned int parameter, float value);
-    
-    void
-    requireCamera();
 	
+	// Takes a still of the burst underway, or drops it if it is not due yet. False if there is no burst.
+	bool
+	parseBurstStill(const MMAL_BUFFER_HEADER_T& buffer);
+	
+	// Stills that still come in after the burst are no longer taken
 	void
-	decodeBuffer(const MMAL_BUFFER_HEADER_T& buffer, cv::Mat& target);
-
+	endBurst();
+	
+	void
+	parseStreamFrame(unsigned int stream, const cv::Mat& frame);
+    
 	void
 	initStill();
 	
+	// Triggers a still into data and waits for it, the still mutex must be held
+	void
+	captureStill(cv::Mat& data);
+	
 	void
 	closeStill();
 };
\ No newline at end of file
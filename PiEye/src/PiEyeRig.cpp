@@ -0,0 +1,111 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "PiEyeRig.h"
+
+#include "PiEye.h"
+#include "PiEyeRigImpl.h"
+
+namespace {
+	std::vector<std::unique_ptr<PiEye> >
+	CreateCameras(unsigned int cameraCount) {
+		std::vector<std::unique_ptr<PiEye> > cameras;
+		for (unsigned int i = 0; i < cameraCount; ++i) {
+			cameras.push_back(std::unique_ptr<PiEye>(new PiEye(i)));
+		}
+		return cameras;
+	}
+	
+	std::vector<std::unique_ptr<PiEye> >
+	CreateCameras(const std::vector<SyntheticSource>& sources) {
+		std::vector<std::unique_ptr<PiEye> > cameras;
+		for (size_t i = 0; i < sources.size(); ++i) {
+			cameras.push_back(std::unique_ptr<PiEye>(new PiEye(sources[i])));
+		}
+		return cameras;
+	}
+}
+
+PiEyeRig::PiEyeRig(unsigned int cameraCount) : _impl(new PiEyeRigImpl(CreateCameras(cameraCount))) {
+    
+}
+
+PiEyeRig::PiEyeRig(const std::vector<SyntheticSource>& sources) : _impl(new PiEyeRigImpl(CreateCameras(sources))) {
+    
+}
+
+PiEyeRig::~PiEyeRig() {
+    if (_impl != nullptr) {
+        delete _impl;
+        _impl = nullptr;
+    }
+}
+
+unsigned int
+PiEyeRig::getCameraCount() const {
+    return _impl->getCameraCount();
+}
+
+PiEye&
+PiEyeRig::getCamera(unsigned int index) {
+    return _impl->getCamera(index);
+}
+
+void
+PiEyeRig::setTolerance(unsigned int micros) {
+    _impl->setTolerance(micros);
+}
+
+void
+PiEyeRig::start() {
+    _impl->start();
+}
+
+void
+PiEyeRig::stop() {
+    _impl->stop();
+}
+
+bool
+PiEyeRig::isRunning() const {
+    return _impl->isRunning();
+}
+
+void
+PiEyeRig::grabFrameSet(FrameSet& set) {
+    _impl->grabFrameSet(set);
+}
+
+bool
+PiEyeRig::popFrameSet(FrameSet& set) {
+    return _impl->popFrameSet(set);
+}
+
+FrameSetStats
+PiEyeRig::getStats() const {
+    return _impl->getStats();
+}
+
+void
+PiEyeRig::resetStats() {
+    _impl->resetStats();
+}
@@ -0,0 +1,192 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "PiEyeRigImpl.h"
+
+#include <future>
+
+#include "PiEye.h"
+#include "PiEyeImpl.h"
+#include "FrameMatcher.h"
+#include "DecodePool.h"
+#include "PiEyeException.hpp"
+#include "Log.hpp"
+
+#define PIEYE_DEFAULT_PAIRING_TOLERANCE_MICROS 5000
+#define PIEYE_FRAME_SET_QUEUE_DEPTH 4
+#define PIEYE_FRAME_SET_TIMEOUT 5
+#define PIEYE_RIG_DECODE_WORKERS_PER_CAMERA 1
+
+PiEyeRigImpl::PiEyeRigImpl(std::vector<std::unique_ptr<PiEye> >&& cameras) : _cameras(std::move(cameras)),
+		_running(false), _sets(PIEYE_FRAME_SET_QUEUE_DEPTH, QueuePolicy::OVERWRITE_OLDEST) {
+	if (_cameras.empty()) {
+		throw PiEyeException("Rig needs at least one camera");
+	}
+	_decodePool.reset(new DecodePool(_cameras.size() * PIEYE_RIG_DECODE_WORKERS_PER_CAMERA));
+	_matcher.reset(new FrameMatcher(_cameras.size(), PIEYE_DEFAULT_PAIRING_TOLERANCE_MICROS));
+}
+
+PiEyeRigImpl::~PiEyeRigImpl() {
+	try {
+		stop();
+	} catch (const std::exception& e) {
+		EZLOG_ERROR("Unable to stop rig: " << e.what());
+	} catch (...) {
+		EZLOG_ERROR("Unable to stop rig.");
+	}
+}
+
+unsigned int
+PiEyeRigImpl::getCameraCount() const {
+	return _cameras.size();
+}
+
+PiEye&
+PiEyeRigImpl::getCamera(unsigned int index) {
+	if (index >= _cameras.size()) {
+		throw PiEyeException("Rig has no camera [" + std::to_string(index) + "]");
+	}
+	return *_cameras[index];
+}
+
+void
+PiEyeRigImpl::setTolerance(unsigned int micros) {
+	if (isRunning()) {
+		throw StateException("Cannot change the tolerance while the rig is running");
+	}
+	_matcher->setTolerance(micros);
+}
+
+void
+PiEyeRigImpl::start() {
+	if (isRunning()) {
+		throw StateException("Rig is already running");
+	}
+	EZLOG_DEBUG("Starting a rig of [" << _cameras.size() << "] cameras");
+	
+	// The cameras decode on the pool of the rig, whose single delivering worker then also matches their frames
+	for (size_t i = 0; i < _cameras.size(); ++i) {
+		_cameras[i]->_impl->setDecodePool(_decodePool);
+	}
+	
+	// Every camera takes a while to settle, so they start side by side
+	std::vector<std::future<void> > starts;
+	for (size_t i = 0; i < _cameras.size(); ++i) {
+		starts.push_back(_cameras[i]->startAsync());
+	}
+	std::exception_ptr error;
+	for (size_t i = 0; i < starts.size(); ++i) {
+		try {
+			starts[i].get();
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+	if (error) {
+		for (size_t i = 0; i < _cameras.size(); ++i) {
+			try {
+				_cameras[i]->stopVideo();
+			} catch (const std::exception& e) {
+				EZLOG_WARN("Unable to stop camera [" << i << "]: " << e.what());
+			}
+		}
+		std::rethrow_exception(error);
+	}
+	
+	_matcher->clear();
+	FrameSet set;
+	while (_sets.pop(set)) {
+	}
+	_running = true;
+	for (unsigned int i = 0; i < _cameras.size(); ++i) {
+		_cameras[i]->_impl->setFrameTap([this, i](const cv::Mat& frame, long long pts, long long arrival) {
+			offer(i, frame, pts, arrival);
+		});
+	}
+}
+
+void
+PiEyeRigImpl::stop() {
+	if (!isRunning()) {
+		return;
+	}
+	stopMatching();
+	for (size_t i = 0; i < _cameras.size(); ++i) {
+		_cameras[i]->stopVideo();
+	}
+	EZLOG_DEBUG("Rig stopped");
+}
+
+bool
+PiEyeRigImpl::isRunning() const {
+	return _running;
+}
+
+void
+PiEyeRigImpl::grabFrameSet(FrameSet& set) {
+	if (!isRunning()) {
+		throw StateException("Cannot grab a frame set before the rig was started");
+	}
+	RingBuffer<FrameSet>& sets = _sets;
+	_setWait.wait(PIEYE_FRAME_SET_TIMEOUT, [&sets, &set]() {
+		return sets.pop(set);
+	});
+}
+
+bool
+PiEyeRigImpl::popFrameSet(FrameSet& set) {
+	return _sets.pop(set);
+}
+
+FrameSetStats
+PiEyeRigImpl::getStats() const {
+	return _matcher->getStats();
+}
+
+void
+PiEyeRigImpl::resetStats() {
+	_matcher->resetStats();
+}
+
+void
+PiEyeRigImpl::offer(unsigned int camera, const cv::Mat& frame, long long pts, long long arrival) {
+	try {
+		_matcher->add(camera, frame, pts, arrival, _matched);
+	} catch (const std::exception& e) {
+		EZLOG_WARN("Unable to match a frame: " << e.what());
+	}
+	for (size_t i = 0; i < _matched.size(); ++i) {
+		_sets.push(_matched[i]);
+	}
+	if (!_matched.empty()) {
+		_setWait.notify();
+	}
+	_matched.clear();
+}
+
+void
+PiEyeRigImpl::stopMatching() {
+	for (size_t i = 0; i < _cameras.size(); ++i) {
+		_cameras[i]->_impl->setFrameTap(PiEyeImpl::FrameTap());
+	}
+	_running = false;
+}
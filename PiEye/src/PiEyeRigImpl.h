@@ -0,0 +1,93 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "FrameSet.hpp"
+#include "RingBuffer.h"
+#include "Wait.h"
+
+class PiEye;
+class FrameMatcher;
+class DecodePool;
+
+class PiEyeRigImpl {
+public:
+
+	explicit PiEyeRigImpl(std::vector<std::unique_ptr<PiEye> >&& cameras);
+	~PiEyeRigImpl();
+
+	unsigned int
+	getCameraCount() const;
+
+	PiEye&
+	getCamera(unsigned int index);
+
+	void
+	setTolerance(unsigned int micros);
+
+	void
+	start();
+
+	void
+	stop();
+
+	bool
+	isRunning() const;
+
+	void
+	grabFrameSet(FrameSet& set);
+
+	bool
+	popFrameSet(FrameSet& set);
+
+	FrameSetStats
+	getStats() const;
+
+	void
+	resetStats();
+
+private:
+	std::vector<std::unique_ptr<PiEye> > _cameras;
+	std::shared_ptr<DecodePool> _decodePool;	// Decodes the video of all cameras and delivers one frame at a time
+	std::unique_ptr<FrameMatcher> _matcher;	// Only used by the delivering decode worker while the rig runs
+	std::vector<FrameSet> _matched;			// Likewise
+	std::atomic<bool> _running;
+	RingBuffer<FrameSet> _sets;
+	Wait _setWait;
+
+	// Called by the decode pool with the frames of all cameras in the order they were captured, one at a time
+	void
+	offer(unsigned int camera, const cv::Mat& frame, long long pts, long long arrival);
+
+	// Removes the taps, video keeps running
+	void
+	stopMatching();
+
+	PiEyeRigImpl(const PiEyeRigImpl&);
+	PiEyeRigImpl& operator=(const PiEyeRigImpl&);
+};
@@ -0,0 +1,159 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "QueuePolicy.hpp"
+#include "PiEyeException.hpp"
+
+/**
+ * Bounded lock-free queue for any number of producers and consumers, e.g. the log queue is fed by every thread. Under
+ * OVERWRITE_OLDEST a producer that finds the queue full also consumes: it pops the oldest item itself, so even a single
+ * producer and a single consumer both claim the head.
+ *
+ * Every slot carries a sequence number telling whose turn it is, so neither side ever waits on the other. Producers
+ * claim the tail with a CAS. To overwrite the oldest item the producer takes it out the same way the consumer does;
+ * both claim the head with a CAS, so the consumer never sees a half-written or half-evicted slot. One spare slot keeps
+ * the sequence numbers unambiguous when the capacity is a single item.
+ */
+template <typename T>
+class RingBuffer {
+public:
+	RingBuffer(unsigned int capacity, const QueuePolicy& policy) : _capacity(capacity), _slotCount(capacity + 1),
+			_policy(policy), _slots(new Slot[capacity + 1]), _head(0), _tail(0), _dropped(0) {
+		if (capacity == 0) {
+			throw PiEyeException("Ring buffer needs a capacity of at least one item");
+		}
+		for (size_t i = 0; i < _slotCount; ++i) {
+			_slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	// Producer side, any thread. Returns false if the item was dropped.
+	bool
+	push(const T& item) {
+		if (tryPush(item)) {
+			return true;
+		}
+
+		// Full, make room by evicting the oldest item
+		if (_policy == QueuePolicy::OVERWRITE_OLDEST) {
+			T evicted;
+			if (pop(evicted)) {
+				_dropped.fetch_add(1, std::memory_order_relaxed);
+				if (tryPush(item)) {
+					return true;
+				}
+			}
+		}
+
+		// Still full: consumer is busy with the slot we need
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	// Consumer side, any thread. Returns false if the queue is empty.
+	bool
+	pop(T& item) {
+		size_t position = _head.load(std::memory_order_relaxed);
+		for (;;) {
+			Slot& slot = _slots[position % _slotCount];
+			const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			const long difference = (long) sequence - (long) (position + 1);
+			if (difference < 0) {
+				return false;
+			} else if (difference == 0) {
+				if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					item = slot.item;
+					slot.item = T();
+					slot.sequence.store(position + _slotCount, std::memory_order_release);
+					return true;
+				}
+			} else {
+				position = _head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	unsigned int
+	size() const {
+		const size_t tail = _tail.load(std::memory_order_acquire);
+		const size_t head = _head.load(std::memory_order_acquire);
+		return tail > head ? tail - head : 0;
+	}
+
+	unsigned int
+	getCapacity() const {
+		return _capacity;
+	}
+
+	unsigned long long
+	getDropped() const {
+		return _dropped.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Slot {
+		std::atomic<size_t> sequence;
+		T item;
+	};
+
+	const size_t _capacity;
+	const size_t _slotCount;
+	const QueuePolicy _policy;
+	std::unique_ptr<Slot[]> _slots;
+	std::atomic<size_t> _head;
+	char _padding[64];	// Keeps head and tail on separate cache lines
+	std::atomic<size_t> _tail;
+	std::atomic<unsigned long long> _dropped;
+
+	bool
+	tryPush(const T& item) {
+		size_t position = _tail.load(std::memory_order_acquire);
+		for (;;) {
+			const size_t head = _head.load(std::memory_order_acquire);
+			if (position >= head && position - head >= _capacity) {
+				return false;
+			}
+			Slot& slot = _slots[position % _slotCount];
+			const long difference = (long) slot.sequence.load(std::memory_order_acquire) - (long) position;
+			if (difference < 0) {
+				// The consumer is still taking the item out of this slot
+				return false;
+			} else if (difference == 0) {
+				if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_acq_rel)) {
+					slot.item = item;
+					slot.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			} else {
+				position = _tail.load(std::memory_order_acquire);
+			}
+		}
+	}
+
+	RingBuffer(const RingBuffer&);
+	RingBuffer& operator=(const RingBuffer&);
+};
@@ -0,0 +1,79 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "SoftwareBufferPool.h"
+
+#include <cstring>
+
+#include "PiEyeException.hpp"
+
+SoftwareBufferPool::SoftwareBufferPool(unsigned int bufferCount, unsigned int bufferSize) :
+		_bufferSize(bufferSize), _headers(bufferCount), _payloads(bufferCount) {
+	_free.reserve(bufferCount);
+	for (unsigned int i = 0; i < bufferCount; ++i) {
+		_payloads[i].resize(bufferSize);
+		MMAL_BUFFER_HEADER_T& header = _headers[i];
+		memset(&header, 0, sizeof(header));
+		header.data = _payloads[i].data();
+		header.alloc_size = bufferSize;
+		_free.push_back(&header);
+	}
+}
+
+SoftwareBufferPool::~SoftwareBufferPool() {
+}
+
+MMAL_BUFFER_HEADER_T*
+SoftwareBufferPool::get() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_free.empty()) {
+		return nullptr;
+	}
+	MMAL_BUFFER_HEADER_T* buffer = _free.back();
+	_free.pop_back();
+	return buffer;
+}
+
+void
+SoftwareBufferPool::unlock(MMAL_BUFFER_HEADER_T* buffer) {
+	// Ordinary memory, nothing to unlock
+}
+
+void
+SoftwareBufferPool::recycle(MMAL_BUFFER_HEADER_T* buffer) {
+	if (buffer < _headers.data() || buffer >= _headers.data() + _headers.size()) {
+		throw PiEyeException("Buffer does not belong to this pool");
+	}
+	std::lock_guard<std::mutex> lock(_mutex);
+	_free.push_back(buffer);
+}
+
+unsigned int
+SoftwareBufferPool::available() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _free.size();
+}
+
+unsigned int
+SoftwareBufferPool::getBufferSize() const {
+	return _bufferSize;
+}
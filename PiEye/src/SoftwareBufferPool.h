@@ -0,0 +1,62 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <interface/mmal/mmal_buffer.h>
+
+#include "BufferPool.h"
+
+/**
+ * Software stand-in for an MMAL port pool: buffer headers and payloads live in ordinary memory, so the buffer paths can
+ * be exercised without camera hardware.
+ */
+class SoftwareBufferPool : public BufferPool {
+public:
+	SoftwareBufferPool(unsigned int bufferCount, unsigned int bufferSize);
+	virtual ~SoftwareBufferPool();
+
+	// Takes a free buffer out of the pool, or nullptr if all buffers are in use
+	MMAL_BUFFER_HEADER_T*
+	get();
+
+	virtual void
+	unlock(MMAL_BUFFER_HEADER_T* buffer);
+
+	virtual void
+	recycle(MMAL_BUFFER_HEADER_T* buffer);
+
+	unsigned int
+	available() const;
+
+	unsigned int
+	getBufferSize() const;
+
+private:
+	const unsigned int _bufferSize;
+	std::vector<MMAL_BUFFER_HEADER_T> _headers;
+	std::vector<std::vector<uint8_t> > _payloads;
+	std::vector<MMAL_BUFFER_HEADER_T*> _free;
+	mutable std::mutex _mutex;
+};
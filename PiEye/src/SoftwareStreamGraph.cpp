@@ -0,0 +1,83 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "SoftwareStreamGraph.h"
+
+#include <opencv2/core/core.hpp>
+#include <interface/mmal/mmal_buffer.h>
+
+#include "SoftwareBufferPool.h"
+#include "PiEyeException.hpp"
+#include "Log.hpp"
+
+#define PIEYE_SOFTWARE_STREAM_BUFFERS 2
+
+SoftwareStreamGraph::SoftwareStreamGraph(const FrameHandler& handler, unsigned int maxStreams) :
+		StreamGraph(handler), _maxStreams(maxStreams) {
+}
+
+SoftwareStreamGraph::~SoftwareStreamGraph() {
+}
+
+void
+SoftwareStreamGraph::build(const std::vector<StreamFormat>& streams) {
+	if (_built) {
+		throw StateException("Stream graph was already built");
+	}
+	setStreams(streams);
+	for (unsigned int stream = 0; stream < _decoders.size(); ++stream) {
+		_pools.push_back(std::shared_ptr<SoftwareBufferPool>(new SoftwareBufferPool(PIEYE_SOFTWARE_STREAM_BUFFERS,
+				_decoders[stream].getFrameSize())));
+	}
+	_built = true;
+}
+
+void
+SoftwareStreamGraph::destroy() {
+	_pools.clear();
+	_built = false;
+}
+
+unsigned int
+SoftwareStreamGraph::getMaxStreams() const {
+	return _maxStreams;
+}
+
+void
+SoftwareStreamGraph::process(const cv::Mat& source) {
+	if (!_built) {
+		throw StateException("Stream graph was not built");
+	} else if (source.type() != CV_8UC3) {
+		throw PiEyeException("Stream graph takes BGR frames");
+	}
+
+	for (unsigned int stream = 0; stream < _pools.size(); ++stream) {
+		MMAL_BUFFER_HEADER_T* buffer = _pools[stream]->get();
+		if (buffer == nullptr) {
+			EZLOG_WARN("No free buffer for stream [" << stream << "], dropped a frame");
+			continue;
+		}
+		_decoders[stream].encode(source, *buffer);
+		deliver(stream, *buffer);
+		_pools[stream]->recycle(buffer);
+	}
+}
@@ -0,0 +1,59 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "StreamGraph.h"
+
+class SoftwareBufferPool;
+
+/**
+ * Software stand-in for the splitter and ISPs of an MmalStreamGraph. Every processed frame is scaled and packed into a
+ * buffer laid out like the ISP output of each stream, which then takes the same decode and delivery path as on the
+ * camera.
+ */
+class SoftwareStreamGraph : public StreamGraph {
+public:
+	SoftwareStreamGraph(const FrameHandler& handler, unsigned int maxStreams = 3);
+	virtual ~SoftwareStreamGraph();
+
+	virtual void
+	build(const std::vector<StreamFormat>& streams);
+
+	virtual void
+	destroy();
+
+	virtual unsigned int
+	getMaxStreams() const;
+
+	// Feeds a BGR frame into the splitter, on the calling thread
+	void
+	process(const cv::Mat& source);
+
+private:
+	const unsigned int _maxStreams;
+	std::vector<std::shared_ptr<SoftwareBufferPool> > _pools;
+	bool _built = false;
+};
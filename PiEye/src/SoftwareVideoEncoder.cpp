@@ -0,0 +1,117 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "SoftwareVideoEncoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <interface/mmal/mmal_buffer.h>
+
+#include "PiEyeException.hpp"
+#include "Log.hpp"
+
+#define PIEYE_SOFTWARE_ENCODER_FPS 30
+#define PIEYE_KEY_FRAME_WEIGHT 4	// Times the size of a predicted frame
+#define PIEYE_CHUNK_HEADER_ROOM 16	// Bytes in front of the filler, for the largest header
+
+namespace {
+	// Start code and NAL header of each unit
+	const std::vector<uint8_t> SPS = {0, 0, 0, 1, 0x67, 0x64, 0x00, 0x28, 0xac, 0x2b, 0x40, 0x3c, 0x01, 0x13, 0xf2, 0xc0};
+	const std::vector<uint8_t> PPS = {0, 0, 0, 1, 0x68, 0xee, 0x1f, 0x2c};
+	const std::vector<uint8_t> IDR_SLICE = {0, 0, 0, 1, 0x65, 0x88, 0x84};
+	const std::vector<uint8_t> SLICE = {0, 0, 0, 1, 0x41, 0x9a};
+	const std::vector<uint8_t> JPEG_START = {0xff, 0xd8, 0xff, 0xdb};
+	const std::vector<uint8_t> JPEG_END = {0xff, 0xd9};
+}
+
+SoftwareVideoEncoder::SoftwareVideoEncoder(float fps, const EncoderSettings& settings, const EncodedHandler& handler) :
+		VideoEncoder(settings, handler), _fps(fps > 0 ? fps : PIEYE_SOFTWARE_ENCODER_FPS) {
+}
+
+SoftwareVideoEncoder::~SoftwareVideoEncoder() {
+}
+
+void
+SoftwareVideoEncoder::build() {
+	if (_built) {
+		throw StateException("Video encoder was already built");
+	}
+	
+	// A GOP spends the bitrate on one key frame and the predicted frames after it
+	const unsigned int intraPeriod = _settings.codec == VideoCodec::H264 ? _settings.intraPeriod : 1;
+	const double gopBytes = _settings.bitrate / 8.0 / _fps * intraPeriod;
+	const unsigned int keyFrameBytes = gopBytes * PIEYE_KEY_FRAME_WEIGHT / (intraPeriod - 1 + PIEYE_KEY_FRAME_WEIGHT);
+	
+	// Laid out once with room for a key frame, chunks only write their header in front of the filler. The filler is
+	// never 0 nor 0xff, so it emulates no start code and no JPEG marker.
+	_payload.assign(PIEYE_CHUNK_HEADER_ROOM + keyFrameBytes, 0);
+	for (unsigned int i = PIEYE_CHUNK_HEADER_ROOM; i < _payload.size(); ++i) {
+		_payload[i] = 0x80 | (i % 0x7f);
+	}
+	_frameCount = 0;
+	_built = true;
+}
+
+void
+SoftwareVideoEncoder::destroy() {
+	_payload.clear();
+	_built = false;
+}
+
+void
+SoftwareVideoEncoder::process(long long pts) {
+	if (!_built) {
+		throw StateException("Video encoder was not built");
+	}
+	
+	const unsigned int keyFrameBytes = _payload.size() - PIEYE_CHUNK_HEADER_ROOM;
+	if (_settings.codec == VideoCodec::MJPEG) {
+		emit(JPEG_START, keyFrameBytes - JPEG_END.size(), pts, MMAL_BUFFER_HEADER_FLAG_KEYFRAME);
+		emit(JPEG_END, JPEG_END.size(), pts, MMAL_BUFFER_HEADER_FLAG_KEYFRAME | MMAL_BUFFER_HEADER_FLAG_FRAME_END);
+	} else if (_frameCount % _settings.intraPeriod == 0) {
+		emit(SPS, SPS.size(), pts, MMAL_BUFFER_HEADER_FLAG_CONFIG | MMAL_BUFFER_HEADER_FLAG_KEYFRAME);
+		emit(PPS, PPS.size(), pts, MMAL_BUFFER_HEADER_FLAG_CONFIG | MMAL_BUFFER_HEADER_FLAG_KEYFRAME);
+		emit(IDR_SLICE, keyFrameBytes, pts, MMAL_BUFFER_HEADER_FLAG_KEYFRAME | MMAL_BUFFER_HEADER_FLAG_FRAME_END);
+	} else {
+		emit(SLICE, keyFrameBytes / PIEYE_KEY_FRAME_WEIGHT, pts, MMAL_BUFFER_HEADER_FLAG_FRAME_END);
+	}
+	++_frameCount;
+}
+
+void
+SoftwareVideoEncoder::emit(const std::vector<uint8_t>& header, unsigned int size, long long pts, uint32_t flags) {
+	const unsigned int headerSize = header.size();
+	const unsigned int fillerSize = std::min(size > headerSize ? size - headerSize : 0, (unsigned int) _payload.size() - PIEYE_CHUNK_HEADER_ROOM);
+	const unsigned int offset = PIEYE_CHUNK_HEADER_ROOM - headerSize;
+	memcpy(_payload.data() + offset, header.data(), headerSize);
+	
+	MMAL_BUFFER_HEADER_T buffer;
+	memset(&buffer, 0, sizeof(buffer));
+	buffer.data = _payload.data();
+	buffer.alloc_size = _payload.size();
+	buffer.offset = offset;
+	buffer.length = headerSize + fillerSize;
+	buffer.pts = pts;
+	buffer.dts = pts;
+	buffer.flags = flags;
+	deliver(buffer);
+}
@@ -0,0 +1,59 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "VideoEncoder.h"
+
+/**
+ * Software stand-in for the video encoder. It doesn't compress anything: every processed frame turns into chunks with
+ * the layout of the real stream, i.e. H.264 NAL units behind start codes with SPS and PPS before each IDR slice, or one
+ * JPEG per frame, sized to match the bitrate at the given frame rate.
+ */
+class SoftwareVideoEncoder : public VideoEncoder {
+public:
+	SoftwareVideoEncoder(float fps, const EncoderSettings& settings, const EncodedHandler& handler);
+	virtual ~SoftwareVideoEncoder();
+
+	virtual void
+	build();
+
+	virtual void
+	destroy();
+
+	// Encodes the next frame, on the calling thread
+	void
+	process(long long pts);
+
+private:
+	const float _fps;
+	std::vector<uint8_t> _payload;
+	unsigned long long _frameCount = 0;
+	bool _built = false;
+
+	// Puts the header in front of the filler and hands on a chunk of the given size
+	void
+	emit(const std::vector<uint8_t>& header, unsigned int size, long long pts, uint32_t flags);
+};
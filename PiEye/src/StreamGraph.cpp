@@ -0,0 +1,77 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "StreamGraph.h"
+
+#include <opencv2/core/core.hpp>
+#include <interface/mmal/mmal_buffer.h>
+
+#include "PiEyeException.hpp"
+#include "Log.hpp"
+
+StreamGraph::StreamGraph(const FrameHandler& handler) : _handler(handler) {
+	if (!_handler) {
+		throw PiEyeException("Stream graph needs a frame handler");
+	}
+}
+
+StreamGraph::~StreamGraph() {
+}
+
+unsigned int
+StreamGraph::getStreamCount() const {
+	return _streams.size();
+}
+
+void
+StreamGraph::setStreams(const std::vector<StreamFormat>& streams) {
+	if (streams.size() > getMaxStreams()) {
+		throw PiEyeException("At most [" + std::to_string(getMaxStreams()) + "] streams are supported");
+	}
+
+	std::vector<FrameDecoder> decoders;
+	const std::vector<StreamFormat>::const_iterator streamEnd = streams.end();
+	for (std::vector<StreamFormat>::const_iterator it = streams.begin(); it != streamEnd; ++it) {
+		// Chroma planes of the I420 encodings need even sizes
+		if (it->width == 0 || it->height == 0 || it->width % 2 != 0 || it->height % 2 != 0) {
+			throw PiEyeException("Stream size must be even, got [" + std::to_string(it->width) + "x" + std::to_string(it->height) + "]");
+		}
+		decoders.push_back(FrameDecoder(it->encoding, it->width, it->height));
+	}
+	_streams = streams;
+	_decoders.swap(decoders);
+}
+
+void
+StreamGraph::deliver(unsigned int stream, const MMAL_BUFFER_HEADER_T& buffer) {
+	if (buffer.length == 0) {
+		EZLOG_DEBUG("Skipping empty buffer of stream [" << stream << "]");
+		return;
+	}
+	try {
+		cv::Mat frame;
+		_decoders.at(stream).decode(buffer, frame);
+		_handler(stream, frame);
+	} catch (const PiEyeException& e) {
+		EZLOG_WARN("Error occurred, skipping a frame of stream [" << stream << "]: " << e.what());
+	}
+}
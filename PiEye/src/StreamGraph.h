@@ -0,0 +1,86 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "Encoding.hpp"
+#include "FrameDecoder.h"
+
+namespace cv {
+	class Mat;
+}
+
+struct MMAL_BUFFER_HEADER_T;
+
+// Size and encoding of an extra video stream
+struct StreamFormat {
+	unsigned short width;
+	unsigned short height;
+	Encoding encoding;
+};
+
+/**
+ * Branches the video output into extra streams, each scaled and encoded on its own before reaching the ARM. Frames of
+ * stream i are decoded and handed to the handler from the thread that delivered its buffer.
+ */
+class StreamGraph {
+public:
+	typedef std::function<void(unsigned int stream, const cv::Mat& frame)> FrameHandler;
+
+	StreamGraph(const FrameHandler& handler);
+	virtual ~StreamGraph();
+
+	virtual void
+	build(const std::vector<StreamFormat>& streams) = 0;
+
+	// Tears down whatever was built, also after a failed build
+	virtual void
+	destroy() = 0;
+
+	unsigned int
+	getStreamCount() const;
+
+	// Upper limit on the stream count of this graph
+	virtual unsigned int
+	getMaxStreams() const = 0;
+
+protected:
+	std::vector<StreamFormat> _streams;
+	std::vector<FrameDecoder> _decoders;
+
+	// Checks the streams and prepares their decoders
+	void
+	setStreams(const std::vector<StreamFormat>& streams);
+
+	// Decodes a buffer that came out of the branch of a stream and hands the frame on
+	void
+	deliver(unsigned int stream, const MMAL_BUFFER_HEADER_T& buffer);
+
+private:
+	FrameHandler _handler;
+
+	StreamGraph(const StreamGraph&);
+	StreamGraph& operator=(const StreamGraph&);
+};
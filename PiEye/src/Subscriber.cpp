@@ -0,0 +1,113 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "Subscriber.h"
+
+#include "PiEyeException.hpp"
+#include "Log.hpp"
+
+namespace {
+	QueuePolicy
+	GetQueuePolicy(const SubscriberPolicy& policy) {
+		return policy == SubscriberPolicy::DROP_NEWEST ? QueuePolicy::REJECT_NEWEST : QueuePolicy::OVERWRITE_OLDEST;
+	}
+
+	unsigned int
+	GetQueueDepth(const SubscriberPolicy& policy, unsigned int queueDepth) {
+		return policy == SubscriberPolicy::LATEST_ONLY ? 1 : queueDepth;
+	}
+}
+
+Subscriber::Subscriber(const Handler& handler, const SubscriberPolicy& policy, unsigned int queueDepth, unsigned int decimation) :
+		_handler(handler), _decimation(policy == SubscriberPolicy::DECIMATE ? decimation : 1),
+		_queue(GetQueueDepth(policy, queueDepth), GetQueuePolicy(policy)), _offered(0), _delivered(0), _running(true) {
+	if (!_handler) {
+		throw PiEyeException("Subscriber needs a frame handler");
+	} else if (_decimation == 0) {
+		throw PiEyeException("Decimation must be at least 1");
+	}
+	_thread = std::thread(&Subscriber::run, this);
+}
+
+Subscriber::~Subscriber() {
+	close();
+}
+
+void
+Subscriber::offer(const cv::Mat& frame) {
+	if (!_running || _offered++ % _decimation != 0) {
+		return;
+	}
+
+	_queue.push(frame);
+	std::lock_guard<std::mutex> lock(_mutex);
+	_condition.notify_one();
+}
+
+void
+Subscriber::close() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = false;
+	}
+	_condition.notify_one();
+	std::lock_guard<std::mutex> lock(_closeMutex);
+	if (_thread.joinable()) {
+		_thread.join();
+	}
+}
+
+SubscriberStats
+Subscriber::getStats() const {
+	SubscriberStats stats;
+	stats.delivered = _delivered;
+	stats.dropped = _queue.getDropped();
+	return stats;
+}
+
+void
+Subscriber::run() {
+	cv::Mat frame;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (_running && _queue.size() == 0) {
+				_condition.wait(lock);
+			}
+			if (!_running) {
+				return;
+			}
+		}
+
+		while (_queue.pop(frame)) {
+			try {
+				_handler(frame);
+			} catch (const std::exception& e) {
+				EZLOG_ERROR("Subscriber failed to handle a frame: " << e.what());
+			} catch (...) {
+				EZLOG_ERROR("Subscriber failed to handle a frame");
+			}
+			++_delivered;
+			frame.release();
+		}
+	}
+}
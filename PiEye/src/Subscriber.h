@@ -0,0 +1,74 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <opencv2/core/core.hpp>
+
+#include "SubscriberPolicy.hpp"
+#include "RingBuffer.h"
+
+/**
+ * One consumer of the video stream. Frames are offered from the camera callback into a private queue and handed to
+ * the handler on the subscriber's own thread.
+ */
+class Subscriber {
+public:
+	typedef std::function<void(const cv::Mat&)> Handler;
+
+	Subscriber(const Handler& handler, const SubscriberPolicy& policy, unsigned int queueDepth, unsigned int decimation);
+	~Subscriber();
+
+	// Called from the camera callback, never waits for the handler. Ignored once closed.
+	void
+	offer(const cv::Mat& frame);
+
+	// Stops the thread after the running handler finished, the handler is not called again
+	void
+	close();
+
+	SubscriberStats
+	getStats() const;
+
+private:
+	const Handler _handler;
+	const unsigned int _decimation;
+	RingBuffer<cv::Mat> _queue;
+	unsigned long long _offered;
+	std::atomic<unsigned long long> _delivered;
+	std::atomic<bool> _running;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::thread _thread;
+	std::mutex _closeMutex;	// Joining twice at once is undefined
+
+	void
+	run();
+
+	Subscriber(const Subscriber&);
+	Subscriber& operator=(const Subscriber&);
+};
@@ -0,0 +1,628 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "SyntheticBackend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <interface/mmal/mmal_buffer.h>
+
+#include "FrameDecoder.h"
+#include "SoftwareBufferPool.h"
+#include "SoftwareStreamGraph.h"
+#include "SoftwareVideoEncoder.h"
+#include "PiEyeException.hpp"
+#include "Log.hpp"
+
+#define PIEYE_SYNTHETIC_VIDEO_BUFFERS 3
+#define PIEYE_SYNTHETIC_GRADIENT_FRAMES 4
+#define PIEYE_SYNTHETIC_NOISE_FRAMES 2
+#define PIEYE_SYNTHETIC_SETTINGS_DELAY 2
+#define PIEYE_SYNTHETIC_AUTO_EXPOSURE 10000
+
+namespace {
+	// Lays a BGR image out the way the port would deliver it
+	std::vector<uint8_t>
+	Pack(const cv::Mat& image, const FrameDecoder& decoder) {
+		std::vector<uint8_t> frame(decoder.getFrameSize());
+		MMAL_BUFFER_HEADER_T buffer;
+		memset(&buffer, 0, sizeof(buffer));
+		buffer.data = frame.data();
+		buffer.alloc_size = frame.size();
+		decoder.encode(image, buffer);
+		return frame;
+	}
+	
+	// A frame rate set on the port wins over the one of the source, as the camera would run at it
+	float
+	GetFps(const CaptureFormat& format, const SyntheticSource& source) {
+		return format.fps > 0 ? format.fps : source.fps;
+	}
+	
+	// Bytes of a packed frame that carry brightness: all of BGR, the Y plane of I420
+	unsigned int
+	GetExposedBytes(const CaptureFormat& format) {
+		const FrameDecoder decoder(format.encoding, format.width, format.height);
+		if (format.encoding == Encoding::NATIVE_BGR) {
+			return decoder.getFrameSize();
+		}
+		return decoder.getStride() * FrameDecoder::AlignHeight(format.height);
+	}
+	
+	// Frames are rendered as exposed at the automatic settings. Others scale them linearly by this factor.
+	double
+	GetExposureFactor(const FrameSettings& settings) {
+		return settings.exposureMicros * (double) settings.analogGain * settings.digitalGain / PIEYE_SYNTHETIC_AUTO_EXPOSURE;
+	}
+	
+	// Maps rendered levels to exposed ones, clipping at white like a sensor
+	void
+	FillResponse(double factor, std::vector<uint8_t>& response) {
+		response.resize(256);
+		for (unsigned int level = 0; level < response.size(); ++level) {
+			response[level] = std::min(255.0, std::floor(level * factor + 0.5));
+		}
+	}
+}
+
+SyntheticBackend::SyntheticBackend(const SyntheticSource& source) : _source(source), _videoRunning(false), _poolStarvations(0),
+		_encoderSettings(), _stillCapture(false) {
+	const FrameSettings settings = {PIEYE_SYNTHETIC_AUTO_EXPOSURE, 1, 1, 1, 1};
+	_requestedSettings = settings;
+	_settings = settings;
+	if (_source.fps < 0) {
+		throw PiEyeException("Synthetic frame rate can't be negative");
+	} else if (_source.jitterMillis < 0) {
+		throw PiEyeException("Synthetic jitter can't be negative");
+	} else if (_source.pattern == SyntheticPattern::FILES && _source.files.empty()) {
+		throw PiEyeException("Synthetic source needs at least one file");
+	}
+}
+
+SyntheticBackend::~SyntheticBackend() {
+	try {
+		destroy();
+	} catch (const std::exception& e) {
+		EZLOG_ERROR("Unable to destroy synthetic camera: " << e.what());
+	}
+}
+
+void
+SyntheticBackend::create(const CaptureFormat& video, const CaptureFormat& still) {
+	if (_created) {
+		return;
+	}
+	if (_source.pattern == SyntheticPattern::FILES) {
+		const std::vector<std::string>::const_iterator fileEnd = _source.files.end();
+		for (std::vector<std::string>::const_iterator it = _source.files.begin(); it != fileEnd; ++it) {
+			const cv::Mat image = cv::imread(*it, cv::IMREAD_COLOR);
+			if (image.empty()) {
+				throw PiEyeException("Unable to load frame [" + *it + "]");
+			}
+			_loadedImages.push_back(image);
+		}
+	}
+	_created = true;
+	reachPhase(StartupPhase::COMPONENT_CREATED);
+	reachPhase(StartupPhase::CONFIGURED);
+	EZLOG_DEBUG("Created synthetic camera at [" << _source.fps << "] fps");
+}
+
+void
+SyntheticBackend::destroy() {
+	stopVideo();
+	closeStill();
+	_loadedImages.clear();
+	_created = false;
+}
+
+bool
+SyntheticBackend::isCreated() const {
+	return _created;
+}
+
+void
+SyntheticBackend::setSettingsHandler(const SettingsHandler& handler) {
+	if (_created) {
+		throw StateException("Cannot change the settings handler after the camera was created");
+	}
+	_settingsHandler = handler;
+}
+
+void
+SyntheticBackend::setPhaseHandler(const PhaseHandler& handler) {
+	if (_created) {
+		throw StateException("Cannot change the phase handler after the camera was created");
+	}
+	_phaseHandler = handler;
+}
+
+void
+SyntheticBackend::startVideo(const CaptureFormat& format, const BufferHandler& handler, const std::vector<StreamFormat>& streams,
+		const StreamGraph::FrameHandler& streamHandler) {
+	if (_videoThread.joinable()) {
+		EZLOG_TRACE("Video already opened");
+		return;
+	} else if (!_created) {
+		throw StateException("Cannot start video before camera was created");
+	}
+	
+	try {
+		if (!streams.empty()) {
+			_streamGraph.reset(new SoftwareStreamGraph(streamHandler));
+			_streamGraph->build(streams);
+		}
+		std::vector<std::vector<uint8_t> > frames;
+		std::vector<cv::Mat> images;
+		packVideo(format, frames, images);
+		reachPhase(StartupPhase::PORT_ENABLED);
+		loadVideo(frames, images);
+		reachPhase(StartupPhase::POOL_ALLOCATED);
+		resetEncoder(GetFps(format, _source));
+		
+		_videoHandler = handler;
+		_videoRunning = true;
+		_videoThread = std::thread(&SyntheticBackend::runVideo, this, GetFps(format, _source), GetExposedBytes(format),
+				handler);
+	} catch (...) {
+		EZLOG_WARN("Could not start synthetic video");
+		stopVideo();
+		throw;
+	}
+}
+
+void
+SyntheticBackend::stopVideo() {
+	_videoRunning = false;
+	if (_videoThread.joinable()) {
+		_videoThread.join();
+	}
+	
+	// Leased buffers keep the pool alive until they are released
+	_videoPool.reset();
+	_streamGraph.reset();
+	{
+		std::lock_guard<std::mutex> lock(_encoderMutex);
+		_encoder.reset();
+	}
+	_videoFrames.clear();
+	_videoImages.clear();
+}
+
+void
+SyntheticBackend::reconfigureVideo(const CaptureFormat& format, const std::function<void()>& stopped) {
+	if (!_videoThread.joinable()) {
+		throw StateException("Cannot reconfigure video before it was started");
+	}
+	
+	// The new frames are packed while the old ones still go out. Only the video thread stops, the stream graph and the
+	// still port stay as they are.
+	std::vector<std::vector<uint8_t> > frames;
+	std::vector<cv::Mat> images;
+	packVideo(format, frames, images);
+	_videoRunning = false;
+	_videoThread.join();
+	try {
+		stopped();
+		loadVideo(frames, images);
+		resetEncoder(GetFps(format, _source));
+		_videoRunning = true;
+		_videoThread = std::thread(&SyntheticBackend::runVideo, this, GetFps(format, _source), GetExposedBytes(format),
+				_videoHandler);
+	} catch (...) {
+		EZLOG_WARN("Could not reconfigure synthetic video");
+		stopVideo();
+		throw;
+	}
+}
+
+bool
+SyntheticBackend::isVideoRunning() const {
+	return _videoThread.joinable();
+}
+
+std::shared_ptr<BufferPool>
+SyntheticBackend::getVideoPool() const {
+	return _videoPool;
+}
+
+unsigned long long
+SyntheticBackend::getPoolStarvations() const {
+	return _poolStarvations;
+}
+
+void
+SyntheticBackend::startEncoder(const EncoderSettings& settings, const EncodedHandler& handler) {
+	if (_encodedHandler) {
+		throw StateException("Encoder is already running");
+	} else if (!handler) {
+		throw PiEyeException("Encoder needs a handler for the encoded stream");
+	}
+	_encoderSettings = settings;
+	_encodedHandler = handler;
+	if (_videoThread.joinable()) {
+		resetEncoder(_videoFps);
+	}
+}
+
+void
+SyntheticBackend::stopEncoder() {
+	_encodedHandler = EncodedHandler();
+	resetEncoder(_videoFps);
+}
+
+bool
+SyntheticBackend::isEncoding() const {
+	return static_cast<bool>(_encodedHandler);
+}
+
+void
+SyntheticBackend::openStill(const CaptureFormat& format, const BufferHandler& handler) {
+	if (_stillPool) {
+		return;
+	}
+	requireCamera();
+	
+	const FrameDecoder decoder(format.encoding, format.width, format.height);
+	_stillFrame = Pack(render(format.width, format.height).front(), decoder);
+	_stillHandler = handler;
+	_stillPool.reset(new SoftwareBufferPool(1, decoder.getFrameSize()));
+}
+
+void
+SyntheticBackend::closeStill() {
+	stopStillCapture();
+	_stillPool.reset();
+	_stillFrame.clear();
+}
+
+bool
+SyntheticBackend::isStillOpen() const {
+	return _stillPool != nullptr;
+}
+
+void
+SyntheticBackend::startStillCapture() {
+	if (!_stillPool) {
+		throw StateException("Still port must be opened first");
+	} else if (_stillCapture) {
+		return;
+	}
+	if (_stillThread.joinable()) {
+		_stillThread.join();
+	}
+	
+	// Delivered from a thread of its own like the camera callback, at the rate of the source or as fast as the buffer
+	// comes back
+	_stillCapture = true;
+	const std::chrono::nanoseconds period(_source.fps > 0 ? (long long) (1e9 / _source.fps) : 0);
+	_stillThread = std::thread([this, period]() {
+		std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+		while (_stillCapture) {
+			if (_settingsHandler) {
+				_settingsHandler(advanceSettings());
+			}
+			if (!Deliver(*_stillPool, _stillFrame, ++_stillCount, _stillHandler)) {
+				EZLOG_WARN("Unable to get a new buffer from pool");
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			next += period;
+			std::this_thread::sleep_until(next);
+		}
+	});
+}
+
+void
+SyntheticBackend::stopStillCapture() {
+	_stillCapture = false;
+	if (_stillThread.joinable()) {
+		_stillThread.join();
+	}
+}
+
+void
+SyntheticBackend::setSensorMode(const SensorMode mode) {
+	requireCamera();
+}
+
+void
+SyntheticBackend::setShutterSpeed(unsigned int micros) {
+	requireCamera();
+	requestSettings([micros](FrameSettings& settings) {
+		settings.exposureMicros = micros > 0 ? micros : PIEYE_SYNTHETIC_AUTO_EXPOSURE;
+	});
+}
+
+void
+SyntheticBackend::setIso(unsigned int iso) {
+	requireCamera();
+}
+
+void
+SyntheticBackend::setAnalogGain(float gain) {
+	requireCamera();
+	requestSettings([gain](FrameSettings& settings) {
+		settings.analogGain = gain > 0 ? gain : 1;
+	});
+}
+
+void
+SyntheticBackend::setDigitalGain(float gain) {
+	requireCamera();
+	requestSettings([gain](FrameSettings& settings) {
+		settings.digitalGain = gain > 0 ? gain : 1;
+	});
+}
+
+void
+SyntheticBackend::setWhiteBalanceMode(const AwbMode& mode) {
+	requireCamera();
+	if (mode != AwbMode::OFF) {
+		requestSettings([](FrameSettings& settings) {
+			settings.redGain = 1;
+			settings.blueGain = 1;
+		});
+	}
+}
+
+void
+SyntheticBackend::setWhiteBalanceGain(float redGain, float blueGain) {
+	requireCamera();
+	requestSettings([redGain, blueGain](FrameSettings& settings) {
+		settings.redGain = redGain;
+		settings.blueGain = blueGain;
+	});
+}
+
+void
+SyntheticBackend::setFpsRange(float minFps, float maxFps) {
+	requireCamera();
+}
+
+std::vector<cv::Mat>
+SyntheticBackend::render(unsigned short width, unsigned short height) const {
+	std::vector<cv::Mat> images;
+	switch (_source.pattern) {
+		case SyntheticPattern::GRADIENT:
+			for (unsigned int frame = 0; frame < PIEYE_SYNTHETIC_GRADIENT_FRAMES; ++frame) {
+				cv::Mat image(height, width, CV_8UC3);
+				const unsigned int shift = frame * 16;
+				for (unsigned short y = 0; y < height; ++y) {
+					uint8_t* row = image.ptr<uint8_t>(y);
+					for (unsigned short x = 0; x < width; ++x) {
+						row[3 * x] = x + shift;
+						row[3 * x + 1] = y + shift;
+						row[3 * x + 2] = (x + y) / 2;
+					}
+				}
+				images.push_back(image);
+			}
+			break;
+		case SyntheticPattern::NOISE: {
+			std::mt19937 generator(width * height);
+			for (unsigned int frame = 0; frame < PIEYE_SYNTHETIC_NOISE_FRAMES; ++frame) {
+				cv::Mat image(height, width, CV_8UC3);
+				for (unsigned short y = 0; y < height; ++y) {
+					uint8_t* row = image.ptr<uint8_t>(y);
+					for (unsigned int i = 0; i < 3u * width; ++i) {
+						row[i] = generator();
+					}
+				}
+				images.push_back(image);
+			}
+			break;
+		}
+		case SyntheticPattern::FILES:
+			// Scaled while packing
+			images = _loadedImages;
+			break;
+	}
+	return images;
+}
+
+void
+SyntheticBackend::packVideo(const CaptureFormat& format, std::vector<std::vector<uint8_t> >& frames, std::vector<cv::Mat>& images) const {
+	const FrameDecoder decoder(format.encoding, format.width, format.height);
+	images = render(format.width, format.height);
+	frames.clear();
+	const std::vector<cv::Mat>::const_iterator imageEnd = images.end();
+	for (std::vector<cv::Mat>::const_iterator it = images.begin(); it != imageEnd; ++it) {
+		frames.push_back(Pack(*it, decoder));
+	}
+}
+
+void
+SyntheticBackend::loadVideo(std::vector<std::vector<uint8_t> >& frames, std::vector<cv::Mat>& images) {
+	_videoFrames.swap(frames);
+	if (_streamGraph) {
+		_videoImages.swap(images);
+	}
+	
+	// Leased buffers of the old format come back to a kept pool, and keep a replaced one alive until then
+	const unsigned int frameSize = _videoFrames.front().size();
+	if (!_videoPool || _videoPool->getBufferSize() < frameSize) {
+		_videoPool.reset(new SoftwareBufferPool(PIEYE_SYNTHETIC_VIDEO_BUFFERS, frameSize));
+	}
+}
+
+void
+SyntheticBackend::runVideo(float fps, unsigned int exposedBytes, const BufferHandler& handler) {
+	EZLOG_DEBUG("Synthetic video started");
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const std::chrono::nanoseconds period(fps > 0 ? (long long) (1e9 / fps) : 0);
+	std::chrono::steady_clock::time_point next = start;
+	
+	// Paced frames lie on a grid of the steady clock, so sources of the same rate capture in step like synchronized
+	// cameras, apart from their jitter
+	if (fps > 0) {
+		next = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				(start.time_since_epoch() / period + 1) * period));
+		std::this_thread::sleep_until(next);
+	}
+	std::vector<uint8_t> response;
+	double responseFactor = 1;
+	std::mt19937 generator(std::random_device{}());
+	const long long jitterNanos = _source.jitterMillis * 1e6;
+	std::uniform_int_distribution<long long> jitter(-jitterNanos, jitterNanos);
+	for (unsigned long long frame = 0; _videoRunning; ++frame) {
+		bool delivered = false;
+		try {
+			const FrameSettings settings = advanceSettings();
+			if (_settingsHandler) {
+				_settingsHandler(settings);
+			}
+			const double factor = GetExposureFactor(settings);
+			if (factor != 1 && factor != responseFactor) {
+				FillResponse(factor, response);
+				responseFactor = factor;
+			}
+			const long long pts = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+			delivered = Deliver(*_videoPool, _videoFrames[frame % _videoFrames.size()], pts, handler,
+					factor != 1 ? response.data() : nullptr, exposedBytes);
+			if (!delivered) {
+				++_poolStarvations;
+				EZLOG_WARN("Unable to get a new buffer from pool");
+			}
+			if (_streamGraph) {
+				_streamGraph->process(_videoImages[frame % _videoImages.size()]);
+			}
+			std::lock_guard<std::mutex> lock(_encoderMutex);
+			if (_encoder) {
+				_encoder->process(pts);
+			}
+		} catch (const std::exception& e) {
+			EZLOG_ERROR("Error occurred in synthetic video: " << e.what());
+		}
+		
+		if (fps > 0) {
+			// Jitter moves single frames, the schedule keeps its pace
+			next += period;
+			std::this_thread::sleep_until(next + std::chrono::nanoseconds(jitter(generator)));
+		} else if (!delivered) {
+			// Unthrottled, but give the consumers a chance to hand buffers back
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	EZLOG_DEBUG("Synthetic video stopped");
+}
+
+void
+SyntheticBackend::resetEncoder(float fps) {
+	// Built outside the lock, the video thread only waits for the swap
+	std::unique_ptr<SoftwareVideoEncoder> encoder;
+	if (_encodedHandler) {
+		try {
+			encoder.reset(new SoftwareVideoEncoder(fps, _encoderSettings, _encodedHandler));
+			encoder->build();
+		} catch (...) {
+			_encodedHandler = EncodedHandler();
+			throw;
+		}
+	}
+	_videoFps = fps;
+	std::lock_guard<std::mutex> lock(_encoderMutex);
+	_encoder.swap(encoder);
+}
+
+void
+SyntheticBackend::requestSettings(const std::function<void(FrameSettings&)>& change) {
+	FrameSettings settings;
+	{
+		std::lock_guard<std::mutex> lock(_settingsMutex);
+		change(_requestedSettings);
+		if (_videoRunning) {
+			_pendingSettings.push_back(std::make_pair(_settingsFrame + PIEYE_SYNTHETIC_SETTINGS_DELAY, _requestedSettings));
+			return;
+		}
+		_settings = _requestedSettings;
+		_pendingSettings.clear();
+		settings = _settings;
+	}
+	
+	// Nothing is captured to carry them, so report them right away
+	if (_settingsHandler) {
+		_settingsHandler(settings);
+	}
+}
+
+FrameSettings
+SyntheticBackend::advanceSettings() {
+	std::lock_guard<std::mutex> lock(_settingsMutex);
+	if (!_videoRunning) {
+		_settings = _requestedSettings;
+		_pendingSettings.clear();
+		return _settings;
+	}
+	++_settingsFrame;
+	while (!_pendingSettings.empty() && _pendingSettings.front().first <= _settingsFrame) {
+		_settings = _pendingSettings.front().second;
+		_pendingSettings.pop_front();
+	}
+	return _settings;
+}
+
+bool
+SyntheticBackend::Deliver(SoftwareBufferPool& pool, const std::vector<uint8_t>& frame, long long pts, const BufferHandler& handler,
+		const uint8_t* response, unsigned int exposedBytes) {
+	MMAL_BUFFER_HEADER_T* buffer = pool.get();
+	if (buffer == nullptr) {
+		return false;
+	}
+	if (response != nullptr) {
+		for (unsigned int i = 0; i < exposedBytes; ++i) {
+			buffer->data[i] = response[frame[i]];
+		}
+		memcpy(buffer->data + exposedBytes, frame.data() + exposedBytes, frame.size() - exposedBytes);
+	} else {
+		memcpy(buffer->data, frame.data(), frame.size());
+	}
+	buffer->offset = 0;
+	buffer->length = frame.size();
+	buffer->pts = pts;
+	buffer->dts = pts;
+	
+	// Same contract as the camera callback: a kept buffer comes back through the pool
+	if (!handler(buffer)) {
+		pool.unlock(buffer);
+		pool.recycle(buffer);
+	}
+	return true;
+}
+
+void
+SyntheticBackend::reachPhase(const StartupPhase& phase) const {
+	if (_phaseHandler) {
+		_phaseHandler(phase);
+	}
+}
+
+void
+SyntheticBackend::requireCamera() const {
+	if (!_created) {
+		throw StateException("Camera must be created first");
+	}
+}
@@ -0,0 +1,211 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CaptureBackend.h"
+#include "SyntheticSource.hpp"
+
+namespace cv {
+	class Mat;
+}
+
+class SoftwareBufferPool;
+class SoftwareStreamGraph;
+class SoftwareVideoEncoder;
+
+/**
+ * Backend without camera hardware. A thread of its own fills buffers of a software pool with generated frames at the
+ * configured rate and runs them through the same handlers as the camera would; extra streams come from the software
+ * stand-in of the splitter and ISPs, recorded video from the stand-in of the encoder. Exposure controls take effect a couple of frames after they are set, like on the
+ * camera, and are reported as the settings of the frames; the frames themselves don't change. As on the sensor, every
+ * change is pipelined on its own, so changing settings on every frame changes them on every frame a little later.
+ */
+class SyntheticBackend : public CaptureBackend {
+public:
+	explicit SyntheticBackend(const SyntheticSource& source);
+	virtual ~SyntheticBackend();
+
+	virtual void
+	create(const CaptureFormat& video, const CaptureFormat& still);
+
+	virtual void
+	destroy();
+
+	virtual bool
+	isCreated() const;
+
+	virtual void
+	setSettingsHandler(const SettingsHandler& handler);
+
+	virtual void
+	setPhaseHandler(const PhaseHandler& handler);
+
+	virtual void
+	startVideo(const CaptureFormat& format, const BufferHandler& handler, const std::vector<StreamFormat>& streams,
+			const StreamGraph::FrameHandler& streamHandler);
+
+	virtual void
+	stopVideo();
+
+	virtual void
+	reconfigureVideo(const CaptureFormat& format, const std::function<void()>& stopped);
+
+	virtual bool
+	isVideoRunning() const;
+
+	virtual std::shared_ptr<BufferPool>
+	getVideoPool() const;
+
+	virtual unsigned long long
+	getPoolStarvations() const;
+
+	virtual void
+	startEncoder(const EncoderSettings& settings, const EncodedHandler& handler);
+
+	virtual void
+	stopEncoder();
+
+	virtual bool
+	isEncoding() const;
+
+	virtual void
+	openStill(const CaptureFormat& format, const BufferHandler& handler);
+
+	virtual void
+	closeStill();
+
+	virtual bool
+	isStillOpen() const;
+
+	virtual void
+	startStillCapture();
+
+	virtual void
+	stopStillCapture();
+
+	virtual void
+	setSensorMode(const SensorMode mode);
+
+	virtual void
+	setShutterSpeed(unsigned int micros);
+
+	virtual void
+	setIso(unsigned int iso);
+
+	virtual void
+	setAnalogGain(float gain);
+
+	virtual void
+	setDigitalGain(float gain);
+
+	virtual void
+	setWhiteBalanceMode(const AwbMode& mode);
+
+	virtual void
+	setWhiteBalanceGain(float redGain, float blueGain);
+
+	virtual void
+	setFpsRange(float minFps, float maxFps);
+
+private:
+	const SyntheticSource _source;
+	bool _created = false;
+	std::vector<cv::Mat> _loadedImages;
+	std::atomic<bool> _videoRunning;
+	std::atomic<unsigned long long> _poolStarvations;
+	std::thread _videoThread;
+	BufferHandler _videoHandler;
+	std::shared_ptr<SoftwareBufferPool> _videoPool;
+	std::vector<std::vector<uint8_t> > _videoFrames;	// Packed once for the video port, copied per delivery
+	std::vector<cv::Mat> _videoImages;	// Source of the packed frames, only kept for the stream graph
+	std::unique_ptr<SoftwareStreamGraph> _streamGraph;
+	std::mutex _encoderMutex;	// The encoder comes and goes while the video thread runs
+	std::unique_ptr<SoftwareVideoEncoder> _encoder;
+	EncoderSettings _encoderSettings;
+	EncodedHandler _encodedHandler;	// Set while encoding is on, also with video stopped
+	float _videoFps = 0;
+	std::shared_ptr<SoftwareBufferPool> _stillPool;
+	std::vector<uint8_t> _stillFrame;
+	BufferHandler _stillHandler;
+	std::thread _stillThread;
+	std::atomic<bool> _stillCapture;	// Stills keep coming from the still thread while set
+	unsigned long long _stillCount = 0;
+	SettingsHandler _settingsHandler;
+	PhaseHandler _phaseHandler;
+	std::mutex _settingsMutex;
+	FrameSettings _requestedSettings;
+	FrameSettings _settings;
+	std::deque<std::pair<unsigned long long, FrameSettings> > _pendingSettings;	// Requested settings by the frame they take effect on
+	unsigned long long _settingsFrame = 0;
+
+	void
+	reachPhase(const StartupPhase& phase) const;
+
+	// BGR images of the source at the given size
+	std::vector<cv::Mat>
+	render(unsigned short width, unsigned short height) const;
+
+	// Renders the source in the given format, packed for the video port and as images for the stream graph
+	void
+	packVideo(const CaptureFormat& format, std::vector<std::vector<uint8_t> >& frames, std::vector<cv::Mat>& images) const;
+
+	// Makes the packed frames those of the video port, with a new pool unless the buffers of the current one fit them.
+	// Only while the video thread is stopped.
+	void
+	loadVideo(std::vector<std::vector<uint8_t> >& frames, std::vector<cv::Mat>& images);
+
+	// Brightness follows exposure and gains over the first exposedBytes of every frame
+	void
+	runVideo(float fps, unsigned int exposedBytes, const BufferHandler& handler);
+
+	// Builds the encoder for video at the given rate, or drops it if encoding is off
+	void
+	resetEncoder(float fps);
+
+	// Changes the requested settings. They take effect on a later video frame, or right away if video is stopped.
+	void
+	requestSettings(const std::function<void(FrameSettings&)>& change);
+
+	// Settings in effect for the next video frame
+	FrameSettings
+	advanceSettings();
+
+	// Copies a packed frame into a free buffer of the pool and hands it to the handler. False if the pool ran dry. With
+	// a response, the first exposedBytes are mapped through it on the way.
+	static bool
+	Deliver(SoftwareBufferPool& pool, const std::vector<uint8_t>& frame, long long pts, const BufferHandler& handler,
+			const uint8_t* response = nullptr, unsigned int exposedBytes = 0);
+
+	void
+	requireCamera() const;
+
+	SyntheticBackend(const SyntheticBackend&);
+	SyntheticBackend& operator=(const SyntheticBackend&);
+};
@@ -22,13 +22,16 @@ SOFTWARE.
 */
 #pragma once
 
+#include <interface/mmal/mmal.h>
 #include <interface/mmal/mmal_types.h>
 #include <interface/mmal/mmal_encodings.h>
+#include <interface/mmal/util/mmal_connection.h>
+#include "Encoding.hpp"
 #include "PiEyeException.hpp"
 
 #define PIEYE_RATIONAL_SCALE 1000
 
-std::string
+inline std::string
 StatusToString(const MMAL_STATUS_T& status) {
 	switch (status) {
 	case MMAL_SUCCESS:
@@ -87,14 +90,14 @@ StatusToString(const MMAL_STATUS_T& status) {
 	return "UNKNOWN";
 }
 
-void
+inline void
 CheckStatus(const MMAL_STATUS_T& status, const std::string& message) {
     if (status != MMAL_SUCCESS) {
         throw StatusException(status, message + ": " + StatusToString(status));
     }
 }
 
-std::string
+inline std::string
 ParameterToString(const unsigned int parameter) {
     switch (parameter) {
         case MMAL_PARAMETER_CAMERA_CUSTOM_SENSOR_CONFIG:
@@ -103,6 +106,12 @@ ParameterToString(const unsigned int parameter) {
         case MMAL_PARAMETER_CAPTURE:
             return "CAPTURE";
             break;
+        case MMAL_PARAMETER_CAMERA_NUM:
+            return "CAMERA_NUM";
+            break;
+        case MMAL_PARAMETER_CAMERA_BURST_CAPTURE:
+            return "CAMERA_BURST_CAPTURE";
+            break;
         case MMAL_PARAMETER_SHUTTER_SPEED:
             return "SHUTTER_SPEED";
             break;
@@ -125,7 +134,54 @@ ParameterToString(const unsigned int parameter) {
     return "Unknown parameter [" + std::to_string(parameter) + "]";
 }
 
-MMAL_RATIONAL_T ToRational(float value) {
+inline MMAL_RATIONAL_T ToRational(float value) {
     const float scaledValue = value * PIEYE_RATIONAL_SCALE;
     return {(int) scaledValue, PIEYE_RATIONAL_SCALE};
 }
+
+inline float FromRational(const MMAL_RATIONAL_T& value) {
+    return value.den == 0 ? 0 : (float) value.num / value.den;
+}
+
+inline unsigned int
+GetMmalEncoding(const Encoding& encoding) {
+	switch(encoding) {
+		case Encoding::NATIVE_BGR:
+			return MMAL_ENCODING_BGR24;
+		case Encoding::NATIVE_GRAYSCALE:
+		case Encoding::CONVERTED_BGR:
+			return MMAL_ENCODING_I420;
+	}
+	
+	throw PiEyeException("Encoding not supported");
+}
+
+// Gives an input or output the format of the port upstream of it
+inline void
+CopyFormat(MMAL_PORT_T* target, const MMAL_PORT_T* source) {
+	mmal_format_copy(target->format, source->format);
+	const MMAL_STATUS_T status = mmal_port_format_commit(target);
+	CheckStatus(status, "Unable to copy format to a graph port");
+}
+
+inline void
+DestroyConnection(MMAL_CONNECTION_T*& connection) {
+	if (connection) {
+		if (connection->is_enabled) {
+			CheckStatus(mmal_connection_disable(connection), "Unable to disable connection");
+		}
+		CheckStatus(mmal_connection_destroy(connection), "Unable to destroy connection");
+		connection = nullptr;
+	}
+}
+
+inline void
+DestroyComponent(MMAL_COMPONENT_T*& component) {
+	if (component) {
+		if (component->is_enabled) {
+			CheckStatus(mmal_component_disable(component), "Unable to disable component");
+		}
+		CheckStatus(mmal_component_destroy(component), "Unable to destroy component");
+		component = nullptr;
+	}
+}
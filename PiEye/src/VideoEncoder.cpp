@@ -0,0 +1,81 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "VideoEncoder.h"
+
+#include <interface/mmal/mmal_buffer.h>
+
+#include "PiEyeException.hpp"
+#include "Log.hpp"
+
+#define PIEYE_DEFAULT_BITRATE 17000000
+#define PIEYE_DEFAULT_INTRA_PERIOD 60
+#define PIEYE_MAX_H264_BITRATE 25000000
+
+namespace {
+	EncoderSettings
+	FillDefaults(EncoderSettings settings) {
+		if (settings.bitrate == 0) {
+			settings.bitrate = PIEYE_DEFAULT_BITRATE;
+		}
+		if (settings.intraPeriod == 0) {
+			settings.intraPeriod = PIEYE_DEFAULT_INTRA_PERIOD;
+		}
+		
+		// Level 4, the highest the encoder supports
+		if (settings.codec == VideoCodec::H264 && settings.bitrate > PIEYE_MAX_H264_BITRATE) {
+			throw PiEyeException("H.264 bitrate is limited to [" + std::to_string(PIEYE_MAX_H264_BITRATE) + "], got ["
+					+ std::to_string(settings.bitrate) + "]");
+		}
+		return settings;
+	}
+}
+
+VideoEncoder::VideoEncoder(const EncoderSettings& settings, const EncodedHandler& handler) : _settings(FillDefaults(settings)),
+		_handler(handler) {
+	if (!_handler) {
+		throw PiEyeException("Video encoder needs a handler for the encoded stream");
+	}
+}
+
+VideoEncoder::~VideoEncoder() {
+}
+
+const EncoderSettings&
+VideoEncoder::getSettings() const {
+	return _settings;
+}
+
+void
+VideoEncoder::deliver(const MMAL_BUFFER_HEADER_T& buffer) {
+	if (buffer.length == 0) {
+		return;
+	}
+	const EncodedChunk chunk = {buffer.data + buffer.offset, buffer.length, buffer.pts,
+			(buffer.flags & MMAL_BUFFER_HEADER_FLAG_KEYFRAME) != 0, (buffer.flags & MMAL_BUFFER_HEADER_FLAG_CONFIG) != 0,
+			(buffer.flags & MMAL_BUFFER_HEADER_FLAG_FRAME_END) != 0};
+	try {
+		_handler(chunk);
+	} catch (const std::exception& e) {
+		EZLOG_WARN("Error occurred while handling an encoded chunk: " << e.what());
+	}
+}
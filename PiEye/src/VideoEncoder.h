@@ -0,0 +1,61 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include "EncoderSettings.hpp"
+
+struct MMAL_BUFFER_HEADER_T;
+
+/**
+ * Encodes the frames of the video port into an H.264 or MJPEG elementary stream, next to the frames that are decoded.
+ * Chunks of the stream are handed to the handler from the thread that delivered their buffer. Defaults of the settings
+ * are filled in on construction.
+ */
+class VideoEncoder {
+public:
+	VideoEncoder(const EncoderSettings& settings, const EncodedHandler& handler);
+	virtual ~VideoEncoder();
+
+	virtual void
+	build() = 0;
+
+	// Tears down whatever was built, also after a failed build
+	virtual void
+	destroy() = 0;
+
+	const EncoderSettings&
+	getSettings() const;
+
+protected:
+	const EncoderSettings _settings;
+
+	// Hands the payload of an encoded buffer on as a chunk
+	void
+	deliver(const MMAL_BUFFER_HEADER_T& buffer);
+
+private:
+	EncodedHandler _handler;
+
+	VideoEncoder(const VideoEncoder&);
+	VideoEncoder& operator=(const VideoEncoder&);
+};
@@ -28,7 +28,7 @@ SOFTWARE.
 #include "PiEyeException.hpp"
 #include "Log.hpp"
 
-Wait::Wait() : _mutex(new std::mutex()), _condition(new std::condition_variable()) {
+Wait::Wait() : _timeOuts(0), _mutex(new std::mutex()), _condition(new std::condition_variable()) {
 }
 
 Wait::~Wait() {
@@ -51,6 +51,22 @@ Wait::wait(unsigned short seconds) {
 	
 	while(_wait) {
 		if (_condition->wait_for(lock, std::chrono::seconds(seconds)) == std::cv_status::timeout) {
+			++_timeOuts;
+			throw TimeOutException("Time out occurred");
+		}
+	}
+	EZLOG_TRACE("Done waiting");
+}
+
+void
+Wait::wait(unsigned short seconds, const std::function<bool()>& ready) {
+	EZLOG_TRACE("Waiting until ready...");
+	std::unique_lock<std::mutex> lock(*_mutex);
+	const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+	
+	while (!ready()) {
+		if (_condition->wait_until(lock, deadline) == std::cv_status::timeout && !ready()) {
+			++_timeOuts;
 			throw TimeOutException("Time out occurred");
 		}
 	}
@@ -64,4 +80,9 @@ Wait::notify() {
 	_wait = false;
 	_condition->notify_all();
 	EZLOG_TRACE("Notified");
+}
+
+unsigned long long
+Wait::getTimeOuts() const {
+	return _timeOuts;
 }
\ No newline at end of file
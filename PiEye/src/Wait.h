@@ -22,6 +22,9 @@ SOFTWARE.
 */
 #pragma once
 
+#include <atomic>
+#include <functional>
+
 namespace std {
 	class mutex;
 	class condition_variable;
@@ -35,11 +38,20 @@ public:
 	void
 	wait(unsigned short seconds);
 	
+	// Waits until ready() holds. ready() is evaluated under the same lock as notify(), so no notification is missed.
+	void
+	wait(unsigned short seconds, const std::function<bool()>& ready);
+	
 	void
 	notify();
 
+	// Waits that ended in a TimeOutException
+	unsigned long long
+	getTimeOuts() const;
+
 private:
 	bool _wait;
+	std::atomic<unsigned long long> _timeOuts;
 	std::mutex* _mutex;
 	std::condition_variable* _condition;
 };
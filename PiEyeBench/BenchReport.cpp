@@ -0,0 +1,111 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "BenchReport.h"
+
+#include <ctime>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <Log.hpp>
+
+#include "I420Converter.h"
+
+namespace {
+	std::string
+	Quote(const std::string& text) {
+		std::string quoted = "\"";
+		for (auto&& character : text) {
+			if (character == '"' || character == '\\') {
+				quoted += '\\';
+			}
+			quoted += character;
+		}
+		return quoted + "\"";
+	}
+
+	// JSON has no NaN or infinity
+	std::string
+	Number(double value) {
+		if (!std::isfinite(value)) {
+			return "null";
+		}
+		std::ostringstream stream;
+		stream.precision(10);
+		stream << value;
+		return stream.str();
+	}
+}
+
+BenchReport::BenchReport() {
+	const std::time_t now = std::time(nullptr);
+	std::tm local;
+	localtime_r(&now, &local);
+	char text[32];
+	std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &local);
+	_started = text;
+}
+
+void
+BenchReport::add(const std::string& group, const std::string& name, const Parameters& parameters, const Metrics& metrics) {
+	const Result result = {group, name, parameters, metrics};
+	_results.push_back(result);
+
+	std::ostringstream line;
+	line << group << " " << name;
+	for (auto&& parameter : parameters) {
+		line << " " << parameter.first << "=" << parameter.second;
+	}
+	line << ":";
+	for (auto&& metric : metrics) {
+		line << " " << metric.first << " [" << (float) metric.second << "]";
+	}
+	EZLOG_INFO(line.str());
+}
+
+void
+BenchReport::write(const std::string& path) const {
+	std::ofstream file(path.c_str(), std::ios::out | std::ios::trunc);
+	if (!file) {
+		throw std::runtime_error("Unable to write results to [" + path + "]");
+	}
+
+	file << "{\n\t\"started\": " << Quote(_started) << ",\n\t\"compiler\": " << Quote(__VERSION__)
+			<< ",\n\t\"i420Kernel\": " << Quote(I420Converter::GetKernelName()) << ",\n\t\"results\": [";
+	for (size_t i = 0; i < _results.size(); ++i) {
+		const Result& result = _results[i];
+		file << (i == 0 ? "\n" : ",\n") << "\t\t{\"group\": " << Quote(result.group) << ", \"name\": " << Quote(result.name)
+				<< ", \"parameters\": {";
+		for (size_t j = 0; j < result.parameters.size(); ++j) {
+			file << (j == 0 ? "" : ", ") << Quote(result.parameters[j].first) << ": " << Quote(result.parameters[j].second);
+		}
+		file << "}, \"metrics\": {";
+		for (size_t j = 0; j < result.metrics.size(); ++j) {
+			file << (j == 0 ? "" : ", ") << Quote(result.metrics[j].first) << ": " << Number(result.metrics[j].second);
+		}
+		file << "}}";
+	}
+	file << "\n\t]\n}\n";
+	EZLOG_INFO("Wrote [" << _results.size() << "] results to [" << path << "]");
+}
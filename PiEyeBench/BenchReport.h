@@ -0,0 +1,56 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Collects benchmark results, logs each one as it comes in and writes all of them as JSON, so runs of different
+ * releases can be compared.
+ */
+class BenchReport {
+public:
+	typedef std::vector<std::pair<std::string, std::string> > Parameters;
+	typedef std::vector<std::pair<std::string, double> > Metrics;
+
+	BenchReport();
+
+	void
+	add(const std::string& group, const std::string& name, const Parameters& parameters, const Metrics& metrics);
+
+	void
+	write(const std::string& path) const;
+
+private:
+	struct Result {
+		std::string group;
+		std::string name;
+		Parameters parameters;
+		Metrics metrics;
+	};
+
+	std::string _started;
+	std::vector<Result> _results;
+};
@@ -0,0 +1,121 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "BenchUtil.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <stdexcept>
+
+#include <opencv2/core/core.hpp>
+#include <interface/mmal/mmal_buffer.h>
+
+#include "SoftwareBufferPool.h"
+
+std::string
+ToString(const Resolution& resolution) {
+	return std::to_string(resolution.width) + "x" + std::to_string(resolution.height);
+}
+
+const char*
+GetEncodingName(const Encoding& encoding) {
+	switch (encoding) {
+		case Encoding::NATIVE_BGR:
+			return "BGR";
+		case Encoding::NATIVE_GRAYSCALE:
+			return "GRAY";
+		case Encoding::CONVERTED_BGR:
+			return "I420>BGR";
+	}
+	return "?";
+}
+
+unsigned long
+ConsumeImage(const cv::Mat& image) {
+	unsigned long checksum = 0;
+	for (int row = 0; row < image.rows; ++row) {
+		checksum += image.ptr<uchar>(row)[0];
+	}
+	return checksum;
+}
+
+MMAL_BUFFER_HEADER_T*
+ProduceBuffer(SoftwareBufferPool& pool) {
+	MMAL_BUFFER_HEADER_T* buffer = pool.get();
+	if (buffer == nullptr) {
+		throw std::runtime_error("Software pool ran dry");
+	}
+	buffer->offset = 0;
+	buffer->length = pool.getBufferSize();
+	return buffer;
+}
+
+void
+FillNoise(MMAL_BUFFER_HEADER_T& buffer) {
+	uint32_t state = 12345;
+	for (uint32_t i = 0; i < buffer.length; ++i) {
+		state = state * 1103515245 + 12345;
+		buffer.data[buffer.offset + i] = state >> 24;
+	}
+}
+
+int
+MaxDifference(const cv::Mat& first, const cv::Mat& second) {
+	if (first.rows != second.rows || first.cols != second.cols || first.type() != second.type()) {
+		throw std::runtime_error("Images differ in size or type");
+	}
+	int difference = 0;
+	for (int row = 0; row < first.rows; ++row) {
+		for (int i = 0; i < first.cols * first.channels(); ++i) {
+			difference = std::max(difference, std::abs(first.ptr<uchar>(row)[i] - second.ptr<uchar>(row)[i]));
+		}
+	}
+	return difference;
+}
+
+double
+GetSeconds(const std::chrono::steady_clock::duration& duration) {
+	return std::chrono::duration_cast<std::chrono::duration<double> >(duration).count();
+}
+
+double
+GetFps(unsigned int frameCount, const std::chrono::steady_clock::duration& duration) {
+	return frameCount / GetSeconds(duration);
+}
+
+double
+GetCpuSeconds() {
+	timespec time;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+double
+GetPercentile(std::vector<double>& samples, double fraction) {
+	if (samples.empty()) {
+		return 0;
+	}
+	std::sort(samples.begin(), samples.end());
+	const size_t index = std::min(samples.size() - 1, (size_t) (fraction * samples.size()));
+	return samples[index];
+}
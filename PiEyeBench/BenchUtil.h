@@ -0,0 +1,80 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Encoding.hpp"
+
+namespace cv {
+	class Mat;
+}
+
+struct MMAL_BUFFER_HEADER_T;
+class SoftwareBufferPool;
+class FrameDecoder;
+
+struct Resolution {
+	unsigned short width;
+	unsigned short height;
+};
+
+const Resolution BENCH_RESOLUTIONS[] = {{640, 480}, {1280, 720}, {1920, 1080}, {3280, 2464}};
+
+std::string
+ToString(const Resolution& resolution);
+
+const char*
+GetEncodingName(const Encoding& encoding);
+
+// Touches one byte per row, so both paths hand over an image that is actually read
+unsigned long
+ConsumeImage(const cv::Mat& image);
+
+// Fakes the camera callback: takes a buffer from the pool and fills in the length of a full frame
+MMAL_BUFFER_HEADER_T*
+ProduceBuffer(SoftwareBufferPool& pool);
+
+// Fills the buffer with noise, so conversions see every combination of Y, U and V
+void
+FillNoise(MMAL_BUFFER_HEADER_T& buffer);
+
+// Largest difference between two images of the same size and type
+int
+MaxDifference(const cv::Mat& first, const cv::Mat& second);
+
+double
+GetSeconds(const std::chrono::steady_clock::duration& duration);
+
+double
+GetFps(unsigned int frameCount, const std::chrono::steady_clock::duration& duration);
+
+// CPU time of all threads of the process so far
+double
+GetCpuSeconds();
+
+// Value below which the given fraction of the samples falls. Sorts the samples.
+double
+GetPercentile(std::vector<double>& samples, double fraction);
@@ -0,0 +1,1232 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <Log.hpp>
+#include <PiEye.h>
+#include <PiEyeRig.h>
+
+#include "AllocationCounter.h"
+#include "BenchReport.h"
+#include "BenchUtil.h"
+#include "FrameDecoder.h"
+#include "FrameLease.h"
+#include "FramePromises.h"
+#include "RingBuffer.h"
+#include "Subscriber.h"
+
+namespace {
+	const unsigned int RING_FPS = 500;
+	const unsigned int RING_SECONDS = 2;
+	const unsigned int SHARED_RING_ITEMS = 200000;	// Per producer
+	const unsigned int SHARED_RING_DEPTH = 64;
+	const unsigned int ASYNC_FPS = 100;
+	const unsigned int ASYNC_FRAMES = 200;
+	const unsigned int FANOUT_FPS = 100;
+	const unsigned int FANOUT_FRAMES = 300;
+	const unsigned int SYNTHETIC_FRAME_COUNT = 300;
+	const float SYNTHETIC_FPS = 30;
+	const unsigned int SYNTHETIC_PACED_FRAME_COUNT = 60;
+	const float SETTINGS_FPS = 100;
+	const unsigned int SETTINGS_STEPS = 10;
+	// Gains and shutter speeds of the bracket sweep, as in the calibration loop of PiEyeTest
+	const unsigned int BRACKET_GAINS = 5;
+	const unsigned int BRACKET_SHUTTERS = 9;
+	// Stills per run when comparing single stills against a burst
+	const unsigned int BURST_STILLS = 20;
+	const float RECONFIGURE_FPS = 100;
+	// Every combination of the three smaller resolutions and the three encodings
+	const unsigned int RECONFIGURE_STEPS = 9;
+	const float STARTUP_FPS = 30;
+	const unsigned int MIXED_FRAMES = 100;
+	const float RECORDING_FPS = 30;
+	const unsigned int RECORDING_FRAMES = 60;
+	const unsigned int RECORDING_BITRATE = 10000000;
+	const unsigned int RECORDING_INTRA_PERIOD = 30;
+	const float EVENT_PRE_ROLL_SECONDS = 2;
+	const float EVENT_POST_ROLL_SECONDS = 1;
+	const char* const EVENT_FILE = "PiEyeBench.h264";
+	const unsigned int EVENT_STRESS_CYCLES = 20;
+	const unsigned int EVENT_STRESS_CYCLE_MILLIS = 100;
+	const unsigned int EVENT_STRESS_TRIGGER_MILLIS = 10;
+	const float MOTION_FPS = 30;
+	const unsigned int MOTION_SECONDS = 3;
+	const float STATISTICS_FPS = 30;
+	const unsigned int STATISTICS_SECONDS = 3;
+	const float EXPOSURE_FPS = 60;
+	const float EXPOSURE_MISTUNED_GAMMA = 2;
+	const unsigned int EXPOSURE_TIMEOUT = 5;
+	const float RIG_FPS = 30;
+	const unsigned int RIG_SECONDS = 3;
+	const unsigned int RIG_TOLERANCE_MICROS = 5000;
+	const unsigned int DECODE_SECONDS = 2;
+	const char* const GROUP = "macro";
+
+	// Simulated callbacks push stamped frames at RING_FPS while a slower consumer pops them
+	void
+	StressFrameRing(BenchReport& report, const QueuePolicy& policy, unsigned int depth, unsigned int consumerMillis) {
+		RingBuffer<cv::Mat> ring(depth, policy);
+		std::atomic<bool> producing(true);
+		unsigned long long maxPushMicros = 0;
+		const unsigned int frameCount = RING_FPS * RING_SECONDS;
+
+		std::thread producer([&]() {
+			const std::chrono::microseconds period(1000 * 1000 / RING_FPS);
+			std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+			for (unsigned int sequence = 1; sequence <= frameCount; ++sequence) {
+				cv::Mat frame(480, 640, CV_8UC1);
+				memcpy(frame.ptr<uchar>(0), &sequence, sizeof(sequence));
+
+				const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				ring.push(frame);
+				const unsigned long long micros = std::chrono::duration_cast<std::chrono::microseconds>(
+						std::chrono::steady_clock::now() - start).count();
+				maxPushMicros = std::max(maxPushMicros, micros);
+
+				next += period;
+				std::this_thread::sleep_until(next);
+			}
+			producing = false;
+		});
+
+		unsigned int popped = 0;
+		unsigned int lastSequence = 0;
+		bool ordered = true;
+		cv::Mat frame;
+		while (producing || ring.size() > 0) {
+			if (!ring.pop(frame)) {
+				std::this_thread::yield();
+				continue;
+			}
+			unsigned int sequence;
+			memcpy(&sequence, frame.ptr<uchar>(0), sizeof(sequence));
+			ordered = ordered && sequence > lastSequence;
+			lastSequence = sequence;
+			++popped;
+			std::this_thread::sleep_for(std::chrono::milliseconds(consumerMillis));
+		}
+		producer.join();
+
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("policy", std::string(policy == QueuePolicy::OVERWRITE_OLDEST ? "overwrite-oldest"
+				: "reject-newest")));
+		parameters.push_back(std::make_pair("depth", std::to_string(depth)));
+		parameters.push_back(std::make_pair("consumerMillis", std::to_string(consumerMillis)));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("pushed", (double) frameCount));
+		metrics.push_back(std::make_pair("popped", (double) popped));
+		metrics.push_back(std::make_pair("dropped", (double) ring.getDropped()));
+		metrics.push_back(std::make_pair("maxPushMicros", (double) maxPushMicros));
+		report.add(GROUP, "frameRing", parameters, metrics);
+		if (!ordered || popped + ring.getDropped() != frameCount) {
+			throw std::runtime_error("Frame ring lost track of frames");
+		}
+	}
+
+	// Producers and consumers hammer one ring, as every thread does with the log queue. Each item must come out at most
+	// once and in the order of its producer, the rest counted as dropped, and neither side may allocate.
+	void
+	StressSharedRing(BenchReport& report, const QueuePolicy& policy, unsigned int producerCount, unsigned int consumerCount) {
+		RingBuffer<unsigned long long> ring(SHARED_RING_DEPTH, policy);
+		std::atomic<bool> started(false);
+		std::atomic<unsigned int> producing(producerCount);
+		std::atomic<unsigned long> allocations(0);
+		std::vector<std::vector<unsigned long long> > popped(consumerCount + 1);
+		for (auto&& items : popped) {
+			items.reserve((size_t) producerCount * SHARED_RING_ITEMS);
+		}
+
+		std::vector<std::thread> threads;
+		for (unsigned int producer = 0; producer < producerCount; ++producer) {
+			threads.push_back(std::thread([&, producer]() {
+				while (!started) {
+					std::this_thread::yield();
+				}
+				const unsigned long allocationsBefore = GetThreadAllocations();
+				const unsigned long long first = (unsigned long long) producer * SHARED_RING_ITEMS;
+				for (unsigned long long item = first; item < first + SHARED_RING_ITEMS; ++item) {
+					ring.push(item);
+					
+					// Lets the consumers in between bursts, even on a single core
+					if (item % SHARED_RING_DEPTH == 0) {
+						std::this_thread::yield();
+					}
+				}
+				allocations += GetThreadAllocations() - allocationsBefore;
+				--producing;
+			}));
+		}
+		for (unsigned int consumer = 0; consumer < consumerCount; ++consumer) {
+			threads.push_back(std::thread([&, consumer]() {
+				std::vector<unsigned long long>& items = popped[consumer];
+				const unsigned long allocationsBefore = GetThreadAllocations();
+				unsigned long long item;
+				while (producing > 0 || ring.size() > 0) {
+					if (ring.pop(item)) {
+						items.push_back(item);
+					} else {
+						std::this_thread::yield();
+					}
+				}
+				allocations += GetThreadAllocations() - allocationsBefore;
+			}));
+		}
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		started = true;
+		for (auto&& thread : threads) {
+			thread.join();
+		}
+		const double seconds = GetSeconds(std::chrono::steady_clock::now() - start);
+		unsigned long long item;
+		while (ring.pop(item)) {
+			popped[consumerCount].push_back(item);
+		}
+
+		// Every consumer sees the items of a producer in the order they were pushed
+		const unsigned long long pushed = (unsigned long long) producerCount * SHARED_RING_ITEMS;
+		std::vector<unsigned char> seen(pushed, 0);
+		unsigned long long poppedCount = 0;
+		bool duplicated = false;
+		bool ordered = true;
+		for (auto&& items : popped) {
+			std::vector<long long> last(producerCount, -1);
+			for (auto&& value : items) {
+				if (value >= pushed || seen[value]++ > 0) {
+					duplicated = true;
+					continue;
+				}
+				const unsigned int producer = value / SHARED_RING_ITEMS;
+				ordered = ordered && (long long) value > last[producer];
+				last[producer] = value;
+			}
+			poppedCount += items.size();
+		}
+
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("policy", std::string(policy == QueuePolicy::OVERWRITE_OLDEST ? "overwrite-oldest"
+				: "reject-newest")));
+		parameters.push_back(std::make_pair("producers", std::to_string(producerCount)));
+		parameters.push_back(std::make_pair("consumers", std::to_string(consumerCount)));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("itemsPerSecond", pushed / seconds));
+		metrics.push_back(std::make_pair("popped", (double) poppedCount));
+		metrics.push_back(std::make_pair("dropped", (double) ring.getDropped()));
+		metrics.push_back(std::make_pair("allocations", (double) allocations.load()));
+		report.add(GROUP, "sharedRing", parameters, metrics);
+		if (duplicated) {
+			throw std::runtime_error("Shared ring handed out an item twice");
+		} else if (!ordered) {
+			throw std::runtime_error("Shared ring reordered the items of a producer");
+		} else if (poppedCount + ring.getDropped() != pushed) {
+			throw std::runtime_error("Shared ring lost items: " + std::to_string(pushed - poppedCount - ring.getDropped())
+					+ " of " + std::to_string(pushed));
+		} else if (allocations > 0) {
+			throw std::runtime_error("Shared ring allocated on a producer or consumer");
+		}
+	}
+
+	// Simulated callbacks fulfil requests at ASYNC_FPS, the consumer spends a bit more than a frame period per frame
+	void
+	BenchAsyncOverlap(BenchReport& report, unsigned int inFlight) {
+		FramePromises promises;
+		std::atomic<bool> producing(true);
+		std::thread producer([&]() {
+			const cv::Mat frame(480, 640, CV_8UC1);
+			const std::chrono::microseconds period(1000 * 1000 / ASYNC_FPS);
+			std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+			while (producing) {
+				if (promises.hasPending()) {
+					promises.fulfil(frame);
+				}
+				next += period;
+				std::this_thread::sleep_until(next);
+			}
+		});
+
+		const std::chrono::microseconds processing(1200 * 1000 / ASYNC_FPS);
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::deque<std::future<cv::Mat> > requests;
+		for (unsigned int i = 0; i < ASYNC_FRAMES; ++i) {
+			// With more than one in flight, the next request is pending while this frame is processed
+			while (requests.size() < inFlight) {
+				requests.push_back(promises.add());
+			}
+			const cv::Mat frame = requests.front().get();
+			requests.pop_front();
+			std::this_thread::sleep_for(processing);
+		}
+		const std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - start;
+
+		producing = false;
+		producer.join();
+		promises.failAll(std::make_exception_ptr(std::runtime_error("Benchmark done")));
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("inFlight", std::to_string(inFlight)));
+		parameters.push_back(std::make_pair("cameraFps", std::to_string(ASYNC_FPS)));
+		report.add(GROUP, "asyncOverlap", parameters, BenchReport::Metrics(1, std::make_pair("fps", GetFps(ASYNC_FRAMES, duration))));
+	}
+
+	// One camera feeding a fast recorder, a slow analytics thread and a decimated preview
+	void
+	StressFanOut(BenchReport& report) {
+		std::atomic<unsigned long> recorded(0);
+		std::atomic<unsigned long> analysed(0);
+		std::atomic<unsigned long> previewed(0);
+		Subscriber recorder([&](const cv::Mat&) { ++recorded; }, SubscriberPolicy::DROP_NEWEST, 8, 1);
+		Subscriber analytics([&](const cv::Mat&) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			++analysed;
+		}, SubscriberPolicy::LATEST_ONLY, 1, 1);
+		Subscriber preview([&](const cv::Mat&) { ++previewed; }, SubscriberPolicy::DECIMATE, 2, 4);
+
+		unsigned long long maxOfferMicros = 0;
+		const std::chrono::microseconds period(1000 * 1000 / FANOUT_FPS);
+		std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < FANOUT_FRAMES; ++i) {
+			const cv::Mat frame(480, 640, CV_8UC1);
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			recorder.offer(frame);
+			analytics.offer(frame);
+			preview.offer(frame);
+			const unsigned long long micros = std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::steady_clock::now() - start).count();
+			maxOfferMicros = std::max(maxOfferMicros, micros);
+
+			next += period;
+			std::this_thread::sleep_until(next);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		const SubscriberStats recorderStats = recorder.getStats();
+		const SubscriberStats analyticsStats = analytics.getStats();
+		const SubscriberStats previewStats = preview.getStats();
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("maxOfferMicros", (double) maxOfferMicros));
+		metrics.push_back(std::make_pair("recorderDelivered", (double) recorderStats.delivered));
+		metrics.push_back(std::make_pair("recorderDropped", (double) recorderStats.dropped));
+		metrics.push_back(std::make_pair("analyticsDelivered", (double) analyticsStats.delivered));
+		metrics.push_back(std::make_pair("analyticsDropped", (double) analyticsStats.dropped));
+		metrics.push_back(std::make_pair("previewDelivered", (double) previewStats.delivered));
+		metrics.push_back(std::make_pair("previewDropped", (double) previewStats.dropped));
+		report.add(GROUP, "fanOut", BenchReport::Parameters(1, std::make_pair("cameraFps", std::to_string(FANOUT_FPS))), metrics);
+		if (recorderStats.delivered != FANOUT_FRAMES || previewStats.delivered != FANOUT_FRAMES / 4) {
+			throw std::runtime_error("Slow subscriber held back the others");
+		}
+	}
+
+	// The whole camera on the synthetic backend. Consumers loop on grabFrameAsync(), each timing request to frame.
+	// At fps 0 the backend delivers as fast as frames are taken, which gives the sustained rate of the pipeline.
+	// CPU per frame includes rendering the synthetic frames, which stands in for the camera.
+	void
+	BenchSyntheticCamera(BenchReport& report, const Resolution& resolution, const Encoding& encoding, float fps,
+			unsigned int consumers) {
+		const SyntheticSource source = {fps, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setResolution(resolution.width, resolution.height);
+		camera.setEncoding(encoding);
+		camera.createCamera();
+		camera.startVideo();
+
+		const unsigned int framesPerConsumer = (fps > 0 ? SYNTHETIC_PACED_FRAME_COUNT : SYNTHETIC_FRAME_COUNT) / consumers;
+		std::vector<std::vector<double> > micros(consumers);
+		std::vector<std::thread> threads;
+		std::atomic<bool> failed(false);
+		const double cpuStart = GetCpuSeconds();
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int consumer = 0; consumer < consumers; ++consumer) {
+			threads.push_back(std::thread([&, consumer]() {
+				micros[consumer].reserve(framesPerConsumer);
+				try {
+					for (unsigned int i = 0; i < framesPerConsumer; ++i) {
+						const std::chrono::steady_clock::time_point request = std::chrono::steady_clock::now();
+						const cv::Mat frame = camera.grabFrameAsync().get();
+						micros[consumer].push_back(std::chrono::duration_cast<std::chrono::duration<double, std::micro> >(
+								std::chrono::steady_clock::now() - request).count());
+						if (frame.cols != resolution.width || frame.rows != resolution.height) {
+							failed = true;
+						}
+					}
+				} catch (const std::exception& e) {
+					EZLOG_WARN("Consumer [" << consumer << "] failed: " << e.what());
+					failed = true;
+				}
+			}));
+		}
+		for (auto&& thread : threads) {
+			thread.join();
+		}
+		const std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - start;
+		const double cpuSeconds = GetCpuSeconds() - cpuStart;
+		const CaptureStats stats = camera.getStats();
+		camera.stopVideo();
+		camera.destroyCamera();
+		if (failed) {
+			throw std::runtime_error("Synthetic camera failed a consumer");
+		}
+
+		std::vector<double> all;
+		for (auto&& samples : micros) {
+			all.insert(all.end(), samples.begin(), samples.end());
+		}
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("resolution", ToString(resolution)));
+		parameters.push_back(std::make_pair("encoding", std::string(GetEncodingName(encoding))));
+		parameters.push_back(std::make_pair("sourceFps", fps > 0 ? std::to_string((unsigned int) fps) : std::string("unlimited")));
+		parameters.push_back(std::make_pair("consumers", std::to_string(consumers)));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("fps", GetFps(all.size(), duration)));
+		metrics.push_back(std::make_pair("cpuMillisPerFrame", cpuSeconds * 1000 / all.size()));
+		metrics.push_back(std::make_pair("p50Micros", GetPercentile(all, 0.5)));
+		metrics.push_back(std::make_pair("p99Micros", GetPercentile(all, 0.99)));
+		metrics.push_back(std::make_pair("maxMicros", all.back()));
+		metrics.push_back(std::make_pair("decodeP50Micros", (double) stats.decode.p50));
+		metrics.push_back(std::make_pair("deliveryP99Micros", (double) stats.delivery.p99));
+		metrics.push_back(std::make_pair("poolStarvations", (double) stats.poolStarvations));
+		report.add(GROUP, "grabAsync", parameters, metrics);
+	}
+
+	// Streams, stills and leases through the synthetic backend, so the other grab paths are covered as well
+	void
+	CheckSyntheticCamera(const Resolution& resolution, const Encoding& encoding) {
+		const SyntheticSource source = {0, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setResolution(resolution.width, resolution.height);
+		camera.setEncoding(encoding);
+		camera.createCamera();
+		const unsigned int analytics = camera.addStream(320, 240, Encoding::NATIVE_GRAYSCALE);
+		camera.startVideo();
+
+		cv::Mat frame;
+		camera.grabFrame(frame);
+		cv::Mat small;
+		camera.grabStreamFrame(analytics, small);
+		cv::Mat still;
+		camera.grabStill(still);
+		if (frame.cols != resolution.width || frame.rows != resolution.height || small.cols != 320 || small.rows != 240
+				|| still.cols != resolution.width || still.rows != resolution.height) {
+			throw std::runtime_error("Synthetic camera delivered frames of the wrong size");
+		}
+		if (FrameDecoder::CanLease(encoding)) {
+			const FrameLease lease = camera.grabFrameLease();
+			if (!lease.isValid()) {
+				throw std::runtime_error("Synthetic camera did not lease a frame");
+			}
+		}
+		const CaptureStats stats = camera.getStats();
+		if (stats.frames == 0 || stats.decode.count == 0 || stats.latency.count != 1 || stats.waitTimeouts != 0) {
+			throw std::runtime_error("Synthetic camera did not record its frames");
+		}
+		camera.stopVideo();
+		camera.destroyCamera();
+	}
+
+	// Exposure sweep that waits for each new setting on the synthetic camera, which applies settings a couple of
+	// frames late like the real one. The old way grabbed every still twice and hoped for the best.
+	void
+	BenchSettingsSweep(BenchReport& report) {
+		const SyntheticSource source = {SETTINGS_FPS, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setResolution(640, 480);
+		camera.createCamera();
+		camera.startVideo();
+
+		cv::Mat frame;
+		FrameSettings settings;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int step = 1; step <= SETTINGS_STEPS; ++step) {
+			camera.setShutterSpeed(step);
+			camera.setAnalogGain(step);
+			camera.grabFrameWithSettings(frame, settings);
+			if (settings.exposureMicros != step * 1000 || settings.analogGain != step) {
+				throw std::runtime_error("Frame was not taken with the requested settings");
+			}
+		}
+		const double frameSeconds = GetSeconds(std::chrono::steady_clock::now() - start);
+		camera.stopVideo();
+
+		start = std::chrono::steady_clock::now();
+		for (unsigned int step = 1; step <= SETTINGS_STEPS; ++step) {
+			camera.setShutterSpeed(step);
+			camera.grabStillWithSettings(frame, settings);
+			if (settings.exposureMicros != step * 1000) {
+				throw std::runtime_error("Still was not taken with the requested settings");
+			}
+		}
+		const double stillSeconds = GetSeconds(std::chrono::steady_clock::now() - start);
+		camera.destroyCamera();
+
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("framePeriodsPerSetting", frameSeconds * SETTINGS_FPS / SETTINGS_STEPS));
+		metrics.push_back(std::make_pair("stillMillisPerSetting", stillSeconds * 1000 / SETTINGS_STEPS));
+		report.add(GROUP, "settingsSweep", BenchReport::Parameters(1, std::make_pair("cameraFps", std::to_string((unsigned int) SETTINGS_FPS))),
+				metrics);
+	}
+
+	// Calibration sweep of gains and shutter speeds, one setting at a time against one pipelined bracket
+	void
+	BenchBracketSweep(BenchReport& report) {
+		std::vector<FrameSettings> brackets;
+		for (unsigned int gain = 1; gain < 1u << BRACKET_GAINS; gain *= 2) {
+			for (unsigned int shutter = 1000; shutter < 1000u << BRACKET_SHUTTERS; shutter *= 2) {
+				FrameSettings settings = FrameSettings();
+				settings.exposureMicros = shutter;
+				settings.analogGain = gain;
+				brackets.push_back(settings);
+			}
+		}
+
+		const SyntheticSource source = {SETTINGS_FPS, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setResolution(640, 480);
+		camera.createCamera();
+		camera.startVideo();
+
+		cv::Mat frame;
+		FrameSettings settings;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (auto&& bracket : brackets) {
+			camera.setShutterSpeed(bracket.exposureMicros / 1000);
+			camera.setAnalogGain(bracket.analogGain);
+			camera.grabFrameWithSettings(frame, settings);
+		}
+		const double serialSeconds = GetSeconds(std::chrono::steady_clock::now() - start);
+
+		std::vector<cv::Mat> frames;
+		std::vector<FrameSettings> reported;
+		start = std::chrono::steady_clock::now();
+		camera.grabBracket(brackets, frames, reported);
+		const double bracketSeconds = GetSeconds(std::chrono::steady_clock::now() - start);
+		camera.stopVideo();
+		camera.destroyCamera();
+
+		for (unsigned int i = 0; i < brackets.size(); ++i) {
+			if (frames[i].empty() || reported[i].exposureMicros != brackets[i].exposureMicros
+					|| reported[i].analogGain != brackets[i].analogGain) {
+				throw std::runtime_error("Bracket frame was not taken with its settings");
+			}
+		}
+
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("serialPeriodsPerSetting", serialSeconds * SETTINGS_FPS / brackets.size()));
+		metrics.push_back(std::make_pair("bracketPeriodsPerSetting", bracketSeconds * SETTINGS_FPS / brackets.size()));
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("cameraFps", std::to_string((unsigned int) SETTINGS_FPS)));
+		parameters.push_back(std::make_pair("settings", std::to_string(brackets.size())));
+		report.add(GROUP, "bracketSweep", parameters, metrics);
+	}
+
+	// Takes frames until one arrives in the given size, returns when it did
+	std::chrono::steady_clock::time_point
+	WaitForSize(PiEye& camera, const Resolution& resolution) {
+		cv::Mat frame;
+		do {
+			camera.grabFrame(frame);
+		} while (frame.cols != resolution.width || frame.rows != resolution.height);
+		return std::chrono::steady_clock::now();
+	}
+
+	// Switches resolution and encoding of running video, hot against a destroy and create of the camera. The blackout
+	// of the hot path comes from getStats(), the restart is timed from its start until the first frame in the new size.
+	void
+	BenchReconfigure(BenchReport& report) {
+		const SyntheticSource source = {RECONFIGURE_FPS, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		const Encoding encodings[] = {Encoding::NATIVE_BGR, Encoding::NATIVE_GRAYSCALE, Encoding::CONVERTED_BGR};
+		PiEye camera(source);
+		camera.setResolution(BENCH_RESOLUTIONS[0].width, BENCH_RESOLUTIONS[0].height);
+		camera.createCamera();
+		camera.startVideo();
+		WaitForSize(camera, BENCH_RESOLUTIONS[0]);
+
+		std::vector<double> restarts;
+		for (unsigned int step = 1; step <= RECONFIGURE_STEPS; ++step) {
+			const Resolution& resolution = BENCH_RESOLUTIONS[step % 3];
+			camera.reconfigure(resolution.width, resolution.height, encodings[(step / 3) % 3]);
+			WaitForSize(camera, resolution);
+		}
+		const CaptureStats stats = camera.getStats();
+		if (stats.blackout.count != RECONFIGURE_STEPS) {
+			throw std::runtime_error("Not every reconfiguration recorded its blackout");
+		}
+
+		for (unsigned int step = 1; step <= RECONFIGURE_STEPS; ++step) {
+			const Resolution& resolution = BENCH_RESOLUTIONS[step % 3];
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			camera.destroyCamera();
+			camera.setResolution(resolution.width, resolution.height);
+			camera.setEncoding(encodings[(step / 3) % 3]);
+			camera.createCamera();
+			camera.startVideo();
+			restarts.push_back(GetSeconds(WaitForSize(camera, resolution) - start) * 1000);
+		}
+		camera.destroyCamera();
+
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("blackoutP50Millis", stats.blackout.p50 / 1000));
+		metrics.push_back(std::make_pair("blackoutMaxMillis", stats.blackout.max / 1000));
+		metrics.push_back(std::make_pair("restartP50Millis", GetPercentile(restarts, 0.5)));
+		metrics.push_back(std::make_pair("restartMaxMillis", restarts.back()));
+		report.add(GROUP, "reconfigure", BenchReport::Parameters(1, std::make_pair("cameraFps", std::to_string((unsigned int) RECONFIGURE_FPS))),
+				metrics);
+	}
+
+	// Time to the first frame and the first still, serial against startAsync, plus the timeline of the latter. The
+	// serial start delivers whatever comes first, startAsync only settled frames; its first still waits for neither.
+	void
+	BenchStartup(BenchReport& report, const Resolution& resolution) {
+		const SyntheticSource source = {STARTUP_FPS, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		cv::Mat frame;
+		cv::Mat still;
+		BenchReport::Metrics metrics;
+		{
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			PiEye camera(source);
+			camera.setResolution(resolution.width, resolution.height);
+			camera.createCamera();
+			camera.startVideo();
+			camera.grabFrame(frame);
+			metrics.push_back(std::make_pair("serialFirstFrameMillis", GetSeconds(std::chrono::steady_clock::now() - start) * 1000));
+			camera.grabStill(still);
+			metrics.push_back(std::make_pair("serialFirstStillMillis", GetSeconds(std::chrono::steady_clock::now() - start) * 1000));
+		}
+
+		// Settling goes on alongside the first still, so it should come as soon as without settling
+		{
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			PiEye camera(source);
+			camera.setResolution(resolution.width, resolution.height);
+			camera.startAsync(false).get();
+			camera.grabStill(still);
+			metrics.push_back(std::make_pair("unsettledFirstStillMillis", GetSeconds(std::chrono::steady_clock::now() - start) * 1000));
+		}
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		PiEye camera(source);
+		camera.setResolution(resolution.width, resolution.height);
+		camera.startAsync().get();
+		camera.grabStill(still);
+		metrics.push_back(std::make_pair("asyncFirstStillMillis", GetSeconds(std::chrono::steady_clock::now() - start) * 1000));
+		camera.grabFrame(frame);
+		metrics.push_back(std::make_pair("asyncFirstFrameMillis", GetSeconds(std::chrono::steady_clock::now() - start) * 1000));
+		if (frame.cols != resolution.width || still.cols != resolution.width) {
+			throw std::runtime_error("Started camera delivered frames of the wrong size");
+		}
+
+		const StartupTimeline timeline = camera.getStartupTimeline();
+		metrics.push_back(std::make_pair("componentCreatedMillis", timeline.componentCreated));
+		metrics.push_back(std::make_pair("configuredMillis", timeline.configured));
+		metrics.push_back(std::make_pair("portEnabledMillis", timeline.portEnabled));
+		metrics.push_back(std::make_pair("poolAllocatedMillis", timeline.poolAllocated));
+		metrics.push_back(std::make_pair("firstFrameMillis", timeline.firstFrame));
+		metrics.push_back(std::make_pair("stillReadyMillis", timeline.stillReady));
+		metrics.push_back(std::make_pair("readyMillis", timeline.ready));
+		metrics.push_back(std::make_pair("warmUpFrames", (double) timeline.warmUpFrames));
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("resolution", ToString(resolution)));
+		parameters.push_back(std::make_pair("cameraFps", std::to_string((unsigned int) STARTUP_FPS)));
+		report.add(GROUP, "startup", parameters, metrics);
+	}
+
+	// Unthrottled video next to full size stills, with video at the still size against small analytics frames. Video
+	// only costs what its own size needs.
+	void
+	BenchMixedResolutions(BenchReport& report, const Resolution& video) {
+		const Resolution& still = BENCH_RESOLUTIONS[3];
+		const SyntheticSource source = {0, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setVideoResolution(video.width, video.height);
+		camera.setStillResolution(still.width, still.height);
+		camera.createCamera();
+		camera.startVideo();
+
+		cv::Mat frame;
+		camera.grabFrame(frame);
+		const double cpuStart = GetCpuSeconds();
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < MIXED_FRAMES; ++i) {
+			camera.grabFrame(frame);
+		}
+		const std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - start;
+		const double cpuSeconds = GetCpuSeconds() - cpuStart;
+		cv::Mat image;
+		camera.grabStill(image);
+		camera.stopVideo();
+		camera.destroyCamera();
+		if (frame.cols != video.width || frame.rows != video.height || image.cols != still.width || image.rows != still.height) {
+			throw std::runtime_error("Video and stills were not taken in their own sizes");
+		}
+
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("videoFps", GetFps(MIXED_FRAMES, duration)));
+		metrics.push_back(std::make_pair("cpuMillisPerFrame", cpuSeconds * 1000 / MIXED_FRAMES));
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("video", ToString(video)));
+		parameters.push_back(std::make_pair("still", ToString(still)));
+		report.add(GROUP, "mixedResolutions", parameters, metrics);
+	}
+
+	// Analytics on 1080p video with and without the encoder stand-in, and what the stream looks like. Recording should
+	// cost grabFrame nothing on the camera; here the stand-in runs on the video thread, so it shows what handling the
+	// stream costs.
+	void
+	BenchRecording(BenchReport& report, const VideoCodec& codec) {
+		const Resolution& resolution = BENCH_RESOLUTIONS[2];
+		const SyntheticSource source = {RECORDING_FPS, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setVideoResolution(resolution.width, resolution.height);
+		camera.createCamera();
+		camera.startVideo();
+
+		cv::Mat frame;
+		camera.grabFrame(frame);
+		double cpuStart = GetCpuSeconds();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < RECORDING_FRAMES; ++i) {
+			camera.grabFrame(frame);
+		}
+		const double plainSeconds = GetSeconds(std::chrono::steady_clock::now() - start);
+		const double plainCpuSeconds = GetCpuSeconds() - cpuStart;
+
+		// Counted on the video thread
+		std::atomic<unsigned long long> bytes(0);
+		std::atomic<unsigned int> frames(0);
+		std::atomic<unsigned int> keyFrames(0);
+		std::atomic<bool> validStart(false);
+		const EncoderSettings settings = {codec, RECORDING_BITRATE, RECORDING_INTRA_PERIOD, H264Profile::HIGH};
+		camera.startRecording(settings, [&](const EncodedChunk& chunk) {
+			if (bytes == 0) {
+				const uint8_t sps[] = {0, 0, 0, 1, 0x67};
+				const uint8_t soi[] = {0xff, 0xd8};
+				validStart = codec == VideoCodec::H264 ? chunk.config && memcmp(chunk.data, sps, sizeof(sps)) == 0
+						: chunk.keyFrame && memcmp(chunk.data, soi, sizeof(soi)) == 0;
+			}
+			bytes += chunk.length;
+			if (chunk.frameEnd) {
+				++frames;
+				keyFrames += chunk.keyFrame ? 1 : 0;
+			}
+		});
+		camera.grabFrame(frame);
+		cpuStart = GetCpuSeconds();
+		start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < RECORDING_FRAMES; ++i) {
+			camera.grabFrame(frame);
+		}
+		const double recordingSeconds = GetSeconds(std::chrono::steady_clock::now() - start);
+		const double recordingCpuSeconds = GetCpuSeconds() - cpuStart;
+		camera.stopRecording();
+		camera.stopVideo();
+		camera.destroyCamera();
+
+		const double bitrate = frames > 0 ? bytes * 8.0 * RECORDING_FPS / frames : 0;
+		if (!validStart || frames == 0 || std::abs(bitrate - RECORDING_BITRATE) > RECORDING_BITRATE / 10) {
+			throw std::runtime_error("Recorded stream does not start with headers or misses its bitrate");
+		}
+
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("plainFps", RECORDING_FRAMES / plainSeconds));
+		metrics.push_back(std::make_pair("recordingFps", RECORDING_FRAMES / recordingSeconds));
+		metrics.push_back(std::make_pair("plainCpuMillisPerFrame", plainCpuSeconds * 1000 / RECORDING_FRAMES));
+		metrics.push_back(std::make_pair("recordingCpuMillisPerFrame", recordingCpuSeconds * 1000 / RECORDING_FRAMES));
+		metrics.push_back(std::make_pair("encodedFrames", frames.load()));
+		metrics.push_back(std::make_pair("keyFrames", keyFrames.load()));
+		metrics.push_back(std::make_pair("mbps", bitrate / 1e6));
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("resolution", ToString(resolution)));
+		parameters.push_back(std::make_pair("codec", codec == VideoCodec::H264 ? "H264" : "MJPEG"));
+		parameters.push_back(std::make_pair("bitrate", std::to_string(RECORDING_BITRATE)));
+		report.add(GROUP, "recording", parameters, metrics);
+	}
+
+	// Pre-roll held in a ring of the given size and how long a trigger takes to reach the disk, while analytics keep
+	// grabbing. A ring smaller than the pre-roll needs holds what fits.
+	void
+	BenchEventRecording(BenchReport& report, size_t memoryBytes) {
+		const Resolution& resolution = BENCH_RESOLUTIONS[2];
+		const SyntheticSource source = {RECORDING_FPS, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setVideoResolution(resolution.width, resolution.height);
+		camera.createCamera();
+		camera.startVideo();
+		const EncoderSettings settings = {VideoCodec::H264, RECORDING_BITRATE, RECORDING_INTRA_PERIOD, H264Profile::HIGH};
+		camera.startEventRecording(settings, EVENT_PRE_ROLL_SECONDS, memoryBytes);
+
+		// Fill the pre-roll, then trigger and keep grabbing until the file is written
+		cv::Mat frame;
+		const unsigned int fillFrames = (EVENT_PRE_ROLL_SECONDS + 1) * RECORDING_FPS;
+		for (unsigned int i = 0; i < fillFrames; ++i) {
+			camera.grabFrame(frame);
+		}
+		const EventRecordingStats before = camera.getEventRecordingStats();
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		camera.triggerEvent(EVENT_FILE, EVENT_POST_ROLL_SECONDS);
+		double maxGrabMillis = 0;
+		while (camera.getEventRecordingStats().flushing) {
+			const std::chrono::steady_clock::time_point grab = std::chrono::steady_clock::now();
+			camera.grabFrame(frame);
+			maxGrabMillis = std::max(maxGrabMillis, GetSeconds(std::chrono::steady_clock::now() - grab) * 1000);
+		}
+		const double flushSeconds = GetSeconds(std::chrono::steady_clock::now() - start);
+		const EventRecordingStats after = camera.getEventRecordingStats();
+		camera.stopEventRecording();
+		camera.stopVideo();
+		camera.destroyCamera();
+
+		std::ifstream file(EVENT_FILE, std::ios::binary | std::ios::ate);
+		const double fileBytes = file.tellg();
+		file.close();
+		std::remove(EVENT_FILE);
+		if (fileBytes <= 0 || after.droppedFrames > 0) {
+			throw std::runtime_error("Event recording lost video");
+		}
+
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("memoryMB", before.memoryBytes / 1e6));
+		metrics.push_back(std::make_pair("bufferedMB", before.bufferedBytes / 1e6));
+		metrics.push_back(std::make_pair("bufferedSeconds", before.bufferedSeconds));
+		metrics.push_back(std::make_pair("fileMB", fileBytes / 1e6));
+		metrics.push_back(std::make_pair("flushMillis", flushSeconds * 1000));
+		metrics.push_back(std::make_pair("maxGrabMillis", maxGrabMillis));
+		metrics.push_back(std::make_pair("droppedFrames", after.droppedFrames));
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("resolution", ToString(resolution)));
+		parameters.push_back(std::make_pair("preRollSeconds", std::to_string((int) EVENT_PRE_ROLL_SECONDS)));
+		parameters.push_back(std::make_pair("memoryMB", std::to_string(memoryBytes / 1000000)));
+		report.add(GROUP, "eventRecording", parameters, metrics);
+	}
+
+	// Event recording starts and stops over and over while another thread triggers short events and polls the stats.
+	// Every trigger must either be refused for want of a recorder or write its file, and nothing may be dropped.
+	void
+	StressEventRecording(BenchReport& report) {
+		const SyntheticSource source = {RECORDING_FPS, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setVideoResolution(BENCH_RESOLUTIONS[0].width, BENCH_RESOLUTIONS[0].height);
+		camera.createCamera();
+		camera.startVideo();
+
+		std::atomic<bool> triggering(true);
+		std::vector<std::string> files;
+		unsigned int refused = 0;
+		bool dropped = false;
+		std::string error;
+		std::thread trigger([&]() {
+			while (triggering) {
+				const std::string path = std::string(EVENT_FILE) + "." + std::to_string(files.size());
+				try {
+					dropped = dropped || camera.getEventRecordingStats().droppedFrames > 0;
+					if (camera.triggerEvent(path, 0.05f)) {
+						files.push_back(path);
+					}
+				} catch (const StateException&) {
+					++refused;
+				} catch (const std::exception& e) {
+					error = e.what();
+					return;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(EVENT_STRESS_TRIGGER_MILLIS));
+			}
+		});
+		const EncoderSettings settings = {VideoCodec::H264, RECORDING_BITRATE, RECORDING_INTRA_PERIOD, H264Profile::HIGH};
+		for (unsigned int i = 0; i < EVENT_STRESS_CYCLES; ++i) {
+			camera.startEventRecording(settings, EVENT_PRE_ROLL_SECONDS, 2000000);
+			std::this_thread::sleep_for(std::chrono::milliseconds(EVENT_STRESS_CYCLE_MILLIS));
+			camera.stopEventRecording();
+		}
+		triggering = false;
+		trigger.join();
+		const EventRecordingStats after = camera.getEventRecordingStats();
+		camera.stopVideo();
+		camera.destroyCamera();
+
+		unsigned int missing = 0;
+		for (auto&& path : files) {
+			std::ifstream file(path.c_str(), std::ios::binary);
+			if (!file) {
+				++missing;
+			}
+			file.close();
+			std::remove(path.c_str());
+		}
+
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("events", (double) files.size()));
+		metrics.push_back(std::make_pair("refused", (double) refused));
+		metrics.push_back(std::make_pair("missingFiles", (double) missing));
+		report.add(GROUP, "eventRecordingStress", BenchReport::Parameters(), metrics);
+		if (!error.empty()) {
+			throw std::runtime_error("Event recording failed a trigger while starting and stopping: " + error);
+		} else if (missing > 0 || dropped) {
+			throw std::runtime_error("Event recording lost events or video while starting and stopping");
+		} else if (after.flushing || after.events > 0) {
+			throw std::runtime_error("Event recording kept running after it was stopped");
+		} else if (files.empty()) {
+			throw std::runtime_error("Event recording never accepted a trigger while starting and stopping");
+		}
+	}
+
+	// Motion detection on every frame of 1080p video at 30 fps, nobody decoding. The gradient shifts with every frame, so
+	// every frame moves and the handler always runs.
+	void
+	BenchMotionDetection(BenchReport& report, unsigned int rowStep) {
+		const Resolution& resolution = BENCH_RESOLUTIONS[2];
+		const SyntheticSource source = {MOTION_FPS, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setEncoding(Encoding::NATIVE_GRAYSCALE);
+		camera.setVideoResolution(resolution.width, resolution.height);
+		camera.createCamera();
+		camera.startVideo();
+		std::atomic<unsigned int> events(0);
+		const MotionSettings settings = {32, rowStep, 10, 1, 2};
+		camera.startMotionDetection(settings, [&events](const MotionEvent&, const cv::Mat&) {
+			++events;
+		});
+		camera.resetStats();
+		const double cpuStart = GetCpuSeconds();
+		std::this_thread::sleep_for(std::chrono::seconds(MOTION_SECONDS));
+		const double cpuSeconds = GetCpuSeconds() - cpuStart;
+		const CaptureStats stats = camera.getStats();
+		camera.stopMotionDetection();
+		camera.stopVideo();
+		camera.destroyCamera();
+		if (stats.motion.count == 0 || events.load() + 1 < stats.motion.count) {
+			throw std::runtime_error("Motion detection missed frames of the moving gradient");
+		}
+
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("resolution", ToString(resolution)));
+		parameters.push_back(std::make_pair("encoding", std::string(GetEncodingName(Encoding::NATIVE_GRAYSCALE))));
+		parameters.push_back(std::make_pair("rowStep", std::to_string(rowStep)));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("fps", stats.fps));
+		metrics.push_back(std::make_pair("motionP50Micros", stats.motion.p50));
+		metrics.push_back(std::make_pair("motionP99Micros", stats.motion.p99));
+		metrics.push_back(std::make_pair("motionCorePercent", stats.motion.p50 * MOTION_FPS / 1e4));
+		metrics.push_back(std::make_pair("processCorePercent", cpuSeconds * 100 / MOTION_SECONDS));
+		report.add(GROUP, "motionDetection", parameters, metrics);
+	}
+
+	// Frame statistics of 1080p video at 30 fps, with nobody taking frames or with a consumer that takes every frame with
+	// its statistics
+	void
+	BenchFrameStatistics(BenchReport& report, bool consume) {
+		const Resolution& resolution = BENCH_RESOLUTIONS[2];
+		const SyntheticSource source = {STATISTICS_FPS, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setEncoding(Encoding::NATIVE_GRAYSCALE);
+		camera.setVideoResolution(resolution.width, resolution.height);
+		camera.createCamera();
+		camera.startVideo();
+		const StatisticsSettings settings = {4, 4, 2, 0, 0};
+		camera.startFrameStatistics(settings);
+
+		cv::Mat frame;
+		FrameStatistics statistics = FrameStatistics();
+		const double cpuStart = GetCpuSeconds();
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		unsigned int frames = 0;
+		while (std::chrono::steady_clock::now() - start < std::chrono::seconds(STATISTICS_SECONDS)) {
+			if (consume) {
+				camera.grabFrameWithStatistics(frame, statistics);
+				++frames;
+			} else {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+		}
+		const double cpuSeconds = GetCpuSeconds() - cpuStart;
+		const bool measured = camera.getFrameStatistics(statistics);
+		camera.stopFrameStatistics();
+		camera.stopVideo();
+		camera.destroyCamera();
+		if (!measured || statistics.cells.size() != 16 || statistics.pixels != resolution.width * resolution.height / 2) {
+			throw std::runtime_error("Frame statistics were not taken on the grid and rows asked for");
+		}
+
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("resolution", ToString(resolution)));
+		parameters.push_back(std::make_pair("mode", std::string(consume ? "withFrames" : "statsOnly")));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("consumedFps", frames / (double) STATISTICS_SECONDS));
+		metrics.push_back(std::make_pair("processCorePercent", cpuSeconds * 100 / STATISTICS_SECONDS));
+		metrics.push_back(std::make_pair("meanLuminance", statistics.frame.mean));
+		report.add(GROUP, "frameStatistics", parameters, metrics);
+	}
+
+	// Frames and time auto-exposure takes from 10 ms to a target, with a model learned from a bracket or with a gamma
+	// set too high. The synthetic sensor is linear until it clips, so the learned model lands in about one adjustment.
+	void
+	BenchAutoExposure(BenchReport& report, float intensity, bool learned) {
+		const SyntheticSource source = {EXPOSURE_FPS, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setEncoding(Encoding::NATIVE_GRAYSCALE);
+		camera.setVideoResolution(640, 480);
+		camera.createCamera();
+		camera.startVideo();
+		ExposureModel model = {EXPOSURE_MISTUNED_GAMMA};
+		if (learned) {
+			std::vector<FrameSettings> brackets;
+			for (unsigned int shutter = 2500; shutter <= 20000; shutter *= 2) {
+				FrameSettings bracket = FrameSettings();
+				bracket.exposureMicros = shutter;
+				bracket.analogGain = 1;
+				brackets.push_back(bracket);
+			}
+			model = camera.learnExposureModel(brackets);
+		}
+		cv::Mat frame;
+		FrameSettings settings;
+		camera.setShutterSpeed(10);
+		camera.setAnalogGain(1);
+		camera.grabFrameWithSettings(frame, settings);
+
+		const ExposureTarget target = {intensity, 0, 0, 0, 0, 0};
+		camera.startAutoExposure(target, model);
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		ExposureStats stats = ExposureStats();
+		while (stats.convergences == 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(EXPOSURE_TIMEOUT)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			stats = camera.getExposureStats();
+		}
+		camera.stopAutoExposure();
+		camera.stopVideo();
+		camera.destroyCamera();
+		if (stats.convergences == 0) {
+			throw std::runtime_error("Auto-exposure did not reach its target");
+		}
+
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("target", std::to_string((int) intensity)));
+		parameters.push_back(std::make_pair("model", std::string(learned ? "learned" : "mistuned")));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("gamma", model.gamma));
+		metrics.push_back(std::make_pair("framesToConverge", stats.framesToConverge));
+		metrics.push_back(std::make_pair("millisToConverge", stats.millisToConverge));
+		metrics.push_back(std::make_pair("adjustments", stats.adjustments));
+		metrics.push_back(std::make_pair("intensity", stats.intensity));
+		report.add(GROUP, "autoExposure", parameters, metrics);
+	}
+
+	// Two stand-in cameras at 30 fps paired into sets, with frames that jitter by up to the given time. Synthetic
+	// sources of the same rate capture in step, so the skew comes from the jitter and the delivery alone.
+	void
+	BenchStereoPairing(BenchReport& report, float jitterMillis) {
+		const SyntheticSource source = {RIG_FPS, SyntheticPattern::GRADIENT, std::vector<std::string>(), jitterMillis};
+		PiEyeRig rig(std::vector<SyntheticSource>(2, source));
+		for (unsigned int i = 0; i < rig.getCameraCount(); ++i) {
+			rig.getCamera(i).setEncoding(Encoding::NATIVE_GRAYSCALE);
+			rig.getCamera(i).setResolution(640, 480);
+		}
+		rig.setTolerance(RIG_TOLERANCE_MICROS);
+		rig.start();
+		rig.resetStats();
+
+		FrameSet set;
+		unsigned int sets = 0;
+		const double cpuStart = GetCpuSeconds();
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		while (std::chrono::steady_clock::now() - start < std::chrono::seconds(RIG_SECONDS)) {
+			rig.grabFrameSet(set);
+			if (set.frames.size() != 2 || set.skewMicros > RIG_TOLERANCE_MICROS || set.frames[0].empty() || set.frames[1].empty()) {
+				throw std::runtime_error("Rig paired frames beyond the tolerance");
+			}
+			++sets;
+		}
+		const double seconds = GetSeconds(std::chrono::steady_clock::now() - start);
+		const double cpuSeconds = GetCpuSeconds() - cpuStart;
+		const FrameSetStats stats = rig.getStats();
+		rig.stop();
+
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("cameras", std::string("2")));
+		parameters.push_back(std::make_pair("jitterMillis", std::to_string((int) jitterMillis)));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("setsPerSecond", sets / seconds));
+		metrics.push_back(std::make_pair("unmatchedPercent", stats.unmatched * 100.0 / std::max(1ull, stats.unmatched + 2 * stats.sets)));
+		metrics.push_back(std::make_pair("skewP50Micros", stats.skew.p50));
+		metrics.push_back(std::make_pair("skewP99Micros", stats.skew.p99));
+		metrics.push_back(std::make_pair("processCorePercent", cpuSeconds * 100 / seconds));
+		report.add(GROUP, "stereoPairing", parameters, metrics);
+	}
+
+	// Sustained rate of the unthrottled synthetic camera with a subscriber taking every frame, decoded on the callback
+	// thread (0 workers) or on a decode pool. The stand-in camera only has its 3 buffers, like the real video port, so
+	// the pool gains by slicing frames as much as by overlapping them.
+	void
+	BenchDecodeWorkers(BenchReport& report, const Resolution& resolution, const Encoding& encoding, unsigned int workers) {
+		const SyntheticSource source = {0, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setEncoding(encoding);
+		camera.setVideoResolution(resolution.width, resolution.height);
+		camera.setDecodeWorkers(workers);
+		camera.createCamera();
+		camera.startVideo();
+		std::atomic<unsigned long long> frames(0);
+		std::atomic<bool> failed(false);
+		const unsigned int subscriber = camera.subscribe([&](const cv::Mat& frame) {
+			failed = failed || frame.cols != resolution.width || frame.rows != resolution.height;
+			++frames;
+		}, SubscriberPolicy::LATEST_ONLY, 1);
+		camera.grabFrameAsync().get();
+		camera.resetStats();
+
+		const double cpuStart = GetCpuSeconds();
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::this_thread::sleep_for(std::chrono::seconds(DECODE_SECONDS));
+		const CaptureStats stats = camera.getStats();
+		const double seconds = GetSeconds(std::chrono::steady_clock::now() - start);
+		const double cpuSeconds = GetCpuSeconds() - cpuStart;
+		camera.unsubscribe(subscriber);
+		camera.stopVideo();
+		camera.destroyCamera();
+		if (failed || frames == 0 || stats.delivery.count == 0) {
+			throw std::runtime_error("Decode workers did not deliver frames of the right size");
+		}
+
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("resolution", ToString(resolution)));
+		parameters.push_back(std::make_pair("encoding", std::string(GetEncodingName(encoding))));
+		parameters.push_back(std::make_pair("workers", std::to_string(workers)));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("fps", stats.delivery.count / seconds));
+		metrics.push_back(std::make_pair("decodeP50Micros", (double) stats.decode.p50));
+		metrics.push_back(std::make_pair("deliveryP50Micros", (double) stats.delivery.p50));
+		metrics.push_back(std::make_pair("deliveryP99Micros", (double) stats.delivery.p99));
+		metrics.push_back(std::make_pair("cpuMillisPerFrame", cpuSeconds * 1000 / stats.delivery.count));
+		metrics.push_back(std::make_pair("poolStarvations", (double) stats.poolStarvations));
+		report.add(GROUP, "decodeWorkers", parameters, metrics);
+	}
+
+	// Stills per second from a grabStill loop against one continuous burst, on the synthetic camera. It does not model
+	// the still mode switch that bursts avoid on real hardware, so this shows what the reused Mats and the single
+	// capture start save, not the rate of the sensor.
+	void
+	BenchStillBurst(BenchReport& report, const Resolution& resolution) {
+		const SyntheticSource source = {0, SyntheticPattern::GRADIENT, std::vector<std::string>()};
+		PiEye camera(source);
+		camera.setResolution(resolution.width, resolution.height);
+		camera.createCamera();
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < BURST_STILLS; ++i) {
+			cv::Mat still;
+			camera.grabStill(still);
+		}
+		const std::chrono::steady_clock::duration loop = std::chrono::steady_clock::now() - start;
+
+		std::vector<cv::Mat> stills;
+		camera.grabStillBurst(stills, BURST_STILLS);
+		start = std::chrono::steady_clock::now();
+		camera.grabStillBurst(stills, BURST_STILLS);
+		const std::chrono::steady_clock::duration burst = std::chrono::steady_clock::now() - start;
+		camera.destroyCamera();
+
+		if (stills.size() != BURST_STILLS || stills.back().cols != resolution.width
+				|| stills.back().rows != resolution.height) {
+			throw std::runtime_error("Burst delivered stills of the wrong size");
+		}
+
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("loopStillsPerSecond", GetFps(BURST_STILLS, loop)));
+		metrics.push_back(std::make_pair("burstStillsPerSecond", GetFps(BURST_STILLS, burst)));
+		report.add(GROUP, "stillBurst", BenchReport::Parameters(1, std::make_pair("resolution", ToString(resolution))), metrics);
+	}
+}
+
+void
+RunMacroBenchmarks(BenchReport& report) {
+	StressFrameRing(report, QueuePolicy::OVERWRITE_OLDEST, 4, 0);
+	StressFrameRing(report, QueuePolicy::OVERWRITE_OLDEST, 4, 5);
+	StressFrameRing(report, QueuePolicy::REJECT_NEWEST, 4, 5);
+	StressFrameRing(report, QueuePolicy::OVERWRITE_OLDEST, 1, 5);
+	StressSharedRing(report, QueuePolicy::OVERWRITE_OLDEST, 4, 1);
+	StressSharedRing(report, QueuePolicy::OVERWRITE_OLDEST, 4, 2);
+	StressSharedRing(report, QueuePolicy::REJECT_NEWEST, 4, 2);
+
+	BenchAsyncOverlap(report, 1);
+	BenchAsyncOverlap(report, 2);
+	BenchAsyncOverlap(report, 3);
+
+	StressFanOut(report);
+	BenchSettingsSweep(report);
+	BenchBracketSweep(report);
+	BenchReconfigure(report);
+	BenchStartup(report, BENCH_RESOLUTIONS[1]);
+	BenchStartup(report, BENCH_RESOLUTIONS[3]);
+	BenchMixedResolutions(report, BENCH_RESOLUTIONS[3]);
+	BenchMixedResolutions(report, BENCH_RESOLUTIONS[0]);
+	BenchRecording(report, VideoCodec::H264);
+	BenchRecording(report, VideoCodec::MJPEG);
+	BenchEventRecording(report, 8000000);
+	BenchEventRecording(report, 2000000);
+	StressEventRecording(report);
+	BenchMotionDetection(report, 1);
+	BenchMotionDetection(report, 4);
+	BenchFrameStatistics(report, false);
+	BenchFrameStatistics(report, true);
+	BenchAutoExposure(report, 40, true);
+	BenchAutoExposure(report, 40, false);
+	BenchAutoExposure(report, 200, true);
+	BenchAutoExposure(report, 200, false);
+	BenchStereoPairing(report, 0);
+	BenchStereoPairing(report, 2);
+	BenchStereoPairing(report, 8);
+	const Resolution decodeResolutions[] = {BENCH_RESOLUTIONS[2], BENCH_RESOLUTIONS[3]};
+	const Encoding decodeEncodings[] = {Encoding::NATIVE_BGR, Encoding::CONVERTED_BGR};
+	for (auto&& resolution : decodeResolutions) {
+		for (auto&& encoding : decodeEncodings) {
+			for (unsigned int workers = 0; workers <= 4; ++workers) {
+				BenchDecodeWorkers(report, resolution, encoding, workers);
+			}
+		}
+	}
+	for (auto&& resolution : BENCH_RESOLUTIONS) {
+		BenchStillBurst(report, resolution);
+	}
+
+	const Encoding encodings[] = {Encoding::NATIVE_BGR, Encoding::NATIVE_GRAYSCALE, Encoding::CONVERTED_BGR};
+	const unsigned int consumers[] = {1, 2, 4};
+	for (auto&& resolution : BENCH_RESOLUTIONS) {
+		for (auto&& encoding : encodings) {
+			CheckSyntheticCamera(resolution, encoding);
+			for (auto&& count : consumers) {
+				BenchSyntheticCamera(report, resolution, encoding, 0, count);
+			}
+		}
+	}
+	for (auto&& count : consumers) {
+		BenchSyntheticCamera(report, BENCH_RESOLUTIONS[0], Encoding::NATIVE_BGR, SYNTHETIC_FPS, count);
+	}
+}
@@ -0,0 +1,713 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <Log.hpp>
+#include <EzRotatingFileSink.h>
+#include <EzBinaryFileSink.h>
+#include <interface/mmal/mmal_buffer.h>
+
+#include "AllocationCounter.h"
+#include "BenchReport.h"
+#include "BenchUtil.h"
+#include "CaptureStatsRecorder.h"
+#include "FrameDecoder.h"
+#include "FrameLease.h"
+#include "FrameMatcher.h"
+#include "FrameStatistician.h"
+#include "I420Converter.h"
+#include "MotionDetector.h"
+#include "SoftwareBufferPool.h"
+#include "SoftwareStreamGraph.h"
+#include "Wait.h"
+
+namespace {
+	const unsigned int FRAME_COUNT = 1000;
+	const unsigned int CONVERT_FRAME_COUNT = 200;
+	const unsigned int PYRAMID_LEVELS = 4;
+	const unsigned int POOL_SIZE = 3;
+	const unsigned int STREAM_FRAME_COUNT = 200;
+	const unsigned int WAKE_COUNT = 2000;
+	const unsigned int STATS_FRAME_COUNT = 1000000;
+	const unsigned int MOTION_FRAME_COUNT = 1000;
+	const unsigned int MOTION_POSITIONS = 8;
+	const unsigned int MOTION_SQUARE = 128;
+	const unsigned int STATISTICS_FRAME_COUNT = 200;
+	const unsigned int MATCH_FRAME_COUNT = 100000;
+	const long long MATCH_PERIOD_MICROS = 33333;
+	const unsigned int MATCH_TOLERANCE_MICROS = 5000;
+	const long long MATCH_PHASE_MICROS = 1000;		// Between neighbouring cameras
+	const unsigned int LOG_MESSAGES = 20000;
+	const unsigned int LOG_QUEUE_SIZE = 4096;
+	const char* const LOG_FILE = "PiEyeBench.log";
+	const char* const BINARY_LOG_FILE = "PiEyeBench.bin";
+	const char* const GROUP = "micro";
+
+	BenchReport::Parameters
+	GetFrameParameters(const Resolution& resolution, const Encoding& encoding) {
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("resolution", ToString(resolution)));
+		parameters.push_back(std::make_pair("encoding", std::string(GetEncodingName(encoding))));
+		return parameters;
+	}
+
+	BenchReport::Metrics
+	GetFrameMetrics(unsigned int frameSize, unsigned int frameCount, const std::chrono::steady_clock::duration& duration) {
+		const double fps = GetFps(frameCount, duration);
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("fps", fps));
+		metrics.push_back(std::make_pair("megabytesPerSecond", fps * frameSize / (1024 * 1024)));
+		return metrics;
+	}
+
+	// Copying decode versus leasing the buffer
+	void
+	BenchCopyAndLease(BenchReport& report, const Resolution& resolution, const Encoding& encoding) {
+		const FrameDecoder decoder(encoding, resolution.width, resolution.height);
+		const unsigned int frameSize = decoder.getFrameSize();
+		std::shared_ptr<SoftwareBufferPool> pool(new SoftwareBufferPool(POOL_SIZE, frameSize));
+		unsigned long checksum = 0;
+
+		// Copy: decode into a Mat owned by the consumer, buffer goes straight back to the pool
+		cv::Mat image;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < FRAME_COUNT; ++i) {
+			MMAL_BUFFER_HEADER_T* buffer = ProduceBuffer(*pool);
+			decoder.decode(*buffer, image);
+			pool->recycle(buffer);
+			checksum += ConsumeImage(image);
+		}
+		report.add(GROUP, "decode", GetFrameParameters(resolution, encoding),
+				GetFrameMetrics(frameSize, FRAME_COUNT, std::chrono::steady_clock::now() - start));
+
+		// Lease: wrap the buffer, it goes back to the pool when the lease is dropped
+		start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < FRAME_COUNT; ++i) {
+			MMAL_BUFFER_HEADER_T* buffer = ProduceBuffer(*pool);
+			const FrameLease lease = decoder.lease(buffer, pool);
+			checksum += ConsumeImage(lease.getImage());
+		}
+		report.add(GROUP, "lease", GetFrameParameters(resolution, encoding),
+				GetFrameMetrics(frameSize, FRAME_COUNT, std::chrono::steady_clock::now() - start));
+
+		if (pool->available() != POOL_SIZE) {
+			throw std::runtime_error("Pool leaked buffers: " + std::to_string(pool->available()) + " of "
+					+ std::to_string(POOL_SIZE) + " available");
+		}
+		EZLOG_DEBUG("Checksum [" << checksum << "]");
+	}
+
+	// Copies the padded planes of a camera buffer into the packed layout cv::cvtColor expects
+	cv::Mat
+	PackI420(const MMAL_BUFFER_HEADER_T& buffer, const FrameDecoder& decoder, const Resolution& resolution) {
+		const unsigned int stride = decoder.getStride();
+		const unsigned int alignedHeight = FrameDecoder::AlignHeight(resolution.height);
+		cv::Mat packed(resolution.height * 3 / 2, resolution.width, CV_8UC1);
+		uchar* target = packed.ptr<uchar>(0);
+		const uint8_t* planes[] = {buffer.data + buffer.offset, buffer.data + buffer.offset + stride * alignedHeight,
+				buffer.data + buffer.offset + stride * alignedHeight + (stride / 2) * (alignedHeight / 2)};
+		for (unsigned int plane = 0; plane < 3; ++plane) {
+			const unsigned int width = plane == 0 ? resolution.width : resolution.width / 2;
+			const unsigned int height = plane == 0 ? resolution.height : resolution.height / 2;
+			const unsigned int planeStride = plane == 0 ? stride : stride / 2;
+			for (unsigned int row = 0; row < height; ++row) {
+				memcpy(target, planes[plane] + row * planeStride, width);
+				target += width;
+			}
+		}
+		return packed;
+	}
+
+	// I420 transfer converted on the ARM side. The conversion must match cv::cvtColor.
+	void
+	BenchI420(BenchReport& report, const Resolution& resolution) {
+		const FrameDecoder decoder(Encoding::CONVERTED_BGR, resolution.width, resolution.height);
+		SoftwareBufferPool pool(POOL_SIZE, decoder.getFrameSize());
+		unsigned long checksum = 0;
+		cv::Mat image;
+
+		MMAL_BUFFER_HEADER_T* buffer = ProduceBuffer(pool);
+		FillNoise(*buffer);
+		decoder.decode(*buffer, image);
+		cv::Mat expected;
+		cv::cvtColor(PackI420(*buffer, decoder, resolution), expected, cv::COLOR_YUV2BGR_I420);
+		pool.recycle(buffer);
+		for (int row = 0; row < image.rows; ++row) {
+			if (memcmp(image.ptr<uchar>(row), expected.ptr<uchar>(row), image.cols * 3) != 0) {
+				throw std::runtime_error(std::string(I420Converter::GetKernelName()) + " I420 conversion differs from cvtColor");
+			}
+		}
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < CONVERT_FRAME_COUNT; ++i) {
+			buffer = ProduceBuffer(pool);
+			decoder.decode(*buffer, image);
+			pool.recycle(buffer);
+			checksum += ConsumeImage(image);
+		}
+		BenchReport::Parameters parameters = GetFrameParameters(resolution, Encoding::CONVERTED_BGR);
+		parameters.push_back(std::make_pair("kernel", std::string(I420Converter::GetKernelName())));
+		report.add(GROUP, "decode", parameters,
+				GetFrameMetrics(decoder.getFrameSize(), CONVERT_FRAME_COUNT, std::chrono::steady_clock::now() - start));
+		EZLOG_DEBUG("Checksum [" << checksum << "]");
+	}
+
+	// Decimated decode and pyramid decode against a full copy followed by cv::resize. Results may differ by rounding.
+	void
+	BenchDownscale(BenchReport& report, const Resolution& resolution, const Encoding& encoding) {
+		const FrameDecoder fullDecoder(encoding, resolution.width, resolution.height);
+		SoftwareBufferPool pool(POOL_SIZE, fullDecoder.getFrameSize());
+		MMAL_BUFFER_HEADER_T* buffer = ProduceBuffer(pool);
+		FillNoise(*buffer);
+		unsigned long checksum = 0;
+		cv::Mat full;
+		cv::Mat resized;
+		cv::Mat decimated;
+
+		const unsigned int divisors[] = {2, 4};
+		for (auto&& divisor : divisors) {
+			const FrameDecoder decoder(encoding, resolution.width, resolution.height, divisor);
+			const cv::Size size(resolution.width / divisor, resolution.height / divisor);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < CONVERT_FRAME_COUNT; ++i) {
+				fullDecoder.decode(*buffer, full);
+				cv::resize(full, resized, size, 0, 0, cv::INTER_AREA);
+				checksum += ConsumeImage(resized);
+			}
+			const double resizeFps = GetFps(CONVERT_FRAME_COUNT, std::chrono::steady_clock::now() - start);
+
+			start = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < CONVERT_FRAME_COUNT; ++i) {
+				decoder.decode(*buffer, decimated);
+				checksum += ConsumeImage(decimated);
+			}
+			const double decimateFps = GetFps(CONVERT_FRAME_COUNT, std::chrono::steady_clock::now() - start);
+
+			BenchReport::Parameters parameters = GetFrameParameters(resolution, encoding);
+			parameters.push_back(std::make_pair("divisor", std::to_string(divisor)));
+			BenchReport::Metrics metrics;
+			metrics.push_back(std::make_pair("resizeFps", resizeFps));
+			metrics.push_back(std::make_pair("fps", decimateFps));
+			metrics.push_back(std::make_pair("maxDifference", (double) MaxDifference(resized, decimated)));
+			report.add(GROUP, "decimate", parameters, metrics);
+		}
+
+		std::vector<cv::Mat> expected(PYRAMID_LEVELS);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < CONVERT_FRAME_COUNT; ++i) {
+			fullDecoder.decode(*buffer, expected[0]);
+			for (unsigned int level = 1; level < PYRAMID_LEVELS; ++level) {
+				cv::resize(expected[level - 1], expected[level], cv::Size(expected[level - 1].cols / 2,
+						expected[level - 1].rows / 2), 0, 0, cv::INTER_AREA);
+			}
+			checksum += ConsumeImage(expected.back());
+		}
+		const double resizeFps = GetFps(CONVERT_FRAME_COUNT, std::chrono::steady_clock::now() - start);
+
+		std::vector<cv::Mat> pyramid;
+		start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < CONVERT_FRAME_COUNT; ++i) {
+			fullDecoder.decodePyramid(*buffer, pyramid, PYRAMID_LEVELS);
+			checksum += ConsumeImage(pyramid.back());
+		}
+		const double pyramidFps = GetFps(CONVERT_FRAME_COUNT, std::chrono::steady_clock::now() - start);
+
+		int difference = 0;
+		for (unsigned int level = 0; level < PYRAMID_LEVELS; ++level) {
+			difference = std::max(difference, MaxDifference(expected[level], pyramid[level]));
+		}
+		BenchReport::Parameters parameters = GetFrameParameters(resolution, encoding);
+		parameters.push_back(std::make_pair("levels", std::to_string(PYRAMID_LEVELS)));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("resizeFps", resizeFps));
+		metrics.push_back(std::make_pair("fps", pyramidFps));
+		metrics.push_back(std::make_pair("maxDifference", (double) difference));
+		report.add(GROUP, "pyramid", parameters, metrics);
+		pool.recycle(buffer);
+		EZLOG_DEBUG("Checksum [" << checksum << "]");
+	}
+
+	// A square of inverted noise walks through the upper half of a noise frame. Every block under it must move and none
+	// in the lower half.
+	void
+	BenchMotion(BenchReport& report, const Resolution& resolution, unsigned int rowStep) {
+		const FrameDecoder decoder(Encoding::NATIVE_GRAYSCALE, resolution.width, resolution.height);
+		SoftwareBufferPool pool(MOTION_POSITIONS + 1, decoder.getFrameSize());
+		MMAL_BUFFER_HEADER_T* background = ProduceBuffer(pool);
+		FillNoise(*background);
+		std::vector<MMAL_BUFFER_HEADER_T*> frames;
+		for (unsigned int position = 0; position < MOTION_POSITIONS; ++position) {
+			MMAL_BUFFER_HEADER_T* frame = ProduceBuffer(pool);
+			memcpy(frame->data, background->data, background->length);
+			for (unsigned int y = 0; y < MOTION_SQUARE; ++y) {
+				uint8_t* row = frame->data + (MOTION_SQUARE / 2 + y) * decoder.getStride() + (position + 1) * MOTION_SQUARE;
+				for (unsigned int x = 0; x < MOTION_SQUARE; ++x) {
+					row[x] = 255 - row[x];
+				}
+			}
+			frames.push_back(frame);
+		}
+
+		const MotionSettings settings = {32, rowStep, 20, 4, 2};
+		MotionDetector detector(settings, resolution.width, resolution.height, decoder.getStride());
+		MotionEvent event;
+		detector.process(background->data, background->length, 0, event);
+		std::chrono::steady_clock::duration duration(0);
+		for (unsigned int i = 0; i < MOTION_FRAME_COUNT; ++i) {
+			const unsigned int position = i % MOTION_POSITIONS;
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			const bool moved = detector.process(frames[position]->data, frames[position]->length, i, event);
+			duration += std::chrono::steady_clock::now() - start;
+
+			if (!moved) {
+				throw std::runtime_error("Motion detection missed the square");
+			}
+			const cv::Mat& mask = detector.getMask();
+			const unsigned int squareBlocks = MOTION_SQUARE / settings.blockSize;
+			for (unsigned int y = 0; y < squareBlocks; ++y) {
+				for (unsigned int x = 0; x < squareBlocks; ++x) {
+					if (mask.at<uint8_t>(MOTION_SQUARE / 2 / settings.blockSize + y, (position + 1) * squareBlocks + x) == 0) {
+						throw std::runtime_error("Motion detection missed a block under the square");
+					}
+				}
+			}
+			bool quiet = true;
+			for (int y = mask.rows / 2; y < mask.rows; ++y) {
+				quiet = quiet && std::count(mask.ptr<uint8_t>(y), mask.ptr<uint8_t>(y) + mask.cols, 0) == mask.cols;
+			}
+			if (!quiet) {
+				throw std::runtime_error("Motion detection found motion where nothing moved");
+			}
+		}
+		for (auto&& frame : frames) {
+			pool.recycle(frame);
+		}
+		pool.recycle(background);
+
+		const double millis = GetSeconds(duration) * 1000 / MOTION_FRAME_COUNT;
+		BenchReport::Parameters parameters = GetFrameParameters(resolution, Encoding::NATIVE_GRAYSCALE);
+		parameters.push_back(std::make_pair("blockSize", std::to_string(settings.blockSize)));
+		parameters.push_back(std::make_pair("rowStep", std::to_string(rowStep)));
+		parameters.push_back(std::make_pair("kernel", std::string(MotionDetector::GetKernelName())));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("millisPerFrame", millis));
+		metrics.push_back(std::make_pair("corePercentAt30Fps", millis * 30 / 10));
+		report.add(GROUP, "motion", parameters, metrics);
+	}
+
+	// What a consumer computes itself from a decoded grayscale frame, like the intensity check of PiEyeTest
+	void
+	ScanImage(const cv::Mat& image, uint8_t darkLevel, uint8_t brightLevel, FrameStatistics& statistics) {
+		unsigned long long sum = 0;
+		unsigned int dark = 0;
+		unsigned int bright = 0;
+		uint8_t low = 255;
+		uint8_t high = 0;
+		std::fill(statistics.histogram, statistics.histogram + 256, 0);
+		for (int row = 0; row < image.rows; ++row) {
+			const uint8_t* pixels = image.ptr<uint8_t>(row);
+			for (int x = 0; x < image.cols; ++x) {
+				const uint8_t pixel = pixels[x];
+				sum += pixel;
+				dark += pixel <= darkLevel ? 1 : 0;
+				bright += pixel >= brightLevel ? 1 : 0;
+				low = std::min(low, pixel);
+				high = std::max(high, pixel);
+				++statistics.histogram[pixel];
+			}
+		}
+		const unsigned int pixels = image.rows * image.cols;
+		statistics.pixels = pixels;
+		statistics.frame.mean = (float) sum / pixels;
+		statistics.frame.min = low;
+		statistics.frame.max = high;
+		statistics.frame.darkFraction = (float) dark / pixels;
+		statistics.frame.brightFraction = (float) bright / pixels;
+	}
+
+	bool
+	SameStatistics(const FrameStatistics& first, const FrameStatistics& second) {
+		return first.pixels == second.pixels && first.frame.mean == second.frame.mean && first.frame.min == second.frame.min
+				&& first.frame.max == second.frame.max && first.frame.darkFraction == second.frame.darkFraction
+				&& first.frame.brightFraction == second.frame.brightFraction
+				&& std::equal(first.histogram, first.histogram + 256, second.histogram);
+	}
+
+	// Statistics of a grayscale frame: decoding and rescanning the copy, taking them during the decode, and reading the
+	// buffer without decoding at all
+	void
+	BenchStatistics(BenchReport& report, const Resolution& resolution) {
+		const FrameDecoder decoder(Encoding::NATIVE_GRAYSCALE, resolution.width, resolution.height);
+		SoftwareBufferPool pool(POOL_SIZE, decoder.getFrameSize());
+		MMAL_BUFFER_HEADER_T* buffer = ProduceBuffer(pool);
+		FillNoise(*buffer);
+		const StatisticsSettings settings = {4, 4, 1, 16, 240};
+		FrameStatistician statistician(settings, resolution.width, resolution.height);
+		cv::Mat frame;
+		FrameStatistics expected = FrameStatistics();
+		FrameStatistics decoded = FrameStatistics();
+		FrameStatistics measured = FrameStatistics();
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < STATISTICS_FRAME_COUNT; ++i) {
+			decoder.decode(*buffer, frame);
+			ScanImage(frame, settings.darkLevel, settings.brightLevel, expected);
+		}
+		const double rescanFps = GetFps(STATISTICS_FRAME_COUNT, std::chrono::steady_clock::now() - start);
+
+		start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < STATISTICS_FRAME_COUNT; ++i) {
+			decoder.decode(*buffer, frame, &statistician);
+			statistician.finish(i, decoded);
+		}
+		const double decodeFps = GetFps(STATISTICS_FRAME_COUNT, std::chrono::steady_clock::now() - start);
+
+		start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < STATISTICS_FRAME_COUNT; ++i) {
+			decoder.measure(*buffer, statistician);
+			statistician.finish(i, measured);
+		}
+		const double measureFps = GetFps(STATISTICS_FRAME_COUNT, std::chrono::steady_clock::now() - start);
+		pool.recycle(buffer);
+		if (!SameStatistics(expected, decoded) || !SameStatistics(expected, measured)) {
+			throw std::runtime_error(std::string(FrameStatistician::GetKernelName()) + " statistics differ from a rescan");
+		}
+
+		BenchReport::Parameters parameters = GetFrameParameters(resolution, Encoding::NATIVE_GRAYSCALE);
+		parameters.push_back(std::make_pair("grid", "4x4"));
+		parameters.push_back(std::make_pair("kernel", std::string(FrameStatistician::GetKernelName())));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("rescanFps", rescanFps));
+		metrics.push_back(std::make_pair("decodeFps", decodeFps));
+		metrics.push_back(std::make_pair("statsOnlyFps", measureFps));
+		report.add(GROUP, "frameStatistics", parameters, metrics);
+	}
+
+	// Recording, analytics and preview streams split off one camera frame by the software stand-in of the GPU graph
+	void
+	BenchStreamGraph(BenchReport& report) {
+		const StreamFormat streams[] = {{1920, 1080, Encoding::NATIVE_BGR}, {320, 240, Encoding::NATIVE_GRAYSCALE},
+				{640, 480, Encoding::CONVERTED_BGR}};
+		const unsigned int streamCount = sizeof(streams) / sizeof(streams[0]);
+		std::vector<unsigned int> counts(streamCount, 0);
+		std::vector<cv::Mat> lastFrames(streamCount);
+		SoftwareStreamGraph graph([&](unsigned int stream, const cv::Mat& frame) {
+			++counts[stream];
+			lastFrames[stream] = frame;
+		});
+		graph.build(std::vector<StreamFormat>(streams, streams + streamCount));
+
+		// Solid colour, so the gray stream has a known value
+		const cv::Mat source(1080, 1920, CV_8UC3, cv::Scalar(50, 100, 200));
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < STREAM_FRAME_COUNT; ++i) {
+			graph.process(source);
+		}
+		const std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - start;
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("source", std::string("1920x1080")));
+		parameters.push_back(std::make_pair("streams", std::to_string(streamCount)));
+		report.add(GROUP, "streamGraph", parameters, BenchReport::Metrics(1, std::make_pair("fps", GetFps(STREAM_FRAME_COUNT, duration))));
+
+		for (unsigned int stream = 0; stream < streamCount; ++stream) {
+			const cv::Mat& frame = lastFrames[stream];
+			if (counts[stream] != STREAM_FRAME_COUNT || frame.cols != streams[stream].width || frame.rows != streams[stream].height) {
+				throw std::runtime_error("Stream " + std::to_string(stream) + " lost frames or has the wrong size");
+			}
+		}
+		if (lastFrames[1].type() != CV_8UC1 || lastFrames[1].ptr<uint8_t>(120)[160] != (29 * 50 + 150 * 100 + 77 * 200 + 128) >> 8) {
+			throw std::runtime_error("Gray stream does not carry the luma of the source");
+		}
+		graph.destroy();
+	}
+
+	// Time from Wait::notify() on the callback side until the waiting grab runs again
+	void
+	BenchWaitLatency(BenchReport& report) {
+		Wait wait;
+		std::atomic<bool> ready(false);
+		std::atomic<long long> notified(0);
+		std::vector<double> micros;
+		micros.reserve(WAKE_COUNT);
+
+		std::thread waiter([&]() {
+			for (unsigned int i = 0; i < WAKE_COUNT; ++i) {
+				wait.wait(1, [&ready]() {
+					return ready.load();
+				});
+				const long long now = std::chrono::steady_clock::now().time_since_epoch().count();
+				micros.push_back((now - notified.load()) / 1000.0);
+				ready = false;
+			}
+		});
+		for (unsigned int i = 0; i < WAKE_COUNT; ++i) {
+			// Give the waiter time to go to sleep, like a grab between two frames
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			notified = std::chrono::steady_clock::now().time_since_epoch().count();
+			ready = true;
+			wait.notify();
+			while (ready) {
+				std::this_thread::yield();
+			}
+		}
+		waiter.join();
+
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("p50Micros", GetPercentile(micros, 0.5)));
+		metrics.push_back(std::make_pair("p99Micros", GetPercentile(micros, 0.99)));
+		metrics.push_back(std::make_pair("maxMicros", micros.back()));
+		report.add(GROUP, "waitWake", BenchReport::Parameters(), metrics);
+	}
+
+	// What the video callback and a consumer spend on getStats() bookkeeping per frame, clock reads included
+	void
+	BenchStatsRecording(BenchReport& report) {
+		CaptureStatsRecorder recorder;
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < STATS_FRAME_COUNT; ++i) {
+			const long long arrival = CaptureStatsRecorder::Now();
+			recorder.recordArrival(arrival, i * 33333ll);
+			const long long decodeStart = CaptureStatsRecorder::Now();
+			recorder.recordDecode(CaptureStatsRecorder::Now() - decodeStart);
+			recorder.recordDelivery(CaptureStatsRecorder::Now() - arrival);
+			recorder.recordLatency(arrival);
+		}
+		const std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - start;
+		const CaptureStats stats = recorder.getStats();
+		if (stats.frames != STATS_FRAME_COUNT || stats.latency.count != STATS_FRAME_COUNT
+				|| stats.frameInterval.p50 < 33333 * 0.94f || stats.frameInterval.p50 > 33333 * 1.06f) {
+			throw std::runtime_error("Stats recorder lost frames or misplaced the frame interval");
+		}
+		report.add(GROUP, "statsRecording", BenchReport::Parameters(), BenchReport::Metrics(1, std::make_pair("nanosPerFrame",
+				std::chrono::duration_cast<std::chrono::duration<double, std::nano> >(duration).count() / STATS_FRAME_COUNT)));
+	}
+
+	// Pairing frames of cameras that run at the same rate, each with a pts base of its own, a phase offset to the
+	// previous camera, capture times that jitter and a varying latency until arrival
+	void
+	BenchFrameMatching(BenchReport& report, unsigned int cameraCount, long long jitterMicros) {
+		std::mt19937 generator(cameraCount);
+		std::uniform_int_distribution<long long> jitter(-jitterMicros, jitterMicros);
+		std::uniform_int_distribution<long long> latency(2000, 2500);
+		FrameMatcher matcher(cameraCount, MATCH_TOLERANCE_MICROS);
+		const cv::Mat frame(4, 4, CV_8UC1, cv::Scalar(0));
+		std::vector<FrameSet> sets;
+		unsigned long long matched = 0;
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < MATCH_FRAME_COUNT; ++i) {
+			for (unsigned int camera = 0; camera < cameraCount; ++camera) {
+				const long long capture = i * MATCH_PERIOD_MICROS + camera * MATCH_PHASE_MICROS + jitter(generator);
+				const long long pts = capture + camera * 1000000000ll;
+				matcher.add(camera, frame, pts, (capture + latency(generator)) * 1000, sets);
+			}
+			matched += sets.size();
+			sets.clear();
+		}
+		const std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - start;
+		const FrameSetStats stats = matcher.getStats();
+		if (stats.sets != matched || (jitterMicros == 0 && (stats.unmatched != 0 || matched + 1 < MATCH_FRAME_COUNT))) {
+			throw std::runtime_error("Frame matcher lost sets of frames that line up");
+		}
+
+		BenchReport::Parameters parameters;
+		parameters.push_back(std::make_pair("cameras", std::to_string(cameraCount)));
+		parameters.push_back(std::make_pair("jitterMicros", std::to_string(jitterMicros)));
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("nanosPerFrame",
+				std::chrono::duration_cast<std::chrono::duration<double, std::nano> >(duration).count() / (MATCH_FRAME_COUNT * cameraCount)));
+		metrics.push_back(std::make_pair("unmatchedPercent", stats.unmatched * 100.0 / (MATCH_FRAME_COUNT * cameraCount)));
+		metrics.push_back(std::make_pair("skewP50Micros", stats.skew.p50));
+		metrics.push_back(std::make_pair("skewP99Micros", stats.skew.p99));
+		report.add(GROUP, "frameMatching", parameters, metrics);
+	}
+
+	// Counts the messages that reach the sink, so the bench can tell lost ones from those the logger reports dropped
+	class CountingSink : public EzSink {
+	public:
+		explicit CountingSink(const std::shared_ptr<EzSink>& sink) : _sink(sink), _written(0) {
+		}
+
+		virtual void
+		write(const EzMessage& message) {
+			_sink->write(message);
+			++_written;
+		}
+
+		virtual void
+		flush() {
+			_sink->flush();
+		}
+
+		unsigned long long
+		getWritten() const {
+			return _written;
+		}
+
+	private:
+		const std::shared_ptr<EzSink> _sink;
+		std::atomic<unsigned long long> _written;
+	};
+
+	void
+	CheckLoggedAll(const CountingSink& sink, const EzLogger& logger) {
+		if (sink.getWritten() + logger.getDropped() != LOG_MESSAGES) {
+			throw std::runtime_error("Logger lost messages: " + std::to_string(sink.getWritten()) + " written and "
+					+ std::to_string(logger.getDropped()) + " dropped of " + std::to_string(LOG_MESSAGES));
+		}
+	}
+
+	// Cost of one trace line on the logging thread, with messages written to a file either right away or by the
+	// background writer
+	void
+	BenchLogger(BenchReport& report, bool async) {
+		EzLogger logger;
+		const std::shared_ptr<CountingSink> sink(new CountingSink(std::shared_ptr<EzSink>(new EzRotatingFileSink(LOG_FILE,
+				64 * 1024 * 1024, 0))));
+		logger.setSink(sink);
+		if (async) {
+			logger.startAsync(LOG_QUEUE_SIZE);
+		}
+
+		std::vector<double> nanos;
+		nanos.reserve(LOG_MESSAGES);
+		for (unsigned int i = 0; i < LOG_MESSAGES; ++i) {
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			EzMessage message(EZLOG_LEVEL_TRACE, __FILE__, __LINE__);
+			message << "Buffer callback on port [" << "vc.ril.camera:out:1" << "], length [" << i << "]";
+			logger.log(message);
+			nanos.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - start).count());
+
+			// Roughly a few messages per frame at a high frame rate
+			if (i % 8 == 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		}
+		logger.stopAsync();
+		std::remove(LOG_FILE);
+
+		double total = 0;
+		for (auto&& value : nanos) {
+			total += value;
+		}
+		BenchReport::Metrics metrics;
+		metrics.push_back(std::make_pair("meanNanos", total / nanos.size()));
+		metrics.push_back(std::make_pair("p99Nanos", GetPercentile(nanos, 0.99)));
+		metrics.push_back(std::make_pair("maxNanos", nanos.back()));
+		metrics.push_back(std::make_pair("dropped", (double) logger.getDropped()));
+		report.add(GROUP, "logger", BenchReport::Parameters(1, std::make_pair("mode", std::string(async ? "async" : "sync"))), metrics);
+		CheckLoggedAll(*sink, logger);
+	}
+
+	unsigned long
+	FileSize(const char* path) {
+		std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+		return file ? (unsigned long) file.tellg() : 0;
+	}
+
+	// Logs the same trace lines as text and as binary. Building and queueing a message must not allocate.
+	void
+	BenchLogAllocations(BenchReport& report) {
+		for (unsigned int binary = 0; binary < 2; ++binary) {
+			EzLogger logger;
+			const std::shared_ptr<CountingSink> sink(new CountingSink(binary
+					? std::shared_ptr<EzSink>(new EzBinaryFileSink(BINARY_LOG_FILE))
+					: std::shared_ptr<EzSink>(new EzRotatingFileSink(LOG_FILE, 64 * 1024 * 1024, 0))));
+			logger.setSink(sink);
+			logger.startAsync(LOG_QUEUE_SIZE);
+
+			const unsigned long allocationsBefore = GetThreadAllocations();
+			for (unsigned int i = 0; i < LOG_MESSAGES; ++i) {
+				EzMessage message(EZLOG_LEVEL_TRACE, __FILE__, __LINE__);
+				message << "Buffer callback on port [" << "vc.ril.camera:out:1" << "], length [" << i << "], gain ["
+						<< 1.5f << "]";
+				logger.log(message);
+				if (i % 8 == 0) {
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+				}
+			}
+			const unsigned long allocations = GetThreadAllocations() - allocationsBefore;
+			logger.stopAsync();
+
+			BenchReport::Metrics metrics;
+			metrics.push_back(std::make_pair("allocationsPerMessage", (double) allocations / LOG_MESSAGES));
+			metrics.push_back(std::make_pair("bytesPerMessage", (double) FileSize(binary ? BINARY_LOG_FILE : LOG_FILE) / LOG_MESSAGES));
+			metrics.push_back(std::make_pair("dropped", (double) logger.getDropped()));
+			report.add(GROUP, "logFormat", BenchReport::Parameters(1, std::make_pair("format", std::string(binary ? "binary" : "text"))),
+					metrics);
+			if (allocations != 0) {
+				throw std::runtime_error("Logging allocated on the calling thread");
+			}
+			CheckLoggedAll(*sink, logger);
+		}
+		std::remove(LOG_FILE);
+		std::remove(BINARY_LOG_FILE);
+	}
+}
+
+void
+RunMicroBenchmarks(BenchReport& report) {
+	for (auto&& resolution : BENCH_RESOLUTIONS) {
+		BenchCopyAndLease(report, resolution, Encoding::NATIVE_BGR);
+		BenchCopyAndLease(report, resolution, Encoding::NATIVE_GRAYSCALE);
+		BenchI420(report, resolution);
+	}
+	for (auto&& resolution : BENCH_RESOLUTIONS) {
+		BenchDownscale(report, resolution, Encoding::NATIVE_GRAYSCALE);
+		BenchDownscale(report, resolution, Encoding::NATIVE_BGR);
+	}
+	for (auto&& resolution : BENCH_RESOLUTIONS) {
+		BenchStatistics(report, resolution);
+	}
+	const unsigned int rowSteps[] = {1, 2, 4};
+	for (auto&& rowStep : rowSteps) {
+		BenchMotion(report, BENCH_RESOLUTIONS[2], rowStep);
+	}
+	BenchStreamGraph(report);
+	BenchWaitLatency(report);
+	BenchStatsRecording(report);
+	const long long jitters[] = {0, 1000, 2500};
+	for (auto&& jitter : jitters) {
+		BenchFrameMatching(report, 2, jitter);
+	}
+	BenchFrameMatching(report, 4, 1000);
+	BenchLogger(report, false);
+	BenchLogger(report, true);
+	BenchLogAllocations(report);
+}
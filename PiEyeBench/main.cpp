@@ -0,0 +1,76 @@
+/* MIT License
+
+Copyright (c) 2017 Philippe Beckers
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include <Log.hpp>
+
+#include "BenchReport.h"
+#include "Benchmarks.h"
+
+namespace {
+	const char* const DEFAULT_JSON = "PiEyeBench.json";
+
+	void
+	PrintUsage(const char* program) {
+		EZLOG_INFO("Usage: " << program << " [micro|macro|all] [--json <file>], results go to [" << DEFAULT_JSON
+				<< "] by default");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	bool micro = true;
+	bool macro = true;
+	std::string json = DEFAULT_JSON;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "micro") == 0) {
+			macro = false;
+		} else if (strcmp(argv[i], "macro") == 0) {
+			micro = false;
+		} else if (strcmp(argv[i], "all") == 0) {
+			micro = macro = true;
+		} else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json = argv[++i];
+		} else {
+			PrintUsage(argv[0]);
+			return 2;
+		}
+	}
+
+	BenchReport report;
+	try {
+		if (micro) {
+			RunMicroBenchmarks(report);
+		}
+		if (macro) {
+			RunMacroBenchmarks(report);
+		}
+		report.write(json);
+	} catch (const std::exception& e) {
+		EZLOG_WARN("Something went wrong: " << e.what());
+		return 1;
+	}
+
+	return 0;
+}
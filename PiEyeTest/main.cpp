@@ -96,19 +96,42 @@ int main(int argc, char* argv[]) {
 		//std::this_thread::sleep_for(std::chrono::milliseconds(10000));
 		cv::Mat img;
 		
+		// Long shutter speeds need the frame rate to drop with them
+		cam.setFpsRange(0.3, 30);
+		std::vector<FrameSettings> brackets;
 		for (auto&& setting : settings) {
-			//EZLOG_INFO("grabbing still with ISO [" << setting.iso << "] and shutter speed [" << setting.shutterSpeed << "]");
-			EZLOG_INFO("grabbing still with analog gain [" << setting.analogGain << "] and shutter speed [" << setting.shutterSpeed << "]");
-			cam.setShutterSpeed(setting.shutterSpeed);
-			//cam.setIso(setting.iso);
-			cam.setAnalogGain(setting.analogGain);
-            
-            // Grab still twice, first one is usually still with old settings
+			FrameSettings bracket = FrameSettings();
+			bracket.exposureMicros = 1000 * setting.shutterSpeed;
+			bracket.analogGain = setting.analogGain;
+			brackets.push_back(bracket);
+		}
+		
+		// The next setting goes out while the frame of the current one is still exposed
+		EZLOG_INFO("grabbing a bracket of [" << settings.size() << "] settings");
+		std::vector<cv::Mat> frames;
+		std::vector<FrameSettings> frameSettings;
+		cam.grabBracket(brackets, frames, frameSettings);
+		for (unsigned int i = 0; i < settings.size(); ++i) {
+			const CameraSetting& setting = settings[i];
+			EZLOG_INFO("Camera reported exposure [" << frameSettings[i].exposureMicros << "] us and analog gain ["
+					<< frameSettings[i].analogGain << "] for analog gain [" << setting.analogGain << "] and shutter speed ["
+					<< setting.shutterSpeed << "]");
+			cv::imwrite("frame_" + std::to_string(setting.analogGain) + "x" + std::to_string(setting.shutterSpeed) + ".jpg", frames[i]);
+		}
+		
+		// Stills per second from single stills against one continuous burst, on the camera itself
+		const unsigned int burstStills = 10;
+		std::chrono::steady_clock::time_point burstStart = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < burstStills; ++i) {
 			cam.grabStill(img);
-            cam.grabStill(img);
-			//cv::imwrite("still_" + std::to_string(setting.iso) + "x" + std::to_string(setting.shutterSpeed) + ".jpg", img);
-			cv::imwrite("still_" + std::to_string(setting.analogGain) + "x" + std::to_string(setting.shutterSpeed) + ".jpg", img);
 		}
+		const float loopMillis = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - burstStart).count() / 1000.0f;
+		std::vector<cv::Mat> stills;
+		burstStart = std::chrono::steady_clock::now();
+		cam.grabStillBurst(stills, burstStills);
+		const float burstMillis = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - burstStart).count() / 1000.0f;
+		EZLOG_INFO("Took [" << burstStills << "] single stills at [" << burstStills * 1000 / loopMillis << "] per second and a burst at ["
+				<< burstStills * 1000 / burstMillis << "] per second");
 		
 		unsigned int counter = 0;
 		while (false) {